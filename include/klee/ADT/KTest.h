@@ -43,7 +43,8 @@ extern "C" {
   /* return true iff file at path matches KTest header */
   int   kTest_isKTestFile(const char *path);
 
-  /* returns NULL on (unspecified) error */
+  /* returns NULL on (unspecified) error; path may also be <pack>#<id> to
+     read the test with that id from a pack */
   KTest* kTest_fromFile(const char *path);
 
   /* returns 1 on success, 0 on (unspecified) error */
@@ -54,6 +55,34 @@ extern "C" {
 
   void  kTest_free(KTest *);
 
+
+  /* A pack stores many tests in one append-only file: a header followed
+     by a record for each test, holding its id and its .ktest contents. */
+  typedef struct KTestPack KTestPack;
+
+  /* return true iff file at path matches KTestPack header */
+  int   kTestPack_isKTestPackFile(const char *path);
+
+  /* creates an empty pack for appending; returns NULL on (unspecified) error */
+  KTestPack* kTestPack_create(const char *path);
+
+  /* returns 1 on success, 0 on (unspecified) error */
+  int   kTestPack_append(KTestPack *, unsigned id, KTest *);
+
+  /* opens a pack for reading and indexes its tests, ignoring a truncated
+     last one; returns NULL on (unspecified) error */
+  KTestPack* kTestPack_open(const char *path);
+
+  unsigned kTestPack_numTests(KTestPack *);
+
+  /* returns the id of the test at index */
+  unsigned kTestPack_getId(KTestPack *, unsigned index);
+
+  /* reads the test at index; returns NULL on (unspecified) error */
+  KTest* kTestPack_getTest(KTestPack *, unsigned index);
+
+  void  kTestPack_close(KTestPack *);
+
 #ifdef __cplusplus
 }
 #endif
@@ -164,6 +164,11 @@ public:
 
   virtual void getCoveredLines(const ExecutionState &state,
                                std::map<const std::string*, std::set<unsigned> > &res) = 0;
+
+  // the ids of the first instructions of the basic blocks the state ran
+  // through, in ascending order (only recorded for --minimize-tests)
+  virtual void getCoveredBlocks(const ExecutionState &state,
+                                std::vector<std::uint32_t> &res) = 0;
 };
 
 } // End klee namespace
@@ -0,0 +1,58 @@
+//===-- ArrayEliminator.h ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_ARRAYELIMINATOR_H
+#define KLEE_ARRAYELIMINATOR_H
+
+#include "klee/ADT/Ref.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+
+#include <cstdint>
+
+namespace klee {
+
+/// Rewrites array reads into array-free bitvector expressions where this can
+/// be done cheaply, before a query is handed to the core solver.
+///
+/// - Update chains with concrete indices are turned into if-then-else trees
+///   over the written values, e.g. read(U[2 := v], i) becomes
+///   (i == 2) ? v : read(U, i).
+/// - Reads whose index is provably bounded by a small value are expanded
+///   into an if-then-else tree over reads at concrete indices, which for
+///   constant arrays fold into the constant values themselves.
+///
+/// Results are cached and shared across queries.
+class ArrayEliminator {
+  ExprHashMap<ref<Expr>> cache;
+
+  /// Maximum number of concrete updates turned into an if-then-else tree
+  unsigned maxUpdates;
+
+  /// Maximum number of array elements a bounded read is expanded into
+  unsigned maxExpansion;
+
+  ref<Expr> eliminateRead(const ReadExpr &re);
+  ref<Expr> expandBoundedRead(const UpdateList &ul, const ref<Expr> &index);
+
+public:
+  ArrayEliminator(unsigned maxUpdates, unsigned maxExpansion)
+      : maxUpdates(maxUpdates), maxExpansion(maxExpansion) {}
+
+  /// Returns an equivalent version of \p e with as many array reads
+  /// eliminated as possible.
+  ref<Expr> eliminate(const ref<Expr> &e);
+
+  /// Computes an upper bound of the values \p e can take from its structure.
+  /// \return false if \p e is wider than 64 bits
+  static bool getUpperBound(const ref<Expr> &e, uint64_t &bound);
+};
+} // namespace klee
+
+#endif /* KLEE_ARRAYELIMINATOR_H */
@@ -11,6 +11,7 @@
 #define KLEE_ARRAYEXPROPTIMIZER_H
 
 #include <cstdint>
+#include <list>
 #include <map>
 #include <unordered_map>
 #include <unordered_set>
@@ -28,12 +29,40 @@ enum ArrayOptimizationType { NONE, ALL, INDEX, VALUE };
 using array2idx_ty = std::map<const Array *, std::vector<ref<Expr>>>;
 using mapIndexOptimizedExpr_ty = std::map<ref<Expr>, std::vector<ref<Expr>>>;
 
+/// Maps each distinct element value of an array to the [begin, end) index
+/// ranges holding it
+using valueRanges_ty =
+    std::map<uint64_t, std::vector<std::pair<uint64_t, uint64_t>>>;
+
 class ExprOptimizer {
 private:
   ExprHashMap<ref<Expr>> cacheExprOptimized;
   ExprHashSet cacheExprUnapplicable;
   ExprHashMap<ref<Expr>> cacheReadExprOptimized;
 
+  /// Result of the value-based analysis of a constant array for one element
+  /// width, independent of the index it is read at
+  struct ArrayValueTable {
+    /// Element values packed from the array's bytes
+    std::vector<uint64_t> values;
+    /// Whether the value ranges below have been computed yet
+    bool analyzed = false;
+    /// Whether the array has few enough distinct values to be optimized
+    bool applicable = false;
+    valueRanges_ty ranges;
+  };
+
+  using ArrayValueTableKey = std::pair<const Array *, Expr::Width>;
+
+  /// Analysis results for constant arrays, shared by all reads and queries,
+  /// most recently used first. The least recently used ones are dropped
+  /// beyond --array-value-table-cache-size entries. Arrays are owned by an
+  /// ArrayCache that lives as long as the executor, so they can be
+  /// identified by address.
+  std::list<std::pair<ArrayValueTableKey, ArrayValueTable>> arrayValueTables;
+  std::map<ArrayValueTableKey, decltype(arrayValueTables)::iterator>
+      arrayValueTableIndex;
+
 public:
   /// Returns the optimised version of e.
   /// @param e expression to optimise
@@ -50,10 +79,21 @@ private:
       std::map<const ReadExpr *, std::pair<ref<Expr>, Expr::Width>> &readInfo,
       bool isSymbolic);
 
+  ArrayValueTable &getArrayValueTable(const Array *array, Expr::Width width);
+
+  /// Packs the bytes of a constant array into elements of \p bytesPerElement
+  /// bytes each, in parallel for large arrays.
+  static void packArrayValues(const Array *array, unsigned bytesPerElement,
+                              std::vector<uint64_t> &values);
+
+  /// Computes the value ranges of \p arrayValues.
+  /// \return false if the array has too many distinct values to be optimized
+  static bool computeValueRanges(const std::vector<uint64_t> &arrayValues,
+                                 valueRanges_ty &ranges);
+
   ref<Expr> buildConstantSelectExpr(const ref<Expr> &index,
-                                    std::vector<uint64_t> &arrayValues,
-                                    Expr::Width width,
-                                    unsigned elementsInArray) const;
+                                    const valueRanges_ty &ranges,
+                                    Expr::Width width) const;
 
   ref<Expr>
   buildMixedSelectExpr(const ReadExpr *re,
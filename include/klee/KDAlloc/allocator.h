@@ -13,6 +13,7 @@
 #include "define.h"
 #include "location_info.h"
 #include "mapping.h"
+#include "size_classes.h"
 #include "suballocators/loh.h"
 #include "suballocators/slot_allocator.h"
 #include "tagged_logger.h"
@@ -30,7 +31,8 @@
 
 namespace klee::kdalloc {
 /// Wraps a mapping and delegates allocation to one of 8 sized-bin slot
-/// allocators (size < 4096) or a large object allocator (size >= 4096).
+/// allocators (size up to the largest size class) or a large object
+/// allocator (larger sizes).
 class Allocator final : public TaggedLogger<Allocator> {
 public:
   class Control final {
@@ -40,25 +42,17 @@ public:
     static constexpr const std::uint32_t unlimitedQuarantine =
         static_cast<std::uint32_t>(-1);
 
-    static constexpr const std::array<std::size_t, 8> meta = {
-        1u,    // bool
-        4u,    // int
-        8u,    // pointer size
-        16u,   // double
-        32u,   // compound types #1
-        64u,   // compound types #2
-        256u,  // compound types #3
-        2048u, // reasonable buffers
-    };
-
-    [[nodiscard]] static inline int
-    convertSizeToBinIndex(std::size_t const size) noexcept {
-      for (std::size_t i = 0; i < meta.size(); ++i) {
-        if (meta[i] >= size) {
+    static constexpr const std::size_t binCount =
+        std::tuple_size_v<SizeClasses>;
+
+    [[nodiscard]] inline int
+    convertSizeToBinIndex(std::size_t const size) const noexcept {
+      for (std::size_t i = 0; i < binCount; ++i) {
+        if (sizeClasses[i] >= size) {
           return i;
         }
       }
-      return meta.size();
+      return binCount;
     }
 
     [[nodiscard]] inline int
@@ -71,7 +65,7 @@ public:
       }
       assert(p >= largeObjectBin.mapping_begin() &&
              p < largeObjectBin.mapping_end());
-      return meta.size();
+      return binCount;
     }
 
   public:
@@ -79,7 +73,8 @@ public:
 
   private:
     Mapping mapping;
-    std::array<suballocators::SlotAllocatorControl, meta.size()> sizedBins;
+    SizeClasses sizeClasses;
+    std::array<suballocators::SlotAllocatorControl, binCount> sizedBins;
     suballocators::LargeObjectAllocator::Control largeObjectBin;
 
   public:
@@ -90,7 +85,8 @@ public:
     Control &operator=(Control &&) = delete;
 
   private:
-    Control(Mapping &&mapping) : mapping(std::move(mapping)) {}
+    Control(Mapping &&mapping, SizeClasses const &sizeClasses)
+        : mapping(std::move(mapping)), sizeClasses(sizeClasses) {}
   };
 
   static constexpr const auto unlimitedQuarantine =
@@ -101,7 +97,7 @@ private:
 
   std::array<std::aligned_union_t<0, suballocators::SlotAllocator<false>,
                                   suballocators::SlotAllocator<true>>,
-             Control::meta.size()>
+             Control::binCount>
       sizedBins;
   suballocators::LargeObjectAllocator largeObjectBin;
 
@@ -267,10 +263,15 @@ public:
     return control->mapping;
   }
 
+  SizeClasses const &getSizeClasses() const noexcept {
+    assert(!!*this && "Cannot get size classes of uninitialized allocator.");
+    return control->sizeClasses;
+  }
+
   [[nodiscard]] void *allocate(std::size_t size) {
     assert(*this && "Invalid allocator");
 
-    auto const bin = Control::convertSizeToBinIndex(size);
+    auto const bin = control->convertSizeToBinIndex(size);
     traceLine("Allocating ", size, " bytes in bin ", bin);
 
     void *result = nullptr;
@@ -317,7 +318,7 @@ public:
     assert(*this && "Invalid allocator");
     assert(ptr && "Freeing nullptrs is not supported"); // we are not ::free!
 
-    auto const bin = Control::convertSizeToBinIndex(size);
+    auto const bin = control->convertSizeToBinIndex(size);
     traceLine("Freeing ", ptr, " of size ", size, " in bin ", bin);
 
     if (bin < static_cast<int>(sizedBins.size())) {
@@ -342,12 +343,86 @@ public:
     traceLine("Getting size for ", ptr, " in bin ", bin);
 
     if (bin < static_cast<int>(sizedBins.size())) {
-      return Control::meta[bin];
+      return control->sizeClasses[bin];
     } else {
       return largeObjectBin.getSize(control->largeObjectBin, ptr);
     }
   }
 
+  /// Calls `f(block, bytes, shared)` for every block of copy-on-write state
+  /// held by this allocator. A block is shared if another allocator (usually
+  /// that of another execution state) references it as well.
+  template <typename F> void visitMemory(F &&f) const {
+    assert(*this && "Invalid allocator");
+
+    for (std::size_t i = 0; i < sizedBins.size(); ++i) {
+      if (control->sizedBins[i].isQuarantineUnlimited()) {
+        reinterpret_cast<suballocators::SlotAllocator<true> const &>(
+            sizedBins[i])
+            .visitMemory(control->sizedBins[i], f);
+      } else {
+        reinterpret_cast<suballocators::SlotAllocator<false> const &>(
+            sizedBins[i])
+            .visitMemory(control->sizedBins[i], f);
+      }
+    }
+    largeObjectBin.visitMemory(control->largeObjectBin, f);
+  }
+
+  /// Returns a hash of the allocation state, which is equal for allocators
+  /// that `deduplicate` can merge completely.
+  [[nodiscard]] std::size_t hash() const noexcept {
+    assert(*this && "Invalid allocator");
+
+    std::size_t result = 0;
+    for (std::size_t i = 0; i < sizedBins.size(); ++i) {
+      if (control->sizedBins[i].isQuarantineUnlimited()) {
+        result = result * 31 +
+                 reinterpret_cast<suballocators::SlotAllocator<true> const &>(
+                     sizedBins[i])
+                     .hash(control->sizedBins[i]);
+      } else {
+        result = result * 31 +
+                 reinterpret_cast<suballocators::SlotAllocator<false> const &>(
+                     sizedBins[i])
+                     .hash(control->sizedBins[i]);
+      }
+    }
+    return result * 31 + largeObjectBin.hash(control->largeObjectBin);
+  }
+
+  /// Makes every bin of `other` whose state equals the one of the same bin in
+  /// `*this` share that state. Both allocators must stem from the same
+  /// factory. Returns the number of bytes released by `other`.
+  std::size_t deduplicate(Allocator &other) {
+    assert(*this && "Invalid allocator");
+    assert(control.get() == other.control.get() &&
+           "Can only deduplicate allocators of the same factory");
+
+    std::size_t released = 0;
+    for (std::size_t i = 0; i < sizedBins.size(); ++i) {
+      if (control->sizedBins[i].isQuarantineUnlimited()) {
+        released +=
+            reinterpret_cast<suballocators::SlotAllocator<true> &>(sizedBins[i])
+                .deduplicate(
+                    control->sizedBins[i],
+                    reinterpret_cast<suballocators::SlotAllocator<true> &>(
+                        other.sizedBins[i]));
+      } else {
+        released +=
+            reinterpret_cast<suballocators::SlotAllocator<false> &>(
+                sizedBins[i])
+                .deduplicate(
+                    control->sizedBins[i],
+                    reinterpret_cast<suballocators::SlotAllocator<false> &>(
+                        other.sizedBins[i]));
+      }
+    }
+    released += largeObjectBin.deduplicate(control->largeObjectBin,
+                                           other.largeObjectBin);
+    return released;
+  }
+
   LocationInfo locationInfo(void const *const ptr,
                             std::size_t const size) const noexcept {
     assert(*this && "Invalid allocator");
@@ -358,7 +433,7 @@ public:
 
     // the following is technically UB if `ptr` does not actually point inside
     // the mapping at all
-    for (std::size_t i = 0; i < Allocator::Control::meta.size(); ++i) {
+    for (std::size_t i = 0; i < Allocator::Control::binCount; ++i) {
       if (control->sizedBins[i].mapping_begin() <= ptr &&
           ptr < control->sizedBins[i].mapping_end()) {
         if (reinterpret_cast<char const *>(ptr) + size <=
@@ -407,30 +482,35 @@ private:
 public:
   AllocatorFactory() = default;
 
-  AllocatorFactory(std::size_t const size, std::uint32_t const quarantineSize)
-      : AllocatorFactory(Mapping{0, size}, quarantineSize) {}
+  AllocatorFactory(std::size_t const size, std::uint32_t const quarantineSize,
+                   SizeClasses const &sizeClasses = defaultSizeClasses)
+      : AllocatorFactory(Mapping{0, size}, quarantineSize, sizeClasses) {}
 
   AllocatorFactory(std::uintptr_t const address, std::size_t const size,
-                   std::uint32_t const quarantineSize)
-      : AllocatorFactory(Mapping{address, size}, quarantineSize) {}
+                   std::uint32_t const quarantineSize,
+                   SizeClasses const &sizeClasses = defaultSizeClasses)
+      : AllocatorFactory(Mapping{address, size}, quarantineSize, sizeClasses) {
+  }
 
-  AllocatorFactory(Mapping &&mapping, std::uint32_t const quarantineSize) {
+  AllocatorFactory(Mapping &&mapping, std::uint32_t const quarantineSize,
+                   SizeClasses const &sizeClasses = defaultSizeClasses) {
+    assert(isValidSizeClasses(sizeClasses) && "Invalid size classes");
     if (mapping) {
       assert(mapping.getSize() >
-                 Allocator::Control::meta.size() * 4096 + 3 * 4096 &&
+                 Allocator::Control::binCount * 4096 + 3 * 4096 &&
              "Mapping is *far* too small");
 
-      control = new Allocator::Control(std::move(mapping));
+      control = new Allocator::Control(std::move(mapping), sizeClasses);
       auto const binSize =
           static_cast<std::size_t>(1)
           << (std::numeric_limits<std::size_t>::digits - 1 -
               countLeadingZeroes(control->mapping.getSize() /
-                                 (Allocator::Control::meta.size() + 1)));
+                                 (Allocator::Control::binCount + 1)));
       char *const base = static_cast<char *>(control->mapping.getBaseAddress());
       std::size_t totalSize = 0;
-      for (std::size_t i = 0; i < Allocator::Control::meta.size(); ++i) {
+      for (std::size_t i = 0; i < Allocator::Control::binCount; ++i) {
         control->sizedBins[i].initialize(
-            base + totalSize, binSize, Allocator::Control::meta[i],
+            base + totalSize, binSize, sizeClasses[i],
             quarantineSize == unlimitedQuarantine,
             quarantineSize == unlimitedQuarantine ? 0 : quarantineSize);
 
@@ -0,0 +1,160 @@
+//===-- size_classes.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KDALLOC_SIZE_CLASSES_H
+#define KDALLOC_SIZE_CLASSES_H
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <vector>
+
+namespace klee::kdalloc {
+/// Slot sizes of the sized bins, in strictly increasing order. Larger
+/// allocations are served by the large object allocator.
+using SizeClasses = std::array<std::size_t, 8>;
+
+inline constexpr SizeClasses defaultSizeClasses = {
+    1u,    // bool
+    4u,    // int
+    8u,    // pointer size
+    16u,   // double
+    32u,   // compound types #1
+    64u,   // compound types #2
+    256u,  // compound types #3
+    2048u, // reasonable buffers
+};
+
+/// Size classes have to be powers of two (slot positions are derived from
+/// their alignment), strictly increasing and smaller than a page.
+[[nodiscard]] inline bool
+isValidSizeClasses(SizeClasses const &sizeClasses) noexcept {
+  for (std::size_t i = 0; i < sizeClasses.size(); ++i) {
+    auto const size = sizeClasses[i];
+    if (size == 0 || (size & (size - 1)) != 0) {
+      return false;
+    }
+    if (i > 0 && size <= sizeClasses[i - 1]) {
+      return false;
+    }
+  }
+  return sizeClasses.back() < 4096;
+}
+
+/// Derives size classes from a histogram mapping allocation sizes to their
+/// number of occurrences. The largest class is kept at the default, so that
+/// no allocation moves to the large object allocator. The other classes are
+/// chosen among the powers of two to minimize the total number of bytes
+/// wasted in slots.
+[[nodiscard]] inline SizeClasses
+deriveSizeClasses(std::map<std::size_t, std::uint64_t> const &histogram) {
+  constexpr std::size_t classes = std::tuple_size_v<SizeClasses>;
+  std::size_t const largest = defaultSizeClasses.back();
+
+  std::vector<std::size_t> sizes;
+  std::vector<std::uint64_t> counts;
+  for (auto const &[size, count] : histogram) {
+    if (size >= largest || count == 0) {
+      continue;
+    }
+    std::size_t s = 1;
+    while (s < size) {
+      s *= 2;
+    }
+    if (s >= largest) {
+      continue;
+    }
+    if (!sizes.empty() && sizes.back() == s) {
+      counts.back() += count;
+    } else {
+      sizes.push_back(s);
+      counts.push_back(count);
+    }
+  }
+
+  std::vector<std::size_t> chosen;
+  if (sizes.size() < classes) {
+    // every size gets its own class, the rest is filled with defaults
+    chosen = sizes;
+    for (std::size_t i = 0; chosen.size() < classes - 1; ++i) {
+      if (std::find(chosen.begin(), chosen.end(), defaultSizeClasses[i]) ==
+          chosen.end()) {
+        chosen.push_back(defaultSizeClasses[i]);
+      }
+    }
+    std::sort(chosen.begin(), chosen.end());
+  } else {
+    // waste(i, j): bytes wasted by sizes i..j-1 in a class of size sizes[j-1]
+    std::size_t const n = sizes.size();
+    std::vector<std::uint64_t> prefixCount(n + 1, 0), prefixBytes(n + 1, 0);
+    for (std::size_t i = 0; i < n; ++i) {
+      prefixCount[i + 1] = prefixCount[i] + counts[i];
+      prefixBytes[i + 1] = prefixBytes[i] + counts[i] * sizes[i];
+    }
+    auto waste = [&](std::size_t i, std::size_t j) {
+      return (prefixCount[j] - prefixCount[i]) * sizes[j - 1] -
+             (prefixBytes[j] - prefixBytes[i]);
+    };
+
+    // cost[k][j]: minimal waste of sizes 0..j-1 in k classes, the largest of
+    // which is sizes[j-1]; sizes above the last class go to the largest one
+    constexpr auto infinity = std::numeric_limits<std::uint64_t>::max();
+    std::vector<std::vector<std::uint64_t>> cost(
+        classes, std::vector<std::uint64_t>(n + 1, infinity));
+    std::vector<std::vector<std::size_t>> split(
+        classes, std::vector<std::size_t>(n + 1, 0));
+    cost[0][0] = 0;
+    for (std::size_t k = 1; k < classes; ++k) {
+      for (std::size_t j = k; j <= n; ++j) {
+        for (std::size_t i = k - 1; i < j; ++i) {
+          if (cost[k - 1][i] == infinity) {
+            continue;
+          }
+          auto const c = cost[k - 1][i] + waste(i, j);
+          if (c < cost[k][j]) {
+            cost[k][j] = c;
+            split[k][j] = i;
+          }
+        }
+      }
+    }
+
+    std::size_t best = n;
+    std::uint64_t bestCost = infinity;
+    for (std::size_t j = classes - 1; j <= n; ++j) {
+      if (cost[classes - 1][j] == infinity) {
+        continue;
+      }
+      auto const remaining = (prefixCount[n] - prefixCount[j]) * largest -
+                             (prefixBytes[n] - prefixBytes[j]);
+      if (cost[classes - 1][j] + remaining < bestCost) {
+        bestCost = cost[classes - 1][j] + remaining;
+        best = j;
+      }
+    }
+
+    for (std::size_t k = classes - 1, j = best; k > 0; j = split[k][j], --k) {
+      chosen.push_back(sizes[j - 1]);
+    }
+    std::reverse(chosen.begin(), chosen.end());
+  }
+
+  SizeClasses result{};
+  std::copy(chosen.begin(), chosen.end(), result.begin());
+  result.back() = largest;
+  assert(isValidSizeClasses(result));
+  return result;
+}
+} // namespace klee::kdalloc
+
+#endif
@@ -84,6 +84,17 @@ public:
     return ptr != nullptr && ptr->referenceCount == 1;
   }
 
+  /// Returns the number of `CoWPtr`s sharing the managed object, or 0 if
+  /// `*this` is in an empty state.
+  [[nodiscard]] std::size_t getReferenceCount() const noexcept {
+    return ptr != nullptr ? ptr->referenceCount : 0;
+  }
+
+  /// Returns the number of bytes allocated for each managed object.
+  [[nodiscard]] static constexpr std::size_t getAllocationSize() noexcept {
+    return sizeof(Wrapper);
+  }
+
   /// Accesses an existing object.
   /// Must not be called when `*this` is in an empty state.
   T const &operator*() const noexcept {
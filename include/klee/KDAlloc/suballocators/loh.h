@@ -19,6 +19,7 @@
 
 #include <cassert>
 #include <cstddef>
+#include <cstring>
 #include <functional>
 #include <ostream>
 #include <utility>
@@ -239,6 +240,61 @@ public:
                                          size);
   }
 
+  /// Calls `f(block, bytes, shared)` for every block of copy-on-write state
+  /// of this allocator, including the nodes of the region treap.
+  template <typename F>
+  void visitMemory(Control const &control, F &&f) const {
+    if (data) {
+      bool const shared = data->referenceCount > 1;
+      f(static_cast<void const *>(data),
+        sizeof(Data) + control.quarantineSize * sizeof(Data::QuarantineElement),
+        shared);
+      data->regions.visitNodes(f, shared);
+    }
+  }
+
+  [[nodiscard]] std::size_t hash(Control const &control) const noexcept {
+    if (!data) {
+      return 0;
+    }
+
+    auto result = data->regions.hash();
+    for (std::uint32_t i = 0; i < control.quarantineSize; ++i) {
+      result = result * 31 + reinterpret_cast<std::uintptr_t const &>(
+                                 data->quarantine[i]);
+    }
+    return result;
+  }
+
+  /// Makes `other` share the state of `*this` if both describe the same
+  /// regions and quarantine. Returns the number of bytes that were released by
+  /// `other`.
+  std::size_t deduplicate(Control const &control, LargeObjectAllocator &other) {
+    if (!data || !other.data || data == other.data) {
+      return 0;
+    }
+
+    if (std::memcmp(&data->quarantine[0], &other.data->quarantine[0],
+                    control.quarantineSize *
+                        sizeof(Data::QuarantineElement)) != 0 ||
+        !data->regions.isEqual(other.data->regions)) {
+      return 0;
+    }
+
+    std::size_t released = 0;
+    if (other.data->referenceCount == 1) {
+      other.visitMemory(control,
+                        [&released](void const *, std::size_t bytes,
+                                    bool shared) {
+                          if (!shared) {
+                            released += bytes;
+                          }
+                        });
+    }
+    other = *this;
+    return released;
+  }
+
   [[nodiscard]] void *allocate(Control const &control, std::size_t size) {
     if (!data) {
       data = static_cast<Data *>(std::malloc(
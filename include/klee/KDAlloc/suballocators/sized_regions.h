@@ -483,6 +483,57 @@ public:
     return out;
   }
 
+private:
+  template <typename F>
+  static void visitRec(CoWPtr<Node> const &treap, F &f, bool shared) {
+    if (treap) {
+      shared = shared || treap.getReferenceCount() > 1;
+      f(static_cast<void const *>(treap.get()),
+        CoWPtr<Node>::getAllocationSize(), shared);
+      visitRec(treap->lhs, f, shared);
+      visitRec(treap->rhs, f, shared);
+    }
+  }
+
+  static bool isEqualRec(CoWPtr<Node> const &lhs,
+                         CoWPtr<Node> const &rhs) noexcept {
+    if (lhs.get() == rhs.get()) {
+      return true;
+    }
+    if (!lhs || !rhs) {
+      return false;
+    }
+    return lhs->getBaseAddress() == rhs->getBaseAddress() &&
+           lhs->getSize() == rhs->getSize() && isEqualRec(lhs->lhs, rhs->lhs) &&
+           isEqualRec(lhs->rhs, rhs->rhs);
+  }
+
+  static std::size_t hashRec(CoWPtr<Node> const &treap) noexcept {
+    if (!treap) {
+      return 0;
+    }
+    auto result = treap->hash() ^ treap->getSize();
+    result = result * 31 + hashRec(treap->lhs);
+    result = result * 31 + hashRec(treap->rhs);
+    return result;
+  }
+
+public:
+  /// Calls `f(node, bytes, shared)` for every node of the treap. A node counts
+  /// as shared if it, or one of its ancestors, is referenced from more than one
+  /// place, as it would then survive the destruction of this treap.
+  template <typename F> void visitNodes(F &&f, bool shared = false) const {
+    visitRec(root, f, shared);
+  }
+
+  /// Returns `true` iff both treaps describe the same regions. As the shape of
+  /// a treap is determined by its keys, this is a structural comparison.
+  [[nodiscard]] bool isEqual(SizedRegions const &other) const noexcept {
+    return isEqualRec(root, other.root);
+  }
+
+  [[nodiscard]] std::size_t hash() const noexcept { return hashRec(root); }
+
 private:
   static void checkInvariants(std::pair<bool, bool> &result,
                               CoWPtr<Node> const &treap) {
@@ -16,6 +16,7 @@
 
 #include "klee/ADT/Bits.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <cstring>
@@ -478,6 +479,55 @@ public:
     }
   }
 
+  /// Calls `f(block, bytes, shared)` for the copy-on-write state of this
+  /// allocator.
+  template <typename F>
+  void visitMemory(Control const &control, F &&f) const {
+    if (data) {
+      f(static_cast<void const *>(data),
+        control.prefixSize + data->capacity * sizeof(std::size_t),
+        data->referenceCount > 1);
+    }
+  }
+
+  [[nodiscard]] std::size_t hash(Control const &control) const noexcept {
+    if (!data) {
+      return 0;
+    }
+
+    auto const words = static_cast<std::size_t>(
+        control.quarantineSize + getLastUsed(control) + 1);
+    std::size_t result = words;
+    for (std::size_t i = 0; i < words; ++i) {
+      result = result * 31 + data->quarantineAndBitmap[i];
+    }
+    return result;
+  }
+
+  /// Makes `other` share the state of `*this` if both track the same slots and
+  /// quarantine. Returns the number of bytes that were released by `other`.
+  std::size_t deduplicate(Control const &control, SlotAllocator &other) {
+    if (!data || !other.data || data == other.data) {
+      return 0;
+    }
+
+    auto const lastUsed = getLastUsed(control);
+    if (lastUsed != other.getLastUsed(control) ||
+        !std::equal(&data->quarantineAndBitmap[0],
+                    &data->quarantineAndBitmap[control.quarantineSize +
+                                               lastUsed + 1],
+                    &other.data->quarantineAndBitmap[0])) {
+      return 0;
+    }
+
+    std::size_t released = 0;
+    if (other.data->referenceCount == 1) {
+      released = control.prefixSize + other.data->capacity * sizeof(std::size_t);
+    }
+    other = *this;
+    return released;
+  }
+
   [[nodiscard]] void *allocate(Control const &control) noexcept {
     traceLine("Allocating ", control.slotSize, " bytes");
     traceContents(control);
@@ -567,6 +617,14 @@ public:
     }
   }
 
+  template <typename F> void visitMemory(Control const &, F &&) const {}
+
+  [[nodiscard]] std::size_t hash(Control const &) const noexcept {
+    return next;
+  }
+
+  std::size_t deduplicate(Control const &, SlotAllocator &) { return 0; }
+
   [[nodiscard]] void *allocate(Control const &control) noexcept {
     traceLine("Allocating ", control.slotSize, " bytes");
 
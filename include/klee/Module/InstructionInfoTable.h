@@ -73,7 +73,15 @@ namespace klee {
     std::vector<std::unique_ptr<std::string>> internedStrings;
 
   public:
-    explicit InstructionInfoTable(const llvm::Module &m);
+    /// Builds the table for \p m. The lines in the generated assembly.ll
+    /// are computed by printing the module, unless \p assemblyLines holds
+    /// them in the order returned by getAssemblyLines().
+    explicit InstructionInfoTable(
+        const llvm::Module &m, const std::vector<uint64_t> &assemblyLines = {});
+
+    /// Returns the assembly lines of each function of \p m followed by the
+    /// ones of its instructions.
+    std::vector<uint64_t> getAssemblyLines(const llvm::Module &m) const;
 
     unsigned getMaxID() const;
     const InstructionInfo &getInfo(const llvm::Instruction &) const;
@@ -19,6 +19,7 @@
 #include <vector>
 
 namespace llvm {
+  class Function;
   class Instruction;
 }
 
@@ -26,6 +27,7 @@ namespace klee {
   class Executor;
   struct InstructionInfo;
   class KModule;
+  struct SpecialFunctionBinding;
 
 
   /// KInstruction - Intermediate instruction representation used
@@ -59,6 +61,16 @@ namespace klee {
     /// instruction.
     uint64_t offset;
   };
+
+  struct KCallInstruction : KInstruction {
+    /// calledFunction - The statically known callee, or null for indirect
+    /// calls and inline assembly. Bound by the executor.
+    llvm::Function *calledFunction = nullptr;
+
+    /// specialFunction - How the executor handles calls to calledFunction
+    /// internally, or null if they are executed normally.
+    const SpecialFunctionBinding *specialFunction = nullptr;
+  };
 }
 
 #endif /* KLEE_KINSTRUCTION_H */
@@ -19,6 +19,7 @@
 #include <map>
 #include <memory>
 #include <set>
+#include <string>
 #include <vector>
 
 namespace llvm {
@@ -111,15 +112,31 @@ namespace klee {
     std::map<const llvm::Constant *, std::unique_ptr<KConstant>> constantMap;
     KConstant* getKConstant(const llvm::Constant *c);
 
-    std::unique_ptr<Cell[]> constantTable;
+    /// Values of the constants, which grow as functions are added
+    std::vector<Cell> constantTable;
 
     // Functions which are part of KLEE runtime
     std::set<const llvm::Function*> internalFunctions;
 
   private:
+    /// Path prefix of the cache entry for the prepared module, or empty if
+    /// caching is disabled
+    std::string cachePath;
+
+    /// Whether the prepared module was loaded from the cache
+    bool loadedFromCache = false;
+
     // Mark function with functionName as part of the KLEE runtime
     void addInternalFunction(const char* functionName);
 
+    /// Return the path prefix under which the module prepared with the given
+    /// options is cached.
+    std::string getCachePath(const Interpreter::ModuleOptions &opts,
+                             llvm::ArrayRef<const char *> preservedFunctions);
+
+    /// Replace the module by the cached prepared module, if there is one.
+    bool loadCachedModule();
+
   public:
     KModule() = default;
 
@@ -153,6 +170,17 @@ namespace klee {
 
     void instrument(const Interpreter::ModuleOptions &opts);
 
+    /// Whether KFunctions are only added when a function is first called,
+    /// instead of for all functions by manifest().
+    static bool prepareFunctionsLazily();
+
+    /// Whether klee_open_merge/klee_close_merge calls are inserted around
+    /// regions after symbolic branches.
+    static bool insertsMergePoints();
+
+    /// Create the KFunction for \p f, which must not exist yet.
+    KFunction *addFunction(llvm::Function *f);
+
     /// Return an id for the given constant, creating a new one if necessary.
     unsigned getConstantID(llvm::Constant *c, KInstruction* ki);
 
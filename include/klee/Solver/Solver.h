@@ -19,6 +19,7 @@
 #include <vector>
 
 namespace klee {
+  class Assignment;
   class ConstraintSet;
   class Expr;
   class SolverImpl;
@@ -29,6 +30,15 @@ namespace klee {
   struct SolverQueryMetaData {
     /// @brief Costs for all queries issued for this state
     time::Span queryCost;
+
+    /// @brief Most recent assignment known to satisfy all of
+    /// `modelConstraints` (null if there is none). Shared between states
+    /// after a fork.
+    std::shared_ptr<const Assignment> model;
+
+    /// @brief The constraint set `model` belongs to; the model is only
+    /// used for queries over exactly this set
+    const ConstraintSet *modelConstraints = nullptr;
   };
 
   struct Query {
@@ -255,6 +265,27 @@ namespace klee {
   /// \param s - The underlying solver to use.
   std::unique_ptr<Solver> createIndependentSolver(std::unique_ptr<Solver> s);
 
+  /// createNormalizingSolver - Create a solver which rewrites queries into a
+  /// canonical form (alpha-renamed arrays, sorted constraints, simplified
+  /// expressions) before propagating them to the underlying solver, so that
+  /// caches below it hit on equivalent queries.
+  ///
+  /// \param s - The underlying solver to use.
+  std::unique_ptr<Solver> createNormalizingSolver(std::unique_ptr<Solver> s);
+
+  /// createArrayEliminatingSolver - Create a solver which replaces array
+  /// reads over concrete updates and with small bounded indices by
+  /// if-then-else expressions before propagating queries to the underlying
+  /// solver.
+  ///
+  /// \param s - The underlying solver to use.
+  /// \param maxUpdates - The maximum number of updates to expand per read.
+  /// \param maxExpansion - The maximum number of elements a bounded read is
+  /// expanded into.
+  std::unique_ptr<Solver> createArrayEliminatingSolver(std::unique_ptr<Solver> s,
+                                                       unsigned maxUpdates,
+                                                       unsigned maxExpansion);
+
   /// createKQueryLoggingSolver - Create a solver which will forward all queries
   /// after writing them to the given path in .kquery format.
   std::unique_ptr<Solver>
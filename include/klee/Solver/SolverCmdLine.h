@@ -36,6 +36,14 @@ extern llvm::cl::opt<bool> UseBranchCache;
 
 extern llvm::cl::opt<bool> UseIndependentSolver;
 
+extern llvm::cl::opt<bool> UseQueryNormalization;
+
+extern llvm::cl::opt<bool> EliminateArrays;
+
+extern llvm::cl::opt<unsigned> ArrayEliminationMaxUpdates;
+
+extern llvm::cl::opt<unsigned> ArrayEliminationMaxSize;
+
 extern llvm::cl::opt<bool> DebugValidateSolver;
 
 extern llvm::cl::opt<std::string> MinQueryTimeToLog;
@@ -26,6 +26,8 @@ namespace stats {
   extern Statistic queryCexCacheMisses;
   extern Statistic queryConstructs;
   extern Statistic queryCounterexamples;
+  extern Statistic queryModelHits;
+  extern Statistic queryNormalizations;
   extern Statistic queryTime;
   
 #ifdef KLEE_ARRAY_DEBUG
@@ -0,0 +1,168 @@
+//===-- StatsLog.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_STATSLOG_H
+#define KLEE_STATSLOG_H
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class raw_fd_ostream;
+}
+
+namespace klee {
+
+/// The kinds of records in a stats log (run.statslog).
+///
+/// A stats log starts with the magic "KSTATLOG", the format version and a
+/// number identifying the run, followed by records that are only ever
+/// appended. Each record is its kind, the size of its payload and the
+/// payload. All integers are LEB128 encoded and strings are prefixed by their
+/// length. Columns, events, files and functions are numbered in the order
+/// they appear. The values of the stats table and of instruction level
+/// statistics are stored as the signed difference to their previous value,
+/// omitting the values that did not change.
+enum class StatsLogRecord : std::uint8_t {
+  /// Name and whether the column of the stats table holds reals
+  Column = 1,
+  /// Number of changed columns, followed by their index and difference
+  Row = 2,
+  /// Key and value describing the run, e.g. its command
+  Info = 3,
+  /// Short name and name of an instruction level statistic
+  Event = 4,
+  /// Path of a source file
+  File = 5,
+  /// Name and file of a function
+  Function = 6,
+  /// ID, function, file, line and assembly line of an instruction
+  Instruction = 7,
+  /// Wall time and number of changed instruction level statistics, followed
+  /// by their instruction, event and difference
+  InstructionStats = 8,
+};
+
+class StatsLogWriter {
+  std::unique_ptr<llvm::raw_fd_ostream> os;
+  std::vector<std::int64_t> lastRow;
+  unsigned numEvents = 0;
+  unsigned numFunctions = 0;
+  std::map<std::string, unsigned> files;
+  std::vector<std::uint64_t> lastInstructionStats;
+
+  void writeRecord(StatsLogRecord kind, const std::string &payload);
+
+public:
+  explicit StatsLogWriter(std::unique_ptr<llvm::raw_fd_ostream> os);
+  ~StatsLogWriter();
+
+  void writeColumn(const std::string &name, bool real);
+  /// Writes the values of all columns, in the order they were added
+  void writeRow(const std::vector<std::int64_t> &values);
+
+  void writeInfo(const std::string &key, const std::string &value);
+  void writeEvent(const std::string &shortName, const std::string &name);
+  /// Returns the index of a source file, which is added if it is new
+  unsigned getFile(const std::string &path);
+  /// Returns the index of the new function
+  unsigned writeFunction(const std::string &name, unsigned file);
+  void writeInstruction(unsigned id, unsigned function, unsigned file,
+                        unsigned line, unsigned assemblyLine);
+  /// Writes the values of all events for all instructions, where the value
+  /// of event e for instruction i is values[i * events + e]
+  void writeInstructionStats(std::uint64_t wallTime,
+                             const std::vector<std::uint64_t> &values);
+};
+
+/// Reads a stats log while it is being written. Reading stops before a
+/// record that is not complete yet and continues there on the next call.
+class StatsLogReader {
+public:
+  struct Column {
+    std::string name;
+    bool real;
+  };
+  struct Event {
+    std::string shortName;
+    std::string name;
+  };
+  struct Function {
+    std::string name;
+    unsigned file;
+  };
+  struct Instruction {
+    unsigned id;
+    unsigned function;
+    unsigned file;
+    unsigned line;
+    unsigned assemblyLine;
+  };
+
+private:
+  std::ifstream is;
+  std::uint64_t runId = 0;
+  std::uint64_t offset = 0;
+
+  std::vector<Column> columns;
+  std::vector<std::int64_t> row;
+  std::vector<std::pair<std::string, std::string>> info;
+  std::vector<Event> events;
+  std::vector<std::string> files;
+  std::vector<Function> functions;
+  std::vector<Instruction> instructions;
+  std::uint64_t instructionStatsTime = 0;
+  std::vector<std::uint64_t> instructionStats;
+
+  bool apply(StatsLogRecord kind, const std::string &payload,
+             std::string &error);
+
+public:
+  /// Opens a stats log, returns false and sets error if it is not one
+  bool open(const std::string &path, std::string &error);
+
+  /// Reads the next complete record. Returns its kind, or nothing at the end
+  /// of the log, or on error, in which case error is set.
+  std::optional<StatsLogRecord> next(std::string &error);
+
+  /// Identifies the run that wrote the log
+  std::uint64_t getRunId() const { return runId; }
+  /// Returns the position after the last record read
+  std::uint64_t getOffset() const { return offset; }
+  /// Continues reading at the offset of a record, where the stats table had
+  /// the given columns and values
+  void restore(std::uint64_t offset, std::vector<Column> columns,
+               std::vector<std::int64_t> row);
+
+  const std::vector<Column> &getColumns() const { return columns; }
+  /// Returns the current values of the columns
+  const std::vector<std::int64_t> &getRow() const { return row; }
+  const std::vector<std::pair<std::string, std::string>> &getInfo() const {
+    return info;
+  }
+  const std::vector<Event> &getEvents() const { return events; }
+  const std::vector<std::string> &getFiles() const { return files; }
+  const std::vector<Function> &getFunctions() const { return functions; }
+  /// Returns the instructions in the order of the module
+  const std::vector<Instruction> &getInstructions() const {
+    return instructions;
+  }
+  std::uint64_t getInstructionStatsTime() const { return instructionStatsTime; }
+  /// Returns the current value of an instruction level statistic
+  std::uint64_t getInstructionStat(unsigned id, unsigned event) const;
+};
+
+} // namespace klee
+
+#endif /* KLEE_STATSLOG_H */
@@ -20,6 +20,10 @@
 // for compatibility reasons
 #define BOUT_MAGIC "BOUT\n"
 
+#define KTEST_PACK_VERSION 1
+#define KTEST_PACK_MAGIC_SIZE 5
+#define KTEST_PACK_MAGIC "KPACK"
+
 /***/
 
 static int read_uint32(FILE *f, unsigned *value_out) {
@@ -91,13 +95,10 @@ int kTest_isKTestFile(const char *path) {
   return res;
 }
 
-KTest *kTest_fromFile(const char *path) {
-  FILE *f = fopen(path, "rb");
+static KTest *kTest_read(FILE *f) {
   KTest *res = 0;
   unsigned i, version;
 
-  if (!f) 
-    goto error;
   if (!kTest_checkHeader(f)) 
     goto error;
 
@@ -146,8 +147,6 @@ KTest *kTest_fromFile(const char *path) {
       goto error;
   }
 
-  fclose(f);
-
   return res;
  error:
   if (res) {
@@ -170,17 +169,57 @@ KTest *kTest_fromFile(const char *path) {
     free(res);
   }
 
-  if (f) fclose(f);
-
   return 0;
 }
 
-int kTest_toFile(KTest *bo, const char *path) {
-  FILE *f = fopen(path, "wb");
+/* reads the test named <pack>#<id> */
+static KTest *kTest_fromPack(const char *path) {
+  const char *separator = strrchr(path, '#');
+  char *end, *packPath;
+  unsigned long id;
+  KTestPack *pack;
+  KTest *res = 0;
+  unsigned i;
+
+  if (!separator || !separator[1])
+    return 0;
+  id = strtoul(separator + 1, &end, 10);
+  if (*end)
+    return 0;
+
+  packPath = strndup(path, separator - path);
+  if (!packPath)
+    return 0;
+  pack = kTestPack_open(packPath);
+  free(packPath);
+  if (!pack)
+    return 0;
+  for (i=0; i<kTestPack_numTests(pack); i++) {
+    if (kTestPack_getId(pack, i) == id) {
+      res = kTestPack_getTest(pack, i);
+      break;
+    }
+  }
+  kTestPack_close(pack);
+
+  return res;
+}
+
+KTest *kTest_fromFile(const char *path) {
+  FILE *f = fopen(path, "rb");
+  KTest *res;
+
+  if (!f)
+    return kTest_fromPack(path);
+  res = kTest_read(f);
+  fclose(f);
+
+  return res;
+}
+
+static int kTest_write(FILE *f, KTest *bo) {
   unsigned i;
 
-  if (!f) 
-    goto error;
   if (fwrite(KTEST_MAGIC, strlen(KTEST_MAGIC), 1, f)!=1)
     goto error;
   if (!write_uint32(f, KTEST_VERSION))
@@ -210,15 +249,34 @@ int kTest_toFile(KTest *bo, const char *path) {
       goto error;
   }
 
-  fclose(f);
-
   return 1;
  error:
-  if (f) fclose(f);
-  
   return 0;
 }
 
+/* returns the number of bytes written by kTest_write */
+static unsigned kTest_size(KTest *bo) {
+  unsigned i, res = KTEST_MAGIC_SIZE + 4 * 5;
+  for (i=0; i<bo->numArgs; i++)
+    res += 4 + strlen(bo->args[i]);
+  for (i=0; i<bo->numObjects; i++)
+    res += 4 + strlen(bo->objects[i].name) + 4 + bo->objects[i].numBytes;
+  return res;
+}
+
+int kTest_toFile(KTest *bo, const char *path) {
+  FILE *f = fopen(path, "wb");
+  int res;
+
+  if (!f)
+    return 0;
+  res = kTest_write(f, bo);
+  if (fclose(f))
+    res = 0;
+
+  return res;
+}
+
 unsigned kTest_numBytes(KTest *bo) {
   unsigned i, res = 0;
   for (i=0; i<bo->numObjects; i++)
@@ -238,3 +296,141 @@ void kTest_free(KTest *bo) {
   free(bo->objects);
   free(bo);
 }
+
+/***/
+
+struct KTestPack {
+  FILE *file;
+  unsigned numTests;
+  unsigned *ids;
+  long *offsets;
+};
+
+static int kTestPack_checkHeader(FILE *f) {
+  char header[KTEST_PACK_MAGIC_SIZE];
+  unsigned version;
+  if (fread(header, KTEST_PACK_MAGIC_SIZE, 1, f)!=1)
+    return 0;
+  if (memcmp(header, KTEST_PACK_MAGIC, KTEST_PACK_MAGIC_SIZE))
+    return 0;
+  if (!read_uint32(f, &version) || version > KTEST_PACK_VERSION)
+    return 0;
+  return 1;
+}
+
+int kTestPack_isKTestPackFile(const char *path) {
+  FILE *f = fopen(path, "rb");
+  int res;
+
+  if (!f)
+    return 0;
+  res = kTestPack_checkHeader(f);
+  fclose(f);
+
+  return res;
+}
+
+KTestPack *kTestPack_create(const char *path) {
+  KTestPack *res = (KTestPack*) calloc(1, sizeof(*res));
+  if (!res)
+    return 0;
+
+  res->file = fopen(path, "wb");
+  if (!res->file)
+    goto error;
+  if (fwrite(KTEST_PACK_MAGIC, KTEST_PACK_MAGIC_SIZE, 1, res->file)!=1)
+    goto error;
+  if (!write_uint32(res->file, KTEST_PACK_VERSION))
+    goto error;
+  if (fflush(res->file))
+    goto error;
+
+  return res;
+ error:
+  kTestPack_close(res);
+  return 0;
+}
+
+int kTestPack_append(KTestPack *pack, unsigned id, KTest *bo) {
+  // Each record is flushed, so that a pack is readable up to its last
+  // complete record if KLEE does not exit normally
+  if (!write_uint32(pack->file, id))
+    return 0;
+  if (!write_uint32(pack->file, kTest_size(bo)))
+    return 0;
+  if (!kTest_write(pack->file, bo))
+    return 0;
+  ++pack->numTests;
+  return fflush(pack->file) == 0;
+}
+
+KTestPack *kTestPack_open(const char *path) {
+  KTestPack *res = (KTestPack*) calloc(1, sizeof(*res));
+  unsigned capacity = 0, id, size;
+  long offset, end;
+  if (!res)
+    return 0;
+
+  res->file = fopen(path, "rb");
+  if (!res->file)
+    goto error;
+  if (fseek(res->file, 0, SEEK_END) || (end = ftell(res->file)) < 0)
+    goto error;
+  rewind(res->file);
+  if (!kTestPack_checkHeader(res->file))
+    goto error;
+
+  // Index the records by skipping over their contents. A truncated last
+  // record is ignored.
+  while (read_uint32(res->file, &id) && read_uint32(res->file, &size)) {
+    offset = ftell(res->file);
+    if (offset < 0 || end - offset < (long) size)
+      break;
+    if (res->numTests == capacity) {
+      capacity = capacity ? 2 * capacity : 64;
+      unsigned *ids = (unsigned*) realloc(res->ids, capacity * sizeof(*ids));
+      if (!ids)
+        goto error;
+      res->ids = ids;
+      long *offsets = (long*) realloc(res->offsets,
+                                      capacity * sizeof(*offsets));
+      if (!offsets)
+        goto error;
+      res->offsets = offsets;
+    }
+    res->ids[res->numTests] = id;
+    res->offsets[res->numTests] = offset;
+    ++res->numTests;
+    if (fseek(res->file, size, SEEK_CUR))
+      goto error;
+  }
+
+  return res;
+ error:
+  kTestPack_close(res);
+  return 0;
+}
+
+unsigned kTestPack_numTests(KTestPack *pack) {
+  return pack->numTests;
+}
+
+unsigned kTestPack_getId(KTestPack *pack, unsigned index) {
+  return pack->ids[index];
+}
+
+KTest *kTestPack_getTest(KTestPack *pack, unsigned index) {
+  if (index >= pack->numTests || !pack->offsets)
+    return 0;
+  if (fseek(pack->file, pack->offsets[index], SEEK_SET))
+    return 0;
+  return kTest_read(pack->file);
+}
+
+void kTestPack_close(KTestPack *pack) {
+  if (pack->file)
+    fclose(pack->file);
+  free(pack->ids);
+  free(pack->offsets);
+  free(pack);
+}
@@ -16,19 +16,29 @@
 #include "klee/Expr/Expr.h"
 #include "klee/Statistics/TimerStatIncrementer.h"
 
+#include "llvm/ADT/Hashing.h"
+
 #include "CoreStats.h"
 
 using namespace klee;
 
 ///
 
+static std::uint64_t hashObject(const MemoryObject *mo) {
+  return llvm::hash_value(mo->id);
+}
+
 void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
   assert(os->copyOnWriteOwner==0 && "object already has owner");
   os->copyOnWriteOwner = cowKey;
+  if (!objects.lookup(mo))
+    objectsHash ^= hashObject(mo);
   objects = objects.replace(std::make_pair(mo, os));
 }
 
 void AddressSpace::unbindObject(const MemoryObject *mo) {
+  if (objects.lookup(mo))
+    objectsHash ^= hashObject(mo);
   objects = objects.remove(mo);
 }
 
@@ -297,7 +307,7 @@ bool AddressSpace::resolve(ExecutionState &state, TimingSolver *solver,
 // transparently avoid screwing up symbolics (if the byte is symbolic
 // then its concrete cache byte isn't being used) but is just a hack.
 
-std::size_t AddressSpace::copyOutConcretes() {
+std::size_t AddressSpace::copyOutConcretes(MemoryManager *memory) {
   std::size_t numPages{};
   for (const auto &object : objects) {
     auto &mo = object.first;
@@ -306,7 +316,15 @@ std::size_t AddressSpace::copyOutConcretes() {
       auto size = std::max(os->size, mo->alignment);
       numPages +=
           (size + MemoryManager::pageSize - 1) / MemoryManager::pageSize;
-      copyOutConcrete(mo, os.get());
+      if (!memory) {
+        copyOutConcrete(mo, os.get());
+      } else if (!memory->isNativeCopyCurrent(mo, os->concreteStoreVersion)) {
+        copyOutConcrete(mo, os.get());
+        // Only the version changes, and it is not part of the state's
+        // observable contents, hence the cast instead of getWriteable.
+        const_cast<ObjectState *>(os.get())->concreteStoreVersion =
+            memory->recordNativeCopy(mo);
+      }
     }
   }
   return numPages;
@@ -318,14 +336,32 @@ void AddressSpace::copyOutConcrete(const MemoryObject *mo,
   std::memcpy(address, os->concreteStore, mo->size);
 }
 
-bool AddressSpace::copyInConcretes(bool concretize) {
+std::uint64_t AddressSpace::getNativeCopyVersion(const MemoryObject *mo,
+                                                 const ObjectState *os,
+                                                 MemoryManager *memory) const {
+  if (!memory)
+    return 0;
+
+  if (os->readOnly) {
+    if (!os->concreteStoreVersion)
+      const_cast<ObjectState *>(os)->concreteStoreVersion =
+          memory->newNativeCopyVersion();
+    return os->concreteStoreVersion;
+  }
+
+  return memory->isNativeCopyCurrent(mo, os->concreteStoreVersion)
+             ? os->concreteStoreVersion
+             : 0;
+}
+
+bool AddressSpace::copyInConcretes(bool concretize, MemoryManager *memory) {
   for (auto &obj : objects) {
     const MemoryObject *mo = obj.first;
 
     if (!mo->isUserSpecified) {
       const auto &os = obj.second;
 
-      if (!copyInConcrete(mo, os.get(), mo->address, concretize))
+      if (!copyInConcrete(mo, os.get(), mo->address, concretize, memory))
         return false;
     }
   }
@@ -334,7 +370,8 @@ bool AddressSpace::copyInConcretes(bool concretize) {
 }
 
 bool AddressSpace::copyInConcrete(const MemoryObject *mo, const ObjectState *os,
-                                  uint64_t src_address, bool concretize) {
+                                  uint64_t src_address, bool concretize,
+                                  MemoryManager *memory) {
   auto address = reinterpret_cast<std::uint8_t*>(src_address);
 
   // Don't do anything if the underlying representation has not been changed
@@ -342,7 +379,10 @@ bool AddressSpace::copyInConcrete(const MemoryObject *mo, const ObjectState *os,
   if (std::memcmp(address, os->concreteStore, mo->size) == 0)
     return true;
 
-  // External object representation has been changed
+  // External object representation has been changed. Other states may hold
+  // copies of the contents that were in native memory before.
+  if (memory)
+    memory->invalidateNativeCopies(mo->address, mo->size);
 
   // Return `false` if the object is marked as read-only
   if (os->readOnly)
@@ -354,6 +394,7 @@ bool AddressSpace::copyInConcrete(const MemoryObject *mo, const ObjectState *os,
   // representation
   if (!wos->unflushedMask) {
     std::memcpy(wos->concreteStore, address, mo->size);
+    wos->concreteStoreVersion = 0;
     return true;
   }
 
@@ -361,6 +402,7 @@ bool AddressSpace::copyInConcrete(const MemoryObject *mo, const ObjectState *os,
   if (concretize) {
     wos->makeConcrete();
     std::memcpy(wos->concreteStore, address, mo->size);
+    wos->concreteStoreVersion = 0;
   } else {
     // The object is partially symbolic, it needs to be updated byte-by-byte
     // via object state's `write` function
@@ -18,6 +18,7 @@
 
 namespace klee {
   class ExecutionState;
+  class MemoryManager;
   class MemoryObject;
   class ObjectState;
   class TimingSolver;
@@ -64,8 +65,13 @@ namespace klee {
     /// \invariant forall o in objects, o->copyOnWriteOwner <= cowKey
     MemoryMap objects;
 
+    /// Order-independent hash of the bound memory objects, which is kept
+    /// up to date by bindObject() and unbindObject().
+    std::uint64_t objectsHash = 0;
+
     AddressSpace() : cowKey(1) {}
-    AddressSpace(const AddressSpace &b) : cowKey(++b.cowKey), objects(b.objects) { }
+    AddressSpace(const AddressSpace &b)
+        : cowKey(++b.cowKey), objects(b.objects), objectsHash(b.objectsHash) {}
     ~AddressSpace() {}
 
     /// Resolve address to an ObjectPair in result.
@@ -128,10 +134,20 @@ namespace klee {
     /// actual system memory location they were allocated at.
     /// Returns the (hypothetical) number of pages needed provided each written
     /// object occupies (at least) a single page.
-    std::size_t copyOutConcretes();
+    ///
+    /// \param memory if given, objects whose native memory still holds their
+    /// current concrete values are not copied again
+    std::size_t copyOutConcretes(MemoryManager *memory = nullptr);
 
     void copyOutConcrete(const MemoryObject *mo, const ObjectState *os) const;
 
+    /// Returns the version identifying the contents of the native memory of
+    /// \p mo after copyOutConcretes(memory), or 0 if it is unknown. Read-only
+    /// objects are only copied out once and get a version of their own.
+    std::uint64_t getNativeCopyVersion(const MemoryObject *mo,
+                                       const ObjectState *os,
+                                       MemoryManager *memory) const;
+
     /// Copy the concrete values of all managed ObjectStates back from
     /// the actual system memory location they were allocated
     /// at. ObjectStates will only be written to (and thus,
@@ -140,9 +156,11 @@ namespace klee {
     ///
     /// \param concretize fully concretize the object representation if changed
     /// externally
+    /// \param memory if given, forget native copies of objects changed
+    /// externally
     /// \return true if copy succeeded, otherwise false (e.g. try to modify
     /// read-only object)
-    bool copyInConcretes(bool concretize);
+    bool copyInConcretes(bool concretize, MemoryManager *memory = nullptr);
 
     /// Updates the memory object with the raw memory from the address
     ///
@@ -151,9 +169,12 @@ namespace klee {
     /// @param src_address the address to copy from
     /// @param concretize fully concretize the object representation if changed
     /// externally
+    /// @param memory if given, forget native copies of the object if changed
+    /// externally
     /// @return
     bool copyInConcrete(const MemoryObject *mo, const ObjectState *os,
-                        uint64_t src_address, bool concretize);
+                        uint64_t src_address, bool concretize,
+                        MemoryManager *memory = nullptr);
   };
 } // End klee namespace
 
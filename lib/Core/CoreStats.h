@@ -18,6 +18,7 @@ namespace klee {
 namespace stats {
 
   extern Statistic allocations;
+  extern Statistic kdallocCompactedBytes;
   extern Statistic resolveTime;
   extern Statistic instructions;
   extern Statistic instructionTime;
@@ -38,6 +39,9 @@ namespace stats {
   /// Number of inhibited forks.
   extern Statistic inhibitedForks;
 
+  /// The number of functions prepared for execution.
+  extern Statistic preparedFunctions;
+
   /// Number of states, this is a "fake" statistic used by istats, it
   /// isn't normally up-to-date.
   extern Statistic states;
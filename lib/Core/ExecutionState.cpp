@@ -11,7 +11,9 @@
 
 #include "Memory.h"
 
+#include "klee/Expr/Assignment.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
 #include "klee/Module/Cell.h"
 #include "klee/Module/InstructionInfoTable.h"
 #include "klee/Module/KInstruction.h"
@@ -19,6 +21,7 @@
 #include "klee/Support/Casting.h"
 #include "klee/Support/OptionCategories.h"
 
+#include "llvm/ADT/Hashing.h"
 #include "llvm/IR/Function.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
@@ -78,6 +81,7 @@ ExecutionState::ExecutionState(KFunction *kf, MemoryManager *mm)
     : pc(kf->instructions), prevPC(pc) {
   pushFrame(nullptr, kf);
   setID();
+  queryMetaData.modelConstraints = &constraints;
   if (mm->stackFactory && mm->heapFactory) {
     stackAllocator = mm->stackFactory.makeAllocator();
     heapAllocator = mm->heapFactory.makeAllocator();
@@ -105,7 +109,9 @@ ExecutionState::ExecutionState(const ExecutionState& state):
     pathOS(state.pathOS),
     symPathOS(state.symPathOS),
     coveredLines(state.coveredLines),
+    coveredBlocks(state.coveredBlocks),
     symbolics(state.symbolics),
+    symbolicsHash(state.symbolicsHash),
     cexPreferences(state.cexPreferences),
     arrayNames(state.arrayNames),
     openMergeStack(state.openMergeStack),
@@ -120,6 +126,13 @@ ExecutionState::ExecutionState(const ExecutionState& state):
     base_mos(state.base_mos) {
   for (const auto &cur_mergehandler: openMergeStack)
     cur_mergehandler->addOpenState(this);
+
+  // The model is shared until one of the states adds a constraint it
+  // violates
+  if (state.queryMetaData.modelConstraints == &state.constraints) {
+    queryMetaData.model = state.queryMetaData.model;
+    queryMetaData.modelConstraints = &constraints;
+  }
 }
 
 ExecutionState *ExecutionState::branch() {
@@ -170,6 +183,7 @@ void ExecutionState::deallocate(const MemoryObject *mo) {
 
 void ExecutionState::addSymbolic(const MemoryObject *mo, const Array *array) {
   symbolics.emplace_back(ref<const MemoryObject>(mo), array);
+  symbolicsHash = llvm::hash_combine(symbolicsHash, mo, array);
 }
 
 /**/
@@ -187,6 +201,17 @@ llvm::raw_ostream &klee::operator<<(llvm::raw_ostream &os, const MemoryMap &mm)
   return os;
 }
 
+std::uint64_t ExecutionState::getMergeFingerprint() const {
+  // The address space and the symbolics are hashed incrementally, while the
+  // stack is usually shallow enough to be hashed on demand
+  llvm::hash_code hash = llvm::hash_combine(
+      static_cast<KInstruction *>(pc), symbolicsHash, addressSpace.objectsHash);
+  for (const StackFrame &sf : stack)
+    hash = llvm::hash_combine(hash, static_cast<KInstruction *>(sf.caller),
+                              sf.kf);
+  return hash;
+}
+
 bool ExecutionState::merge(const ExecutionState &b) {
   if (DebugLogStateMerge)
     llvm::errs() << "-- attempting merge of A:" << this << " with B:" << &b
@@ -194,6 +219,12 @@ bool ExecutionState::merge(const ExecutionState &b) {
   if (pc != b.pc)
     return false;
 
+  if (getMergeFingerprint() != b.getMergeFingerprint()) {
+    if (DebugLogStateMerge)
+      llvm::errs() << "\tfingerprints differ\n";
+    return false;
+  }
+
   // XXX is it even possible for these to differ? does it matter? probably
   // implies difference in object states?
 
@@ -214,37 +245,37 @@ bool ExecutionState::merge(const ExecutionState &b) {
       return false;
   }
 
-  std::set< ref<Expr> > aConstraints(constraints.begin(), constraints.end());
-  std::set< ref<Expr> > bConstraints(b.constraints.begin(), 
-                                     b.constraints.end());
-  std::set< ref<Expr> > commonConstraints, aSuffix, bSuffix;
-  std::set_intersection(aConstraints.begin(), aConstraints.end(),
-                        bConstraints.begin(), bConstraints.end(),
-                        std::inserter(commonConstraints, commonConstraints.begin()));
-  std::set_difference(aConstraints.begin(), aConstraints.end(),
-                      commonConstraints.begin(), commonConstraints.end(),
-                      std::inserter(aSuffix, aSuffix.end()));
-  std::set_difference(bConstraints.begin(), bConstraints.end(),
-                      commonConstraints.begin(), commonConstraints.end(),
-                      std::inserter(bSuffix, bSuffix.end()));
+  // Both states usually inherit the constraints from before they forked as
+  // a common prefix, so only the remaining constraints are hashed to find
+  // the common ones among them
+  std::vector<ref<Expr>> commonConstraints, aSuffix, bSuffix;
+  auto ca = constraints.begin(), cae = constraints.end();
+  auto cb = b.constraints.begin(), cbe = b.constraints.end();
+  for (; ca != cae && cb != cbe && *ca == *cb; ++ca, ++cb)
+    commonConstraints.push_back(*ca);
+  ExprHashSet aRemainder(ca, cae), bRemainder(cb, cbe);
+  for (; ca != cae; ++ca) {
+    if (bRemainder.count(*ca))
+      commonConstraints.push_back(*ca);
+    else
+      aSuffix.push_back(*ca);
+  }
+  for (; cb != cbe; ++cb) {
+    if (!aRemainder.count(*cb))
+      bSuffix.push_back(*cb);
+  }
   if (DebugLogStateMerge) {
     llvm::errs() << "\tconstraint prefix: [";
-    for (std::set<ref<Expr> >::iterator it = commonConstraints.begin(),
-                                        ie = commonConstraints.end();
-         it != ie; ++it)
-      llvm::errs() << *it << ", ";
+    for (const auto &constraint : commonConstraints)
+      llvm::errs() << constraint << ", ";
     llvm::errs() << "]\n";
     llvm::errs() << "\tA suffix: [";
-    for (std::set<ref<Expr> >::iterator it = aSuffix.begin(),
-                                        ie = aSuffix.end();
-         it != ie; ++it)
-      llvm::errs() << *it << ", ";
+    for (const auto &constraint : aSuffix)
+      llvm::errs() << constraint << ", ";
     llvm::errs() << "]\n";
     llvm::errs() << "\tB suffix: [";
-    for (std::set<ref<Expr> >::iterator it = bSuffix.begin(),
-                                        ie = bSuffix.end();
-         it != ie; ++it)
-      llvm::errs() << *it << ", ";
+    for (const auto &constraint : bSuffix)
+      llvm::errs() << constraint << ", ";
     llvm::errs() << "]\n";
   }
 
@@ -295,12 +326,10 @@ bool ExecutionState::merge(const ExecutionState &b) {
 
   ref<Expr> inA = ConstantExpr::alloc(1, Expr::Bool);
   ref<Expr> inB = ConstantExpr::alloc(1, Expr::Bool);
-  for (std::set< ref<Expr> >::iterator it = aSuffix.begin(), 
-         ie = aSuffix.end(); it != ie; ++it)
-    inA = AndExpr::create(inA, *it);
-  for (std::set< ref<Expr> >::iterator it = bSuffix.begin(), 
-         ie = bSuffix.end(); it != ie; ++it)
-    inB = AndExpr::create(inB, *it);
+  for (const auto &constraint : aSuffix)
+    inA = AndExpr::create(inA, constraint);
+  for (const auto &constraint : bSuffix)
+    inB = AndExpr::create(inB, constraint);
 
   // XXX should we have a preference as to which predicate to use?
   // it seems like it can make a difference, even though logically
@@ -341,6 +370,7 @@ bool ExecutionState::merge(const ExecutionState &b) {
   }
 
   constraints = ConstraintSet();
+  queryMetaData.model.reset();
 
   ConstraintManager m(constraints);
   for (const auto &constraint : commonConstraints)
@@ -391,6 +421,13 @@ void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
 void ExecutionState::addConstraint(ref<Expr> e) {
   ConstraintManager c(constraints);
   c.addConstraint(e);
+
+  // Keep the model only as long as it satisfies every added constraint
+  if (queryMetaData.model) {
+    ref<Expr> value = queryMetaData.model->evaluate(e);
+    if (!isa<ConstantExpr>(value) || !cast<ConstantExpr>(value)->isTrue())
+      queryMetaData.model.reset();
+  }
 }
 
 void ExecutionState::addCexPreference(const ref<Expr> &cond) {
@@ -207,6 +207,10 @@ public:
   /// @brief Set containing which lines in which files are covered by this state
   std::map<const std::string *, std::set<std::uint32_t>> coveredLines;
 
+  /// @brief Ids of the first instructions of the basic blocks this state
+  /// ran through (only recorded for --minimize-tests)
+  ImmutableSet<std::uint32_t> coveredBlocks;
+
   /// @brief Pointer to the execution tree of the current state
   /// Copies of ExecutionState should not copy executionTreeNode
   ExecutionTreeNode *executionTreeNode = nullptr;
@@ -216,6 +220,9 @@ public:
   // FIXME: Move to a shared list structure (not critical).
   std::vector<std::pair<ref<const MemoryObject>, const Array *>> symbolics;
 
+  /// @brief Hash of the symbolics, updated by addSymbolic
+  std::uint64_t symbolicsHash = 0;
+
   /// @brief A set of boolean expressions
   /// the user has requested be true of a counterexample.
   ImmutableSet<ref<Expr>> cexPreferences;
@@ -283,6 +290,10 @@ public:
   void addConstraint(ref<Expr> e);
   void addCexPreference(const ref<Expr> &cond);
 
+  /// @brief Hash of the parts of the state that merge() requires to be
+  /// equal, so that states which cannot be merged are told apart quickly
+  std::uint64_t getMergeFingerprint() const;
+
   bool merge(const ExecutionState &b);
   void dumpStack(llvm::raw_ostream &out) const;
 
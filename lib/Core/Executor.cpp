@@ -18,6 +18,7 @@
 #include "ImpliedValue.h"
 #include "Memory.h"
 #include "MemoryManager.h"
+#include "MergeHandler.h"
 #include "Searcher.h"
 #include "SeedInfo.h"
 #include "SpecialFunctionHandler.h"
@@ -91,6 +92,7 @@
 #include <string>
 #include <sys/mman.h>
 #include <sys/resource.h>
+#include <unordered_map>
 #include <vector>
 
 using namespace llvm;
@@ -122,6 +124,27 @@ cl::opt<std::string> MaxTime(
     cl::init("0s"),
     cl::cat(TerminationCat));
 
+cl::opt<bool> MinimizeTests(
+    "minimize-tests", cl::init(false),
+    cl::desc("Only output test cases that cover a basic block no test case "
+             "output before covers. At exit, output test cases covered by "
+             "the others are moved to the redundant-tests subdirectory. Test "
+             "cases for errors are always kept, and --max-tests only counts "
+             "the output test cases (default=false)"),
+    cl::cat(TestGenCat));
+
+cl::opt<bool> ExternalCallsSandbox(
+    "external-calls-sandbox", cl::init(false),
+    cl::desc("Run external calls in a helper process forked from KLEE, so "
+             "crashing or hanging calls cannot corrupt KLEE. Requires "
+             "--kdalloc. Calls still block KLEE and are queued on a single "
+             "helper shared by all states, which receives the memory of a "
+             "state that changed since it was last shipped. Memory the "
+             "helper allocates (e.g. FILEs from fopen) persists across calls "
+             "but is lost when a crashing or timed out call restarts the "
+             "helper (default=false)"),
+    cl::cat(ExtCallsCat));
+
 /*** Misc options ***/
 cl::opt<bool> SingleObjectResolution(
     "single-object-resolution",
@@ -240,6 +263,31 @@ cl::opt<std::size_t> ExternalPageThreshold(
         "used for external calls is above the given threshold (default=1024)."),
     cl::cat(ExtCallsCat));
 
+cl::opt<bool> ExternalCallsCopyChangedOnly(
+    "external-calls-copy-changed-only", cl::init(true),
+    cl::desc("Before an external call, only copy objects to native memory "
+             "that changed since they were last copied there (default=true)"),
+    cl::cat(ExtCallsCat));
+
+cl::list<std::string> PureExternalFunctions(
+    "external-calls-pure", cl::CommaSeparated, cl::value_desc("function"),
+    cl::desc("External functions whose results only depend on their "
+             "non-pointer arguments and errno (e.g. sin,cos,sqrt). Calls to "
+             "them do not copy memory and are memoized"),
+    cl::cat(ExtCallsCat));
+
+cl::opt<unsigned> PureExternalCallsCacheSize(
+    "external-calls-pure-cache-size", cl::init(65536),
+    cl::desc("Maximum number of memoized calls to --external-calls-pure "
+             "functions, 0 means unlimited (default=65536)"),
+    cl::cat(ExtCallsCat));
+
+cl::opt<std::string> ExternalCallsSandboxTimeout(
+    "external-calls-sandbox-timeout", cl::init("10s"),
+    cl::desc("Time after which a sandboxed external call fails. Set to 0s to "
+             "disable (default=10s)"),
+    cl::cat(ExtCallsCat));
+
 /*** Seeding options ***/
 
 cl::opt<bool> AlwaysOutputSeeds(
@@ -261,6 +309,13 @@ cl::opt<bool> OnlySeed("only-seed",
                                 "doing regular search (default=false)."),
                        cl::cat(SeedingCat));
 
+cl::opt<bool> ConcolicSeeding(
+    "concolic-seeding", cl::init(false),
+    cl::desc("Follow the seeds without querying the solver, and only check "
+             "the branches they do not take once seeding is done "
+             "(default=false)."),
+    cl::cat(SeedingCat));
+
 cl::opt<bool> AllowSeedExtension(
     "allow-seed-extension", cl::init(false),
     cl::desc("Allow extra values to become symbolic during seeding; "
@@ -483,6 +538,9 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
       atMemoryLimit(false), inhibitForking(false), haltExecution(false),
       ivcEnabled(false), debugLogBuffer(debugBufferString) {
 
+  externalDispatcher->setPureFunctions(
+      {PureExternalFunctions.begin(), PureExternalFunctions.end()},
+      PureExternalCallsCacheSize);
 
   const time::Span maxTime{MaxTime};
   if (maxTime) timers.add(
@@ -508,11 +566,26 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
   this->solver = std::make_unique<TimingSolver>(std::move(solver), EqualitySubstitution);
   memory = std::make_unique<MemoryManager>(&arrayCache);
 
+  if (ExternalCallsSandbox && !MemoryManager::isDeterministic)
+    klee_error("To use --external-calls-sandbox, you need to enable --kdalloc.");
+  externalDispatcher->setSandbox(ExternalCallsSandbox,
+                                 time::Span{ExternalCallsSandboxTimeout},
+                                 memory->getDeterministicMappings());
+
+  if (const time::Span compactionInterval =
+          MemoryManager::getCompactionInterval())
+    timers.add(std::make_unique<Timer>(compactionInterval, [&] {
+      MemoryManager::compactAllocators(states);
+    }));
+
   initializeSearchOptions();
 
   if (OnlyOutputStatesCoveringNew && !StatsTracker::useIStats())
     klee_error("To use --only-output-states-covering-new, you need to enable --output-istats.");
 
+  if (MinimizeTests && !StatsTracker::useIStats())
+    klee_error("To use --minimize-tests, you need to enable --output-istats.");
+
   if (DebugPrintInstructions.isSet(FILE_ALL) ||
       DebugPrintInstructions.isSet(FILE_COMPACT) ||
       DebugPrintInstructions.isSet(FILE_SRC)) {
@@ -578,11 +651,15 @@ Executor::setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
   preservedFunctions.push_back("bcmp");
   preservedFunctions.push_back("memmove");
 
+  if (KModule::insertsMergePoints() && !UseMerge)
+    klee_error("--auto-merge used without --use-merge");
+
   kmodule->optimiseAndPrepare(opts, preservedFunctions);
   kmodule->checkModule();
 
   // 4.) Manifest the module
   kmodule->manifest(interpreterHandler, StatsTracker::useStatistics());
+  stats::preparedFunctions += kmodule->functions.size();
 
   specialFunctionHandler->bind();
 
@@ -1018,7 +1095,7 @@ void Executor::branch(ExecutionState &state,
   std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it = 
     seedMap.find(&state);
   if (it != seedMap.end()) {
-    std::vector<SeedInfo> seeds = it->second;
+    std::vector<SeedInfo> seeds = std::move(it->second);
     seedMap.erase(it);
 
     // Assume each seed only satisfies one condition (necessarily true
@@ -1045,7 +1122,7 @@ void Executor::branch(ExecutionState &state,
 
       // Extra check in case we're replaying seeds with a max-fork
       if (result[i])
-        seedMap[result[i]].push_back(*siit);
+        seedMap[result[i]].push_back(std::move(*siit));
     }
 
     if (OnlyReplaySeeds) {
@@ -1129,17 +1206,35 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
   if (!isSeeding)
     condition = maxStaticPctChecks(current, condition);
 
-  time::Span timeout = coreSolverTimeout;
-  if (isSeeding)
-    timeout *= static_cast<unsigned>(it->second.size());
-  solver->setTimeout(timeout);
-  bool success = solver->evaluate(current.constraints, condition, res,
-                                  current.queryMetaData);
-  solver->setTimeout(time::Span());
-  if (!success) {
-    current.pc = current.prevPC;
-    terminateStateOnSolverError(current, "Query timed out (fork).");
-    return StatePair(nullptr, nullptr);
+  // In concolic mode the seeds alone decide the directions of branch
+  // instructions while seeding (before the searcher takes over). A direction
+  // without seeds is forked unchecked, as its state is not executed before
+  // resolveUncheckedBranches() checks it.
+  bool concolic = isSeeding && ConcolicSeeding && !searcher &&
+                  reason == BranchType::Conditional &&
+                  !isa<klee::ConstantExpr>(condition);
+  if (concolic) {
+    concolic = std::all_of(
+        it->second.begin(), it->second.end(), [&](const SeedInfo &seed) {
+          return isa<klee::ConstantExpr>(seed.assignment.evaluate(condition));
+        });
+  }
+
+  if (concolic) {
+    res = Solver::Unknown;
+  } else {
+    time::Span timeout = coreSolverTimeout;
+    if (isSeeding)
+      timeout *= static_cast<unsigned>(it->second.size());
+    solver->setTimeout(timeout);
+    bool success = solver->evaluate(current.constraints, condition, res,
+                                    current.queryMetaData);
+    solver->setTimeout(time::Span());
+    if (!success) {
+      current.pc = current.prevPC;
+      terminateStateOnSolverError(current, "Query timed out (fork).");
+      return StatePair(nullptr, nullptr);
+    }
   }
 
   if (!isSeeding) {
@@ -1243,8 +1338,9 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
     falseState = trueState->branch();
     addedStates.push_back(falseState);
 
+    ExecutionState *unchecked = nullptr;
     if (it != seedMap.end()) {
-      std::vector<SeedInfo> seeds = it->second;
+      std::vector<SeedInfo> seeds = std::move(it->second);
       it->second.clear();
       std::vector<SeedInfo> &trueSeeds = seedMap[trueState];
       std::vector<SeedInfo> &falseSeeds = seedMap[falseState];
@@ -1257,9 +1353,9 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
         assert(success && "FIXME: Unhandled solver failure");
         (void) success;
         if (res->isTrue()) {
-          trueSeeds.push_back(*siit);
+          trueSeeds.push_back(std::move(*siit));
         } else {
-          falseSeeds.push_back(*siit);
+          falseSeeds.push_back(std::move(*siit));
         }
       }
       
@@ -1267,10 +1363,14 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
       if (trueSeeds.empty()) {
         if (&current == trueState) swapInfo = true;
         seedMap.erase(trueState);
+        if (concolic)
+          unchecked = trueState;
       }
       if (falseSeeds.empty()) {
         if (&current == falseState) swapInfo = true;
         seedMap.erase(falseState);
+        if (concolic)
+          unchecked = falseState;
       }
       if (swapInfo) {
         std::swap(trueState->coveredNew, falseState->coveredNew);
@@ -1298,20 +1398,61 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
       }
     }
 
-    addConstraint(*trueState, condition);
-    addConstraint(*falseState, Expr::createIsZero(condition));
+    // The constraint of an unchecked state is only added once it is known
+    // to be satisfiable
+    ref<Expr> uncheckedCondition;
+    if (unchecked == trueState)
+      uncheckedCondition = condition;
+    else
+      addConstraint(*trueState, condition);
+    if (unchecked == falseState)
+      uncheckedCondition = Expr::createIsZero(condition);
+    else
+      addConstraint(*falseState, Expr::createIsZero(condition));
 
     // Kinda gross, do we even really still want this option?
     if (MaxDepth && MaxDepth<=trueState->depth) {
-      terminateStateEarly(*trueState, "max-depth exceeded.", StateTerminationType::MaxDepth);
-      terminateStateEarly(*falseState, "max-depth exceeded.", StateTerminationType::MaxDepth);
+      // An unchecked state may be infeasible and lacks its constraint, so it
+      // is dropped without a test
+      for (ExecutionState *state : {trueState, falseState}) {
+        if (state == unchecked)
+          terminateState(*state, StateTerminationType::MaxDepth);
+        else
+          terminateStateEarly(*state, "max-depth exceeded.",
+                              StateTerminationType::MaxDepth);
+      }
       return StatePair(nullptr, nullptr);
     }
 
+    if (unchecked)
+      uncheckedBranches.emplace_back(unchecked, uncheckedCondition);
+
     return StatePair(trueState, falseState);
   }
 }
 
+/// Keeps only the first of the seeds that follow the same path and returns
+/// the number of seeds removed.
+static unsigned removeDuplicateSeeds(std::vector<SeedInfo> &seeds) {
+  if (seeds.size() < 2)
+    return 0;
+  std::unordered_map<std::size_t, std::vector<std::size_t>> seedsByPath;
+  std::vector<SeedInfo> unique;
+  unique.reserve(seeds.size());
+  for (SeedInfo &seed : seeds) {
+    auto &samePath = seedsByPath[seed.hashPath()];
+    if (std::any_of(samePath.begin(), samePath.end(), [&](std::size_t i) {
+          return seed.followsSamePath(unique[i]);
+        }))
+      continue;
+    samePath.push_back(unique.size());
+    unique.push_back(std::move(seed));
+  }
+  const unsigned removed = seeds.size() - unique.size();
+  seeds = std::move(unique);
+  return removed;
+}
+
 void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(condition)) {
     if (!CE->isTrue())
@@ -1337,8 +1478,11 @@ void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
         warn = true;
       }
     }
-    if (warn)
-      klee_warning("seeds patched for violating constraint"); 
+    if (warn) {
+      klee_warning("seeds patched for violating constraint");
+      // Patched seeds may now assign the same values
+      numDuplicateSeeds += removeDuplicateSeeds(it->second);
+    }
   }
 
   state.addConstraint(condition);
@@ -1729,7 +1873,7 @@ void Executor::unwindToNextLandingpad(ExecutionState &state) {
 
         llvm::Function *personality_fn =
             kmodule->module->getFunction("_klee_eh_cxx_personality");
-        KFunction *kf = kmodule->functionMap[personality_fn];
+        KFunction *kf = getKFunction(personality_fn);
 
         state.pushFrame(state.prevPC, kf);
         state.pc = kf->instructions;
@@ -1794,11 +1938,19 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
   Instruction *i = ki->inst;
   if (isa_and_nonnull<DbgInfoIntrinsic>(i))
     return;
+  if (const SpecialFunctionBinding *binding =
+          f ? specialFunctionHandler->getBinding(ki, f) : nullptr;
+      binding &&
+      specialFunctionHandler->handle(state, *binding, ki, arguments)) {
+    if (InvokeInst *ii = dyn_cast<InvokeInst>(i))
+      transferToBasicBlock(ii->getNormalDest(), i->getParent(), state);
+    return;
+  }
   if (f && f->isDeclaration()) {
     switch (f->getIntrinsicID()) {
     case Intrinsic::not_intrinsic: {
       // state may be destroyed by this call, cannot touch
-      callExternalFunction(state, ki, kmodule->functionMap[f], arguments);
+      callExternalFunction(state, ki, getKFunction(f), arguments);
       break;
     }
     case Intrinsic::fabs: {
@@ -2029,7 +2181,7 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
     // guess. This just done to avoid having to pass KInstIterator everywhere
     // instead of the actual instruction, since we can't make a KInstIterator
     // from just an instruction (unlike LLVM).
-    KFunction *kf = kmodule->functionMap[f];
+    KFunction *kf = getKFunction(f);
 
     state.pushFrame(state.prevPC, kf);
     state.pc = kf->instructions;
@@ -2174,6 +2326,29 @@ void Executor::transferToBasicBlock(BasicBlock *dst, BasicBlock *src,
   }
 }
 
+KFunction *Executor::getKFunction(Function *f) {
+  auto it = kmodule->functionMap.find(f);
+  if (it != kmodule->functionMap.end())
+    return it->second;
+
+  // The function is called for the first time
+  assert(KModule::prepareFunctionsLazily() && "missing KFunction");
+  unsigned firstConstant = kmodule->constants.size();
+  KFunction *kf = kmodule->addFunction(f);
+  for (unsigned i = 0; i < kf->numInstructions; ++i)
+    bindInstructionConstants(kf->instructions[i]);
+  specialFunctionHandler->bindCallSites(*kf);
+
+  // Otherwise the constants are evaluated by bindModuleConstants()
+  if (constantsBound) {
+    kmodule->constantTable.resize(kmodule->constants.size());
+    for (unsigned i = firstConstant; i < kmodule->constants.size(); ++i)
+      kmodule->constantTable[i].value = evalConstant(kmodule->constants[i]);
+  }
+  ++stats::preparedFunctions;
+  return kf;
+}
+
 /// Compute the true target of a function call, resolving LLVM aliases
 /// and bitcasts.
 Function *Executor::getTargetFunction(Value *calledVal) {
@@ -2540,7 +2715,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     const CallBase &cb = cast<CallBase>(*i);
     Value *fp = cb.getCalledOperand();
     unsigned numArgs = cb.arg_size();
-    Function *f = getTargetFunction(fp);
+    Function *f = static_cast<KCallInstruction *>(ki)->calledFunction;
 
     // evaluate arguments
     std::vector< ref<Expr> > arguments;
@@ -3609,12 +3784,13 @@ void Executor::bindModuleConstants() {
       bindInstructionConstants(kf->instructions[i]);
   }
 
-  kmodule->constantTable =
-      std::unique_ptr<Cell[]>(new Cell[kmodule->constants.size()]);
+  kmodule->constantTable.clear();
+  kmodule->constantTable.resize(kmodule->constants.size());
   for (unsigned i=0; i<kmodule->constants.size(); ++i) {
     Cell &c = kmodule->constantTable[i];
     c.value = evalConstant(kmodule->constants[i]);
   }
+  constantsBound = true;
 }
 
 bool Executor::checkMemoryUsage() {
@@ -3659,6 +3835,35 @@ bool Executor::checkMemoryUsage() {
   return false;
 }
 
+void Executor::resolveUncheckedBranches() {
+  if (uncheckedBranches.empty())
+    return;
+
+  unsigned feasible = 0;
+  for (auto &[state, condition] : uncheckedBranches) {
+    // The query belongs to the branch that forked the state
+    QueryProfiler::OriginScope origin(solver->getProfiler(), state->prevPC);
+    bool mayBeTrue;
+    solver->setTimeout(coreSolverTimeout);
+    bool success = solver->mayBeTrue(state->constraints, condition, mayBeTrue,
+                                     state->queryMetaData);
+    solver->setTimeout(time::Span());
+    if (!success) {
+      terminateStateOnSolverError(*state, "Query timed out (unchecked branch).");
+    } else if (!mayBeTrue) {
+      terminateStateEarlyAlgorithm(*state, "Infeasible unchecked branch.",
+                                   StateTerminationType::Replay);
+    } else {
+      addConstraint(*state, condition);
+      ++feasible;
+    }
+  }
+  klee_message("%u of %zu branches not taken by the seeds are feasible",
+               feasible, uncheckedBranches.size());
+  uncheckedBranches.clear();
+  updateStates(nullptr);
+}
+
 void Executor::doDumpStates() {
   if (states.empty())
     return;
@@ -3686,16 +3891,20 @@ void Executor::run(ExecutionState &initialState) {
 
   if (usingSeeds) {
     std::vector<SeedInfo> &v = seedMap[&initialState];
-    
-    for (std::vector<KTest*>::const_iterator it = usingSeeds->begin(), 
-           ie = usingSeeds->end(); it != ie; ++it)
-      v.push_back(SeedInfo(*it));
 
-    int lastNumSeeds = usingSeeds->size()+10;
+    for (KTest *seed : *usingSeeds)
+      v.push_back(SeedInfo(seed));
+
+    // Seeds with the same inputs follow the same path, so only the first
+    // of them is replayed (fuzzer corpora often contain many duplicates)
+    if (unsigned duplicateSeeds = removeDuplicateSeeds(v))
+      klee_message("ignoring %u duplicate seeds", duplicateSeeds);
+
     time::Point lastTime, startTime = lastTime = time::getWallTime();
     ExecutionState *lastState = 0;
     while (!seedMap.empty()) {
       if (haltExecution) {
+        resolveUncheckedBranches();
         doDumpStates();
         return;
       }
@@ -3716,30 +3925,31 @@ void Executor::run(ExecutionState &initialState) {
         dumpExecutionTree();
       updateStates(&state);
 
+      // Seeds are only counted when reported, as there may be many of them
       if ((stats::instructions % 1000) == 0) {
-        int numSeeds = 0, numStates = 0;
-        for (std::map<ExecutionState*, std::vector<SeedInfo> >::iterator
-               it = seedMap.begin(), ie = seedMap.end();
-             it != ie; ++it) {
-          numSeeds += it->second.size();
-          numStates++;
-        }
         const auto time = time::getWallTime();
         const time::Span seedTime(SeedTime);
-        if (seedTime && time > startTime + seedTime) {
-          klee_warning("seed time expired, %d seeds remain over %d states",
-                       numSeeds, numStates);
-          break;
-        } else if (numSeeds<=lastNumSeeds-10 ||
-                   time - lastTime >= time::seconds(10)) {
+        bool const expired = seedTime && time > startTime + seedTime;
+        if (expired || time - lastTime >= time::seconds(10)) {
           lastTime = time;
-          lastNumSeeds = numSeeds;          
-          klee_message("%d seeds remaining over: %d states", 
-                       numSeeds, numStates);
+          std::size_t numSeeds = 0;
+          for (const auto &[seedState, seeds] : seedMap)
+            numSeeds += seeds.size();
+          if (expired) {
+            klee_warning("seed time expired, %zu seeds remain over %zu states",
+                         numSeeds, seedMap.size());
+            break;
+          }
+          klee_message("%zu seeds remaining over: %zu states", numSeeds,
+                       seedMap.size());
         }
       }
     }
 
+    resolveUncheckedBranches();
+    if (numDuplicateSeeds)
+      klee_message("dropped %u seeds following the same path as another seed",
+                   numDuplicateSeeds);
     klee_message("seeding done (%d states remain)", (int) states.size());
 
     if (OnlySeed) {
@@ -4063,12 +4273,6 @@ static std::set<std::string> okExternals(okExternalsList,
 void Executor::callExternalFunction(ExecutionState &state, KInstruction *target,
                                     KCallable *callable,
                                     std::vector<ref<Expr>> &arguments) {
-  // check if specialFunctionHandler wants it
-  if (const auto *func = dyn_cast<KFunction>(callable);
-      func &&
-      specialFunctionHandler->handle(state, func->function, target, arguments))
-    return;
-
   if (ExternalCalls == ExternalCallPolicy::None &&
       !okExternals.count(callable->getName().str())) {
     klee_warning("Disallowed call to external function: %s\n",
@@ -4124,10 +4328,16 @@ void Executor::callExternalFunction(ExecutionState &state, KInstruction *target,
     }
   }
 
-  // Prepare external memory for invoking the function
+  // Prepare external memory for invoking the function. Pure functions do not
+  // access memory.
+  const bool pure = externalDispatcher->isPure(callable);
+  MemoryManager *const copyTracker =
+      ExternalCallsCopyChangedOnly ? memory.get() : nullptr;
   static std::size_t residentPages = 0;
   double avgNeededPages = 0;
-  if (MemoryManager::isDeterministic) {
+  if (pure) {
+    // nothing to copy
+  } else if (MemoryManager::isDeterministic) {
     auto const minflt = [] {
       struct rusage ru = {};
       [[maybe_unused]] int ret = getrusage(RUSAGE_SELF, &ru);
@@ -4137,7 +4347,8 @@ void Executor::callExternalFunction(ExecutionState &state, KInstruction *target,
     };
 
     auto tmp = minflt();
-    std::size_t neededPages = state.addressSpace.copyOutConcretes();
+    std::size_t neededPages =
+        state.addressSpace.copyOutConcretes(copyTracker);
     auto newPages = minflt() - tmp;
     assert(newPages >= 0);
     residentPages += newPages;
@@ -4151,7 +4362,7 @@ void Executor::callExternalFunction(ExecutionState &state, KInstruction *target,
     avgNeededPages_ = (3.0 * avgNeededPages_ + neededPages) / 4.0;
     avgNeededPages = avgNeededPages_;
   } else {
-    state.addressSpace.copyOutConcretes();
+    state.addressSpace.copyOutConcretes(copyTracker);
   }
 
 #ifndef WINDOWS
@@ -4192,7 +4403,23 @@ void Executor::callExternalFunction(ExecutionState &state, KInstruction *target,
       klee_warning_once(callable->getValue(), "%s", os.str().c_str());
   }
 
-  bool success = externalDispatcher->executeCall(callable, target->inst, args);
+  // A sandboxed call receives the memory of all objects the state owns,
+  // unless the sandbox already holds the same version. It inherits read-only
+  // native objects (e.g. locale tables) from KLEE.
+  ExternalDispatcher::memory_ranges_ty sandboxMemory;
+  if (ExternalCallsSandbox && !pure) {
+    for (const auto &[mo, os] : state.addressSpace.objects) {
+      if (!mo->isUserSpecified && mo->size != 0 &&
+          !(mo->isFixed && os->readOnly))
+        sandboxMemory.push_back(
+            {reinterpret_cast<void *>(mo->address), mo->size,
+             state.addressSpace.getNativeCopyVersion(mo, os.get(),
+                                                     copyTracker)});
+    }
+  }
+
+  bool success = externalDispatcher->executeCall(callable, target->inst, args,
+                                                 sandboxMemory);
   if (!success) {
     terminateStateOnExecError(state,
                               "failed external call: " + callable->getName(),
@@ -4200,14 +4427,15 @@ void Executor::callExternalFunction(ExecutionState &state, KInstruction *target,
     return;
   }
 
-  if (!state.addressSpace.copyInConcretes(ExternalCalls ==
-                                          ExternalCallPolicy::All)) {
+  if (!pure && !state.addressSpace.copyInConcretes(
+                   ExternalCalls == ExternalCallPolicy::All, copyTracker)) {
     terminateStateOnExecError(state, "external modified read-only object",
                               StateTerminationType::External);
     return;
   }
 
-  if (MemoryManager::isDeterministic && residentPages > ExternalPageThreshold &&
+  if (!pure && MemoryManager::isDeterministic &&
+      residentPages > ExternalPageThreshold &&
       residentPages > 2 * avgNeededPages) {
     if (memory->markMappingsAsUnneeded()) {
       residentPages = 0;
@@ -4732,6 +4960,12 @@ void Executor::executeMakeSymbolic(ExecutionState &state,
           }
         }
       }
+
+      // Seeds that differed only in bytes cut off by --allow-seed-truncation
+      // now follow the same path
+      found = seedMap.find(&state);
+      if (found != seedMap.end())
+        numDuplicateSeeds += removeDuplicateSeeds(found->second);
     }
   } else {
     ObjectState *os = bindObjectInState(state, mo, false);
@@ -4772,8 +5006,7 @@ void Executor::runFunctionAsMain(Function *f,
   for (envc=0; envp[envc]; ++envc) ;
 
   unsigned NumPtrBytes = Context::get().getPointerWidth() / 8;
-  KFunction *kf = kmodule->functionMap[f];
-  assert(kf);
+  KFunction *kf = getKFunction(f);
   Function::arg_iterator ai = f->arg_begin(), ae = f->arg_end();
   if (ai!=ae) {
     arguments.push_back(ConstantExpr::alloc(argc, Expr::Int32));
@@ -4800,7 +5033,7 @@ void Executor::runFunctionAsMain(Function *f,
   }
 
   ExecutionState *state =
-      new ExecutionState(kmodule->functionMap[f], memory.get());
+      new ExecutionState(kf, memory.get());
 
   if (pathWriter) 
     state->pathOS = pathWriter->open();
@@ -4849,11 +5082,17 @@ void Executor::runFunctionAsMain(Function *f,
   run(*state);
   executionTree = nullptr;
 
+  if (MemoryManager::isProfilingAllocations()) {
+    if (auto os = interpreterHandler->openOutputFile("kdalloc-profile.txt"))
+      memory->writeAllocationProfile(*os);
+  }
+
   // hack to clear memory objects
   memory = std::make_unique<MemoryManager>(&arrayCache);
 
   globalObjects.clear();
   globalAddresses.clear();
+  constantsBound = false;
 
   if (statsTracker)
     statsTracker->done();
@@ -4906,6 +5145,8 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
                                    std::pair<std::string,
                                    std::vector<unsigned char> > >
                                    &res) {
+  // Test generation is not part of the last executed instruction
+  QueryProfiler::OriginScope origin(solver->getProfiler(), nullptr);
   solver->setTimeout(coreSolverTimeout);
 
   ConstraintSet extendedConstraints(state.constraints);
@@ -4957,6 +5198,13 @@ void Executor::getCoveredLines(const ExecutionState &state,
   res = state.coveredLines;
 }
 
+void Executor::getCoveredBlocks(const ExecutionState &state,
+                                std::vector<std::uint32_t> &res) {
+  res.clear();
+  for (std::uint32_t block : state.coveredBlocks)
+    res.push_back(block);
+}
+
 void Executor::doImpliedValueConcretization(ExecutionState &state,
                                             ref<Expr> e,
                                             ref<ConstantExpr> value) {
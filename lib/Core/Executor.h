@@ -140,6 +140,14 @@ private:
   /// on as-yet-to-be-determined flags.
   std::map<ExecutionState*, std::vector<SeedInfo> > seedMap;
 
+  /// Number of seeds dropped while seeding, as another seed of their state
+  /// follows the same path.
+  unsigned numDuplicateSeeds = 0;
+
+  /// States forked by -concolic-seeding for branch directions that no seed
+  /// takes, together with the branch condition they still lack.
+  std::vector<std::pair<ExecutionState *, ref<Expr>>> uncheckedBranches;
+
   /// Map of globals to their representative memory object.
   std::map<const llvm::GlobalValue*, MemoryObject*> globalObjects;
 
@@ -213,7 +221,15 @@ private:
   /// Return the typeid corresponding to a certain `type_info`
   ref<ConstantExpr> getEhTypeidFor(ref<Expr> type_info);
 
+  /// Whether the module constant table has been initialized for the
+  /// current run
+  bool constantsBound = false;
+
   llvm::Function* getTargetFunction(llvm::Value *calledVal);
+
+  /// Return the KFunction of \p f, which is created and bound when \p f is
+  /// first called if functions are prepared lazily.
+  KFunction *getKFunction(llvm::Function *f);
   
   void executeInstruction(ExecutionState &state, KInstruction *ki);
 
@@ -524,6 +540,10 @@ private:
   void printDebugInstructions(ExecutionState &state);
   void doDumpStates();
 
+  /// Adds the conditions of the unchecked branches that are feasible, and
+  /// terminates the other unchecked states.
+  void resolveUncheckedBranches();
+
   /// Only for debug purposes; enable via debugger or klee-control
   void dumpStates();
   void dumpExecutionTree();
@@ -592,6 +612,9 @@ public:
                        std::map<const std::string *, std::set<unsigned>> &res)
       override;
 
+  void getCoveredBlocks(const ExecutionState &state,
+                        std::vector<std::uint32_t> &res) override;
+
   Expr::Width getWidthForLLVMType(llvm::Type *type) const;
   size_t getAllocationAlignment(const llvm::Value *allocSite) const;
 
@@ -13,6 +13,7 @@
 #include "klee/Config/Version.h"
 #include "klee/Module/KCallable.h"
 #include "klee/Module/KModule.h"
+#include "klee/Support/ErrorHandling.h"
 
 #include "klee/Support/CompilerWarning.h"
 DISABLE_WARNING_PUSH
@@ -31,8 +32,22 @@ DISABLE_WARNING_DEPRECATED_DECLARATIONS
 #include "llvm/Support/TargetSelect.h"
 DISABLE_WARNING_POP
 
+#include <algorithm>
+#include <cerrno>
+#include <climits>
 #include <csetjmp>
 #include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <tuple>
+#include <vector>
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 using namespace llvm;
 using namespace klee;
@@ -52,14 +67,58 @@ namespace klee {
 
 class ExternalDispatcherImpl {
 private:
-  typedef std::map<const llvm::Instruction *, llvm::Function *> dispatchers_ty;
+  /// A compiled dispatcher and, if it calls through a function pointer, the
+  /// function to call
+  struct Dispatcher {
+    llvm::Function *function = nullptr;
+    void *target = nullptr;
+  };
+  typedef std::map<const llvm::Instruction *, Dispatcher> dispatchers_ty;
   dispatchers_ty dispatchers;
+
+  /// Dispatchers that call through a function pointer, keyed by the type of
+  /// the callee, the argument types at the call site and the attributes
+  typedef std::tuple<llvm::FunctionType *, std::vector<llvm::Type *>, void *>
+      signature_ty;
+  std::map<signature_ty, llvm::Function *> signatureDispatchers;
+
+  std::set<std::string> pureFunctions;
+  /// Result words and errno of pure calls by callee, argument words and
+  /// errno, most recently used first
+  typedef std::tuple<KCallable *, std::vector<uint64_t>, int> memo_key_ty;
+  std::list<std::pair<memo_key_ty, std::tuple<uint64_t, uint64_t, int>>>
+      memoizedCalls;
+  std::map<memo_key_ty, decltype(memoizedCalls)::iterator> memoizedCallIndex;
+  std::size_t maxMemoizedCalls = 0;
+
   llvm::Function *createDispatcher(KCallable *target, llvm::Instruction *i,
-                                   llvm::Module *module);
+                                   llvm::Module *module, bool indirect);
+  llvm::Function *compileDispatcher(KCallable *target, llvm::Instruction *i,
+                                    bool indirect);
+  const Dispatcher &getDispatcher(KCallable *callable, llvm::Instruction *i);
   llvm::ExecutionEngine *executionEngine;
   LLVMContext &ctx;
   std::map<std::string, void *> preboundFunctions;
-  bool runProtectedCall(llvm::Function *f, uint64_t *args);
+  bool runProtectedCall(const Dispatcher &dispatcher, uint64_t *args);
+  bool runSandboxedCall(KCallable *callable, llvm::Instruction *i,
+                        uint64_t *args,
+                        const ExternalDispatcher::memory_ranges_ty &memory);
+  bool sandboxed = false;
+  time::Span sandboxTimeout;
+  /// Native memory mapped afresh in the sandbox helper
+  std::vector<std::pair<void *, std::size_t>> sandboxMappings;
+  /// The sandbox helper process and the socket calls are queued on, or -1
+  pid_t helperPid = -1;
+  int helperSocket = -1;
+  /// Native memory ranges [start, end) of the helper mapped to the version of
+  /// the contents last shipped there
+  std::map<std::uintptr_t, std::pair<std::uintptr_t, std::uint64_t>>
+      helperCopies;
+  bool startHelper();
+  void stopHelper();
+  [[noreturn]] void runHelper(int socket);
+  bool isHelperCopyCurrent(const ExternalDispatcher::MemoryRange &range) const;
+  void forgetHelperCopies(std::uintptr_t address, std::size_t size);
   llvm::Module *singleDispatchModule;
   std::vector<std::string> moduleIDs;
   std::string &getFreshModuleID();
@@ -69,12 +128,48 @@ public:
   ExternalDispatcherImpl(llvm::LLVMContext &ctx);
   ~ExternalDispatcherImpl();
   bool executeCall(KCallable *callable, llvm::Instruction *i,
-                   uint64_t *args);
+                   uint64_t *args,
+                   const ExternalDispatcher::memory_ranges_ty &memory);
   void *resolveSymbol(const std::string &name);
+  void setPureFunctions(const std::set<std::string> &names,
+                        std::size_t maxMemoizedCalls);
+  bool isPure(KCallable *callable);
+  void setSandbox(bool enabled, time::Span timeout,
+                  const std::vector<std::pair<void *, std::size_t>> &mappings);
   int getLastErrno();
   void setLastErrno(int newErrno);
 };
 
+/// Returns the type each argument of the call \p cb to \p target is passed
+/// as. This accommodates for the corresponding code in Executor.cpp for
+/// handling calls to bitcasted functions.
+static std::vector<Type *> getArgumentTypes(KCallable *target,
+                                            const CallBase &cb) {
+  FunctionType *FTy = target->getFunctionType();
+  std::vector<Type *> types;
+  types.reserve(cb.arg_size());
+  unsigned i = 0;
+  for (auto ai = cb.arg_begin(), ae = cb.arg_end(); ai != ae; ++ai, ++i)
+    types.push_back(i < FTy->getNumParams() ? FTy->getParamType(i)
+                                            : (*ai)->getType());
+  return types;
+}
+
+/// Returns the index of the first word in the argument buffer after the
+/// arguments of type \p types.
+static unsigned getArgumentWordsEnd(const std::vector<Type *> &types) {
+  unsigned idx = 2;
+  for (Type *argTy : types) {
+    // fp80 must be aligned to 16 according to the System V AMD 64 ABI
+    if (argTy->isX86_FP80Ty() && idx & 0x01)
+      idx++;
+
+    unsigned argSize = argTy->getPrimitiveSizeInBits();
+    idx += ((!!argSize ? argSize : 64) + 63) / 64;
+  }
+  return idx;
+}
+
 std::string &ExternalDispatcherImpl::getFreshModuleID() {
   // We store the module IDs because `llvm::Module` constructor takes the
   // module ID as a StringRef so it doesn't own the ID.  Therefore we need to
@@ -157,41 +252,99 @@ ExternalDispatcherImpl::ExternalDispatcherImpl(LLVMContext &ctx)
 }
 
 ExternalDispatcherImpl::~ExternalDispatcherImpl() {
+  stopHelper();
   delete executionEngine;
   // NOTE: the `executionEngine` owns all modules so
   // we don't need to delete any of them.
 }
 
-bool ExternalDispatcherImpl::executeCall(KCallable *callable, Instruction *i,
-                                         uint64_t *args) {
+bool ExternalDispatcherImpl::executeCall(
+    KCallable *callable, Instruction *i, uint64_t *args,
+    const ExternalDispatcher::memory_ranges_ty &memory) {
   ++stats::externalCalls;
-  dispatchers_ty::iterator it = dispatchers.find(i);
-  if (it != dispatchers.end()) {
-    // Code already JIT'ed for this
-    return runProtectedCall(it->second, args);
+
+  memo_key_ty memoKey;
+  bool const pure = isPure(callable);
+  if (pure) {
+    auto argsEnd =
+        getArgumentWordsEnd(getArgumentTypes(callable, cast<CallBase>(*i)));
+    memoKey = {callable, std::vector<uint64_t>(args + 2, args + argsEnd),
+               lastErrno};
+    auto it = memoizedCallIndex.find(memoKey);
+    if (it != memoizedCallIndex.end()) {
+      memoizedCalls.splice(memoizedCalls.begin(), memoizedCalls, it->second);
+      std::tie(args[0], args[1], lastErrno) = it->second->second;
+      return true;
+    }
   }
 
-  // Code for this not JIT'ed. Do this now.
-  Function *dispatcher;
-#ifdef WINDOWS
-  std::map<std::string, void *>::iterator it2 =
-      preboundFunctions.find(f->getName());
-
-  if (it2 != preboundFunctions.end()) {
-    // only bind once
-    if (it2->second) {
-      executionEngine->addGlobalMapping(f, it2->second);
-      it2->second = 0;
+  // The sandbox helper compiles dispatchers itself
+  if (sandboxed ? !runSandboxedCall(callable, i, args, memory)
+                : !runProtectedCall(getDispatcher(callable, i), args))
+    return false;
+
+  if (pure) {
+    if (maxMemoizedCalls && memoizedCalls.size() >= maxMemoizedCalls) {
+      memoizedCallIndex.erase(memoizedCalls.back().first);
+      memoizedCalls.pop_back();
     }
+    memoizedCalls.emplace_front(std::move(memoKey),
+                                std::make_tuple(args[0], args[1], lastErrno));
+    memoizedCallIndex.emplace(memoizedCalls.front().first,
+                              memoizedCalls.begin());
   }
+  return true;
+}
+
+const ExternalDispatcherImpl::Dispatcher &
+ExternalDispatcherImpl::getDispatcher(KCallable *callable, Instruction *i) {
+  dispatchers_ty::iterator it = dispatchers.find(i);
+  if (it == dispatchers.end()) {
+    // Code for this not JIT'ed. Do this now.
+    Dispatcher dispatcher;
+#ifdef WINDOWS
+    std::map<std::string, void *>::iterator it2 =
+        preboundFunctions.find(f->getName());
+
+    if (it2 != preboundFunctions.end()) {
+      // only bind once
+      if (it2->second) {
+        executionEngine->addGlobalMapping(f, it2->second);
+        it2->second = 0;
+      }
+    }
 #endif
 
-  Module *dispatchModule = NULL;
-  // The MCJIT generates whole modules at a time so for every call that we
-  // haven't made before we need to create a new Module.
-  dispatchModule = new Module(getFreshModuleID(), ctx);
-  dispatcher = createDispatcher(callable, i, dispatchModule);
-  dispatchers.insert(std::make_pair(i, dispatcher));
+    if (auto *func = dyn_cast<KFunction>(callable)) {
+      // Functions are called through a pointer, so that all calls with the
+      // same signature share a single module instead of compiling one module
+      // per call site.
+      dispatcher.target = resolveSymbol(func->getName().str());
+      if (dispatcher.target) {
+        signature_ty signature{
+            func->getFunctionType(),
+            getArgumentTypes(callable, cast<CallBase>(*i)),
+            func->function->getAttributes().getRawPointer()};
+        auto &function = signatureDispatchers[signature];
+        if (!function)
+          function = compileDispatcher(callable, i, true);
+        dispatcher.function = function;
+      }
+    } else {
+      dispatcher.function = compileDispatcher(callable, i, false);
+    }
+    it = dispatchers.insert(std::make_pair(i, dispatcher)).first;
+  }
+  return it->second;
+}
+
+Function *ExternalDispatcherImpl::compileDispatcher(KCallable *target,
+                                                    Instruction *i,
+                                                    bool indirect) {
+  // The MCJIT generates whole modules at a time so for every dispatcher that
+  // we haven't built before we need to create a new Module.
+  Module *dispatchModule = new Module(getFreshModuleID(), ctx);
+  Function *dispatcher = createDispatcher(target, i, dispatchModule, indirect);
 
   // Force the JIT execution engine to go ahead and build the function. This
   // ensures that any errors or assertions in the compilation process will
@@ -213,20 +366,49 @@ bool ExternalDispatcherImpl::executeCall(KCallable *callable, Instruction *i,
     // MCJIT didn't take ownership of the module so delete it.
     delete dispatchModule;
   }
-  return runProtectedCall(dispatcher, args);
+  return dispatcher;
+}
+
+void ExternalDispatcherImpl::setPureFunctions(
+    const std::set<std::string> &names, std::size_t maxMemoizedCalls) {
+  pureFunctions = names;
+  this->maxMemoizedCalls = maxMemoizedCalls;
+}
+
+bool ExternalDispatcherImpl::isPure(KCallable *callable) {
+  if (pureFunctions.empty() || !isa<KFunction>(callable) ||
+      !pureFunctions.count(callable->getName().str()))
+    return false;
+
+  // Results may only depend on the arguments, not on memory they point to
+  FunctionType *FTy = callable->getFunctionType();
+  bool const valid =
+      !FTy->isVarArg() && !FTy->getReturnType()->isPointerTy() &&
+      std::none_of(FTy->param_begin(), FTy->param_end(),
+                   [](Type *ty) { return ty->isPointerTy(); });
+  if (!valid)
+    klee_warning_once(callable,
+                      "not memoizing calls to %s: it takes or returns "
+                      "pointers or variadic arguments",
+                      callable->getName().str().c_str());
+  return valid;
 }
 
 // FIXME: This is not reentrant.
 static uint64_t *gTheArgsP;
-bool ExternalDispatcherImpl::runProtectedCall(Function *f, uint64_t *args) {
+static void *gTheTargetP;
+bool ExternalDispatcherImpl::runProtectedCall(const Dispatcher &dispatcher,
+                                              uint64_t *args) {
   struct sigaction segvAction, segvActionOld;
   bool res;
 
+  Function *f = dispatcher.function;
   if (!f)
     return false;
 
   std::vector<GenericValue> gvArgs;
   gTheArgsP = args;
+  gTheTargetP = dispatcher.target;
 
   segvAction.sa_handler = nullptr;
   sigemptyset(&(segvAction.sa_mask));
@@ -249,6 +431,320 @@ bool ExternalDispatcherImpl::runProtectedCall(Function *f, uint64_t *args) {
   return res;
 }
 
+void ExternalDispatcherImpl::setSandbox(
+    bool enabled, time::Span timeout,
+    const std::vector<std::pair<void *, std::size_t>> &mappings) {
+  sandboxed = enabled;
+  sandboxTimeout = timeout;
+  sandboxMappings = mappings;
+}
+
+namespace {
+/// A call queued on the sandbox helper, followed by the argument words, a
+/// SandboxRange per memory range and the contents of the shipped ranges
+struct SandboxRequest {
+  KCallable *callable;
+  Instruction *instruction;
+  int errorNumber;
+  std::uint32_t numArgWords;
+  std::uint64_t numRanges;
+};
+
+struct SandboxRange {
+  std::uintptr_t address;
+  std::uint64_t size;
+  std::uint64_t shipped;
+};
+
+/// The result of a call, followed by the indices of the ranges the call
+/// changed and their contents
+struct SandboxResponse {
+  std::uint64_t results[2];
+  int errorNumber;
+  std::uint32_t success;
+  std::uint64_t numChanged;
+};
+} // namespace
+
+static bool sendAll(int socket, const void *data, std::size_t size) {
+  auto *pos = static_cast<const char *>(data);
+  while (size) {
+    ssize_t sent = ::send(socket, pos, size, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent <= 0)
+      return false;
+    pos += sent;
+    size -= sent;
+  }
+  return true;
+}
+
+static bool receiveAll(int socket, void *data, std::size_t size) {
+  auto *pos = static_cast<char *>(data);
+  while (size) {
+    ssize_t received = ::recv(socket, pos, size, 0);
+    if (received < 0 && errno == EINTR)
+      continue;
+    if (received <= 0)
+      return false;
+    pos += received;
+    size -= received;
+  }
+  return true;
+}
+
+bool ExternalDispatcherImpl::startHelper() {
+  int sockets[2];
+  if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets)) {
+    klee_warning("unable to create socket for the sandbox helper: %s",
+                 std::strerror(errno));
+    return false;
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+
+  pid_t pid = ::fork();
+  // - error
+  if (pid == -1) {
+    klee_warning("fork() failed for the sandbox helper: %s",
+                 std::strerror(errno));
+    ::close(sockets[0]);
+    ::close(sockets[1]);
+    return false;
+  }
+  // - child (sandbox helper)
+  if (pid == 0) {
+    ::close(sockets[0]);
+    runHelper(sockets[1]);
+  }
+  // - parent
+  ::close(sockets[1]);
+  helperPid = pid;
+  helperSocket = sockets[0];
+  return true;
+}
+
+void ExternalDispatcherImpl::stopHelper() {
+  if (helperPid == -1)
+    return;
+
+  ::close(helperSocket);
+  ::kill(helperPid, SIGKILL);
+  while (::waitpid(helperPid, nullptr, 0) < 0 && errno == EINTR)
+    ;
+  helperPid = -1;
+  helperSocket = -1;
+  helperCopies.clear();
+}
+
+void ExternalDispatcherImpl::runHelper(int socket) {
+  // Crashes terminate the helper without KLEE's handlers, and interrupts are
+  // left to KLEE, which stops the helper
+  for (int signal : {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT})
+    ::signal(signal, SIG_DFL);
+  ::signal(SIGINT, SIG_IGN);
+
+  // The memory of the deterministic allocator only holds what KLEE ships.
+  // Mapping it afresh also releases the pages shared with KLEE.
+  for (const auto &[address, size] : sandboxMappings) {
+    if (::mmap(address, size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1,
+               0) == MAP_FAILED)
+      _exit(1);
+  }
+
+  SandboxRequest request;
+  std::vector<uint64_t> args;
+  std::vector<SandboxRange> ranges;
+  std::vector<unsigned char> contents;
+  std::vector<std::uint64_t> changed;
+  while (receiveAll(socket, &request, sizeof(request))) {
+    args.assign(request.numArgWords, 0);
+    ranges.resize(request.numRanges);
+    if (!receiveAll(socket, args.data(), args.size() * sizeof(uint64_t)) ||
+        !receiveAll(socket, ranges.data(),
+                    ranges.size() * sizeof(SandboxRange)))
+      _exit(1);
+
+    // Keep the memory as it was before the call to find the changed ranges
+    contents.clear();
+    for (const auto &range : ranges) {
+      auto *address = reinterpret_cast<unsigned char *>(range.address);
+      if (range.shipped && !receiveAll(socket, address, range.size))
+        _exit(1);
+      contents.insert(contents.end(), address, address + range.size);
+    }
+
+    // Inline assembly is called through a KInlineAsm that only exists during
+    // the call in KLEE
+    Instruction *i = request.instruction;
+    KCallable *callable = request.callable;
+    std::unique_ptr<KInlineAsm> inlineAsm;
+    if (auto *asmValue =
+            dyn_cast<InlineAsm>(cast<CallBase>(i)->getCalledOperand())) {
+      inlineAsm = std::make_unique<KInlineAsm>(asmValue);
+      callable = inlineAsm.get();
+    }
+
+    SandboxResponse response = {};
+    response.errorNumber = request.errorNumber;
+    const Dispatcher &dispatcher = getDispatcher(callable, i);
+    if (dispatcher.function) {
+      std::vector<GenericValue> gvArgs;
+      gTheArgsP = args.data();
+      gTheTargetP = dispatcher.target;
+      errno = request.errorNumber;
+      executionEngine->runFunction(dispatcher.function, gvArgs);
+      response.errorNumber = errno;
+      response.success = true;
+      fflush(stdout);
+      fflush(stderr);
+    }
+    response.results[0] = args[0];
+    response.results[1] = args[1];
+
+    changed.clear();
+    const unsigned char *before = contents.data();
+    for (std::size_t j = 0; j < ranges.size(); ++j) {
+      if (std::memcmp(reinterpret_cast<void *>(ranges[j].address), before,
+                      ranges[j].size))
+        changed.push_back(j);
+      before += ranges[j].size;
+    }
+    response.numChanged = changed.size();
+
+    if (!sendAll(socket, &response, sizeof(response)) ||
+        !sendAll(socket, changed.data(),
+                 changed.size() * sizeof(std::uint64_t)))
+      _exit(1);
+    for (auto j : changed) {
+      if (!sendAll(socket, reinterpret_cast<void *>(ranges[j].address),
+                   ranges[j].size))
+        _exit(1);
+    }
+  }
+  // KLEE closed the socket
+  _exit(0);
+}
+
+bool ExternalDispatcherImpl::isHelperCopyCurrent(
+    const ExternalDispatcher::MemoryRange &range) const {
+  if (!range.version)
+    return false;
+  auto const address = reinterpret_cast<std::uintptr_t>(range.address);
+  auto it = helperCopies.find(address);
+  return it != helperCopies.end() &&
+         it->second.first == address + range.size &&
+         it->second.second == range.version;
+}
+
+void ExternalDispatcherImpl::forgetHelperCopies(std::uintptr_t address,
+                                                std::size_t size) {
+  // the copy starting closest below `address` may extend into the range
+  auto it = helperCopies.upper_bound(address);
+  if (it != helperCopies.begin() && std::prev(it)->second.first > address)
+    --it;
+  const std::uintptr_t end = address + std::max<std::size_t>(size, 1);
+  while (it != helperCopies.end() && it->first < end)
+    it = helperCopies.erase(it);
+}
+
+bool ExternalDispatcherImpl::runSandboxedCall(
+    KCallable *callable, Instruction *i, uint64_t *args,
+    const ExternalDispatcher::memory_ranges_ty &memory) {
+  if (helperPid == -1 && !startHelper())
+    return false;
+
+  // Queue the call with the memory the helper does not hold yet
+  SandboxRequest request = {
+      callable, i, lastErrno,
+      getArgumentWordsEnd(getArgumentTypes(callable, cast<CallBase>(*i))),
+      memory.size()};
+  std::vector<SandboxRange> ranges;
+  ranges.reserve(memory.size());
+  for (const auto &range : memory)
+    ranges.push_back({reinterpret_cast<std::uintptr_t>(range.address),
+                      range.size, !isHelperCopyCurrent(range)});
+
+  fflush(stdout);
+  fflush(stderr);
+
+  bool sent =
+      sendAll(helperSocket, &request, sizeof(request)) &&
+      sendAll(helperSocket, args, request.numArgWords * sizeof(uint64_t)) &&
+      sendAll(helperSocket, ranges.data(),
+              ranges.size() * sizeof(SandboxRange));
+  for (std::size_t j = 0; sent && j < memory.size(); ++j) {
+    if (ranges[j].shipped)
+      sent = sendAll(helperSocket, memory[j].address, memory[j].size);
+  }
+  if (!sent) {
+    klee_warning("unable to send external call to the sandbox helper: %s",
+                 std::strerror(errno));
+    stopHelper();
+    return false;
+  }
+
+  if (sandboxTimeout) {
+    pollfd fd = {helperSocket, POLLIN, 0};
+    auto const timeout = static_cast<int>(std::min<std::uint64_t>(
+        (sandboxTimeout.toMicroseconds() + 999) / 1000, INT_MAX));
+    int ready;
+    do {
+      ready = ::poll(&fd, 1, timeout);
+    } while (ready < 0 && errno == EINTR);
+    if (ready == 0) {
+      klee_warning("external call to %s timed out",
+                   callable->getName().str().c_str());
+      stopHelper();
+      return false;
+    }
+  }
+
+  // The socket is closed if the call crashed the helper
+  SandboxResponse response;
+  if (!receiveAll(helperSocket, &response, sizeof(response))) {
+    stopHelper();
+    return false;
+  }
+
+  for (std::size_t j = 0; j < memory.size(); ++j) {
+    if (ranges[j].shipped && memory[j].version) {
+      forgetHelperCopies(ranges[j].address, ranges[j].size);
+      helperCopies.emplace(
+          ranges[j].address,
+          std::make_pair(ranges[j].address + ranges[j].size,
+                         memory[j].version));
+    }
+  }
+
+  // Changed ranges no longer hold the shipped version
+  std::vector<std::uint64_t> changed(response.numChanged);
+  bool received = receiveAll(helperSocket, changed.data(),
+                             changed.size() * sizeof(std::uint64_t));
+  for (std::size_t j = 0; received && j < changed.size(); ++j) {
+    if (changed[j] >= memory.size()) {
+      received = false;
+      break;
+    }
+    const auto &range = memory[changed[j]];
+    received = receiveAll(helperSocket, range.address, range.size);
+    forgetHelperCopies(reinterpret_cast<std::uintptr_t>(range.address),
+                       range.size);
+  }
+  if (!received) {
+    stopHelper();
+    return false;
+  }
+
+  args[0] = response.results[0];
+  args[1] = response.results[1];
+  lastErrno = response.errorNumber;
+  return response.success;
+}
+
 // FIXME: This might have been relevant for the old JIT but the MCJIT
 // has a completely different implementation so this comment below is
 // likely irrelevant and misleading.
@@ -259,9 +755,14 @@ bool ExternalDispatcherImpl::runProtectedCall(Function *f, uint64_t *args) {
 // the special cases that the JIT knows how to directly call. If this is not
 // done, then the jit will end up generating a nullary stub just to call our
 // stub, for every single function call.
+//
+// An indirect dispatcher calls the function pointer in gTheTargetP instead of
+// `target` itself and can therefore be shared by all functions of the same
+// signature.
 Function *ExternalDispatcherImpl::createDispatcher(KCallable *target,
                                                    Instruction *inst,
-                                                   Module *module) {
+                                                   Module *module,
+                                                   bool indirect) {
   if (isa<KFunction>(target) && !resolveSymbol(target->getName().str()))
     return 0;
 
@@ -274,7 +775,9 @@ Function *ExternalDispatcherImpl::createDispatcher(KCallable *target,
   // The module identifier is included because for the MCJIT we need
   // unique function names across all `llvm::Modules`s.
   std::string fnName =
-      "dispatcher_" + target->getName().str() + module->getModuleIdentifier();
+      "dispatcher_" +
+      (indirect ? std::string("indirect") : target->getName().str()) +
+      module->getModuleIdentifier();
   Function *dispatcher =
       Function::Create(FunctionType::get(Type::getVoidTy(ctx), nullary, false),
                        GlobalVariable::ExternalLinkage, fnName, module);
@@ -292,13 +795,10 @@ Function *ExternalDispatcherImpl::createDispatcher(KCallable *target,
   FunctionType *FTy = target->getFunctionType();
 
   // Each argument will be passed by writing it into gTheArgsP[i].
+  auto argTypes = getArgumentTypes(target, cb);
   unsigned i = 0, idx = 2;
   for (auto ai = cb.arg_begin(), ae = cb.arg_end(); ai != ae; ++ai, ++i) {
-    // Determine the type the argument will be passed as. This accommodates for
-    // the corresponding code in Executor.cpp for handling calls to bitcasted
-    // functions.
-    auto argTy =
-        (i < FTy->getNumParams() ? FTy->getParamType(i) : (*ai)->getType());
+    auto argTy = argTypes[i];
 
     // fp80 must be aligned to 16 according to the System V AMD 64 ABI
     if (argTy->isX86_FP80Ty() && idx & 0x01)
@@ -316,7 +816,18 @@ Function *ExternalDispatcherImpl::createDispatcher(KCallable *target,
   }
 
   llvm::CallInst *result;
-  if (auto* func = dyn_cast<KFunction>(target)) {
+  if (auto *func = dyn_cast<KFunction>(target); func && indirect) {
+    // Get a Value* for gTheTargetP, cast to the type of the target.
+    auto targetpp = Builder.CreateIntToPtr(
+        ConstantInt::get(Type::getInt64Ty(ctx), (uintptr_t)&gTheTargetP),
+        PointerType::getUnqual(Builder.getPtrTy()), "targetp");
+    auto targetp = Builder.CreateBitCast(
+        Builder.CreateLoad(Builder.getPtrTy(), targetpp, "target"),
+        PointerType::getUnqual(FTy));
+    result = Builder.CreateCall(FTy, targetp,
+                                llvm::ArrayRef<Value *>(args, args + i));
+    result->setAttributes(func->function->getAttributes());
+  } else if (auto* func = dyn_cast<KFunction>(target)) {
     auto dispatchTarget = module->getOrInsertFunction(target->getName(), FTy,
                                                       func->function->getAttributes());
     result = Builder.CreateCall(dispatchTarget,
@@ -362,14 +873,30 @@ ExternalDispatcher::ExternalDispatcher(llvm::LLVMContext &ctx)
 ExternalDispatcher::~ExternalDispatcher() { delete impl; }
 
 bool ExternalDispatcher::executeCall(KCallable *callable,
-                                     llvm::Instruction *i, uint64_t *args) {
-  return impl->executeCall(callable, i, args);
+                                     llvm::Instruction *i, uint64_t *args,
+                                     const memory_ranges_ty &memory) {
+  return impl->executeCall(callable, i, args, memory);
 }
 
 void *ExternalDispatcher::resolveSymbol(const std::string &name) {
   return impl->resolveSymbol(name);
 }
 
+void ExternalDispatcher::setPureFunctions(const std::set<std::string> &names,
+                                          std::size_t maxMemoizedCalls) {
+  impl->setPureFunctions(names, maxMemoizedCalls);
+}
+
+bool ExternalDispatcher::isPure(KCallable *callable) {
+  return impl->isPure(callable);
+}
+
+void ExternalDispatcher::setSandbox(
+    bool enabled, time::Span timeout,
+    const std::vector<std::pair<void *, std::size_t>> &mappings) {
+  impl->setSandbox(enabled, timeout, mappings);
+}
+
 int ExternalDispatcher::getLastErrno() { return impl->getLastErrno(); }
 void ExternalDispatcher::setLastErrno(int newErrno) {
   impl->setLastErrno(newErrno);
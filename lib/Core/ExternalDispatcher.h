@@ -11,11 +11,17 @@
 #define KLEE_EXTERNALDISPATCHER_H
 
 #include "klee/Config/Version.h"
+#include "klee/System/Time.h"
 
+#include <cstddef>
+#include <cstdint>
 #include <map>
 #include <memory>
+#include <set>
 #include <stdint.h>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace llvm {
 class Instruction;
@@ -30,17 +36,47 @@ private:
   ExternalDispatcherImpl *impl;
 
 public:
+  /// Native memory an external call may access and the version identifying
+  /// its contents (0 if unknown)
+  struct MemoryRange {
+    void *address;
+    std::size_t size;
+    std::uint64_t version;
+  };
+  typedef std::vector<MemoryRange> memory_ranges_ty;
+
   ExternalDispatcher(llvm::LLVMContext &ctx);
   ~ExternalDispatcher();
 
   /* Call the given function using the parameter passing convention of
    * ci with arguments in args[1], args[2], ... and writing the result
-   * into args[0].
+   * into args[0]. Sandboxed calls can only access the native memory in
+   * `memory`.
    */
   bool executeCall(KCallable *callable, llvm::Instruction *i,
-                   uint64_t *args);
+                   uint64_t *args, const memory_ranges_ty &memory = {});
   void *resolveSymbol(const std::string &name);
 
+  /// Marks the named external functions as pure: their results only depend on
+  /// their (non-pointer) arguments and errno, so calls are memoized. At most
+  /// \p maxMemoizedCalls calls (if non-zero) are kept, dropping the least
+  /// recently used ones.
+  void setPureFunctions(const std::set<std::string> &names,
+                        std::size_t maxMemoizedCalls);
+
+  /// Returns true if calls to \p callable are memoized. Such calls neither
+  /// read nor write memory.
+  bool isPure(KCallable *callable);
+
+  /// Runs external calls in a helper process forked from KLEE, which keeps
+  /// running until a call crashes or takes longer than \p timeout (if
+  /// non-zero). Each call ships the memory ranges whose version the helper
+  /// does not hold yet, and the helper sends back the ranges the call
+  /// changed. The helper maps the native memory \p mappings afresh, so that
+  /// it only holds shipped memory there.
+  void setSandbox(bool enabled, time::Span timeout,
+                  const std::vector<std::pair<void *, std::size_t>> &mappings);
+
   int getLastErrno();
   void setLastErrno(int newErrno);
 };
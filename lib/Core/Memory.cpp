@@ -86,6 +86,7 @@ ObjectState::ObjectState(const MemoryObject *mo)
     knownSymbolics(nullptr),
     unflushedMask(nullptr),
     updates(nullptr, nullptr),
+    concreteStoreVersion(0),
     size(mo->size),
     readOnly(false) {
   if (!UseConstantArrays) {
@@ -106,6 +107,7 @@ ObjectState::ObjectState(const MemoryObject *mo, const Array *array)
     knownSymbolics(nullptr),
     unflushedMask(nullptr),
     updates(array, nullptr),
+    concreteStoreVersion(0),
     size(mo->size),
     readOnly(false) {
   makeSymbolic();
@@ -120,6 +122,7 @@ ObjectState::ObjectState(const ObjectState &os)
     knownSymbolics(nullptr),
     unflushedMask(os.unflushedMask ? new BitArray(*os.unflushedMask, os.size) : nullptr),
     updates(os.updates),
+    concreteStoreVersion(os.concreteStoreVersion),
     size(os.size),
     readOnly(false) {
   assert(!os.readOnly && "no need to copy read only object?");
@@ -207,6 +210,7 @@ void ObjectState::flushToConcreteStore(Executor &executor,
     ref<ConstantExpr> ce =
         executor.toConstant(state, read8(i), "external call", concretize);
     ce->toMemory(concreteStore + i);
+    concreteStoreVersion = 0;
   }
 }
 
@@ -234,6 +238,7 @@ void ObjectState::makeSymbolic() {
 void ObjectState::initializeToZero() {
   makeConcrete();
   memset(concreteStore, 0, size);
+  concreteStoreVersion = 0;
 }
 
 void ObjectState::initializeToRandom() {  
@@ -242,6 +247,7 @@ void ObjectState::initializeToRandom() {
     // randomly selected by 256 sided die
     concreteStore[i] = 0xAB;
   }
+  concreteStoreVersion = 0;
 }
 
 /*
@@ -408,6 +414,7 @@ ref<Expr> ObjectState::read8(Executor &executor, ExecutionState &state, ref<Expr
 void ObjectState::write8(size_t offset, uint8_t value) {
   //assert(read_only == false && "writing to read-only object!");
   concreteStore[offset] = value;
+  concreteStoreVersion = 0;
   setKnownSymbolic(offset, 0);
 
   markByteConcrete(offset);
@@ -563,6 +570,25 @@ void ObjectState::write(size_t offset, ref<Expr> value) {
   }
 } 
 
+bool ObjectState::readConcrete8(size_t offset, uint8_t &value) const {
+  if (!isByteConcrete(offset))
+    return false;
+  value = concreteStore[offset];
+  return true;
+}
+
+void ObjectState::copyBytes(size_t offset, const ObjectState &src,
+                            size_t srcOffset, size_t count) {
+  assert(offset + count <= size && srcOffset + count <= src.size &&
+         "copy out of bounds");
+  for (size_t i = 0; i != count; ++i) {
+    if (src.isByteConcrete(srcOffset + i))
+      write8(offset + i, src.concreteStore[srcOffset + i]);
+    else
+      write8(offset + i, src.read8(srcOffset + i));
+  }
+}
+
 void ObjectState::write16(size_t offset, uint16_t value) {
   size_t NumBytes = 2;
   for (size_t i = 0; i != NumBytes; ++i) {
@@ -17,6 +17,7 @@
 
 #include "llvm/ADT/StringExtras.h"
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -193,6 +194,10 @@ private:
   // mutable because we may need flush during read of const
   mutable UpdateList updates;
 
+  /// Identifies the contents of concreteStore when it was last copied to
+  /// native memory for an external call; 0 if it was modified since
+  std::uint64_t concreteStoreVersion;
+
 public:
   size_t size;
 
@@ -234,6 +239,16 @@ public:
   void write16(size_t offset, uint16_t value);
   void write32(size_t offset, uint32_t value);
   void write64(size_t offset, uint64_t value);
+
+  /// Returns true and sets \p value if the byte at \p offset is concrete.
+  bool readConcrete8(size_t offset, uint8_t &value) const;
+
+  /// Copies \p count bytes at \p srcOffset of \p src to \p offset without
+  /// constructing expressions for concrete bytes. Overlapping ranges are
+  /// copied front to back.
+  void copyBytes(size_t offset, const ObjectState &src, size_t srcOffset,
+                 size_t count);
+
   void print() const;
 
   /// Generate concrete values for each symbolic byte of the object and put them
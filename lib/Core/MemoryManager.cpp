@@ -19,17 +19,24 @@
 #include "klee/Support/CompilerWarning.h"
 DISABLE_WARNING_PUSH
 DISABLE_WARNING_DEPRECATED_DECLARATIONS
+#include "llvm/IR/Function.h"
 #include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instruction.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/Alignment.h"
+#include "llvm/Support/raw_ostream.h"
 DISABLE_WARNING_POP
 
 #include <cinttypes>
 #include <algorithm>
+#include <fstream>
+#include <sstream>
 #include <sys/mman.h>
 #include <tuple>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace klee;
 
@@ -122,10 +129,84 @@ llvm::cl::opt<std::uint32_t, true, QuarantineSizeParser>
         llvm::cl::value_desc("size"), llvm::cl::init(8),
         llvm::cl::cat(MemoryCat));
 
+llvm::cl::list<unsigned> DeterministicAllocationSizeClasses(
+    "kdalloc-size-classes", llvm::cl::CommaSeparated,
+    llvm::cl::desc("Comma-separated list of the 8 strictly increasing slot "
+                   "sizes (powers of two below 4096) of the deterministic "
+                   "allocator; larger allocations use the large object "
+                   "allocator (default=1,4,8,16,32,64,256,2048)"),
+    llvm::cl::value_desc("sizes"), llvm::cl::cat(MemoryCat));
+
+llvm::cl::opt<std::string> DeterministicAllocationSizeClassesFromProfile(
+    "kdalloc-size-classes-from-profile",
+    llvm::cl::desc("Derive the slot sizes of the deterministic allocator from "
+                   "a kdalloc-profile.txt written by --kdalloc-profile"),
+    llvm::cl::value_desc("file"), llvm::cl::cat(MemoryCat));
+
+llvm::cl::opt<bool> DeterministicAllocationProfile(
+    "kdalloc-profile",
+    llvm::cl::desc("Record the sizes of deterministic allocations per "
+                   "allocation site in kdalloc-profile.txt (default=false)"),
+    llvm::cl::init(false), llvm::cl::cat(MemoryCat));
+
+llvm::cl::opt<std::string> DeterministicAllocationCompactInterval(
+    "kdalloc-compact-interval",
+    llvm::cl::desc("Periodically let execution states share identical "
+                   "deterministic allocator state (default=0s (off))"),
+    llvm::cl::init("0s"), llvm::cl::cat(MemoryCat));
+
 llvm::cl::opt<bool> NullOnZeroMalloc(
     "return-null-on-zero-malloc",
     llvm::cl::desc("Returns NULL if malloc(0) is called (default=false)"),
     llvm::cl::init(false), llvm::cl::cat(MemoryCat));
+kdalloc::SizeClasses getSizeClasses() {
+  if (!DeterministicAllocationSizeClasses.empty() &&
+      !DeterministicAllocationSizeClassesFromProfile.empty())
+    klee_error("Deterministic allocator: --kdalloc-size-classes and "
+               "--kdalloc-size-classes-from-profile are mutually exclusive");
+
+  if (!DeterministicAllocationSizeClasses.empty()) {
+    kdalloc::SizeClasses sizeClasses;
+    if (DeterministicAllocationSizeClasses.size() != sizeClasses.size())
+      klee_error("Deterministic allocator: --kdalloc-size-classes requires "
+                 "exactly %zu sizes",
+                 sizeClasses.size());
+    std::copy(DeterministicAllocationSizeClasses.begin(),
+              DeterministicAllocationSizeClasses.end(), sizeClasses.begin());
+    if (!kdalloc::isValidSizeClasses(sizeClasses))
+      klee_error("Deterministic allocator: --kdalloc-size-classes must be "
+                 "strictly increasing powers of two below 4096");
+    return sizeClasses;
+  }
+
+  if (!DeterministicAllocationSizeClassesFromProfile.empty()) {
+    std::ifstream profile(DeterministicAllocationSizeClassesFromProfile);
+    if (!profile)
+      klee_error("Deterministic allocator: Could not open allocation profile "
+                 "%s",
+                 DeterministicAllocationSizeClassesFromProfile.c_str());
+
+    // Each line holds a size, its number of allocations and the site
+    std::map<std::size_t, std::uint64_t> histogram;
+    std::string line;
+    while (std::getline(profile, line)) {
+      if (line.empty() || line[0] == '#')
+        continue;
+      std::istringstream fields(line);
+      std::size_t size;
+      std::uint64_t count;
+      if (!(fields >> size >> count))
+        klee_error("Deterministic allocator: Malformed line in allocation "
+                   "profile %s: %s",
+                   DeterministicAllocationSizeClassesFromProfile.c_str(),
+                   line.c_str());
+      histogram[size] += count;
+    }
+    return kdalloc::deriveSizeClasses(histogram);
+  }
+
+  return kdalloc::defaultSizeClasses;
+}
 } // namespace
 
 /***/
@@ -140,6 +221,15 @@ MemoryManager::MemoryManager(ArrayCache *_arrayCache)
                    DeterministicAllocationQuarantineSize.getValue());
     }
 
+    const kdalloc::SizeClasses sizeClasses = getSizeClasses();
+    if (sizeClasses != kdalloc::defaultSizeClasses) {
+      std::string sizes;
+      for (auto size : sizeClasses)
+        sizes += (sizes.empty() ? "" : ",") + std::to_string(size);
+      klee_message("Deterministic allocator: Using size classes %s",
+                   sizes.c_str());
+    }
+
     std::vector<std::tuple<std::string,
                            std::uintptr_t, // start address (0 if none
                                            // requested)
@@ -224,7 +314,7 @@ MemoryManager::MemoryManager(ArrayCache *_arrayCache)
       auto &factory = std::get<3>(requestedSegment);
       auto &allocator = std::get<4>(requestedSegment);
       factory.get() = kdalloc::AllocatorFactory(
-          start, size, DeterministicAllocationQuarantineSize);
+          start, size, DeterministicAllocationQuarantineSize, sizeClasses);
 
       if (!factory.get()) {
         klee_error("Deterministic allocator: Could not allocate mapping for %s "
@@ -311,6 +401,10 @@ MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal,
     }
 
     address = reinterpret_cast<std::uint64_t>(allocAddress);
+
+    if (DeterministicAllocationProfile)
+      ++allocationProfile[allocSite]
+                         [std::max(size, static_cast<std::uint64_t>(alignment))];
   } else {
     // Use malloc for the standard case
     if (alignment <= 8)
@@ -354,6 +448,7 @@ MemoryObject *MemoryManager::allocateFixed(uint64_t address, uint64_t size,
 
 void MemoryManager::markFreed(MemoryObject *mo) {
   if (objects.find(mo) != objects.end()) {
+    invalidateNativeCopies(mo->address, mo->size);
     if (!mo->isFixed && !DeterministicAllocation)
       free((void *)mo->address);
     objects.erase(mo);
@@ -370,11 +465,138 @@ bool MemoryManager::markMappingsAsUnneeded() {
   globalsFactory.getMapping().clear();
   heapFactory.getMapping().clear();
   stackFactory.getMapping().clear();
+  nativeCopies.clear();
 
   return true;
 }
 
+bool MemoryManager::isNativeCopyCurrent(const MemoryObject *mo,
+                                        std::uint64_t version) const {
+  if (!version)
+    return false;
+  auto it = nativeCopies.find(mo->address);
+  return it != nativeCopies.end() &&
+         it->second.first == mo->address + mo->size &&
+         it->second.second == version;
+}
+
+std::uint64_t MemoryManager::recordNativeCopy(const MemoryObject *mo) {
+  invalidateNativeCopies(mo->address, mo->size);
+  nativeCopies.emplace(mo->address, std::make_pair(mo->address + mo->size,
+                                                   ++lastNativeCopyVersion));
+  return lastNativeCopyVersion;
+}
+
+void MemoryManager::invalidateNativeCopies(std::uint64_t address,
+                                           std::uint64_t size) {
+  if (nativeCopies.empty())
+    return;
+
+  // the copy starting closest below `address` may extend into the range
+  auto it = nativeCopies.upper_bound(address);
+  if (it != nativeCopies.begin() && std::prev(it)->second.first > address)
+    --it;
+  const std::uint64_t end = address + std::max<std::uint64_t>(size, 1);
+  while (it != nativeCopies.end() && it->first < end)
+    it = nativeCopies.erase(it);
+}
+
+std::vector<std::pair<void *, std::size_t>>
+MemoryManager::getDeterministicMappings() const {
+  std::vector<std::pair<void *, std::size_t>> mappings;
+  if (!DeterministicAllocation)
+    return mappings;
+
+  for (const auto *factory :
+       {&globalsFactory, &constantsFactory, &heapFactory, &stackFactory}) {
+    const auto &mapping = factory->getMapping();
+    mappings.emplace_back(mapping.getBaseAddress(), mapping.getSize());
+  }
+  return mappings;
+}
+
 size_t MemoryManager::getUsedDeterministicSize() {
   // TODO: implement
   return 0;
 }
+
+MemoryManager::AllocatorSharing MemoryManager::getAllocatorSharing(
+    const std::set<ExecutionState *, ExecutionStateIDCompare> &states) {
+  AllocatorSharing result;
+  if (!DeterministicAllocation)
+    return result;
+
+  std::unordered_set<const void *> sharedBlocks;
+  auto visit = [&](const void *block, std::size_t bytes, bool shared) {
+    if (!shared)
+      result.privateBytes += bytes;
+    else if (sharedBlocks.insert(block).second)
+      result.sharedBytes += bytes;
+  };
+  for (const ExecutionState *state : states) {
+    state->heapAllocator.visitMemory(visit);
+    state->stackAllocator.visitMemory(visit);
+  }
+  return result;
+}
+
+time::Span MemoryManager::getCompactionInterval() {
+  if (!DeterministicAllocation)
+    return {};
+  return time::Span{DeterministicAllocationCompactInterval};
+}
+
+std::uint64_t MemoryManager::compactAllocators(
+    const std::set<ExecutionState *, ExecutionStateIDCompare> &states) {
+  if (!DeterministicAllocation)
+    return 0;
+
+  // Allocators with equal hashes are likely to be equal in every bin, so each
+  // allocator is only deduplicated against the first one with the same hash.
+  std::uint64_t released = 0;
+  auto compact = [&released](std::vector<kdalloc::Allocator *> &allocators) {
+    std::unordered_map<std::size_t, kdalloc::Allocator *> representatives;
+    for (kdalloc::Allocator *allocator : allocators) {
+      auto [it, inserted] =
+          representatives.emplace(allocator->hash(), allocator);
+      if (!inserted)
+        released += it->second->deduplicate(*allocator);
+    }
+  };
+
+  std::vector<kdalloc::Allocator *> heapAllocators, stackAllocators;
+  heapAllocators.reserve(states.size());
+  stackAllocators.reserve(states.size());
+  for (ExecutionState *state : states) {
+    heapAllocators.push_back(&state->heapAllocator);
+    stackAllocators.push_back(&state->stackAllocator);
+  }
+  compact(heapAllocators);
+  compact(stackAllocators);
+
+  stats::kdallocCompactedBytes += released;
+  return released;
+}
+
+bool MemoryManager::isProfilingAllocations() {
+  return DeterministicAllocation && DeterministicAllocationProfile;
+}
+
+void MemoryManager::writeAllocationProfile(llvm::raw_ostream &os) const {
+  os << "# size count site\n";
+  for (const auto &[site, histogram] : allocationProfile) {
+    std::string description;
+    llvm::raw_string_ostream siteOS(description);
+    if (!site) {
+      siteOS << "<unknown>";
+    } else if (const auto *inst = dyn_cast<llvm::Instruction>(site)) {
+      siteOS << inst->getFunction()->getName() << ":" << *inst;
+    } else {
+      siteOS << "@" << site->getName();
+    }
+    siteOS.flush();
+
+    for (const auto &[size, count] : histogram)
+      os << size << ' ' << count << ' ' << description << '\n';
+  }
+}
@@ -11,18 +11,24 @@
 #define KLEE_MEMORYMANAGER_H
 
 #include "klee/KDAlloc/kdalloc.h"
+#include "klee/System/Time.h"
 
 #include <cstddef>
+#include <map>
 #include <set>
 #include <cstdint>
+#include <utility>
+#include <vector>
 
 namespace llvm {
 class Value;
+class raw_ostream;
 }
 
 namespace klee {
 class ArrayCache;
 class ExecutionState;
+struct ExecutionStateIDCompare;
 class MemoryObject;
 
 class MemoryManager {
@@ -37,6 +43,16 @@ private:
   kdalloc::AllocatorFactory constantsFactory;
   kdalloc::Allocator constantsAllocator;
 
+  /// Native memory ranges [start, end) mapped to the concrete store version
+  /// that was last copied there for an external call
+  std::map<std::uint64_t, std::pair<std::uint64_t, std::uint64_t>>
+      nativeCopies;
+  std::uint64_t lastNativeCopyVersion = 0;
+
+  /// Number of deterministic allocations per allocation site and size
+  std::map<const llvm::Value *, std::map<std::size_t, std::uint64_t>>
+      allocationProfile;
+
 public:
   explicit MemoryManager(ArrayCache *arrayCache);
   ~MemoryManager();
@@ -63,10 +79,59 @@ public:
   bool markMappingsAsUnneeded();
   ArrayCache *getArrayCache() const { return arrayCache; }
 
+  /// Returns true if the native memory of \p mo still holds the contents of
+  /// the concrete store identified by \p version.
+  bool isNativeCopyCurrent(const MemoryObject *mo,
+                           std::uint64_t version) const;
+
+  /// Records that the native memory of \p mo now holds a copy of a concrete
+  /// store and returns the version identifying its contents.
+  std::uint64_t recordNativeCopy(const MemoryObject *mo);
+
+  /// Forgets all copies overlapping the native memory [address, address+size).
+  void invalidateNativeCopies(std::uint64_t address, std::uint64_t size);
+
+  /// Returns a fresh version for contents that are copied to native memory
+  /// only once, like those of read-only objects.
+  std::uint64_t newNativeCopyVersion() { return ++lastNativeCopyVersion; }
+
+  /// Returns the native memory (address and size) reserved by the
+  /// deterministic allocator, or nothing if it is disabled.
+  std::vector<std::pair<void *, std::size_t>> getDeterministicMappings() const;
+
   /*
    * Returns the size used by deterministic allocation in bytes
    */
   size_t getUsedDeterministicSize();
+
+  /// Copy-on-write state of the deterministic heap and stack allocators in
+  /// bytes. Shared state is referenced by more than one execution state and
+  /// counted only once.
+  struct AllocatorSharing {
+    std::uint64_t privateBytes = 0;
+    std::uint64_t sharedBytes = 0;
+  };
+
+  static AllocatorSharing getAllocatorSharing(
+      const std::set<ExecutionState *, ExecutionStateIDCompare> &states);
+
+  /// Returns the interval of allocator compaction (--kdalloc-compact-interval)
+  /// or zero if it is disabled.
+  static time::Span getCompactionInterval();
+
+  /// Lets execution states share allocator state that is equal but was copied
+  /// separately, e.g. after both sides of a fork allocated the same objects.
+  /// Returns the number of bytes released.
+  static std::uint64_t compactAllocators(
+      const std::set<ExecutionState *, ExecutionStateIDCompare> &states);
+
+  /// Returns true if deterministic allocations are profiled
+  /// (--kdalloc-profile).
+  static bool isProfilingAllocations();
+
+  /// Writes the allocation size histogram per allocation site in the format
+  /// read by --kdalloc-size-classes-from-profile.
+  void writeAllocationProfile(llvm::raw_ostream &os) const;
 };
 
 } // End klee namespace
@@ -91,20 +91,20 @@ void MergeHandler::addClosedState(ExecutionState *es,
   // Remove from openStates
   removeOpenState(es);
 
-  auto closePoint = reachedCloseMerge.find(mp);
+  // Only states that ran into this klee_close_merge instruction with the
+  // same fingerprint can be merged with this one
+  auto &candidates = mergeCandidates[mp][es->getMergeFingerprint()];
 
-  // If no other state has yet encountered this klee_close_merge instruction,
-  // add a new element to the map
-  if (closePoint == reachedCloseMerge.end()) {
+  // If there are none, add a new element to the map
+  if (candidates.empty()) {
     reachedCloseMerge[mp].push_back(es);
+    candidates.push_back(es);
     executor->mergingSearcher->pauseState(*es);
   } else {
-    // Otherwise try to merge with any state in the map element for this
-    // instruction
-    auto &cpv = closePoint->second;
+    // Otherwise try to merge with any of them
     bool mergedSuccessful = false;
 
-    for (auto& mState: cpv) {
+    for (auto& mState: candidates) {
       if (mState->merge(*es)) {
         executor->terminateStateEarlyAlgorithm(*es, "merged state.", StateTerminationType::Merge);
         executor->mergingSearcher->inCloseMerge.erase(es);
@@ -113,7 +113,8 @@ void MergeHandler::addClosedState(ExecutionState *es,
       }
     }
     if (!mergedSuccessful) {
-      cpv.push_back(es);
+      reachedCloseMerge[mp].push_back(es);
+      candidates.push_back(es);
       executor->mergingSearcher->pauseState(*es);
     }
   }
@@ -127,6 +128,7 @@ void MergeHandler::releaseStates() {
     }
   }
   reachedCloseMerge.clear();
+  mergeCandidates.clear();
 }
 
 bool MergeHandler::hasMergedStates() {
@@ -79,6 +79,7 @@ DISABLE_WARNING_POP
 
 #include <map>
 #include <stdint.h>
+#include <unordered_map>
 #include <vector>
 
 namespace llvm {
@@ -124,6 +125,12 @@ private:
   std::map<llvm::Instruction *, std::vector<ExecutionState *> >
       reachedCloseMerge;
 
+  /// @brief The states in 'reachedCloseMerge' grouped by their merge
+  /// fingerprint, as only states with the same fingerprint can be merged
+  std::map<llvm::Instruction *,
+           std::unordered_map<std::uint64_t, std::vector<ExecutionState *>>>
+      mergeCandidates;
+
 public:
 
   /// @brief Called when a state runs into a 'klee_close_merge()' call
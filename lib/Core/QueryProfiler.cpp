@@ -0,0 +1,117 @@
+//===-- QueryProfiler.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "QueryProfiler.h"
+
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Solver/SolverStats.h"
+
+#include <unordered_set>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+std::uint64_t countNodes(const ref<Expr> &e) {
+  std::unordered_set<const Expr *> visited;
+  std::vector<const Expr *> stack{e.get()};
+  while (!stack.empty()) {
+    const Expr *current = stack.back();
+    stack.pop_back();
+    if (!visited.insert(current).second)
+      continue;
+    for (unsigned i = 0, n = current->getNumKids(); i < n; ++i)
+      stack.push_back(current->getKid(i).get());
+  }
+  return visited.size();
+}
+} // namespace
+
+QueryProfiler::Scope::Scope(QueryProfiler *profiler, Kind kind,
+                            const ConstraintSet &constraints, ref<Expr> expr)
+    : profiler(profiler), kind(kind), constraints(constraints),
+      expr(std::move(expr)) {
+  if (!profiler)
+    return;
+  modelHits = stats::queryModelHits;
+  cacheHits = stats::queryCacheHits;
+  cexCacheHits = stats::queryCexCacheHits;
+  solverQueries = stats::solverQueries;
+  start = time::getWallTime();
+}
+
+QueryProfiler::Scope::~Scope() {
+  if (!profiler)
+    return;
+
+  const auto elapsed = time::getWallTime() - start;
+
+  // Stages further down the chain take precedence, as the earlier ones
+  // only hit on parts of the query then
+  Stage stage = Stage::Other;
+  if (stats::solverQueries != solverQueries)
+    stage = Stage::Core;
+  else if (stats::queryCexCacheHits != cexCacheHits)
+    stage = Stage::CexCache;
+  else if (stats::queryCacheHits != cacheHits)
+    stage = Stage::BranchCache;
+  else if (stats::queryModelHits != modelHits)
+    stage = Stage::Model;
+
+  std::vector<ref<Expr>> exprs(constraints.begin(), constraints.end());
+  exprs.push_back(expr);
+  std::vector<const Array *> arrays;
+  findSymbolicObjects(exprs.begin(), exprs.end(), arrays);
+
+  Entry &entry = profiler->entries[Key(profiler->origin, kind, stage)];
+  ++entry.queries;
+  entry.time += elapsed.toMicroseconds();
+  entry.exprNodes += countNodes(expr);
+  entry.arrays += arrays.size();
+  entry.constraints += constraints.size();
+}
+
+void QueryProfiler::recordConstant(Kind kind) {
+  ++entries[Key(origin, kind, Stage::Constant)].queries;
+}
+
+const char *QueryProfiler::getKindName(Kind kind) {
+  switch (kind) {
+  case Kind::Validity:
+    return "Validity";
+  case Kind::Truth:
+    return "Truth";
+  case Kind::Value:
+    return "Value";
+  case Kind::InitialValues:
+    return "InitialValues";
+  case Kind::Range:
+    return "Range";
+  }
+  return "Unknown";
+}
+
+const char *QueryProfiler::getStageName(Stage stage) {
+  switch (stage) {
+  case Stage::Constant:
+    return "Constant";
+  case Stage::Model:
+    return "Model";
+  case Stage::BranchCache:
+    return "BranchCache";
+  case Stage::CexCache:
+    return "CexCache";
+  case Stage::Core:
+    return "Core";
+  case Stage::Other:
+    return "Other";
+  }
+  return "Unknown";
+}
@@ -0,0 +1,106 @@
+//===-- QueryProfiler.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_QUERYPROFILER_H
+#define KLEE_QUERYPROFILER_H
+
+#include "klee/ADT/Ref.h"
+#include "klee/Expr/Expr.h"
+#include "klee/System/Time.h"
+
+#include <cstdint>
+#include <map>
+#include <tuple>
+
+namespace klee {
+class ConstraintSet;
+struct KInstruction;
+
+/// QueryProfiler - Aggregates the cost of solver queries by the instruction
+/// that issued them, the kind of query and the part of the solver chain
+/// that answered it.
+class QueryProfiler {
+public:
+  enum class Kind { Validity, Truth, Value, InitialValues, Range };
+
+  /// The first part of the solver chain that could answer a query
+  enum class Stage { Constant, Model, BranchCache, CexCache, Core, Other };
+
+  struct Entry {
+    std::uint64_t queries = 0;
+    /// Wall time in microseconds
+    std::uint64_t time = 0;
+    /// Number of distinct nodes of the query expressions
+    std::uint64_t exprNodes = 0;
+    /// Number of distinct arrays in constraints and query expressions
+    std::uint64_t arrays = 0;
+    std::uint64_t constraints = 0;
+  };
+
+  using Key = std::tuple<const KInstruction *, Kind, Stage>;
+
+  /// Scope - Records a single query from construction to destruction.
+  class Scope {
+    QueryProfiler *profiler;
+    Kind kind;
+    const ConstraintSet &constraints;
+    ref<Expr> expr;
+    time::Point start;
+    std::uint64_t modelHits, cacheHits, cexCacheHits, solverQueries;
+
+  public:
+    Scope(QueryProfiler *profiler, Kind kind, const ConstraintSet &constraints,
+          ref<Expr> expr);
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  };
+
+  /// OriginScope - Attributes the queries of a scope to an instruction, or
+  /// to none for queries not issued while executing one, and restores the
+  /// previous origin afterwards.
+  class OriginScope {
+    QueryProfiler *profiler;
+    const KInstruction *previous;
+
+  public:
+    OriginScope(QueryProfiler *profiler, const KInstruction *ki)
+        : profiler(profiler), previous(profiler ? profiler->origin : nullptr) {
+      if (profiler)
+        profiler->origin = ki;
+    }
+    ~OriginScope() {
+      if (profiler)
+        profiler->origin = previous;
+    }
+
+    OriginScope(const OriginScope &) = delete;
+    OriginScope &operator=(const OriginScope &) = delete;
+  };
+
+private:
+  const KInstruction *origin = nullptr;
+  std::map<Key, Entry> entries;
+
+public:
+  /// Attributes all following queries to \p ki.
+  void setOrigin(const KInstruction *ki) { origin = ki; }
+
+  /// Records a query answered without consulting the solver chain.
+  void recordConstant(Kind kind);
+
+  const std::map<Key, Entry> &getEntries() const { return entries; }
+
+  static const char *getKindName(Kind kind);
+  static const char *getStageName(Stage stage);
+};
+} // namespace klee
+
+#endif /* KLEE_QUERYPROFILER_H */
@@ -19,6 +19,12 @@
 #include "klee/ADT/KTest.h"
 #include "klee/Support/ErrorHandling.h"
 
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <algorithm>
+#include <cstring>
+
 using namespace klee;
 
 KTestObject *SeedInfo::getNextInput(const MemoryObject *mo,
@@ -163,3 +169,36 @@ void SeedInfo::patchSeed(const ExecutionState &state,
   }
 #endif
 }
+
+std::vector<const KTestObject *> SeedInfo::getUnusedInputs() const {
+  std::vector<const KTestObject *> inputs;
+  for (unsigned i = inputPosition; i < input->numObjects; ++i)
+    if (!used.count(&input->objects[i]))
+      inputs.push_back(&input->objects[i]);
+  return inputs;
+}
+
+std::size_t SeedInfo::hashPath() const {
+  llvm::hash_code hash = llvm::hash_value(assignment.bindings.size());
+  for (const auto &[array, values] : assignment.bindings)
+    hash = llvm::hash_combine(
+        hash, array, llvm::hash_combine_range(values.begin(), values.end()));
+  for (const KTestObject *obj : getUnusedInputs())
+    hash = llvm::hash_combine(
+        hash, llvm::StringRef(obj->name),
+        llvm::hash_combine_range(obj->bytes, obj->bytes + obj->numBytes));
+  return hash;
+}
+
+bool SeedInfo::followsSamePath(const SeedInfo &other) const {
+  if (assignment.bindings != other.assignment.bindings)
+    return false;
+  const auto inputs = getUnusedInputs(), otherInputs = other.getUnusedInputs();
+  return std::equal(
+      inputs.begin(), inputs.end(), otherInputs.begin(), otherInputs.end(),
+      [](const KTestObject *a, const KTestObject *b) {
+        return std::strcmp(a->name, b->name) == 0 &&
+               a->numBytes == b->numBytes &&
+               std::equal(a->bytes, a->bytes + a->numBytes, b->bytes);
+      });
+}
@@ -12,6 +12,9 @@
 
 #include "klee/Expr/Assignment.h"
 
+#include <cstddef>
+#include <vector>
+
 extern "C" {
   struct KTest;
   struct KTestObject;
@@ -43,6 +46,18 @@ namespace klee {
     void patchSeed(const ExecutionState &state, 
                    ref<Expr> condition,
                    TimingSolver *solver);
+
+    /// Hash of the values the seed assigns and of its inputs not used yet,
+    /// which determine the path the seed follows from here on.
+    std::size_t hashPath() const;
+
+    /// Returns true if the seed assigns the same values as \p other and has
+    /// the same inputs left, and so follows the same path from here on.
+    bool followsSamePath(const SeedInfo &other) const;
+
+  private:
+    /// Returns the inputs not used yet.
+    std::vector<const KTestObject *> getUnusedInputs() const;
   };
 }
 
@@ -58,6 +58,15 @@ cl::opt<bool>
                               "condition given to klee_assume rather than "
                               "emitting an error (default=false)"),
                      cl::cat(TerminationCat));
+
+cl::opt<bool> SummarizeLibc(
+    "summarize-libc", cl::init(false),
+    cl::desc("Execute memcmp, memcpy, strcmp and strlen with built-in models "
+             "that work on whole objects when their pointers and sizes are "
+             "concrete, instead of interpreting them byte by byte. Symbolic "
+             "bytes yield select expressions rather than forks "
+             "(default=false)"),
+    cl::cat(MiscCat));
 } // namespace
 
 /// \todo Almost all of the demands in this file should be replaced
@@ -109,6 +118,7 @@ static constexpr std::array handlerInfo = {
   add("__error", handleErrnoLocation, true),
 #endif
   add("klee_is_symbolic", handleIsSymbolic, true),
+  add("klee_loop_search", handleLoopSearch, true),
   add("klee_make_symbolic", handleMakeSymbolic, false),
   add("klee_mark_global", handleMarkGlobal, false),
   add("klee_open_merge", handleOpenMerge, false),
@@ -151,21 +161,47 @@ static constexpr std::array handlerInfo = {
 #undef add
 };
 
+static constexpr std::array summaryInfo = {
+#define add(name, summary) SpecialFunctionHandler::SummaryInfo{ name, \
+                             &SpecialFunctionHandler::summary }
+  add("memcmp", summarizeMemcmp),
+  add("memcpy", summarizeMemcpy),
+  add("strcmp", summarizeStrcmp),
+  add("strlen", summarizeStrlen),
+#undef add
+};
+
 SpecialFunctionHandler::SpecialFunctionHandler(Executor &_executor) 
   : executor(_executor) {}
 
+std::vector<SpecialFunctionHandler::CustomHandlerInfo> &
+SpecialFunctionHandler::getCustomHandlers() {
+  static std::vector<CustomHandlerInfo> customHandlers;
+  return customHandlers;
+}
+
+void SpecialFunctionHandler::registerHandler(const std::string &name,
+                                             CustomHandler handler,
+                                             bool doesNotReturn,
+                                             bool hasReturnValue,
+                                             bool doNotOverride) {
+  getCustomHandlers().push_back(
+      {name, handler, doesNotReturn, hasReturnValue, doNotOverride});
+}
+
 void SpecialFunctionHandler::prepare(
     std::vector<const char *> &preservedFunctions) {
-  for (auto &hi : handlerInfo) {
-    Function *f = executor.kmodule->module->getFunction(hi.name);
+  auto prepareHandler = [&](const char *name, bool doesNotReturn,
+                            bool doNotOverride) {
+    Function *f = executor.kmodule->module->getFunction(name);
 
     // No need to create if the function doesn't exist, since it cannot
     // be called in that case.
-    if (f && (!hi.doNotOverride || f->isDeclaration())) {
-      preservedFunctions.push_back(hi.name);
+    if (f && (!doNotOverride || f->isDeclaration())) {
+      preservedFunctions.push_back(name);
       // Make sure NoReturn attribute is set, for optimization and
       // coverage counting.
-      if (hi.doesNotReturn)
+      if (doesNotReturn)
         f->addFnAttr(Attribute::NoReturn);
 
       // Change to a declaration since we handle internally (simplifies
@@ -173,38 +209,103 @@ void SpecialFunctionHandler::prepare(
       if (!f->isDeclaration())
         f->deleteBody();
     }
+  };
+
+  // Summarized functions keep their bodies, which are executed whenever a
+  // summary does not apply
+  if (SummarizeLibc) {
+    for (auto &si : summaryInfo) {
+      if (executor.kmodule->module->getFunction(si.name))
+        preservedFunctions.push_back(si.name);
+    }
   }
+
+  for (auto &hi : handlerInfo)
+    prepareHandler(hi.name, hi.doesNotReturn, hi.doNotOverride);
+  for (auto &ci : getCustomHandlers())
+    prepareHandler(ci.name.c_str(), ci.doesNotReturn, ci.doNotOverride);
 }
 
 void SpecialFunctionHandler::bind() {
+  if (SummarizeLibc) {
+    for (auto &si : summaryInfo) {
+      if (Function *f = executor.kmodule->module->getFunction(si.name)) {
+        SpecialFunctionBinding binding;
+        binding.summary = si.summary;
+        handlers[f] = binding;
+      }
+    }
+  }
+
   for (auto &hi : handlerInfo) {
     Function *f = executor.kmodule->module->getFunction(hi.name);
 
-    if (f && (!hi.doNotOverride || f->isDeclaration()))
-      handlers[f] = std::make_pair(hi.handler, hi.hasReturnValue);
+    if (f && (!hi.doNotOverride || f->isDeclaration())) {
+      SpecialFunctionBinding binding;
+      binding.handler = hi.handler;
+      binding.hasReturnValue = hi.hasReturnValue;
+      handlers[f] = binding;
+    }
   }
+
+  for (auto &ci : getCustomHandlers()) {
+    Function *f = executor.kmodule->module->getFunction(ci.name);
+
+    if (f && (!ci.doNotOverride || f->isDeclaration())) {
+      SpecialFunctionBinding binding;
+      binding.customHandler = ci.handler;
+      binding.hasReturnValue = ci.hasReturnValue;
+      handlers[f] = binding;
+    }
+  }
+
+  for (auto &kf : executor.kmodule->functions)
+    bindCallSites(*kf);
 }
 
+void SpecialFunctionHandler::bindCallSites(KFunction &kf) const {
+  // Resolve the callee and its handler once per call site
+  for (unsigned i = 0; i < kf.numInstructions; ++i) {
+    KInstruction *ki = kf.instructions[i];
+    if (!isa<CallInst>(ki->inst) && !isa<InvokeInst>(ki->inst))
+      continue;
+
+    auto *kci = static_cast<KCallInstruction *>(ki);
+    kci->calledFunction = executor.getTargetFunction(
+        cast<CallBase>(ki->inst)->getCalledOperand());
+    handlers_ty::const_iterator it = handlers.find(kci->calledFunction);
+    kci->specialFunction = it != handlers.end() ? &it->second : nullptr;
+  }
+}
+
+const SpecialFunctionBinding *
+SpecialFunctionHandler::getBinding(KInstruction *target, Function *f) const {
+  auto *kci = static_cast<KCallInstruction *>(target);
+  if (f == kci->calledFunction)
+    return kci->specialFunction;
+
+  // Calls through function pointers
+  handlers_ty::const_iterator it = handlers.find(f);
+  return it != handlers.end() ? &it->second : nullptr;
+}
 
 bool SpecialFunctionHandler::handle(ExecutionState &state, 
-                                    Function *f,
+                                    const SpecialFunctionBinding &binding,
                                     KInstruction *target,
                                     std::vector< ref<Expr> > &arguments) {
-  handlers_ty::iterator it = handlers.find(f);
-  if (it != handlers.end()) {    
-    Handler h = it->second.first;
-    bool hasReturnValue = it->second.second;
-     // FIXME: Check this... add test?
-    if (!hasReturnValue && !target->inst->use_empty()) {
-      executor.terminateStateOnExecError(state, 
-                                         "expected return value from void special function");
-    } else {
-      (this->*h)(state, target, arguments);
-    }
-    return true;
+  if (binding.summary)
+    return (this->*binding.summary)(state, target, arguments);
+
+  // FIXME: Check this... add test?
+  if (!binding.hasReturnValue && !target->inst->use_empty()) {
+    executor.terminateStateOnExecError(state, 
+                                       "expected return value from void special function");
+  } else if (binding.handler) {
+    (this->*binding.handler)(state, target, arguments);
   } else {
-    return false;
+    binding.customHandler(*this, state, target, arguments);
   }
+  return true;
 }
 
 /****/
@@ -842,3 +943,233 @@ void SpecialFunctionHandler::handleMarkGlobal(ExecutionState &state,
     mo->isGlobal = true;
   }
 }
+
+/* Summaries */
+
+/// Resolves the concrete pointer \p address to the object containing it and
+/// the offset into that object.
+static bool resolveConcretePointer(ExecutionState &state, ref<Expr> address,
+                                   ObjectPair &op, size_t &offset) {
+  auto *ce = dyn_cast<klee::ConstantExpr>(address);
+  if (!ce || !state.addressSpace.resolveOne(ref<klee::ConstantExpr>(ce), op))
+    return false;
+  offset = ce->getZExtValue() - op.first->address;
+  return true;
+}
+
+/// Resolves the concrete pointer \p address to an object that contains all
+/// \p count bytes starting at it.
+static bool resolveConcreteRange(ExecutionState &state, ref<Expr> address,
+                                 uint64_t count, ObjectPair &op,
+                                 size_t &offset) {
+  return resolveConcretePointer(state, address, op, offset) &&
+         count <= op.second->size - offset;
+}
+
+bool SpecialFunctionHandler::summarizeMemcmp(
+    ExecutionState &state, KInstruction *target,
+    std::vector<ref<Expr>> &arguments) {
+  if (arguments.size() != 3)
+    return false;
+  auto *count = dyn_cast<ConstantExpr>(arguments[2]);
+  ObjectPair a, b;
+  size_t aOffset, bOffset;
+  if (!count ||
+      !resolveConcreteRange(state, arguments[0], count->getZExtValue(), a,
+                            aOffset) ||
+      !resolveConcreteRange(state, arguments[1], count->getZExtValue(), b,
+                            bOffset))
+    return false;
+
+  Expr::Width width = executor.getWidthForLLVMType(target->inst->getType());
+  auto difference = [&](size_t i) {
+    return SubExpr::create(
+        ZExtExpr::create(a.second->read8(aOffset + i), width),
+        ZExtExpr::create(b.second->read8(bOffset + i), width));
+  };
+
+  // The result is decided by the first concretely differing byte, unless a
+  // symbolic byte before it differs
+  std::vector<size_t> symbolicBytes;
+  ref<Expr> result = ConstantExpr::create(0, width);
+  for (size_t i = 0, e = count->getZExtValue(); i != e; ++i) {
+    uint8_t x, y;
+    if (!a.second->readConcrete8(aOffset + i, x) ||
+        !b.second->readConcrete8(bOffset + i, y)) {
+      symbolicBytes.push_back(i);
+    } else if (x != y) {
+      result = difference(i);
+      break;
+    }
+  }
+  for (auto it = symbolicBytes.rbegin(); it != symbolicBytes.rend(); ++it) {
+    result = SelectExpr::create(NeExpr::create(a.second->read8(aOffset + *it),
+                                               b.second->read8(bOffset + *it)),
+                                difference(*it), result);
+  }
+
+  executor.bindLocal(target, state, result);
+  return true;
+}
+
+bool SpecialFunctionHandler::summarizeMemcpy(
+    ExecutionState &state, KInstruction *target,
+    std::vector<ref<Expr>> &arguments) {
+  if (arguments.size() != 3)
+    return false;
+  auto *count = dyn_cast<ConstantExpr>(arguments[2]);
+  if (!count)
+    return false;
+
+  if (!count->isZero()) {
+    ObjectPair dest, src;
+    size_t destOffset, srcOffset;
+    if (!resolveConcreteRange(state, arguments[0], count->getZExtValue(),
+                              dest, destOffset) ||
+        !resolveConcreteRange(state, arguments[1], count->getZExtValue(), src,
+                              srcOffset) ||
+        dest.second->readOnly)
+      return false;
+
+    ObjectState *wos = state.addressSpace.getWriteable(dest.first, dest.second);
+    // The source object state is replaced if it is the one made writeable
+    const ObjectState *ros = src.first == dest.first ? wos : src.second;
+    wos->copyBytes(destOffset, *ros, srcOffset, count->getZExtValue());
+  }
+
+  if (!target->inst->getType()->isVoidTy())
+    executor.bindLocal(target, state, arguments[0]);
+  return true;
+}
+
+bool SpecialFunctionHandler::summarizeStrcmp(
+    ExecutionState &state, KInstruction *target,
+    std::vector<ref<Expr>> &arguments) {
+  if (arguments.size() != 2)
+    return false;
+  ObjectPair a, b;
+  size_t aOffset, bOffset;
+  if (!resolveConcretePointer(state, arguments[0], a, aOffset) ||
+      !resolveConcretePointer(state, arguments[1], b, bOffset))
+    return false;
+
+  // Find the first position at which the comparison certainly stops. Without
+  // one, the implementation reports the out of bounds access.
+  std::vector<size_t> symbolicBytes;
+  size_t end = 0;
+  for (;; ++end) {
+    if (aOffset + end == a.second->size || bOffset + end == b.second->size)
+      return false;
+    uint8_t x, y;
+    if (!a.second->readConcrete8(aOffset + end, x) ||
+        !b.second->readConcrete8(bOffset + end, y)) {
+      symbolicBytes.push_back(end);
+    } else if (x != y || !x) {
+      break;
+    }
+  }
+
+  Expr::Width width = executor.getWidthForLLVMType(target->inst->getType());
+  auto difference = [&](size_t i) {
+    return SubExpr::create(
+        ZExtExpr::create(a.second->read8(aOffset + i), width),
+        ZExtExpr::create(b.second->read8(bOffset + i), width));
+  };
+
+  ref<Expr> result = difference(end);
+  for (auto it = symbolicBytes.rbegin(); it != symbolicBytes.rend(); ++it) {
+    ref<Expr> x = a.second->read8(aOffset + *it);
+    ref<Expr> y = b.second->read8(bOffset + *it);
+    result = SelectExpr::create(
+        OrExpr::create(NeExpr::create(x, y), Expr::createIsZero(x)),
+        difference(*it), result);
+  }
+
+  executor.bindLocal(target, state, result);
+  return true;
+}
+
+bool SpecialFunctionHandler::summarizeStrlen(
+    ExecutionState &state, KInstruction *target,
+    std::vector<ref<Expr>> &arguments) {
+  if (arguments.size() != 1)
+    return false;
+  ObjectPair op;
+  size_t offset;
+  if (!resolveConcretePointer(state, arguments[0], op, offset))
+    return false;
+  const ObjectState *os = op.second;
+
+  // Find the first byte that is certainly the terminator. Without one, the
+  // implementation reports the out of bounds access.
+  std::vector<size_t> symbolicBytes;
+  size_t end = offset;
+  for (uint8_t value;; ++end) {
+    if (end == os->size)
+      return false;
+    if (!os->readConcrete8(end, value))
+      symbolicBytes.push_back(end);
+    else if (!value)
+      break;
+  }
+
+  Expr::Width width = executor.getWidthForLLVMType(target->inst->getType());
+  ref<Expr> result = ConstantExpr::create(end - offset, width);
+  for (auto it = symbolicBytes.rbegin(); it != symbolicBytes.rend(); ++it) {
+    result = SelectExpr::create(Expr::createIsZero(os->read8(*it)),
+                                ConstantExpr::create(*it - offset, width),
+                                result);
+  }
+
+  executor.bindLocal(target, state, result);
+  return true;
+}
+
+/* Loop summaries */
+
+void SpecialFunctionHandler::handleLoopSearch(
+    ExecutionState &state, KInstruction *target,
+    std::vector<ref<Expr>> &arguments) {
+  assert(arguments.size() == 3 &&
+         "invalid number of arguments to klee_loop_search");
+  Expr::Width width = executor.getWidthForLLVMType(target->inst->getType());
+  auto *exitOnMatch = dyn_cast<ConstantExpr>(arguments[2]);
+  assert(exitOnMatch && "klee_loop_search requires a constant exit condition");
+
+  // Without an object containing a certain stop, the loop is executed
+  ref<Expr> unsummarized = ConstantExpr::alloc(APInt::getAllOnes(width));
+  ObjectPair op;
+  size_t offset;
+  if (!resolveConcretePointer(state, arguments[0], op, offset)) {
+    executor.bindLocal(target, state, unsummarized);
+    return;
+  }
+  const ObjectState *os = op.second;
+  ref<Expr> needle = arguments[1];
+  auto stopsAt = [&](size_t i) {
+    ref<Expr> match = EqExpr::create(os->read8(i), needle);
+    return exitOnMatch->isTrue() ? match : Expr::createIsZero(match);
+  };
+
+  std::vector<size_t> undecided;
+  size_t end = offset;
+  for (;; ++end) {
+    if (end >= os->size) {
+      executor.bindLocal(target, state, unsummarized);
+      return;
+    }
+    ref<Expr> stop = stopsAt(end);
+    if (!isa<ConstantExpr>(stop))
+      undecided.push_back(end);
+    else if (stop->isTrue())
+      break;
+  }
+
+  ref<Expr> result = ConstantExpr::create(end - offset, width);
+  for (auto it = undecided.rbegin(); it != undecided.rend(); ++it) {
+    result = SelectExpr::create(stopsAt(*it),
+                                ConstantExpr::create(*it - offset, width),
+                                result);
+  }
+  executor.bindLocal(target, state, result);
+}
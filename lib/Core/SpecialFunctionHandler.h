@@ -24,17 +24,47 @@ namespace klee {
   class Executor;
   class Expr;
   class ExecutionState;
+  struct KFunction;
   struct KInstruction;
   template<typename T> class ref;
   
-  class SpecialFunctionHandler {
-  public:
+  class SpecialFunctionHandler;
+
+  /// How calls to a function are handled: by exactly one of a built-in
+  /// handler, a registered handler, or a summary
+  struct SpecialFunctionBinding {
     typedef void (SpecialFunctionHandler::*Handler)(ExecutionState &state,
                                                     KInstruction *target, 
                                                     std::vector<ref<Expr> > 
                                                       &arguments);
+
+    /// A built-in model of a library function, which returns false if it
+    /// does not apply to the arguments and the function must be executed
+    typedef bool (SpecialFunctionHandler::*Summary)(ExecutionState &state,
+                                                    KInstruction *target,
+                                                    std::vector<ref<Expr> >
+                                                      &arguments);
+
+    /// A handler registered with SpecialFunctionHandler::registerHandler
+    typedef void (*CustomHandler)(SpecialFunctionHandler &handler,
+                                  ExecutionState &state,
+                                  KInstruction *target,
+                                  std::vector<ref<Expr> > &arguments);
+
+    Handler handler = nullptr;
+    CustomHandler customHandler = nullptr;
+    Summary summary = nullptr;
+    bool hasReturnValue = false;
+  };
+
+  class SpecialFunctionHandler {
+  public:
+    typedef SpecialFunctionBinding::Handler Handler;
+    typedef SpecialFunctionBinding::Summary Summary;
+    typedef SpecialFunctionBinding::CustomHandler CustomHandler;
+
     typedef std::map<const llvm::Function*,
-                     std::pair<Handler,bool> > handlers_ty;
+                     SpecialFunctionBinding> handlers_ty;
 
     handlers_ty handlers;
     class Executor &executor;
@@ -47,6 +77,22 @@ namespace klee {
       bool doNotOverride; /// Intrinsic should not be used if already defined
     };
 
+    struct SummaryInfo {
+      const char *name;
+      SpecialFunctionHandler::Summary summary;
+    };
+
+    struct CustomHandlerInfo {
+      std::string name;
+      SpecialFunctionHandler::CustomHandler handler;
+      bool doesNotReturn;
+      bool hasReturnValue;
+      bool doNotOverride;
+    };
+
+  private:
+    static std::vector<CustomHandlerInfo> &getCustomHandlers();
+
   public:
     SpecialFunctionHandler(Executor &_executor);
 
@@ -59,12 +105,32 @@ namespace klee {
     /// be preserved during optimization
     void prepare(std::vector<const char *> &preservedFunctions);
 
+    /// Registers \p handler for calls to the function \p name, taking
+    /// precedence over a built-in handler of the same name. Handlers must be
+    /// registered before any module is prepared.
+    static void registerHandler(const std::string &name,
+                                CustomHandler handler,
+                                bool doesNotReturn,
+                                bool hasReturnValue,
+                                bool doNotOverride = false);
+
     /// Initialize the internal handler map after the module has been
-    /// prepared for execution.
+    /// prepared for execution, and bind each call site of the module to its
+    /// callee and handler.
     void bind();
 
+    /// Bind the call sites of \p kf, which was added after bind().
+    void bindCallSites(KFunction &kf) const;
+
+    /// Returns the handler of calls to \p f from \p target, or null if
+    /// there is none.
+    const SpecialFunctionBinding *getBinding(KInstruction *target,
+                                             llvm::Function *f) const;
+
+    /// Executes a call with \p binding. Returns false if the call still has
+    /// to be executed, which happens if a summary does not apply.
     bool handle(ExecutionState &state, 
-                llvm::Function *f,
+                const SpecialFunctionBinding &binding,
                 KInstruction *target,
                 std::vector< ref<Expr> > &arguments);
 
@@ -97,6 +163,7 @@ namespace klee {
     HANDLER(handleGetObjSize);
     HANDLER(handleGetValue);
     HANDLER(handleIsSymbolic);
+    HANDLER(handleLoopSearch);
     HANDLER(handleMakeSymbolic);
     HANDLER(handleMalloc);
     HANDLER(handleMemalign);
@@ -120,6 +187,17 @@ namespace klee {
     HANDLER(handleWarning);
     HANDLER(handleWarningOnce);
 #undef HANDLER
+
+    /* Summaries */
+
+#define SUMMARY(name) bool name(ExecutionState &state, \
+                                KInstruction *target, \
+                                std::vector< ref<Expr> > &arguments)
+    SUMMARY(summarizeMemcmp);
+    SUMMARY(summarizeMemcpy);
+    SUMMARY(summarizeStrcmp);
+    SUMMARY(summarizeStrlen);
+#undef SUMMARY
   };
 } // End klee namespace
 
@@ -20,12 +20,14 @@
 #include "klee/Statistics/Statistics.h"
 #include "klee/Support/ErrorHandling.h"
 #include "klee/Support/ModuleUtil.h"
+#include "klee/Support/StatsLog.h"
 #include "klee/System/MemoryUsage.h"
 
 #include "CallPathManager.h"
 #include "CoreStats.h"
 #include "Executor.h"
 #include "MemoryManager.h"
+#include "TimingSolver.h"
 #include "UserSearcher.h"
 
 #include "klee/Support/CompilerWarning.h"
@@ -36,6 +38,7 @@ DISABLE_WARNING_DEPRECATED_DECLARATIONS
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Module.h"
@@ -75,6 +78,21 @@ cl::opt<bool> OutputIStats("output-istats", cl::init(true),
                                     "callgrind format (default=true)"),
                            cl::cat(StatsCat));
 
+enum class StatsFormat { SQLite, Log };
+
+cl::opt<StatsFormat> OutputStatsFormat(
+    "stats-format",
+    cl::desc("Format of the running stats and instruction level statistics "
+             "(default=sqlite)"),
+    cl::values(clEnumValN(StatsFormat::SQLite, "sqlite",
+                          "SQLite database (run.stats) and callgrind file "
+                          "(run.istats)"),
+               clEnumValN(StatsFormat::Log, "log",
+                          "Append-only log of the changed values "
+                          "(run.statslog), which klee-stats-backend "
+                          "--export converts into the other format")),
+    cl::init(StatsFormat::SQLite), cl::cat(StatsCat));
+
 cl::opt<std::string> StatsWriteInterval(
     "stats-write-interval", cl::init("1s"),
     cl::desc("Approximate time between stats writes (default=1s)"),
@@ -116,6 +134,21 @@ cl::opt<bool> UseCallPaths("use-call-paths", cl::init(true),
                                     "level statistics (default=true)"),
                            cl::cat(StatsCat));
 
+cl::opt<bool> ProfileQueries(
+    "profile-queries", cl::init(false),
+    cl::desc("Attribute solver queries and their cost to the instructions "
+             "issuing them and write the result to the query_profile table "
+             "of run.stats (default=false)"),
+    cl::cat(StatsCat));
+
+cl::opt<bool> KDAllocSharingStats(
+    "kdalloc-sharing-stats", cl::init(false),
+    cl::desc("Record the private and shared bytes of the deterministic "
+             "allocators in run.stats. Walks the allocators of all states on "
+             "every stats line (default=false)"),
+    cl::cat(StatsCat));
+
+extern cl::opt<bool> MinimizeTests;
 } // namespace klee
 
 ///
@@ -152,6 +185,52 @@ static bool instructionIsCoverable(Instruction *i) {
   return true;
 }
 
+/// Columns of the stats table, in the order of the values returned by
+/// StatsTracker::getStatsRecord()
+#undef BTYPE
+#define BTYPE(Name, I) "Branches" #Name,
+#undef TCLASS
+#define TCLASS(Name, I) "Termination" #Name,
+static const char *const statsColumns[] = {
+    "Instructions",
+    "FullBranches",
+    "PartialBranches",
+    "NumBranches",
+    "UserTime",
+    "NumStates",
+    "MallocUsage",
+    "Queries",
+    "SolverQueries",
+    "NumQueryConstructs",
+    "WallTime",
+    "CoveredInstructions",
+    "UncoveredInstructions",
+    "QueryTime",
+    "SolverTime",
+    "CexCacheTime",
+    "ForkTime",
+    "ResolveTime",
+    "QueryCacheMisses",
+    "QueryCacheHits",
+    "QueryCexCacheMisses",
+    "QueryCexCacheHits",
+    "QueryModelHits",
+    "InhibitedForks",
+    "ExternalCalls",
+    "Allocations",
+    "States",
+    "KDAllocPrivate",
+    "KDAllocShared",
+    "KDAllocCompacted",
+    BRANCH_TYPES
+    TERMINATION_CLASSES
+    "ArrayHashTime",
+};
+
+static bool isRealStatsColumn(llvm::StringRef name) {
+  return name == "UserTime" || name == "WallTime";
+}
+
 std::string sqlite3ErrToStringAndFree(const std::string& prefix , char* sqlite3ErrMsg) {
   std::ostringstream sstream;
   sstream << prefix << sqlite3ErrMsg;
@@ -202,29 +281,47 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
   if (useStatistics() || userSearcherRequiresMD2U())
     theStatisticManager->useIndexedStats(km->infos->getMaxID());
 
-  for (auto &kfp : km->functions) {
-    KFunction *kf = kfp.get();
-    kf->trackCoverage = 1;
-
-    for (unsigned i=0; i<kf->numInstructions; ++i) {
-      KInstruction *ki = kf->instructions[i];
-
+  // Functions may only get their KFunction when they are first called, so
+  // count the coverable instructions of the module instead
+  for (auto &function : *km->module) {
+    for (auto &inst : instructions(function)) {
       if (OutputIStats) {
-        unsigned id = ki->info->id;
+        unsigned id = km->infos->getInfo(inst).id;
         theStatisticManager->setIndex(id);
-        if (kf->trackCoverage && instructionIsCoverable(ki->inst))
+        if (instructionIsCoverable(&inst))
           ++stats::uncoveredInstructions;
       }
-      
-      if (kf->trackCoverage) {
-        if (BranchInst *bi = dyn_cast<BranchInst>(ki->inst))
-          if (!bi->isUnconditional())
-            numBranches++;
-      }
+
+      if (BranchInst *bi = dyn_cast<BranchInst>(&inst))
+        if (!bi->isUnconditional())
+          numBranches++;
     }
   }
 
-  if (OutputStats) {
+  if (OutputStatsFormat == StatsFormat::Log && useStatistics()) {
+    if (ProfileQueries)
+      klee_error("--profile-queries requires --stats-format=sqlite.");
+
+    auto file = executor.interpreterHandler->openOutputFile("run.statslog");
+    if (!file)
+      klee_error("Unable to open stats log (run.statslog).");
+    statsLog = std::make_unique<StatsLogWriter>(std::move(file));
+    statsLog->writeInfo("pid", std::to_string(getpid()));
+    statsLog->writeInfo("cmd", km->module->getModuleIdentifier());
+    statsLog->writeInfo("ob",
+                        llvm::sys::path::filename(objectFilename).str());
+
+    if (OutputStats) {
+      for (const char *column : statsColumns)
+        statsLog->writeColumn(column, isRealStatsColumn(column));
+      writeStatsLine();
+
+      if (statsWriteInterval)
+        executor.timers.add(std::make_unique<Timer>(statsWriteInterval, [&]{
+          writeStatsLine();
+        }));
+    }
+  } else if (OutputStats) {
     sqlite3_config(SQLITE_CONFIG_SINGLETHREAD);
 
     // open database
@@ -268,6 +365,11 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
 
     writeStatsLine();
 
+    if (ProfileQueries) {
+      queryProfiler = std::make_unique<QueryProfiler>();
+      executor.solver->setProfiler(queryProfiler.get());
+    }
+
     if (statsWriteInterval)
       executor.timers.add(std::make_unique<Timer>(statsWriteInterval, [&]{
         writeStatsLine();
@@ -283,8 +385,9 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
   }
 
   if (OutputIStats) {
-    istatsFile = executor.interpreterHandler->openOutputFile("run.istats");
-    if (istatsFile) {
+    if (!statsLog)
+      istatsFile = executor.interpreterHandler->openOutputFile("run.istats");
+    if (istatsFile || statsLog) {
       if (iStatsWriteInterval)
         executor.timers.add(std::make_unique<Timer>(iStatsWriteInterval, [&]{
           writeIStats();
@@ -296,6 +399,9 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
 }
 
 StatsTracker::~StatsTracker() {  
+  if (queryProfiler)
+    executor.solver->setProfiler(nullptr);
+
   if (statsFile) {
     auto rc = sqlite3_step(transactionEndStmt);
     if (rc != SQLITE_DONE) {
@@ -310,18 +416,24 @@ StatsTracker::~StatsTracker() {
 }
 
 void StatsTracker::done() {
-  if (statsFile)
+  if (statsFile || (statsLog && OutputStats))
     writeStatsLine();
 
+  if (queryProfiler)
+    writeQueryProfile();
+
   if (OutputIStats) {
     if (updateMinDistToUncovered)
       computeReachableUncovered();
-    if (istatsFile)
+    if (istatsFile || statsLog)
       writeIStats();
   }
 }
 
 void StatsTracker::stepInstruction(ExecutionState &es) {
+  if (queryProfiler)
+    queryProfiler->setOrigin(es.pc);
+
   if (OutputIStats) {
     if (TrackInstructionTime) {
       static time::Point lastNowTime(time::getWallTime());
@@ -365,13 +477,19 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
 	stats::uncoveredInstructions += (uint64_t)-1;
       }
     }
+
+    if (MinimizeTests && sf.kf->trackCoverage &&
+        inst == &inst->getParent()->front() && !es.coveredBlocks.count(ii.id))
+      es.coveredBlocks = es.coveredBlocks.insert(ii.id);
   }
 
-  if (statsFile && StatsWriteAfterInstructions &&
+  if ((statsFile || (statsLog && OutputStats)) &&
+      StatsWriteAfterInstructions &&
       stats::instructions % StatsWriteAfterInstructions.getValue() == 0)
     writeStatsLine();
 
-  if (istatsFile && IStatsWriteAfterInstructions &&
+  if ((istatsFile || (statsLog && OutputIStats)) &&
+      IStatsWriteAfterInstructions &&
       stats::instructions % IStatsWriteAfterInstructions.getValue() == 0)
     writeIStats();
 }
@@ -435,42 +553,17 @@ void StatsTracker::markBranchVisited(ExecutionState *visitedTrue,
 }
 
 void StatsTracker::writeStatsHeader() {
-  #undef BTYPE
-  #define BTYPE(Name,I) << "Branches" #Name " INTEGER,"
-  #undef TCLASS
-  #define TCLASS(Name,I) << "Termination" #Name " INTEGER,"
-  std::ostringstream create, insert;
-  create << "CREATE TABLE stats ("
-         << "Instructions INTEGER,"
-         << "FullBranches INTEGER,"
-         << "PartialBranches INTEGER,"
-         << "NumBranches INTEGER,"
-         << "UserTime REAL,"
-         << "NumStates INTEGER,"
-         << "MallocUsage INTEGER,"
-         << "Queries INTEGER,"
-         << "SolverQueries INTEGER,"
-         << "NumQueryConstructs INTEGER,"
-         << "WallTime REAL,"
-         << "CoveredInstructions INTEGER,"
-         << "UncoveredInstructions INTEGER,"
-         << "QueryTime INTEGER,"
-         << "SolverTime INTEGER,"
-         << "CexCacheTime INTEGER,"
-         << "ForkTime INTEGER,"
-         << "ResolveTime INTEGER,"
-         << "QueryCacheMisses INTEGER,"
-         << "QueryCacheHits INTEGER,"
-         << "QueryCexCacheMisses INTEGER,"
-         << "QueryCexCacheHits INTEGER,"
-         << "InhibitedForks INTEGER,"
-         << "ExternalCalls INTEGER,"
-         << "Allocations INTEGER,"
-         << "States INTEGER,"
-         BRANCH_TYPES
-         TERMINATION_CLASSES
-         << "ArrayHashTime INTEGER"
-         << ')';
+  std::ostringstream create, insert, values;
+  create << "CREATE TABLE stats (";
+  insert << "INSERT OR FAIL INTO stats (";
+  for (const char *column : statsColumns) {
+    const char *separator = column == statsColumns[0] ? "" : ",";
+    create << separator << column
+           << (isRealStatsColumn(column) ? " REAL" : " INTEGER");
+    insert << separator << column;
+    values << separator << '?';
+  }
+  create << ')';
   char *zErrMsg = nullptr;
   if(sqlite3_exec(statsFile, create.str().c_str(), nullptr, nullptr, &zErrMsg)) {
     klee_error("%s", sqlite3ErrToStringAndFree("ERROR creating table: ", zErrMsg).c_str());
@@ -482,76 +575,7 @@ void StatsTracker::writeStatsHeader() {
    * happen, but if it does this statement will fail with SQLITE_CONSTRAINT error. If this happens you should either
    * remove the constraints or consider using `IGNORE` mode.
    */
-  #undef BTYPE
-  #define BTYPE(Name, I) << "Branches" #Name ","
-  #undef TCLASS
-  #define TCLASS(Name, I) << "Termination" #Name ","
-  insert << "INSERT OR FAIL INTO stats ("
-         << "Instructions,"
-         << "FullBranches,"
-         << "PartialBranches,"
-         << "NumBranches,"
-         << "UserTime,"
-         << "NumStates,"
-         << "MallocUsage,"
-         << "Queries,"
-         << "SolverQueries,"
-         << "NumQueryConstructs,"
-         << "WallTime,"
-         << "CoveredInstructions,"
-         << "UncoveredInstructions,"
-         << "QueryTime,"
-         << "SolverTime,"
-         << "CexCacheTime,"
-         << "ForkTime,"
-         << "ResolveTime,"
-         << "QueryCacheMisses,"
-         << "QueryCacheHits,"
-         << "QueryCexCacheMisses,"
-         << "QueryCexCacheHits,"
-         << "InhibitedForks,"
-         << "ExternalCalls,"
-         << "Allocations,"
-         << "States,"
-         BRANCH_TYPES
-         TERMINATION_CLASSES
-         << "ArrayHashTime"
-         << ')';
-  #undef BTYPE
-  #define BTYPE(Name, I) << "?,"
-  #undef TCLASS
-  #define TCLASS(Name, I) << "?,"
-  insert << " VALUES ("
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         << "?,"
-         BRANCH_TYPES
-         TERMINATION_CLASSES
-         << "? "
-         << ')';
+  insert << ") VALUES (" << values.str() << ')';
 
   if(sqlite3_prepare_v2(statsFile, insert.str().c_str(), -1, &insertStmt, nullptr) != SQLITE_OK) {
     klee_error("Cannot create prepared statement: %s", sqlite3_errmsg(statsFile));
@@ -562,45 +586,134 @@ time::Span StatsTracker::elapsed() {
   return time::getWallTime() - startWallTime;
 }
 
-void StatsTracker::writeStatsLine() {
+void StatsTracker::writeQueryProfile() {
+  char *zErrMsg;
+  if (sqlite3_exec(statsFile,
+                   "CREATE TABLE query_profile ("
+                   "Function TEXT,"
+                   "File TEXT,"
+                   "Line INTEGER,"
+                   "AssemblyLine INTEGER,"
+                   "Kind TEXT,"
+                   "Stage TEXT,"
+                   "Queries INTEGER,"
+                   "Time INTEGER,"
+                   "ExprNodes INTEGER,"
+                   "Arrays INTEGER,"
+                   "Constraints INTEGER"
+                   ")",
+                   nullptr, nullptr, &zErrMsg)) {
+    klee_warning("%s", sqlite3ErrToStringAndFree(
+                           "Can't create query profile table: ", zErrMsg)
+                           .c_str());
+    return;
+  }
+
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2(statsFile,
+                         "INSERT INTO query_profile VALUES "
+                         "(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
+                         -1, &stmt, nullptr) != SQLITE_OK) {
+    klee_warning("Cannot create prepared statement: %s",
+                 sqlite3_errmsg(statsFile));
+    return;
+  }
+
+  for (const auto &it : queryProfiler->getEntries()) {
+    const KInstruction *ki = std::get<0>(it.first);
+    const QueryProfiler::Entry &entry = it.second;
+    int arg = 1;
+    if (ki) {
+      sqlite3_bind_text(stmt, arg++,
+                        ki->inst->getFunction()->getName().str().c_str(), -1,
+                        SQLITE_TRANSIENT);
+      sqlite3_bind_text(stmt, arg++, ki->info->file.c_str(), -1,
+                        SQLITE_TRANSIENT);
+      sqlite3_bind_int64(stmt, arg++, ki->info->line);
+      sqlite3_bind_int64(stmt, arg++, ki->info->assemblyLine);
+    } else {
+      // Queries issued outside of instruction execution, e.g. for tests
+      for (int i = 0; i < 4; ++i)
+        sqlite3_bind_null(stmt, arg++);
+    }
+    sqlite3_bind_text(stmt, arg++,
+                      QueryProfiler::getKindName(std::get<1>(it.first)), -1,
+                      SQLITE_STATIC);
+    sqlite3_bind_text(stmt, arg++,
+                      QueryProfiler::getStageName(std::get<2>(it.first)), -1,
+                      SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, arg++, entry.queries);
+    sqlite3_bind_int64(stmt, arg++, entry.time);
+    sqlite3_bind_int64(stmt, arg++, entry.exprNodes);
+    sqlite3_bind_int64(stmt, arg++, entry.arrays);
+    sqlite3_bind_int64(stmt, arg++, entry.constraints);
+
+    if (sqlite3_step(stmt) != SQLITE_DONE)
+      klee_warning("Can't write query profile: %s", sqlite3_errmsg(statsFile));
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+}
+
+std::vector<std::int64_t> StatsTracker::getStatsRecord() {
   #undef BTYPE
-  #define BTYPE(Name,I) sqlite3_bind_int64(insertStmt, arg++, stats::branches ## Name);
+  #define BTYPE(Name,I) record.push_back(stats::branches ## Name);
   #undef TCLASS
-  #define TCLASS(Name,I) sqlite3_bind_int64(insertStmt, arg++, stats::termination ## Name);
-  int arg = 1;
-  sqlite3_bind_int64(insertStmt, arg++, stats::instructions);
-  sqlite3_bind_int64(insertStmt, arg++, fullBranches);
-  sqlite3_bind_int64(insertStmt, arg++, partialBranches);
-  sqlite3_bind_int64(insertStmt, arg++, numBranches);
-  sqlite3_bind_int64(insertStmt, arg++, time::getUserTime().toMicroseconds());
-  sqlite3_bind_int64(insertStmt, arg++, executor.states.size());
-  sqlite3_bind_int64(insertStmt, arg++, util::GetTotalMallocUsage() + executor.memory->getUsedDeterministicSize());
-  sqlite3_bind_int64(insertStmt, arg++, stats::queries);
-  sqlite3_bind_int64(insertStmt, arg++, stats::solverQueries);
-  sqlite3_bind_int64(insertStmt, arg++, stats::queryConstructs);
-  sqlite3_bind_int64(insertStmt, arg++, elapsed().toMicroseconds());
-  sqlite3_bind_int64(insertStmt, arg++, stats::coveredInstructions);
-  sqlite3_bind_int64(insertStmt, arg++, stats::uncoveredInstructions);
-  sqlite3_bind_int64(insertStmt, arg++, stats::queryTime);
-  sqlite3_bind_int64(insertStmt, arg++, stats::solverTime);
-  sqlite3_bind_int64(insertStmt, arg++, stats::cexCacheTime);
-  sqlite3_bind_int64(insertStmt, arg++, stats::forkTime);
-  sqlite3_bind_int64(insertStmt, arg++, stats::resolveTime);
-  sqlite3_bind_int64(insertStmt, arg++, stats::queryCacheMisses);
-  sqlite3_bind_int64(insertStmt, arg++, stats::queryCacheHits);
-  sqlite3_bind_int64(insertStmt, arg++, stats::queryCexCacheMisses);
-  sqlite3_bind_int64(insertStmt, arg++, stats::queryCexCacheHits);
-  sqlite3_bind_int64(insertStmt, arg++, stats::inhibitedForks);
-  sqlite3_bind_int64(insertStmt, arg++, stats::externalCalls);
-  sqlite3_bind_int64(insertStmt, arg++, stats::allocations);
-  sqlite3_bind_int64(insertStmt, arg++, ExecutionState::getLastID());
+  #define TCLASS(Name,I) record.push_back(stats::termination ## Name);
+  std::vector<std::int64_t> record;
+  record.push_back(stats::instructions);
+  record.push_back(fullBranches);
+  record.push_back(partialBranches);
+  record.push_back(numBranches);
+  record.push_back(time::getUserTime().toMicroseconds());
+  record.push_back(executor.states.size());
+  record.push_back(util::GetTotalMallocUsage() + executor.memory->getUsedDeterministicSize());
+  record.push_back(stats::queries);
+  record.push_back(stats::solverQueries);
+  record.push_back(stats::queryConstructs);
+  record.push_back(elapsed().toMicroseconds());
+  record.push_back(stats::coveredInstructions);
+  record.push_back(stats::uncoveredInstructions);
+  record.push_back(stats::queryTime);
+  record.push_back(stats::solverTime);
+  record.push_back(stats::cexCacheTime);
+  record.push_back(stats::forkTime);
+  record.push_back(stats::resolveTime);
+  record.push_back(stats::queryCacheMisses);
+  record.push_back(stats::queryCacheHits);
+  record.push_back(stats::queryCexCacheMisses);
+  record.push_back(stats::queryCexCacheHits);
+  record.push_back(stats::queryModelHits);
+  record.push_back(stats::inhibitedForks);
+  record.push_back(stats::externalCalls);
+  record.push_back(stats::allocations);
+  record.push_back(ExecutionState::getLastID());
+  const auto allocatorSharing =
+      KDAllocSharingStats ? MemoryManager::getAllocatorSharing(executor.states)
+                          : MemoryManager::AllocatorSharing{};
+  record.push_back(allocatorSharing.privateBytes);
+  record.push_back(allocatorSharing.sharedBytes);
+  record.push_back(stats::kdallocCompactedBytes);
   BRANCH_TYPES
   TERMINATION_CLASSES
 #ifdef KLEE_ARRAY_DEBUG
-  sqlite3_bind_int64(insertStmt, arg++, stats::arrayHashTime);
+  record.push_back(stats::arrayHashTime);
 #else
-  sqlite3_bind_int64(insertStmt, arg++, -1LL);
+  record.push_back(-1LL);
 #endif
+  return record;
+}
+
+void StatsTracker::writeStatsLine() {
+  const std::vector<std::int64_t> record = getStatsRecord();
+  if (statsLog) {
+    statsLog->writeRow(record);
+    return;
+  }
+
+  int arg = 1;
+  for (std::int64_t value : record)
+    sqlite3_bind_int64(insertStmt, arg++, value);
   int errCode = sqlite3_step(insertStmt);
   if(errCode != SQLITE_DONE) klee_error("Error writing stats data: %s", sqlite3_errmsg(statsFile));
   sqlite3_reset(insertStmt);
@@ -629,7 +742,81 @@ void StatsTracker::updateStateStatistics(uint64_t addend) {
   }
 }
 
+llvm::SmallBitVector StatsTracker::getIStatsMask() {
+  StatisticManager &sm = *theStatisticManager;
+  llvm::SmallBitVector istatsMask(sm.getNumStatistics());
+
+  istatsMask.set(sm.getStatisticID("Queries"));
+  istatsMask.set(sm.getStatisticID("QueriesValid"));
+  istatsMask.set(sm.getStatisticID("QueriesInvalid"));
+  istatsMask.set(sm.getStatisticID("QueryTime"));
+  istatsMask.set(sm.getStatisticID("ResolveTime"));
+  istatsMask.set(sm.getStatisticID("Instructions"));
+  istatsMask.set(sm.getStatisticID("InstructionTimes"));
+  istatsMask.set(sm.getStatisticID("InstructionRealTimes"));
+  istatsMask.set(sm.getStatisticID("Forks"));
+  istatsMask.set(sm.getStatisticID("CoveredInstructions"));
+  istatsMask.set(sm.getStatisticID("UncoveredInstructions"));
+  istatsMask.set(sm.getStatisticID("States"));
+  istatsMask.set(sm.getStatisticID("MinDistToUncovered"));
+  return istatsMask;
+}
+
+void StatsTracker::writeIStatsLog() {
+  const auto m = executor.kmodule->module.get();
+  const InstructionInfoTable &infos = *executor.kmodule->infos;
+  StatisticManager &sm = *theStatisticManager;
+  unsigned nStats = sm.getNumStatistics();
+  llvm::SmallBitVector istatsMask = getIStatsMask();
+
+  // The events and instructions never change, so they are only written once
+  if (!istatsLogStarted) {
+    istatsLogStarted = true;
+    for (unsigned i = 0; i < nStats; i++) {
+      if (istatsMask.test(i)) {
+        Statistic &s = sm.getStatistic(i);
+        statsLog->writeEvent(s.getShortName(), s.getName());
+      }
+    }
+
+    for (Function &fn : *m) {
+      if (fn.isDeclaration())
+        continue;
+      const FunctionInfo &fi = infos.getFunctionInfo(fn);
+      unsigned function = statsLog->writeFunction(fn.getName().str(),
+                                                  statsLog->getFile(fi.file));
+      for (Instruction &instr : instructions(fn)) {
+        const InstructionInfo &ii = infos.getInfo(instr);
+        statsLog->writeInstruction(ii.id, function, statsLog->getFile(ii.file),
+                                   ii.line, ii.assemblyLine);
+      }
+    }
+  }
+
+  // set state counts, decremented after we process so that we don't
+  // have to zero all records each time.
+  if (istatsMask.test(stats::states.getID()))
+    updateStateStatistics(1);
+
+  std::vector<std::uint64_t> values;
+  values.reserve(infos.getMaxID() * istatsMask.count());
+  for (unsigned id = 0; id < infos.getMaxID(); ++id)
+    for (unsigned i = 0; i < nStats; i++)
+      if (istatsMask.test(i))
+        values.push_back(sm.getIndexedValue(sm.getStatistic(i), id));
+
+  if (istatsMask.test(stats::states.getID()))
+    updateStateStatistics((uint64_t)-1);
+
+  statsLog->writeInstructionStats(elapsed().toMicroseconds(), values);
+}
+
 void StatsTracker::writeIStats() {
+  if (statsLog) {
+    writeIStatsLog();
+    return;
+  }
+
   const auto m = executor.kmodule->module.get();
   llvm::raw_fd_ostream &of = *istatsFile;
   
@@ -646,21 +833,7 @@ void StatsTracker::writeIStats() {
 
   StatisticManager &sm = *theStatisticManager;
   unsigned nStats = sm.getNumStatistics();
-  llvm::SmallBitVector istatsMask(nStats);
-
-  istatsMask.set(sm.getStatisticID("Queries"));
-  istatsMask.set(sm.getStatisticID("QueriesValid"));
-  istatsMask.set(sm.getStatisticID("QueriesInvalid"));
-  istatsMask.set(sm.getStatisticID("QueryTime"));
-  istatsMask.set(sm.getStatisticID("ResolveTime"));
-  istatsMask.set(sm.getStatisticID("Instructions"));
-  istatsMask.set(sm.getStatisticID("InstructionTimes"));
-  istatsMask.set(sm.getStatisticID("InstructionRealTimes"));
-  istatsMask.set(sm.getStatisticID("Forks"));
-  istatsMask.set(sm.getStatisticID("CoveredInstructions"));
-  istatsMask.set(sm.getStatisticID("UncoveredInstructions"));
-  istatsMask.set(sm.getStatisticID("States"));
-  istatsMask.set(sm.getStatisticID("MinDistToUncovered"));
+  llvm::SmallBitVector istatsMask = getIStatsMask();
 
   of << "positions: instr line\n";
 
@@ -11,14 +11,17 @@
 #define KLEE_STATSTRACKER_H
 
 #include "CallPathManager.h"
+#include "QueryProfiler.h"
 #include "klee/System/Time.h"
 
 #include <memory>
 #include <set>
 #include <sqlite3.h>
+#include <vector>
 
 namespace llvm {
   class BranchInst;
+  class SmallBitVector;
   class Function;
   class Instruction;
   class raw_fd_ostream;
@@ -31,6 +34,7 @@ namespace klee {
   class InterpreterHandler;
   struct KInstruction;
   struct StackFrame;
+  class StatsLogWriter;
 
   class StatsTracker {
     friend class WriteStatsTimer;
@@ -44,6 +48,9 @@ namespace klee {
     ::sqlite3_stmt *transactionBeginStmt = nullptr;
     ::sqlite3_stmt *transactionEndStmt = nullptr;
     ::sqlite3_stmt *insertStmt = nullptr;
+    /// Replaces statsFile and istatsFile with --stats-format=log
+    std::unique_ptr<StatsLogWriter> statsLog;
+    bool istatsLogStarted = false;
     std::uint32_t statsCommitEvery;
     std::uint32_t statsWriteCount = 0;
     time::Point startWallTime;
@@ -53,6 +60,8 @@ namespace klee {
 
     CallPathManager callPathManager;
 
+    std::unique_ptr<QueryProfiler> queryProfiler;
+
     bool updateMinDistToUncovered;
 
   public:
@@ -62,7 +71,11 @@ namespace klee {
   private:
     void updateStateStatistics(uint64_t addend);
     void writeStatsHeader();
+    std::vector<std::int64_t> getStatsRecord();
     void writeStatsLine();
+    void writeQueryProfile();
+    llvm::SmallBitVector getIStatsMask();
+    void writeIStatsLog();
     void writeIStats();
 
   public:
@@ -12,34 +12,123 @@
 #include "ExecutionState.h"
 
 #include "klee/Config/Version.h"
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/ExprUtil.h"
 #include "klee/Statistics/Statistics.h"
 #include "klee/Statistics/TimerStatIncrementer.h"
 #include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
 #include "klee/Solver/SolverStats.h"
+#include "klee/Support/OptionCategories.h"
 
 #include "CoreStats.h"
 
+#include "llvm/Support/CommandLine.h"
+
 using namespace klee;
 using namespace llvm;
 
+namespace {
+cl::opt<bool> ReuseStateModels(
+    "reuse-state-models", cl::init(false),
+    cl::desc("Try the most recent satisfying assignment of a state before "
+             "querying the solver chain (default=false)"),
+    cl::cat(SolvingCat));
+} // namespace
+
 /***/
 
+ref<ConstantExpr>
+TimingSolver::evaluateModel(const ConstraintSet &constraints,
+                            const ref<Expr> &expr,
+                            const SolverQueryMetaData &metaData) const {
+  if (!ReuseStateModels || !metaData.model ||
+      metaData.modelConstraints != &constraints)
+    return nullptr;
+  return dyn_cast<ConstantExpr>(metaData.model->evaluate(expr));
+}
+
+bool TimingSolver::canUpdateModel(const ConstraintSet &constraints,
+                                  const SolverQueryMetaData &metaData) const {
+  return ReuseStateModels && !metaData.model &&
+         metaData.modelConstraints == &constraints;
+}
+
+bool TimingSolver::mustBeTrueUpdatingModel(const ConstraintSet &constraints,
+                                           const ref<Expr> &expr, bool &result,
+                                           SolverQueryMetaData &metaData) {
+  if (!canUpdateModel(constraints, metaData) || isa<ConstantExpr>(expr))
+    return solver->mustBeTrue(Query(constraints, expr), result);
+
+  // Asking for a counterexample answers the truth query as well, so the
+  // model costs no additional query
+  std::vector<ref<Expr>> exprs(constraints.begin(), constraints.end());
+  exprs.push_back(expr);
+  std::vector<const Array *> objects;
+  findSymbolicObjects(exprs.begin(), exprs.end(), objects);
+
+  std::vector<std::vector<unsigned char>> values;
+  bool hasSolution;
+  if (!solver->impl->computeInitialValues(Query(constraints, expr), objects,
+                                          values, hasSolution))
+    return false;
+  result = !hasSolution;
+  if (hasSolution)
+    metaData.model = std::make_shared<Assignment>(objects, values,
+                                                  /*_allowFreeValues=*/true);
+  return true;
+}
+
 bool TimingSolver::evaluate(const ConstraintSet &constraints, ref<Expr> expr,
                             Solver::Validity &result,
                             SolverQueryMetaData &metaData) {
   ++stats::queries;
   // Fast path, to avoid timer and OS overhead.
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(expr)) {
+    if (profiler)
+      profiler->recordConstant(QueryProfiler::Kind::Validity);
     result = CE->isTrue() ? Solver::True : Solver::False;
     return true;
   }
 
   TimerStatIncrementer timer(stats::solverTime);
+  QueryProfiler::Scope profile(profiler, QueryProfiler::Kind::Validity,
+                               constraints, expr);
+
+  // A model decides on which side the expression may be, so only the
+  // other side needs to be checked
+  ref<ConstantExpr> modelValue = evaluateModel(constraints, expr, metaData);
 
   if (simplifyExprs)
     expr = ConstraintManager::simplifyExpr(constraints, expr);
 
-  bool success = solver->evaluate(Query(constraints, expr), result);
+  bool success;
+  bool mustBe = false;
+  if (modelValue) {
+    bool isTrue = modelValue->isTrue();
+    success = solver->mustBeTrue(
+        Query(constraints, isTrue ? expr : Expr::createIsZero(expr)), mustBe);
+    if (success) {
+      ++stats::queryModelHits;
+      if (mustBe)
+        result = isTrue ? Solver::True : Solver::False;
+      else
+        result = Solver::Unknown;
+    }
+  } else if (canUpdateModel(constraints, metaData)) {
+    // Checking the true side provides a model on the false side, so only the
+    // false side remains, like with a reused model
+    success = mustBeTrueUpdatingModel(constraints, expr, mustBe, metaData);
+    if (success && mustBe) {
+      result = Solver::True;
+    } else if (success) {
+      success = solver->mustBeTrue(
+          Query(constraints, Expr::createIsZero(expr)), mustBe);
+      result = mustBe ? Solver::False : Solver::Unknown;
+    }
+  } else {
+    success = solver->evaluate(Query(constraints, expr), result);
+  }
 
   metaData.queryCost += timer.delta();
 
@@ -51,16 +140,30 @@ bool TimingSolver::mustBeTrue(const ConstraintSet &constraints, ref<Expr> expr,
   ++stats::queries;
   // Fast path, to avoid timer and OS overhead.
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(expr)) {
+    if (profiler)
+      profiler->recordConstant(QueryProfiler::Kind::Truth);
     result = CE->isTrue() ? true : false;
     return true;
   }
 
   TimerStatIncrementer timer(stats::solverTime);
+  QueryProfiler::Scope profile(profiler, QueryProfiler::Kind::Truth,
+                               constraints, expr);
+
+  // The model is a counterexample
+  if (ref<ConstantExpr> value = evaluateModel(constraints, expr, metaData)) {
+    if (value->isFalse()) {
+      ++stats::queryModelHits;
+      result = false;
+      metaData.queryCost += timer.delta();
+      return true;
+    }
+  }
 
   if (simplifyExprs)
     expr = ConstraintManager::simplifyExpr(constraints, expr);
 
-  bool success = solver->mustBeTrue(Query(constraints, expr), result);
+  bool success = mustBeTrueUpdatingModel(constraints, expr, result, metaData);
 
   metaData.queryCost += timer.delta();
 
@@ -96,11 +199,22 @@ bool TimingSolver::getValue(const ConstraintSet &constraints, ref<Expr> expr,
   ++stats::queries;
   // Fast path, to avoid timer and OS overhead.
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(expr)) {
+    if (profiler)
+      profiler->recordConstant(QueryProfiler::Kind::Value);
     result = CE;
     return true;
   }
   
   TimerStatIncrementer timer(stats::solverTime);
+  QueryProfiler::Scope profile(profiler, QueryProfiler::Kind::Value,
+                               constraints, expr);
+
+  if (ref<ConstantExpr> value = evaluateModel(constraints, expr, metaData)) {
+    ++stats::queryModelHits;
+    result = value;
+    metaData.queryCost += timer.delta();
+    return true;
+  }
 
   if (simplifyExprs)
     expr = ConstraintManager::simplifyExpr(constraints, expr);
@@ -121,6 +235,9 @@ bool TimingSolver::getInitialValues(
     return true;
 
   TimerStatIncrementer timer(stats::solverTime);
+  QueryProfiler::Scope profile(profiler, QueryProfiler::Kind::InitialValues,
+                               constraints,
+                               ConstantExpr::alloc(0, Expr::Bool));
 
   bool success = solver->getInitialValues(
       Query(constraints, ConstantExpr::alloc(0, Expr::Bool)), objects, result);
@@ -135,6 +252,8 @@ TimingSolver::getRange(const ConstraintSet &constraints, ref<Expr> expr,
                        SolverQueryMetaData &metaData) {
   ++stats::queries;
   TimerStatIncrementer timer(stats::solverTime);
+  QueryProfiler::Scope profile(profiler, QueryProfiler::Kind::Range,
+                               constraints, expr);
   auto result = solver->getRange(Query(constraints, expr));
   metaData.queryCost += timer.delta();
   return result;
@@ -10,6 +10,8 @@
 #ifndef KLEE_TIMINGSOLVER_H
 #define KLEE_TIMINGSOLVER_H
 
+#include "QueryProfiler.h"
+
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Solver/Solver.h"
@@ -30,6 +32,8 @@ class TimingSolver {
 public:
   std::unique_ptr<Solver> solver;
   bool simplifyExprs;
+  /// Optional profiler all queries are reported to
+  QueryProfiler *profiler = nullptr;
 
 public:
   /// TimingSolver - Construct a new timing solver.
@@ -42,6 +46,9 @@ public:
 
   void setTimeout(time::Span t) { solver->setCoreSolverTimeout(t); }
 
+  void setProfiler(QueryProfiler *p) { profiler = p; }
+  QueryProfiler *getProfiler() const { return profiler; }
+
   std::string getConstraintLog(const Query &query) {
     return solver->getConstraintLog(query);
   }
@@ -72,6 +79,25 @@ public:
   std::pair<ref<Expr>, ref<Expr>> getRange(const ConstraintSet &,
                                            ref<Expr> query,
                                            SolverQueryMetaData &metaData);
+
+private:
+  /// Evaluate \p expr under the model stored in \p metaData. Returns null if
+  /// there is no model for \p constraints or the result is not constant.
+  ref<ConstantExpr> evaluateModel(const ConstraintSet &constraints,
+                                  const ref<Expr> &expr,
+                                  const SolverQueryMetaData &metaData) const;
+
+  /// Whether \p metaData lacks a model for \p constraints that could be
+  /// stored
+  bool canUpdateModel(const ConstraintSet &constraints,
+                      const SolverQueryMetaData &metaData) const;
+
+  /// Decide whether \p expr must be true under \p constraints. If it need
+  /// not be and \p metaData has no model for \p constraints, the
+  /// counterexample is computed by the same query and stored as the model.
+  bool mustBeTrueUpdatingModel(const ConstraintSet &constraints,
+                               const ref<Expr> &expr, bool &result,
+                               SolverQueryMetaData &metaData);
 };
 }
 
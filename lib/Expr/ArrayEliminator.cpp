@@ -0,0 +1,201 @@
+//===-- ArrayEliminator.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ArrayEliminator.h"
+
+#include "klee/Expr/Expr.h"
+
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+/// Bound the recursion of getUpperBound on deeply shared expressions
+const unsigned MaxBoundDepth = 8;
+
+/// Drop the cache once it grows beyond this many entries
+const size_t MaxCacheSize = 1 << 16;
+
+uint64_t widthBound(Expr::Width width) {
+  return width >= Expr::Int64 ? std::numeric_limits<uint64_t>::max()
+                              : (UINT64_C(1) << width) - 1;
+}
+
+uint64_t upperBound(const ref<Expr> &e, unsigned depth) {
+  uint64_t maxValue = widthBound(e->getWidth());
+  if (depth == MaxBoundDepth)
+    return maxValue;
+
+  switch (e->getKind()) {
+  case Expr::Constant:
+    return cast<ConstantExpr>(e)->getZExtValue();
+
+  case Expr::ZExt:
+    return upperBound(e->getKid(0), depth + 1);
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    if (ee->offset != 0 || ee->expr->getWidth() > Expr::Int64)
+      return maxValue;
+    return std::min(maxValue, upperBound(ee->expr, depth + 1));
+  }
+
+  case Expr::Select:
+    return std::max(upperBound(e->getKid(1), depth + 1),
+                    upperBound(e->getKid(2), depth + 1));
+
+  case Expr::And:
+    return std::min(upperBound(e->getKid(0), depth + 1),
+                    upperBound(e->getKid(1), depth + 1));
+
+  case Expr::URem:
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(e->getKid(1)))
+      if (!CE->isZero())
+        return std::min(upperBound(e->getKid(0), depth + 1),
+                        CE->getZExtValue() - 1);
+    return maxValue;
+
+  case Expr::UDiv:
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(e->getKid(1)))
+      if (!CE->isZero())
+        return upperBound(e->getKid(0), depth + 1) / CE->getZExtValue();
+    return maxValue;
+
+  case Expr::LShr:
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(e->getKid(1))) {
+      uint64_t shift = CE->getZExtValue();
+      return shift >= e->getWidth() ? 0
+                                    : upperBound(e->getKid(0), depth + 1) >>
+                                          shift;
+    }
+    return maxValue;
+
+  case Expr::Add: {
+    // Only valid as long as the addition cannot wrap around
+    uint64_t l = upperBound(e->getKid(0), depth + 1);
+    uint64_t r = upperBound(e->getKid(1), depth + 1);
+    if (l > maxValue - r)
+      return maxValue;
+    return l + r;
+  }
+
+  case Expr::Mul: {
+    uint64_t l = upperBound(e->getKid(0), depth + 1);
+    uint64_t r = upperBound(e->getKid(1), depth + 1);
+    if (l != 0 && r > maxValue / l)
+      return maxValue;
+    return l * r;
+  }
+
+  default:
+    return maxValue;
+  }
+}
+} // namespace
+
+bool ArrayEliminator::getUpperBound(const ref<Expr> &e, uint64_t &bound) {
+  if (e->getWidth() > Expr::Int64)
+    return false;
+  bound = upperBound(e, 0);
+  return true;
+}
+
+ref<Expr> ArrayEliminator::eliminate(const ref<Expr> &e) {
+  if (isa<ConstantExpr>(e))
+    return e;
+
+  auto it = cache.find(e);
+  if (it != cache.end())
+    return it->second;
+
+  ref<Expr> result;
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+    result = eliminateRead(*re);
+  } else {
+    ref<Expr> kids[8];
+    bool changed = false;
+    for (unsigned i = 0, n = e->getNumKids(); i < n; ++i) {
+      kids[i] = eliminate(e->getKid(i));
+      changed |= kids[i] != e->getKid(i);
+    }
+    result = changed ? e->rebuild(kids) : e;
+  }
+
+  if (cache.size() >= MaxCacheSize)
+    cache.clear();
+  cache.insert(std::make_pair(e, result));
+  return result;
+}
+
+ref<Expr> ArrayEliminator::eliminateRead(const ReadExpr &re) {
+  ref<Expr> index = eliminate(re.index);
+  const ConstantExpr *concreteIndex = dyn_cast<ConstantExpr>(index);
+
+  uint64_t indexBound = std::numeric_limits<uint64_t>::max();
+  getUpperBound(index, indexBound);
+
+  // Walk the concrete prefix of the update list, newest update first.
+  // Updates shadowed by a newer one at the same index and updates beyond
+  // the reach of the index are dropped.
+  std::vector<const UpdateNode *> updates;
+  std::set<uint64_t> written;
+  const UpdateNode *un = re.updates.head.get();
+  for (; un; un = un->next.get()) {
+    const ConstantExpr *updateIndex = dyn_cast<ConstantExpr>(un->index);
+    if (!updateIndex || updateIndex->getWidth() > Expr::Int64)
+      break;
+
+    uint64_t position = updateIndex->getZExtValue();
+    if (concreteIndex) {
+      if (concreteIndex->getZExtValue() == position)
+        return eliminate(un->value);
+      continue;
+    }
+
+    if (position > indexBound || !written.insert(position).second)
+      continue;
+
+    // Too many updates to be worth an if-then-else tree
+    if (updates.size() == maxUpdates)
+      return ReadExpr::create(re.updates, index);
+    updates.push_back(un);
+  }
+
+  // The remaining updates start with a symbolic index and are kept as is
+  UpdateList remaining(re.updates.root,
+                       ref<UpdateNode>(const_cast<UpdateNode *>(un)));
+  ref<Expr> result = un ? ReadExpr::create(remaining, index)
+                        : expandBoundedRead(remaining, index);
+
+  for (auto it = updates.rbegin(), ie = updates.rend(); it != ie; ++it)
+    result = SelectExpr::create(EqExpr::create(index, (*it)->index),
+                                eliminate((*it)->value), result);
+  return result;
+}
+
+ref<Expr> ArrayEliminator::expandBoundedRead(const UpdateList &ul,
+                                             const ref<Expr> &index) {
+  uint64_t bound;
+  if (isa<ConstantExpr>(index) || !getUpperBound(index, bound) ||
+      bound >= ul.root->size || bound >= maxExpansion)
+    return ReadExpr::create(ul, index);
+
+  Expr::Width width = index->getWidth();
+  ref<Expr> result =
+      ReadExpr::create(ul, ConstantExpr::create(bound, width));
+  for (uint64_t i = bound; i-- > 0;) {
+    ref<Expr> position = ConstantExpr::create(i, width);
+    result = SelectExpr::create(EqExpr::create(index, position),
+                                ReadExpr::create(ul, position), result);
+  }
+  return result;
+}
@@ -22,6 +22,8 @@
 
 #include <llvm/ADT/APInt.h>
 #include <llvm/Support/CommandLine.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/Threading.h>
 
 #include <algorithm>
 #include <cassert>
@@ -57,6 +59,20 @@ llvm::cl::opt<double> ArrayValueSymbRatio(
                    "the mixed value-based transformations are applied."),
     llvm::cl::init(1.0), llvm::cl::value_desc("Symbolic Values / Array Size"),
     llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<unsigned> ArrayValueParallelThreshold(
+    "array-value-parallel-threshold",
+    llvm::cl::desc("Minimum number of elements of a constant array for which "
+                   "the value-based analysis is run on multiple threads, 0 "
+                   "disables it (default=65536)"),
+    llvm::cl::init(65536), llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<unsigned> ArrayValueTableCacheSize(
+    "array-value-table-cache-size",
+    llvm::cl::desc("Maximum number of constant arrays whose value-based "
+                   "analysis is kept for later queries, 0 means unlimited "
+                   "(default=128)"),
+    llvm::cl::init(128), llvm::cl::cat(klee::SolvingCat));
 }; // namespace klee
 
 ref<Expr> extendRead(const UpdateList &ul, const ref<Expr> index,
@@ -278,46 +294,50 @@ ref<Expr> ExprOptimizer::getSelectOptExpr(
       assert(read->updates.root->isConstantArray() &&
              "Expected concrete array, found symbolic array");
 
-      // We need to read updates from lest recent to most recent, therefore
-      // reverse the list
-      std::vector<const UpdateNode *> us;
-      us.reserve(read->updates.getSize());
-      for (const UpdateNode *un = read->updates.head.get(); un;
-           un = un->next.get())
-        us.push_back(un);
-
-      auto arrayConstValues = read->updates.root->constantValues;
-      for (auto it = us.rbegin(); it != us.rend(); it++) {
-        const UpdateNode *un = *it;
-        auto ce = dyn_cast<ConstantExpr>(un->index);
-        assert(ce && "Not a constant expression");
-        uint64_t index = ce->getAPValue().getZExtValue();
-        assert(index < arrayConstValues.size());
-        auto arrayValue = dyn_cast<ConstantExpr>(un->value);
-        assert(arrayValue && "Not a constant expression");
-        arrayConstValues[index] = arrayValue;
-      }
-      std::vector<uint64_t> arrayValues;
-      // Get the concrete values from the array
-      for (unsigned i = 0; i < elementsInArray; i++) {
-        uint64_t val = 0;
-        for (unsigned j = 0; j < bytesPerElement; j++) {
-          val |= (*(
-                       arrayConstValues[(i * bytesPerElement) + j]
-                           .get()
-                           ->getAPValue()
-                           .getRawData())
-                  << (j * 8));
-        }
-        arrayValues.push_back(val);
-      }
-
       ref<Expr> index = UDivExpr::create(
           read->index,
           ConstantExpr::create(bytesPerElement, read->index->getWidth()));
 
-      ref<Expr> opt =
-          buildConstantSelectExpr(index, arrayValues, width, elementsInArray);
+      ArrayValueTable &table = getArrayValueTable(read->updates.root, width);
+      ref<Expr> opt;
+      if (read->updates.getSize() == 0) {
+        // The analysis of an array without updates is shared by all reads
+        if (!table.analyzed) {
+          table.applicable = computeValueRanges(table.values, table.ranges);
+          table.analyzed = true;
+        }
+        if (table.applicable)
+          opt = buildConstantSelectExpr(index, table.ranges, width);
+      } else {
+        // We need to apply updates from least recent to most recent,
+        // therefore reverse the list
+        std::vector<const UpdateNode *> us;
+        us.reserve(read->updates.getSize());
+        for (const UpdateNode *un = read->updates.head.get(); un;
+             un = un->next.get())
+          us.push_back(un);
+
+        std::vector<uint64_t> arrayValues = table.values;
+        for (auto it = us.rbegin(); it != us.rend(); it++) {
+          const UpdateNode *un = *it;
+          auto ce = dyn_cast<ConstantExpr>(un->index);
+          assert(ce && "Not a constant expression");
+          uint64_t position = ce->getAPValue().getZExtValue();
+          assert(position < size);
+          auto arrayValue = dyn_cast<ConstantExpr>(un->value);
+          assert(arrayValue && "Not a constant expression");
+          if (position >= elementsInArray * bytesPerElement)
+            continue;
+          unsigned shift = (position % bytesPerElement) * 8;
+          uint64_t &val = arrayValues[position / bytesPerElement];
+          val = (val & ~(UINT64_C(0xff) << shift)) |
+                (arrayValue->getZExtValue() << shift);
+        }
+
+        valueRanges_ty ranges;
+        if (computeValueRanges(arrayValues, ranges))
+          opt = buildConstantSelectExpr(index, ranges, width);
+      }
       if (opt) {
         cacheReadExprOptimized[const_cast<ReadExpr *>(read)] = opt;
         optimized.insert(std::make_pair(info.first, opt));
@@ -429,23 +449,73 @@ ref<Expr> ExprOptimizer::getSelectOptExpr(
   return toReturn ? toReturn : notFound;
 }
 
-ref<Expr> ExprOptimizer::buildConstantSelectExpr(
-    const ref<Expr> &index, std::vector<uint64_t> &arrayValues,
-    Expr::Width width, unsigned arraySize) const {
+ExprOptimizer::ArrayValueTable &
+ExprOptimizer::getArrayValueTable(const Array *array, Expr::Width width) {
+  const ArrayValueTableKey key(array, width);
+  auto found = arrayValueTableIndex.find(key);
+  if (found != arrayValueTableIndex.end()) {
+    arrayValueTables.splice(arrayValueTables.begin(), arrayValueTables,
+                            found->second);
+    return found->second->second;
+  }
+
+  if (ArrayValueTableCacheSize &&
+      arrayValueTables.size() >= ArrayValueTableCacheSize) {
+    arrayValueTableIndex.erase(arrayValueTables.back().first);
+    arrayValueTables.pop_back();
+  }
+  arrayValueTables.emplace_front(key, ArrayValueTable());
+  arrayValueTableIndex.emplace(key, arrayValueTables.begin());
+  ArrayValueTable &table = arrayValueTables.front().second;
+  packArrayValues(array, width / 8, table.values);
+  return table;
+}
+
+void ExprOptimizer::packArrayValues(const Array *array,
+                                    unsigned bytesPerElement,
+                                    std::vector<uint64_t> &values) {
+  unsigned elementsInArray = array->getSize() / bytesPerElement;
+  values.assign(elementsInArray, 0);
+
+  // Only reads the constant values through raw pointers, so that no
+  // reference counts are touched from the worker threads
+  auto pack = [array, bytesPerElement, &values](unsigned begin, unsigned end) {
+    for (unsigned i = begin; i < end; i++) {
+      uint64_t val = 0;
+      for (unsigned j = 0; j < bytesPerElement; j++)
+        val |= array->constantValues[(i * bytesPerElement) + j]->getZExtValue()
+               << (j * 8);
+      values[i] = val;
+    }
+  };
+
+  unsigned threads = llvm::hardware_concurrency().compute_thread_count();
+  if (ArrayValueParallelThreshold == 0 ||
+      elementsInArray < ArrayValueParallelThreshold || threads < 2) {
+    pack(0, elementsInArray);
+    return;
+  }
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(19, 0)
+  llvm::DefaultThreadPool pool;
+#else
+  llvm::ThreadPool pool;
+#endif
+  unsigned chunk = (elementsInArray + threads - 1) / threads;
+  for (unsigned begin = 0; begin < elementsInArray; begin += chunk)
+    pool.async(pack, begin, std::min(begin + chunk, elementsInArray));
+  pool.wait();
+}
+
+bool ExprOptimizer::computeValueRanges(const std::vector<uint64_t> &arrayValues,
+                                       valueRanges_ty &exprMap) {
   std::vector<std::pair<uint64_t, uint64_t>> ranges;
   std::vector<uint64_t> values;
   std::set<uint64_t> unique_array_values;
-  ExprBuilder *builder = createDefaultExprBuilder();
-  Expr::Width valWidth = width;
-  ref<Expr> result;
 
-  ref<Expr> actualIndex;
-  if (index->getWidth() > Expr::Int32) {
-    actualIndex = ExtractExpr::alloc(index, 0, Expr::Int32);
-  } else {
-    actualIndex = index;
-  }
-  Expr::Width idxWidth = actualIndex->getWidth();
+  unsigned arraySize = arrayValues.size();
+  if (arraySize == 0)
+    return false;
 
   // Calculate the repeating values ranges in the constant array
   unsigned curr_idx = 0;
@@ -470,26 +540,32 @@ ref<Expr> ExprOptimizer::buildConstantSelectExpr(
 
   if (((double)unique_array_values.size() / (double)(arraySize)) >=
       ArrayValueRatio) {
-    return result;
+    return false;
   }
 
-  std::map<uint64_t, std::vector<std::pair<uint64_t, uint64_t>>> exprMap;
-  for (size_t i = 0; i < ranges.size(); i++) {
-    if (exprMap.find(values[i]) != exprMap.end()) {
-      exprMap[values[i]].emplace_back(ranges[i].first, ranges[i].second);
-    } else {
-      if (exprMap.find(values[i]) == exprMap.end()) {
-        exprMap.insert(std::make_pair(
-            values[i], std::vector<std::pair<uint64_t, uint64_t>>()));
-      }
-      exprMap.find(values[i])->second.emplace_back(ranges[i].first,
-                                                   ranges[i].second);
-    }
+  for (size_t i = 0; i < ranges.size(); i++)
+    exprMap[values[i]].emplace_back(ranges[i].first, ranges[i].second);
+  return true;
+}
+
+ref<Expr> ExprOptimizer::buildConstantSelectExpr(const ref<Expr> &index,
+                                                 const valueRanges_ty &exprMap,
+                                                 Expr::Width width) const {
+  ExprBuilder *builder = createDefaultExprBuilder();
+  Expr::Width valWidth = width;
+  ref<Expr> result;
+
+  ref<Expr> actualIndex;
+  if (index->getWidth() > Expr::Int32) {
+    actualIndex = ExtractExpr::alloc(index, 0, Expr::Int32);
+  } else {
+    actualIndex = index;
   }
+  Expr::Width idxWidth = actualIndex->getWidth();
 
   int ct = 0;
   // For each range appropriately build the Select expression.
-  for (auto range : exprMap) {
+  for (auto &range : exprMap) {
     ref<Expr> temp;
     if (ct == 0) {
       temp = builder->Constant(llvm::APInt(valWidth, range.first, false));
@@ -0,0 +1,156 @@
+//===-- BranchToSelect.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Passes.h"
+
+#include "klee/Support/CompilerWarning.h"
+DISABLE_WARNING_PUSH
+DISABLE_WARNING_DEPRECATED_DECLARATIONS
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Local.h"
+DISABLE_WARNING_POP
+
+using namespace llvm;
+
+char klee::BranchToSelectPass::ID = 0;
+
+/// Returns the successor of \p bb if it ends with an unconditional branch.
+static BasicBlock *getJumpTarget(BasicBlock &bb) {
+  auto *br = dyn_cast<BranchInst>(bb.getTerminator());
+  return br && br->isUnconditional() ? br->getSuccessor(0) : nullptr;
+}
+
+bool klee::BranchToSelectPass::runOnFunction(Function &f) {
+  // Converting inner diamonds exposes the outer ones
+  bool changed = false;
+  for (bool converted = true; converted;) {
+    converted = false;
+    for (auto it = f.begin(); it != f.end();) {
+      // Only the arms and the join are removed, so the head is tried again
+      if (convertBranch(*it))
+        converted = changed = true;
+      else
+        ++it;
+    }
+  }
+  return changed;
+}
+
+bool klee::BranchToSelectPass::canSpeculate(BasicBlock &arm,
+                                            BasicBlock &head) const {
+  if (arm.getSinglePredecessor() != &head || arm.hasAddressTaken())
+    return false;
+
+  unsigned size = 0;
+  for (Instruction &inst : arm) {
+    if (&inst == arm.getTerminator() || isa<DbgInfoIntrinsic>(inst))
+      continue;
+    // Loads are not speculated, as they could report spurious memory errors
+    if (isa<PHINode>(inst) || inst.mayReadOrWriteMemory() ||
+        !isSafeToSpeculativelyExecute(&inst) || ++size > maxArmSize)
+      return false;
+  }
+  return true;
+}
+
+bool klee::BranchToSelectPass::convertBranch(BasicBlock &head) {
+  auto *br = dyn_cast<BranchInst>(head.getTerminator());
+  if (!br || !br->isConditional() || isa<Constant>(br->getCondition()))
+    return false;
+
+  // Find the join block of a diamond (head -> {T, F} -> join) or a triangle
+  // (head -> T -> join, head -> join), where the arms can be speculated
+  BasicBlock *succs[2] = {br->getSuccessor(0), br->getSuccessor(1)};
+  BasicBlock *arms[2] = {nullptr, nullptr};
+  BasicBlock *join = nullptr;
+  if (succs[0] == succs[1])
+    return false;
+  for (unsigned i = 0; i != 2; ++i) {
+    BasicBlock *other = succs[1 - i];
+    BasicBlock *next = getJumpTarget(*succs[i]);
+    if (!next || next == succs[i] || next == &head)
+      continue;
+    if (next == other) {
+      arms[i] = succs[i];
+      join = other;
+      break;
+    }
+    if (next == getJumpTarget(*other)) {
+      arms[0] = succs[0];
+      arms[1] = succs[1];
+      join = next;
+      break;
+    }
+  }
+  if (!join || join == &head)
+    return false;
+  for (BasicBlock *arm : arms) {
+    if (arm && !canSpeculate(*arm, head))
+      return false;
+  }
+
+  // Values of the join's phis on both paths: from the arms, or from head
+  // for the side of a triangle without an arm
+  for (PHINode &phi : join->phis()) {
+    for (unsigned i = 0; i != 2; ++i) {
+      if (phi.getBasicBlockIndex(arms[i] ? arms[i] : &head) < 0)
+        return false;
+    }
+  }
+
+  for (BasicBlock *arm : arms) {
+    if (!arm)
+      continue;
+    for (Instruction &inst : make_early_inc_range(*arm)) {
+      if (&inst == arm->getTerminator())
+        break;
+      if (isa<DbgInfoIntrinsic>(inst))
+        inst.eraseFromParent();
+      else
+        inst.moveBefore(br);
+    }
+  }
+
+  IRBuilder<> builder(br);
+  Value *condition = br->getCondition();
+  for (PHINode &phi : join->phis()) {
+    Value *values[2];
+    for (unsigned i = 0; i != 2; ++i)
+      values[i] = phi.getIncomingValueForBlock(arms[i] ? arms[i] : &head);
+    Value *select = values[0] == values[1]
+                        ? values[0]
+                        : builder.CreateSelect(condition, values[0], values[1],
+                                               phi.getName());
+    for (BasicBlock *arm : arms) {
+      if (arm)
+        phi.removeIncomingValue(arm, /*DeletePHIIfEmpty=*/false);
+    }
+    if (phi.getBasicBlockIndex(&head) < 0)
+      phi.addIncoming(select, &head);
+    else
+      phi.setIncomingValueForBlock(&head, select);
+  }
+
+  builder.CreateBr(join);
+  br->eraseFromParent();
+  // The arms are left with only their branch to the already updated join
+  for (BasicBlock *arm : arms) {
+    if (arm)
+      arm->eraseFromParent();
+  }
+  MergeBlockIntoPredecessor(join);
+  RecursivelyDeleteTriviallyDeadInstructions(condition);
+
+  ++convertedBranches;
+  return true;
+}
@@ -7,6 +7,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "ModuleHelper.h"
 #include "Passes.h"
 
 #include "klee/Support/Casting.h"
@@ -15,6 +16,7 @@
 
 #include "llvm/IR/GlobalAlias.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Support/Regex.h"
 
 using namespace llvm;
@@ -216,4 +218,10 @@ bool FunctionAliasPass::isFunctionOrGlobalFunctionAlias(const GlobalValue *gv) {
 
 char FunctionAliasPass::ID = 0;
 
+void hashFunctionAliases(llvm::MD5 &hash) {
+  // Each alias is hashed with its terminator to keep them apart
+  for (const auto &pair : FunctionAlias)
+    hash.update(StringRef(pair.c_str(), pair.size() + 1));
+}
+
 } // namespace klee
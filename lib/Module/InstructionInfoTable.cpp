@@ -85,6 +85,13 @@ buildInstructionToLineMap(const llvm::Module &m) {
   return mapping;
 }
 
+static std::size_t countFunctionsAndInstructions(const llvm::Module &m) {
+  std::size_t count = 0;
+  for (const auto &Func : m)
+    count += 1 + Func.getInstructionCount();
+  return count;
+}
+
 class DebugInfoExtractor {
   std::vector<std::unique_ptr<std::string>> &internedStrings;
   std::map<uintptr_t, uint64_t> lineTable;
@@ -94,9 +101,21 @@ class DebugInfoExtractor {
 public:
   DebugInfoExtractor(
       std::vector<std::unique_ptr<std::string>> &_internedStrings,
-      const llvm::Module &_module)
+      const llvm::Module &_module, const std::vector<uint64_t> &assemblyLines)
       : internedStrings(_internedStrings), module(_module) {
-    lineTable = buildInstructionToLineMap(module);
+    // Given lines are matched to the module in the order they were stored
+    auto line = assemblyLines.begin();
+    for (const auto &Func : module) {
+      if (line == assemblyLines.end())
+        break;
+      lineTable.emplace(reinterpret_cast<std::uintptr_t>(&Func), *line++);
+      for (auto it = llvm::inst_begin(Func), ie = llvm::inst_end(Func);
+           it != ie && line != assemblyLines.end(); ++it)
+        lineTable.emplace(reinterpret_cast<std::uintptr_t>(&*it), *line++);
+    }
+    if (line != assemblyLines.end() ||
+        lineTable.size() != countFunctionsAndInstructions(module))
+      lineTable = buildInstructionToLineMap(module);
   }
 
   std::string &getInternedString(const std::string &s) {
@@ -165,9 +184,10 @@ public:
   }
 };
 
-InstructionInfoTable::InstructionInfoTable(const llvm::Module &m) {
+InstructionInfoTable::InstructionInfoTable(
+    const llvm::Module &m, const std::vector<uint64_t> &assemblyLines) {
   // Generate all debug instruction information
-  DebugInfoExtractor DI(internedStrings, m);
+  DebugInfoExtractor DI(internedStrings, m, assemblyLines);
   for (const auto &Func : m) {
     auto F = DI.getFunctionInfo(Func);
     auto FR = F.get();
@@ -188,6 +208,19 @@ InstructionInfoTable::InstructionInfoTable(const llvm::Module &m) {
     item.second->id = idCounter++;
 }
 
+std::vector<uint64_t>
+InstructionInfoTable::getAssemblyLines(const llvm::Module &m) const {
+  std::vector<uint64_t> lines;
+  lines.reserve(countFunctionsAndInstructions(m));
+  for (const auto &Func : m) {
+    lines.push_back(getFunctionInfo(Func).assemblyLine);
+    for (auto it = llvm::inst_begin(Func), ie = llvm::inst_end(Func); it != ie;
+         ++it)
+      lines.push_back(getInfo(*it).assemblyLine);
+  }
+  return lines;
+}
+
 unsigned InstructionInfoTable::getMaxID() const {
   return infos.size() + functionInfos.size();
 }
@@ -79,24 +79,23 @@ void klee::checkModule(bool DontVerify, llvm::Module *module) {
   }
 }
 
-void klee::optimiseAndPrepare(bool OptimiseKLEECall, bool Optimize,
-                              SwitchImplType SwitchType, std::string EntryPoint,
+void klee::optimiseAndPrepare(const PrepareOptions &opts,
                               llvm::ArrayRef<const char *> preservedFunctions,
                               llvm::Module *module) {
   // Preserve all functions containing klee-related function calls from being
   // optimised around
-  if (!OptimiseKLEECall) {
+  if (!opts.OptimiseKLEECall) {
     legacy::PassManager pm;
     pm.add(new OptNonePass());
     pm.run(*module);
   }
 
-  if (Optimize)
+  if (opts.Optimize)
     optimizeModule(module, preservedFunctions);
 
   // Needs to happen after linking (since ctors/dtors can be modified)
   // and optimization (since global optimization can rewrite lists).
-  injectStaticConstructorsAndDestructors(module, EntryPoint);
+  injectStaticConstructorsAndDestructors(module, opts.EntryPoint);
 
   // Finally, run the passes that maintain invariants we expect during
   // interpretation. We run the intrinsic cleaner just in case we
@@ -105,7 +104,7 @@ void klee::optimiseAndPrepare(bool OptimiseKLEECall, bool Optimize,
   // directly I think?
   legacy::PassManager pm3;
   pm3.add(createCFGSimplificationPass());
-  switch (SwitchType) {
+  switch (opts.SwitchType) {
   case SwitchImplType::eSwitchTypeInternal:
     break;
   case SwitchImplType::eSwitchTypeSimple:
@@ -115,6 +114,18 @@ void klee::optimiseAndPrepare(bool OptimiseKLEECall, bool Optimize,
     pm3.add(createLowerSwitchPass());
     break;
   }
+  BranchToSelectPass *branchToSelect = nullptr;
+  if (opts.BranchToSelect) {
+    branchToSelect = new BranchToSelectPass(opts.MaxSelectArmSize);
+    pm3.add(branchToSelect);
+  }
+  if (opts.SummarizeLoops)
+    pm3.add(new LoopSummarizerPass());
+  MergePointPass *mergePoints = nullptr;
+  if (opts.AutoMerge) {
+    mergePoints = new MergePointPass(opts.MaxMergeRegionSize);
+    pm3.add(mergePoints);
+  }
 
   llvm::DataLayout targetData(module);
   pm3.add(new IntrinsicCleanerPass(targetData));
@@ -122,4 +133,11 @@ void klee::optimiseAndPrepare(bool OptimiseKLEECall, bool Optimize,
   pm3.add(new PhiCleanerPass());
   pm3.add(new FunctionAliasPass());
   pm3.run(*module);
+
+  if (branchToSelect)
+    klee_message("Converted %u branches into selects",
+                 branchToSelect->getConvertedBranches());
+  if (mergePoints)
+    klee_message("Inserted merge points for %u regions",
+                 mergePoints->getMergeRegions());
 }
\ No newline at end of file
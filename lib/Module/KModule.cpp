@@ -28,10 +28,20 @@
 
 DISABLE_WARNING_PUSH
 DISABLE_WARNING_DEPRECATED_DECLARATIONS
+#include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
 DISABLE_WARNING_POP
 
+#include <chrono>
+#include <cstring>
 #include <sstream>
 
 using namespace llvm;
@@ -84,6 +94,63 @@ cl::opt<SwitchImplType> SwitchType(
                           "execute switch internally")),
     cl::init(SwitchImplType::eSwitchTypeInternal), cl::cat(ModuleCat));
 
+  cl::opt<bool> OptimizeSymbolic(
+      "optimize-symbolic",
+      cl::desc("Replace branches over small side-effect free blocks with "
+               "selects, so that symbolic conditions do not fork "
+               "(default=false)"),
+      cl::init(false), cl::cat(ModuleCat));
+
+  cl::opt<unsigned> OptimizeSymbolicMaxArmSize(
+      "optimize-symbolic-max-arm-size",
+      cl::desc("Maximum number of instructions per branch arm that "
+               "--optimize-symbolic executes unconditionally (default=4)"),
+      cl::init(4), cl::cat(ModuleCat));
+
+  cl::opt<std::string> ModuleCacheDir(
+      "module-cache-dir",
+      cl::desc("Cache the prepared module in the given directory, keyed by "
+               "the linked bitcode and the module options, and reuse it in "
+               "later runs. Old entries are removed according to "
+               "--module-cache-policy (default=off)"),
+      cl::cat(ModuleCat));
+
+  cl::opt<std::string> ModuleCachePolicy(
+      "module-cache-policy",
+      cl::desc("When to remove entries from --module-cache-dir, in the "
+               "format of LLVM's cache pruning policies, e.g. "
+               "prune_after=24h:cache_size_bytes=1g (default: remove entries "
+               "not used for a week, checking at most every 20 minutes)"),
+      cl::cat(ModuleCat));
+
+  cl::opt<bool> LazyFunctionPreparation(
+      "lazy-function-preparation",
+      cl::desc("Prepare functions for execution when they are first called "
+               "instead of at startup (default=false)"),
+      cl::init(false), cl::cat(ModuleCat));
+
+  cl::opt<bool> AutoMerge(
+      "auto-merge",
+      cl::desc("Merge the states forked in small regions after branches "
+               "and around loops at the end of the region, without "
+               "klee_open_merge/klee_close_merge annotations. Regions are "
+               "chosen statically by estimating the solver queries merging "
+               "saves after the region. Requires --use-merge "
+               "(default=false)"),
+      cl::init(false), cl::cat(ModuleCat));
+
+  cl::opt<unsigned> AutoMergeMaxRegionSize(
+      "auto-merge-max-region-size",
+      cl::desc("Maximum number of instructions in a region merged by "
+               "--auto-merge (default=64)"),
+      cl::init(64), cl::cat(ModuleCat));
+
+  cl::opt<bool> SummarizeLoops(
+      "summarize-loops",
+      cl::desc("Compute the iteration count of simple byte search loops (e.g. "
+               "strlen) instead of forking in every iteration (default=false)"),
+      cl::init(false), cl::cat(ModuleCat));
+
 } // namespace
 
 /***/
@@ -196,9 +263,121 @@ void KModule::instrument(const Interpreter::ModuleOptions &opts) {
   klee::instrument(opts.CheckDivZero, opts.CheckOvershift, module.get());
 }
 
+/// Atomically replaces the cache file \p path with the output of \p write,
+/// as other KLEE processes may read it concurrently.
+static void writeCacheFile(const std::string &path,
+                           function_ref<void(raw_ostream &)> write) {
+  int fd;
+  SmallString<128> tempPath;
+  if (auto ec = sys::fs::createUniqueFile(path + ".tmp-%%%%%%%%", fd,
+                                          tempPath)) {
+    klee_warning("Unable to write cache file %s: %s", path.c_str(),
+                 ec.message().c_str());
+    return;
+  }
+
+  raw_fd_ostream os(fd, /*shouldClose=*/true);
+  write(os);
+  os.close();
+  if (os.has_error()) {
+    klee_warning("Unable to write cache file %s: %s", path.c_str(),
+                 os.error().message().c_str());
+    os.clear_error();
+    sys::fs::remove(tempPath);
+    return;
+  }
+  if (auto ec = sys::fs::rename(tempPath, path)) {
+    klee_warning("Unable to write cache file %s: %s", path.c_str(),
+                 ec.message().c_str());
+    sys::fs::remove(tempPath);
+  }
+}
+
+std::string
+KModule::getCachePath(const Interpreter::ModuleOptions &opts,
+                      llvm::ArrayRef<const char *> preservedFunctions) {
+  MD5 hash;
+  auto addString = [&hash](StringRef s) {
+    hash.update(s);
+    hash.update(static_cast<uint8_t>(0));
+  };
+
+  addString(PACKAGE_STRING);
+  addString(LLVM_VERSION_STRING);
+
+  SmallVector<char, 0> bitcode;
+  raw_svector_ostream os(bitcode);
+  WriteBitcodeToFile(*module, os);
+  hash.update(StringRef(bitcode.data(), bitcode.size()));
+
+  addString(opts.EntryPoint);
+  for (bool option : {opts.Optimize, opts.CheckDivZero, opts.CheckOvershift,
+                      DontVerify.getValue(), OptimiseKLEECall.getValue(),
+                      OptimizeSymbolic.getValue(), SummarizeLoops.getValue(),
+                      AutoMerge.getValue()})
+    hash.update(static_cast<uint8_t>(option));
+  hash.update(static_cast<uint8_t>(SwitchType.getValue()));
+  addString(std::to_string(OptimizeSymbolicMaxArmSize));
+  addString(std::to_string(AutoMergeMaxRegionSize));
+  for (const char *name : preservedFunctions)
+    addString(name);
+  hashOptimizeOptions(hash);
+  hashFunctionAliases(hash);
+
+  MD5::MD5Result result;
+  hash.final(result);
+  // pruneCache only removes files with this prefix
+  SmallString<128> path(ModuleCacheDir);
+  sys::path::append(path, "llvmcache-" + result.digest());
+  return std::string(path);
+}
+
+bool KModule::loadCachedModule() {
+  auto buffer = MemoryBuffer::getFile(cachePath + ".bc");
+  if (!buffer)
+    return false;
+
+  auto cached =
+      parseBitcodeFile(buffer.get()->getMemBufferRef(), module->getContext());
+  if (!cached) {
+    klee_warning("Ignoring unreadable cached module %s.bc: %s",
+                 cachePath.c_str(), toString(cached.takeError()).c_str());
+    return false;
+  }
+
+  module = std::move(cached.get());
+  targetData = std::unique_ptr<llvm::DataLayout>(new DataLayout(module.get()));
+  klee_message("Using prepared module from cache: %s.bc", cachePath.c_str());
+
+  // Pruning removes the entries used least recently, and access times are
+  // not updated on every file system
+  int fd;
+  if (!sys::fs::openFileForRead(cachePath + ".bc", fd)) {
+    sys::fs::setLastAccessAndModificationTime(
+        fd, std::chrono::system_clock::now());
+    sys::Process::SafelyCloseFileDescriptor(fd);
+  }
+  return true;
+}
+
 void KModule::optimiseAndPrepare(
     const Interpreter::ModuleOptions &opts,
     llvm::ArrayRef<const char *> preservedFunctions) {
+  if (!ModuleCacheDir.empty()) {
+    auto policy = parseCachePruningPolicy(ModuleCachePolicy);
+    if (!policy)
+      klee_error("Invalid --module-cache-policy: %s",
+                 toString(policy.takeError()).c_str());
+    if (auto ec = sys::fs::create_directories(ModuleCacheDir)) {
+      klee_warning("Unable to create module cache directory %s: %s",
+                   ModuleCacheDir.c_str(), ec.message().c_str());
+    } else {
+      pruneCache(ModuleCacheDir, *policy);
+      cachePath = getCachePath(opts, preservedFunctions);
+      loadedFromCache = loadCachedModule();
+    }
+  }
+
   // Add internal functions which are not used to check if instructions
   // have been already visited
   if (opts.CheckDivZero)
@@ -206,15 +385,36 @@ void KModule::optimiseAndPrepare(
   if (opts.CheckOvershift)
     addInternalFunction("klee_overshift_check");
 
-  klee::optimiseAndPrepare(OptimiseKLEECall, opts.Optimize, SwitchType,
-                           opts.EntryPoint, preservedFunctions, module.get());
+  if (loadedFromCache)
+    return;
+
+  PrepareOptions prepareOpts;
+  prepareOpts.OptimiseKLEECall = OptimiseKLEECall;
+  prepareOpts.Optimize = opts.Optimize;
+  prepareOpts.BranchToSelect = OptimizeSymbolic;
+  prepareOpts.MaxSelectArmSize = OptimizeSymbolicMaxArmSize;
+  prepareOpts.SummarizeLoops = SummarizeLoops;
+  prepareOpts.AutoMerge = AutoMerge;
+  prepareOpts.MaxMergeRegionSize = AutoMergeMaxRegionSize;
+  prepareOpts.SwitchType = SwitchType;
+  prepareOpts.EntryPoint = opts.EntryPoint;
+  klee::optimiseAndPrepare(prepareOpts, preservedFunctions, module.get());
 }
 
 void KModule::manifest(InterpreterHandler *ih, bool forceSourceOutput) {
   if (OutputSource || forceSourceOutput) {
-    std::unique_ptr<llvm::raw_fd_ostream> os(ih->openOutputFile("assembly.ll"));
-    assert(os && !os->has_error() && "unable to open source output");
-    *os << *module;
+    // Printing large modules is slow, so the cached module's assembly is
+    // copied instead
+    if (!cachePath.empty() && !sys::fs::exists(cachePath + ".ll"))
+      writeCacheFile(cachePath + ".ll", [&](raw_ostream &os) { os << *module; });
+    if (cachePath.empty() ||
+        sys::fs::copy_file(cachePath + ".ll",
+                           ih->getOutputFilename("assembly.ll"))) {
+      std::unique_ptr<llvm::raw_fd_ostream> os(
+          ih->openOutputFile("assembly.ll"));
+      assert(os && !os->has_error() && "unable to open source output");
+      *os << *module;
+    }
   }
 
   if (OutputModule) {
@@ -224,37 +424,34 @@ void KModule::manifest(InterpreterHandler *ih, bool forceSourceOutput) {
 
   /* Build shadow structures */
 
-  infos = std::unique_ptr<InstructionInfoTable>(
-      new InstructionInfoTable(*module.get()));
-
-  std::vector<Function *> declarations;
-
-  for (auto &Function : *module) {
-    if (Function.isDeclaration()) {
-      declarations.push_back(&Function);
+  std::vector<uint64_t> assemblyLines;
+  if (!cachePath.empty()) {
+    auto buffer = MemoryBuffer::getFile(cachePath + ".lines");
+    if (buffer && buffer.get()->getBufferSize() % sizeof(uint64_t) == 0) {
+      assemblyLines.resize(buffer.get()->getBufferSize() / sizeof(uint64_t));
+      std::memcpy(assemblyLines.data(), buffer.get()->getBufferStart(),
+                  buffer.get()->getBufferSize());
     }
-
-    auto kf = std::unique_ptr<KFunction>(new KFunction(&Function, this));
-
-    for (unsigned i=0; i<kf->numInstructions; ++i) {
-      KInstruction *ki = kf->instructions[i];
-      ki->info = &infos->getInfo(*ki->inst);
-    }
-
-    functionMap.insert(std::make_pair(&Function, kf.get()));
-    functions.push_back(std::move(kf));
   }
 
-  /* Compute various interesting properties */
-
-  for (auto &kf : functions) {
-    if (functionEscapes(kf->function))
-      escapingFunctions.insert(kf->function);
+  infos = std::unique_ptr<InstructionInfoTable>(
+      new InstructionInfoTable(*module.get(), assemblyLines));
+
+  if (!cachePath.empty() && assemblyLines.empty()) {
+    writeCacheFile(cachePath + ".lines", [&](raw_ostream &os) {
+      auto lines = infos->getAssemblyLines(*module);
+      os.write(reinterpret_cast<const char *>(lines.data()),
+               lines.size() * sizeof(uint64_t));
+    });
   }
 
-  for (auto &declaration : declarations) {
-    if (functionEscapes(declaration))
-      escapingFunctions.insert(declaration);
+  for (auto &Function : *module) {
+    if (!LazyFunctionPreparation)
+      addFunction(&Function);
+
+    /* Compute various interesting properties */
+    if (functionEscapes(&Function))
+      escapingFunctions.insert(&Function);
   }
 
   if (DebugPrintEscapingFunctions && !escapingFunctions.empty()) {
@@ -268,7 +465,33 @@ void KModule::manifest(InterpreterHandler *ih, bool forceSourceOutput) {
   }
 }
 
-void KModule::checkModule() { klee::checkModule(DontVerify, module.get()); }
+bool KModule::prepareFunctionsLazily() { return LazyFunctionPreparation; }
+
+bool KModule::insertsMergePoints() { return AutoMerge; }
+
+KFunction *KModule::addFunction(llvm::Function *f) {
+  assert(!functionMap.count(f) && "function already added");
+  auto kf = std::unique_ptr<KFunction>(new KFunction(f, this));
+
+  for (unsigned i=0; i<kf->numInstructions; ++i) {
+    KInstruction *ki = kf->instructions[i];
+    ki->info = &infos->getInfo(*ki->inst);
+  }
+
+  functionMap.insert(std::make_pair(f, kf.get()));
+  functions.push_back(std::move(kf));
+  return functions.back().get();
+}
+
+void KModule::checkModule() {
+  // A cached module is checked again, as the cache may be shared and the
+  // entry may have been damaged since it was stored
+  klee::checkModule(DontVerify, module.get());
+  if (!cachePath.empty() && !loadedFromCache) {
+    writeCacheFile(cachePath + ".bc",
+                   [&](raw_ostream &os) { WriteBitcodeToFile(*module, os); });
+  }
+}
 
 KConstant* KModule::getKConstant(const Constant *c) {
   auto it = constantMap.find(c);
@@ -355,6 +578,9 @@ KFunction::KFunction(llvm::Function *_function,
       case Instruction::InsertValue:
       case Instruction::ExtractValue:
         ki = new KGEPInstruction(); break;
+      case Instruction::Call:
+      case Instruction::Invoke:
+        ki = new KCallInstruction(); break;
       default:
         ki = new KInstruction(); break;
       }
@@ -0,0 +1,253 @@
+//===-- LoopSummarizer.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Passes.h"
+
+#include "klee/Support/CompilerWarning.h"
+DISABLE_WARNING_PUSH
+DISABLE_WARNING_DEPRECATED_DECLARATIONS
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/PatternMatch.h"
+#include "llvm/Transforms/Utils/SSAUpdater.h"
+DISABLE_WARNING_POP
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+using namespace llvm;
+using namespace llvm::PatternMatch;
+
+char klee::LoopSummarizerPass::ID = 0;
+
+namespace {
+/// A value that advances by one byte (or one, for integers) per iteration:
+/// in iteration j it is init + offset + j, or base + (init + offset + j) if
+/// base is set.
+struct AffineValue {
+  Value *init;
+  Value *base;
+  uint64_t offset;
+};
+
+/// Creates the value of \p value in iteration \p iteration.
+Value *materialize(IRBuilder<> &builder, const AffineValue &value,
+                   Value *iteration) {
+  bool const isPointer = value.init->getType()->isPointerTy();
+  Type *stepTy = isPointer ? iteration->getType() : value.init->getType();
+  Value *step = builder.CreateZExtOrTrunc(iteration, stepTy);
+  if (value.offset)
+    step = builder.CreateAdd(step, ConstantInt::get(stepTy, value.offset));
+  Value *index = value.init;
+  if (!match(step, m_Zero()))
+    index = isPointer ? builder.CreateGEP(builder.getInt8Ty(), index, step)
+                      : builder.CreateAdd(index, step);
+  if (value.base)
+    return builder.CreateGEP(builder.getInt8Ty(), value.base, index);
+  return index;
+}
+} // namespace
+
+bool klee::LoopSummarizerPass::runOnFunction(Function &f) {
+  // Summarizing adds blocks, so collect the candidates first
+  std::vector<BasicBlock *> blocks;
+  for (BasicBlock &bb : f)
+    blocks.push_back(&bb);
+
+  bool changed = false;
+  for (BasicBlock *bb : blocks)
+    changed |= summarizeSearchLoop(*bb);
+  return changed;
+}
+
+bool klee::LoopSummarizerPass::summarizeSearchLoop(BasicBlock &loop) {
+  // The loop consists of a single block that branches back to itself
+  auto *br = dyn_cast<BranchInst>(loop.getTerminator());
+  if (!br || !br->isConditional() ||
+      (br->getSuccessor(0) == &loop) == (br->getSuccessor(1) == &loop))
+    return false;
+  bool const exitOnTrue = br->getSuccessor(1) == &loop;
+  BasicBlock *exit = br->getSuccessor(exitOnTrue ? 0 : 1);
+
+  BasicBlock *preheader = nullptr;
+  for (BasicBlock *pred : predecessors(&loop)) {
+    if (pred == &loop)
+      continue;
+    if (preheader)
+      return false;
+    preheader = pred;
+  }
+  if (!preheader)
+    return false;
+
+  auto isInvariant = [&](Value *v) {
+    auto *inst = dyn_cast<Instruction>(v);
+    return !inst || inst->getParent() != &loop;
+  };
+
+  // It exits depending on a comparison of one loaded byte with an invariant
+  auto *cmp = dyn_cast<ICmpInst>(br->getCondition());
+  if (!cmp || cmp->getParent() != &loop || !cmp->isEquality())
+    return false;
+  auto *load = dyn_cast<LoadInst>(cmp->getOperand(0));
+  Value *needle = cmp->getOperand(1);
+  if (!load) {
+    load = dyn_cast<LoadInst>(cmp->getOperand(1));
+    needle = cmp->getOperand(0);
+  }
+  if (!load || load->getParent() != &loop || !load->isSimple() ||
+      !load->getType()->isIntegerTy(8) || load->getPointerAddressSpace() != 0 ||
+      !isInvariant(needle))
+    return false;
+  bool const exitOnMatch =
+      (cmp->getPredicate() == ICmpInst::ICMP_EQ) == exitOnTrue;
+
+  // All other values advance by one per iteration
+  const DataLayout &dataLayout = loop.getModule()->getDataLayout();
+  unsigned const indexWidth = dataLayout.getIndexTypeSizeInBits(
+      load->getPointerOperand()->getType());
+  std::map<Value *, AffineValue> affine;
+  std::vector<PHINode *> phis;
+  for (PHINode &phi : loop.phis()) {
+    if (phi.getNumIncomingValues() != 2)
+      return false;
+    Value *init = phi.getIncomingValueForBlock(preheader);
+    auto *next = dyn_cast<Instruction>(phi.getIncomingValueForBlock(&loop));
+    if (!next)
+      return false;
+
+    if (auto *gep = dyn_cast<GetElementPtrInst>(next)) {
+      auto *step = gep->getNumIndices() == 1
+                       ? dyn_cast<ConstantInt>(gep->getOperand(1))
+                       : nullptr;
+      if (gep->getPointerOperand() != &phi ||
+          !gep->getSourceElementType()->isIntegerTy(8) || !step ||
+          !step->isOne())
+        return false;
+    } else if (next->getOpcode() == Instruction::Add) {
+      auto *step = dyn_cast<ConstantInt>(next->getOperand(1));
+      if (next->getOperand(0) != &phi || !step || !step->isOne() ||
+          phi.getType()->getIntegerBitWidth() != indexWidth)
+        return false;
+    } else {
+      return false;
+    }
+    phis.push_back(&phi);
+    affine[&phi] = {init, nullptr, 0};
+    affine[next] = {init, nullptr, 1};
+  }
+
+  for (Instruction &inst : loop) {
+    if (isa<PHINode>(inst) || affine.count(&inst) || &inst == load ||
+        &inst == cmp || &inst == br || isa<DbgInfoIntrinsic>(inst))
+      continue;
+
+    // Addresses derived from the induction variables
+    auto *gep = dyn_cast<GetElementPtrInst>(&inst);
+    if (!gep || gep->getNumIndices() != 1 ||
+        !gep->getSourceElementType()->isIntegerTy(8))
+      return false;
+    Value *ptr = gep->getPointerOperand();
+    Value *index = gep->getOperand(1);
+    auto ptrIt = affine.find(ptr);
+    auto indexIt = affine.find(index);
+    if (ptrIt != affine.end() && !ptrIt->second.base &&
+        isa<ConstantInt>(index) && !cast<ConstantInt>(index)->isNegative()) {
+      affine[gep] = {ptrIt->second.init, nullptr,
+                     ptrIt->second.offset +
+                         cast<ConstantInt>(index)->getZExtValue()};
+    } else if (isInvariant(ptr) && indexIt != affine.end() &&
+               !indexIt->second.base &&
+               !indexIt->second.init->getType()->isPointerTy()) {
+      affine[gep] = {indexIt->second.init, ptr, indexIt->second.offset};
+    } else {
+      return false;
+    }
+  }
+
+  auto address = affine.find(load->getPointerOperand());
+  if (address == affine.end())
+    return false;
+
+  // Only advancing values can be used after the loop
+  std::vector<Instruction *> liveOut;
+  for (Instruction &inst : loop) {
+    bool const usedOutside = std::any_of(
+        inst.user_begin(), inst.user_end(), [&](const User *user) {
+          return cast<Instruction>(user)->getParent() != &loop;
+        });
+    if (!usedOutside)
+      continue;
+    if (!affine.count(&inst))
+      return false;
+    liveOut.push_back(&inst);
+  }
+
+  // Ask the executor for the number of iterations before entering the loop,
+  // which is executed as before if the search cannot be summarized.
+  LLVMContext &ctx = loop.getContext();
+  Type *sizeTy = dataLayout.getIntPtrType(ctx);
+  BasicBlock *search = BasicBlock::Create(ctx, loop.getName() + ".search",
+                                          loop.getParent(), &loop);
+  BasicBlock *summary = BasicBlock::Create(ctx, loop.getName() + ".summary",
+                                           loop.getParent(), &loop);
+  preheader->getTerminator()->replaceSuccessorWith(&loop, search);
+  for (PHINode *phi : phis)
+    phi->replaceIncomingBlockWith(preheader, search);
+
+  IRBuilder<> builder(search);
+  FunctionCallee searchFunction = loop.getModule()->getOrInsertFunction(
+      "klee_loop_search",
+      FunctionType::get(sizeTy,
+                        {PointerType::getUnqual(builder.getInt8Ty()),
+                         builder.getInt8Ty(), builder.getInt1Ty()},
+                        false));
+  Value *start =
+      materialize(builder, address->second, ConstantInt::get(sizeTy, 0));
+  Value *iterations = builder.CreateCall(
+      searchFunction, {start, needle, builder.getInt1(exitOnMatch)},
+      loop.getName() + ".iterations");
+  builder.CreateCondBr(
+      builder.CreateICmpNE(iterations, ConstantInt::getAllOnesValue(sizeTy)),
+      summary, &loop);
+
+  builder.SetInsertPoint(summary);
+  std::map<Value *, Value *> exitValues;
+  for (Instruction *inst : liveOut)
+    exitValues[inst] = materialize(builder, affine[inst], iterations);
+  builder.CreateBr(exit);
+
+  for (PHINode &phi : exit->phis()) {
+    Value *value = phi.getIncomingValueForBlock(&loop);
+    auto it = exitValues.find(value);
+    phi.addIncoming(it != exitValues.end() ? it->second : value, summary);
+  }
+
+  // Join the other uses with the summarized values
+  for (auto &[value, exitValue] : exitValues) {
+    SSAUpdater updater;
+    updater.Initialize(value->getType(), value->getName());
+    updater.AddAvailableValue(&loop, value);
+    updater.AddAvailableValue(summary, exitValue);
+    for (Use &use : make_early_inc_range(value->uses())) {
+      auto *user = cast<Instruction>(use.getUser());
+      if (user->getParent() == &loop || user->getParent() == summary)
+        continue;
+      if (auto *phi = dyn_cast<PHINode>(user);
+          phi && phi->getParent() == exit && phi->getIncomingBlock(use) == &loop)
+        continue;
+      updater.RewriteUse(use);
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,260 @@
+//===-- MergePoints.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Passes.h"
+
+#include "klee/Support/CompilerWarning.h"
+DISABLE_WARNING_PUSH
+DISABLE_WARNING_DEPRECATED_DECLARATIONS
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+DISABLE_WARNING_POP
+
+#include <functional>
+#include <map>
+#include <set>
+
+using namespace llvm;
+
+char klee::MergePointPass::ID = 0;
+
+bool klee::MergePointPass::runOnFunction(Function &f) {
+  if (f.isDeclaration())
+    return false;
+
+  DominatorTree dominators(f);
+  PostDominatorTree postDominators(f);
+  LoopInfo loops(dominators);
+
+  // Regions are chosen outermost first and must not overlap, so that the
+  // merges of a state are never nested
+  std::vector<Region> regions;
+  std::set<BasicBlock *> covered;
+  ReversePostOrderTraversal<Function *> blocks(&f);
+  for (BasicBlock *head : blocks) {
+    if (covered.count(head))
+      continue;
+
+    // A region either starts at a branch, or spans a loop from its
+    // preheader to the loop's exit
+    Instruction *terminator = head->getTerminator();
+    BasicBlock *start = head;
+    if (auto *br = dyn_cast<BranchInst>(terminator)) {
+      if (br->isUnconditional()) {
+        Loop *loop = loops.getLoopFor(br->getSuccessor(0));
+        if (!loop || loop->getLoopPreheader() != head)
+          continue;
+        start = br->getSuccessor(0);
+      } else if (isa<Constant>(br->getCondition())) {
+        continue;
+      }
+    } else if (auto *si = dyn_cast<SwitchInst>(terminator)) {
+      if (isa<Constant>(si->getCondition()))
+        continue;
+    } else {
+      continue;
+    }
+
+    DomTreeNode *node = postDominators.getNode(start);
+    BasicBlock *join =
+        node && node->getIDom() ? node->getIDom()->getBlock() : nullptr;
+    Region region;
+    if (!join || !findRegion(*head, *join, region) || !paysOff(region))
+      continue;
+    if (std::any_of(region.blocks.begin(), region.blocks.end(),
+                    [&](BasicBlock *bb) { return covered.count(bb); }))
+      continue;
+
+    covered.insert(head);
+    covered.insert(region.blocks.begin(), region.blocks.end());
+    regions.push_back(std::move(region));
+  }
+
+  for (Region &region : regions)
+    insertMergePoints(region);
+  return !regions.empty();
+}
+
+bool klee::MergePointPass::findRegion(BasicBlock &head, BasicBlock &join,
+                                      Region &region) const {
+  region.head = &head;
+  region.join = &join;
+
+  // Collect the blocks between the head and the join
+  std::set<BasicBlock *> blocks;
+  std::vector<BasicBlock *> worklist(succ_begin(&head), succ_end(&head));
+  unsigned size = 0;
+  while (!worklist.empty()) {
+    BasicBlock *bb = worklist.back();
+    worklist.pop_back();
+    if (bb == &join || !blocks.insert(bb).second)
+      continue;
+    // Reaching the head again would open the merge once per iteration
+    if (bb == &head || bb->isEHPad())
+      return false;
+
+    for (Instruction &inst : *bb) {
+      if (isa<DbgInfoIntrinsic>(inst))
+        continue;
+      if (++size > maxRegionSize)
+        return false;
+      // Objects allocated in only some of the states prevent the merge
+      if (isa<AllocaInst>(inst))
+        return false;
+      if (auto *call = dyn_cast<CallBase>(&inst)) {
+        Function *callee = call->getCalledFunction();
+        if (!isa<CallInst>(call) || !callee)
+          return false;
+        StringRef name = callee->getName();
+        if (!callee->isIntrinsic() && name != "klee_div_zero_check" &&
+            name != "klee_overshift_check")
+          return false;
+      }
+    }
+    worklist.insert(worklist.end(), succ_begin(bb), succ_end(bb));
+  }
+
+  // The region can only be entered through the head
+  for (BasicBlock *bb : blocks) {
+    for (BasicBlock *pred : predecessors(bb)) {
+      if (pred != &head && !blocks.count(pred))
+        return false;
+    }
+  }
+
+  region.blocks.assign(blocks.begin(), blocks.end());
+  return true;
+}
+
+bool klee::MergePointPass::paysOff(const Region &region) const {
+  // Without merging, each path through the region executes the code after
+  // the join again, including its solver queries and the query for the test
+  // case at the end of the path. Merging runs them only once, but queries on
+  // values that differ between the paths then reason about a select over
+  // the values of all paths, and are assumed to cost as much as the queries
+  // they replace. So merging pays off if the queries not depending on merged
+  // values saved on the additional paths outnumber the merged values. Loops
+  // count as arbitrarily many paths, and every branch on a non-constant
+  // condition as a query, as it is not known statically which are symbolic.
+  const uint64_t many = 1u << 16;
+  const uint64_t visiting = ~uint64_t(0);
+  std::set<BasicBlock *> blocks(region.blocks.begin(), region.blocks.end());
+  std::map<BasicBlock *, uint64_t> paths;
+  std::function<uint64_t(BasicBlock *)> countPaths = [&](BasicBlock *bb) {
+    if (bb == region.join || !blocks.count(bb))
+      return uint64_t(1);
+    auto it = paths.find(bb);
+    if (it != paths.end())
+      return it->second == visiting ? many : it->second;
+    paths[bb] = visiting;
+    uint64_t count = 0;
+    for (BasicBlock *succ : successors(bb))
+      count = std::min(count + countPaths(succ), many);
+    return paths[bb] = count;
+  };
+  uint64_t count = 0;
+  for (BasicBlock *succ : successors(region.head))
+    count = std::min(count + countPaths(succ), many);
+  if (count < 2)
+    return false;
+
+  // The values merged are the phis at the join and the memory stored to
+  std::vector<Value *> worklist;
+  for (PHINode &phi : region.join->phis())
+    worklist.push_back(&phi);
+  std::set<Value *> storedTo;
+  for (BasicBlock *bb : region.blocks) {
+    for (Instruction &inst : *bb) {
+      if (auto *store = dyn_cast<StoreInst>(&inst))
+        storedTo.insert(store->getPointerOperand());
+    }
+  }
+  const uint64_t mergedValues = worklist.size() + storedTo.size();
+
+  // Collect the code after the join, where any load may read merged memory
+  std::set<BasicBlock *> later;
+  std::vector<BasicBlock *> pending{region.join};
+  while (!pending.empty()) {
+    BasicBlock *bb = pending.back();
+    pending.pop_back();
+    if (!later.insert(bb).second)
+      continue;
+    pending.insert(pending.end(), succ_begin(bb), succ_end(bb));
+    if (!storedTo.empty()) {
+      for (Instruction &inst : *bb) {
+        if (isa<LoadInst>(inst))
+          worklist.push_back(&inst);
+      }
+    }
+  }
+
+  std::set<Value *> dependsOnMerge;
+  while (!worklist.empty()) {
+    Value *value = worklist.back();
+    worklist.pop_back();
+    if (!dependsOnMerge.insert(value).second)
+      continue;
+    for (User *user : value->users()) {
+      if (isa<Instruction>(user))
+        worklist.push_back(user);
+    }
+  }
+
+  uint64_t queries = 1, dependentQueries = 0;
+  for (BasicBlock *bb : later) {
+    Value *condition = nullptr;
+    if (auto *br = dyn_cast<BranchInst>(bb->getTerminator())) {
+      if (br->isConditional())
+        condition = br->getCondition();
+    } else if (auto *si = dyn_cast<SwitchInst>(bb->getTerminator())) {
+      condition = si->getCondition();
+    }
+    if (!condition || isa<Constant>(condition))
+      continue;
+    ++queries;
+    dependentQueries += dependsOnMerge.count(condition);
+  }
+
+  return (count - 1) * (queries - dependentQueries) >= mergedValues;
+}
+
+void klee::MergePointPass::insertMergePoints(Region &region) {
+  Module *module = region.head->getModule();
+  FunctionType *type =
+      FunctionType::get(Type::getVoidTy(module->getContext()), false);
+  FunctionCallee openMerge =
+      module->getOrInsertFunction("klee_open_merge", type);
+  FunctionCallee closeMerge =
+      module->getOrInsertFunction("klee_close_merge", type);
+
+  CallInst::Create(openMerge, "", region.head->getTerminator());
+
+  // Only states from the region may run into the close
+  std::set<BasicBlock *> blocks(region.blocks.begin(), region.blocks.end());
+  SetVector<BasicBlock *> preds;
+  bool enteredFromOutside = false;
+  for (BasicBlock *pred : predecessors(region.join)) {
+    if (pred == region.head || blocks.count(pred))
+      preds.insert(pred);
+    else
+      enteredFromOutside = true;
+  }
+  BasicBlock *join = region.join;
+  if (enteredFromOutside)
+    join = SplitBlockPredecessors(join, preds.getArrayRef(), ".merge");
+  CallInst::Create(closeMerge, "", &*join->getFirstInsertionPt());
+
+  ++mergeRegions;
+}
@@ -13,6 +13,12 @@
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/IR/Module.h"
 
+#include <string>
+
+namespace llvm {
+class MD5;
+} // namespace llvm
+
 namespace klee {
 enum class SwitchImplType {
   eSwitchTypeSimple,
@@ -20,8 +26,24 @@ enum class SwitchImplType {
   eSwitchTypeInternal
 };
 
-void optimiseAndPrepare(bool OptimiseKLEECall, bool Optimize,
-                        SwitchImplType SwitchType, std::string EntryPoint,
+/// The options of optimiseAndPrepare
+struct PrepareOptions {
+  bool OptimiseKLEECall = true;
+  bool Optimize = false;
+  /// Replace branches over arms of at most MaxSelectArmSize instructions
+  /// with selects
+  bool BranchToSelect = false;
+  unsigned MaxSelectArmSize = 0;
+  bool SummarizeLoops = false;
+  /// Insert merge points around regions of at most MaxMergeRegionSize
+  /// instructions
+  bool AutoMerge = false;
+  unsigned MaxMergeRegionSize = 0;
+  SwitchImplType SwitchType = SwitchImplType::eSwitchTypeInternal;
+  std::string EntryPoint;
+};
+
+void optimiseAndPrepare(const PrepareOptions &opts,
                         llvm::ArrayRef<const char *> preservedFunctions,
                         llvm::Module *module);
 void checkModule(bool DontVerfify, llvm::Module *module);
@@ -32,6 +54,11 @@ void injectStaticConstructorsAndDestructors(llvm::Module *m,
 
 void optimizeModule(llvm::Module *M,
                     llvm::ArrayRef<const char *> preservedFunctions);
+
+/// Adds the options affecting optimizeModule to \p hash
+void hashOptimizeOptions(llvm::MD5 &hash);
+/// Adds the aliases injected by the FunctionAliasPass to \p hash
+void hashFunctionAliases(llvm::MD5 &hash);
 } // namespace klee
 
 #endif // KLEE_MODULEHELPER_H
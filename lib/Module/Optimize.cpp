@@ -18,6 +18,7 @@
 
 #include "Passes.h"
 #include "klee/Config/Version.h"
+#include "klee/Support/ErrorHandling.h"
 #include "klee/Support/OptionCategories.h"
 
 #include "llvm/IR/DataLayout.h"
@@ -25,6 +26,7 @@
 #include "llvm/IR/Verifier.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/IPO/GlobalDCE.h"
 #include "llvm/Transforms/IPO/Internalize.h"
@@ -104,14 +106,14 @@ void keepPreservedFunctionsAlive(Module &M,
     appendToCompilerUsed(M, used);
 }
 
-void runFinalKleeCleanup(Module &M, SwitchImplType SwitchType) {
+void runFinalKleeCleanup(Module &M, const PrepareOptions &opts) {
   FunctionPassManager FPM;
   FPM.addPass(SimplifyCFGPass());
-  if (SwitchType == SwitchImplType::eSwitchTypeLLVM)
+  if (opts.SwitchType == SwitchImplType::eSwitchTypeLLVM)
     FPM.addPass(llvm::LowerSwitchPass());
   runFunctionPassManager(M, std::move(FPM));
 
-  if (SwitchType == SwitchImplType::eSwitchTypeSimple) {
+  if (opts.SwitchType == SwitchImplType::eSwitchTypeSimple) {
     klee::LowerSwitchPass P;
     for (auto &F : M) {
       if (!F.isDeclaration())
@@ -119,6 +121,34 @@ void runFinalKleeCleanup(Module &M, SwitchImplType SwitchType) {
     }
   }
 
+  if (opts.BranchToSelect) {
+    BranchToSelectPass SelectFormation(opts.MaxSelectArmSize);
+    for (auto &F : M) {
+      if (!F.isDeclaration())
+        SelectFormation.runOnFunction(F);
+    }
+    klee_message("Converted %u branches into selects",
+                 SelectFormation.getConvertedBranches());
+  }
+
+  if (opts.SummarizeLoops) {
+    LoopSummarizerPass LoopSummarizer;
+    for (auto &F : M) {
+      if (!F.isDeclaration())
+        LoopSummarizer.runOnFunction(F);
+    }
+  }
+
+  if (opts.AutoMerge) {
+    MergePointPass MergePoints(opts.MaxMergeRegionSize);
+    for (auto &F : M) {
+      if (!F.isDeclaration())
+        MergePoints.runOnFunction(F);
+    }
+    klee_message("Inserted merge points for %u regions",
+                 MergePoints.getMergeRegions());
+  }
+
   DataLayout targetData(&M);
   IntrinsicCleanerPass(targetData).runOnModule(M);
 
@@ -193,21 +223,27 @@ void klee::optimizeModule(llvm::Module *M,
   verifyModuleIfRequested(*M);
 }
 
-void klee::optimiseAndPrepare(bool OptimiseKLEECall, bool Optimize,
-                              SwitchImplType SwitchType, std::string EntryPoint,
+void klee::optimiseAndPrepare(const PrepareOptions &opts,
                               llvm::ArrayRef<const char *> preservedFunctions,
                               llvm::Module *module) {
   // Preserve all functions containing klee-related function calls from being
   // optimised around.
-  if (!OptimiseKLEECall)
+  if (!opts.OptimiseKLEECall)
     OptNonePass().runOnModule(*module);
 
-  if (Optimize)
+  if (opts.Optimize)
     optimizeModule(module, preservedFunctions);
 
   // Needs to happen after linking and optimization, since both can rewrite
   // global constructor/destructor lists.
-  injectStaticConstructorsAndDestructors(module, EntryPoint);
+  injectStaticConstructorsAndDestructors(module, opts.EntryPoint);
+
+  runFinalKleeCleanup(*module, opts);
+}
 
-  runFinalKleeCleanup(*module, SwitchType);
+void klee::hashOptimizeOptions(llvm::MD5 &hash) {
+  for (bool option : {DisableInline.getValue(), DisableInternalize.getValue(),
+                      VerifyEach.getValue(), Strip.getValue(),
+                      StripDebug.getValue()})
+    hash.update(static_cast<uint8_t>(option));
 }
@@ -29,6 +29,7 @@ DISABLE_WARNING_DEPRECATED_DECLARATIONS
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Transforms/IPO.h"
 #include "llvm/Transforms/IPO/FunctionAttrs.h"
@@ -240,3 +241,10 @@ void klee::optimizeModule(llvm::Module *M,
   // Run our queue of passes all at once now, efficiently.
   Passes.run(*M);
 }
+
+void klee::hashOptimizeOptions(llvm::MD5 &hash) {
+  for (bool option : {DisableInline.getValue(), DisableInternalize.getValue(),
+                      VerifyEach.getValue(), Strip.getValue(),
+                      StripDebug.getValue()})
+    hash.update(static_cast<uint8_t>(option));
+}
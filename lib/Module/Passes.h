@@ -159,6 +159,78 @@ private:
                      llvm::BasicBlock *defaultBlock);
 };
 
+/// LoopSummarizerPass - Guards single-block loops that search a byte array
+/// for a (mismatching) byte with a call to klee_loop_search, which lets the
+/// executor compute the number of iterations directly. The original loop is
+/// kept and executed whenever the search cannot be summarized.
+class LoopSummarizerPass : public llvm::FunctionPass {
+public:
+  static char ID;
+  LoopSummarizerPass() : llvm::FunctionPass(ID) {}
+
+  bool runOnFunction(llvm::Function &F) override;
+
+private:
+  bool summarizeSearchLoop(llvm::BasicBlock &loop);
+};
+
+/// BranchToSelectPass - Replaces branches over small side-effect free blocks
+/// (diamonds and triangles) with selects, so that a symbolic condition is
+/// carried in the value instead of forking the state.
+class BranchToSelectPass : public llvm::FunctionPass {
+public:
+  static char ID;
+  explicit BranchToSelectPass(unsigned maxArmSize)
+      : llvm::FunctionPass(ID), maxArmSize(maxArmSize) {}
+
+  bool runOnFunction(llvm::Function &F) override;
+
+  /// Number of branches replaced so far
+  unsigned getConvertedBranches() const { return convertedBranches; }
+
+private:
+  unsigned maxArmSize;
+  unsigned convertedBranches = 0;
+
+  bool canSpeculate(llvm::BasicBlock &arm, llvm::BasicBlock &head) const;
+  bool convertBranch(llvm::BasicBlock &head);
+};
+
+/// MergePointPass - Brackets the single-entry regions between a branch and
+/// its immediate post-dominator with klee_open_merge and klee_close_merge
+/// calls, so that the states forked in a region are merged at its end
+/// without annotating the program. Whether a branch is symbolic is only known
+/// at run time, so every branch on a non-constant condition is considered;
+/// regions whose branch turns out to be concrete merge a single state.
+class MergePointPass : public llvm::FunctionPass {
+public:
+  static char ID;
+  explicit MergePointPass(unsigned maxRegionSize)
+      : llvm::FunctionPass(ID), maxRegionSize(maxRegionSize) {}
+
+  bool runOnFunction(llvm::Function &F) override;
+
+  /// Number of regions bracketed so far
+  unsigned getMergeRegions() const { return mergeRegions; }
+
+private:
+  struct Region {
+    llvm::BasicBlock *head;
+    std::vector<llvm::BasicBlock *> blocks;
+    llvm::BasicBlock *join;
+  };
+
+  unsigned maxRegionSize;
+  unsigned mergeRegions = 0;
+
+  bool findRegion(llvm::BasicBlock &head, llvm::BasicBlock &join,
+                  Region &region) const;
+  /// Estimates whether merging the states of \p region saves solver
+  /// queries.
+  bool paysOff(const Region &region) const;
+  void insertMergePoints(Region &region);
+};
+
 /// InstructionOperandTypeCheckPass - Type checks the types of instruction
 /// operands to check that they conform to invariants expected by the Executor.
 ///
@@ -0,0 +1,135 @@
+//===-- ArrayEliminatingSolver.cpp ----------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver/Solver.h"
+
+#include "klee/Expr/ArrayEliminator.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/SolverImpl.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+class ArrayEliminatingSolver : public SolverImpl {
+private:
+  std::unique_ptr<Solver> solver;
+  ArrayEliminator eliminator;
+
+  /// Rewrites all constraints of \p query into \p constraints and returns
+  /// the rewritten query expression.
+  ref<Expr> eliminate(const Query &query, ConstraintSet &constraints);
+
+public:
+  ArrayEliminatingSolver(std::unique_ptr<Solver> solver, unsigned maxUpdates,
+                         unsigned maxExpansion)
+      : solver(std::move(solver)), eliminator(maxUpdates, maxExpansion) {}
+
+  bool computeValidity(const Query &, Solver::Validity &result) override;
+  bool computeTruth(const Query &, bool &isValid) override;
+  bool computeValue(const Query &, ref<Expr> &result) override;
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char>> &values,
+                            bool &hasSolution) override;
+  SolverRunStatus getOperationStatusCode() override;
+  std::string getConstraintLog(const Query &) override;
+  void setCoreSolverTimeout(time::Span timeout) override;
+};
+
+ref<Expr> ArrayEliminatingSolver::eliminate(const Query &query,
+                                            ConstraintSet &constraints) {
+  for (const auto &constraint : query.constraints) {
+    ref<Expr> e = eliminator.eliminate(constraint);
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e))
+      if (CE->isTrue())
+        continue;
+    constraints.push_back(e);
+  }
+  return eliminator.eliminate(query.expr);
+}
+
+bool ArrayEliminatingSolver::computeValidity(const Query &query,
+                                             Solver::Validity &result) {
+  ConstraintSet constraints;
+  ref<Expr> expr = eliminate(query, constraints);
+
+  // Solvers expect a non-constant query expression
+  if (isa<ConstantExpr>(expr))
+    return solver->impl->computeValidity(query, result);
+
+  return solver->impl->computeValidity(Query(constraints, expr), result);
+}
+
+bool ArrayEliminatingSolver::computeTruth(const Query &query, bool &isValid) {
+  ConstraintSet constraints;
+  ref<Expr> expr = eliminate(query, constraints);
+
+  if (isa<ConstantExpr>(expr))
+    return solver->impl->computeTruth(query, isValid);
+
+  return solver->impl->computeTruth(Query(constraints, expr), isValid);
+}
+
+bool ArrayEliminatingSolver::computeValue(const Query &query,
+                                          ref<Expr> &result) {
+  ConstraintSet constraints;
+  ref<Expr> expr = eliminate(query, constraints);
+
+  // A constant is the only feasible value of itself
+  if (isa<ConstantExpr>(expr)) {
+    result = expr;
+    return true;
+  }
+
+  return solver->impl->computeValue(Query(constraints, expr), result);
+}
+
+bool ArrayEliminatingSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char>> &values, bool &hasSolution) {
+  ConstraintSet constraints;
+  ref<Expr> expr = eliminate(query, constraints);
+
+  // Solvers below assume a constant query expression to be false
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(expr))
+    if (!CE->isFalse())
+      return solver->impl->computeInitialValues(query, objects, values,
+                                                hasSolution);
+
+  // Arrays are not renamed, so the objects can be passed on unchanged
+  return solver->impl->computeInitialValues(Query(constraints, expr), objects,
+                                            values, hasSolution);
+}
+
+SolverImpl::SolverRunStatus ArrayEliminatingSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+std::string ArrayEliminatingSolver::getConstraintLog(const Query &query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void ArrayEliminatingSolver::setCoreSolverTimeout(time::Span timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+} // namespace
+
+std::unique_ptr<Solver>
+klee::createArrayEliminatingSolver(std::unique_ptr<Solver> s,
+                                   unsigned maxUpdates, unsigned maxExpansion) {
+  return std::make_unique<Solver>(std::make_unique<ArrayEliminatingSolver>(
+      std::move(s), maxUpdates, maxExpansion));
+}
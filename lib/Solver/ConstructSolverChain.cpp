@@ -46,6 +46,11 @@ std::unique_ptr<Solver> constructSolverChain(
                  baseSolverQuerySMT2LogPath.c_str());
   }
 
+  if (EliminateArrays)
+    solver = createArrayEliminatingSolver(std::move(solver),
+                                          ArrayEliminationMaxUpdates,
+                                          ArrayEliminationMaxSize);
+
   if (UseAssignmentValidatingSolver)
     solver = createAssignmentValidatingSolver(std::move(solver));
 
@@ -58,6 +63,9 @@ std::unique_ptr<Solver> constructSolverChain(
   if (UseBranchCache)
     solver = createCachingSolver(std::move(solver));
 
+  if (UseQueryNormalization)
+    solver = createNormalizingSolver(std::move(solver));
+
   if (UseIndependentSolver)
     solver = createIndependentSolver(std::move(solver));
 
@@ -0,0 +1,444 @@
+//===-- NormalizingSolver.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver/Solver.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprBuilder.h"
+#include "klee/Expr/ExprHashMap.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+
+#include "llvm/ADT/StringExtras.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// Rewrites a query into a canonical form so that the caches below it see
+/// queries that differ only in array names, constraint order or trivially
+/// equivalent expression forms as the same query.
+///
+/// Normalization consists of three steps:
+///  - every expression is rebuilt through a simplifying, constant folding
+///    ExprBuilder and commutative operands are put into a fixed order,
+///  - symbolic arrays are alpha-renamed to canonical arrays numbered in
+///    order of first appearance, constant arrays are replaced by a
+///    canonical array per distinct content,
+///  - constraints are sorted and duplicates are removed.
+class QueryNormalizer {
+  std::unique_ptr<ExprBuilder> builder;
+
+  /// Owns all canonical arrays; they have to outlive every query that
+  /// reached the underlying solver as those may hold on to them.
+  ArrayCache canonicalArrays;
+
+  /// Canonical constant arrays, keyed by their shape and contents.
+  std::map<std::vector<uint64_t>, const Array *> constantArrays;
+
+  // Per-query state
+  std::map<const Array *, const Array *> renaming;
+  ExprHashMap<ref<Expr>> normalized;
+  std::unordered_map<const UpdateNode *, ref<UpdateNode>> normalizedUpdates;
+  ExprHashMap<unsigned> shapeHashes;
+  unsigned nextArrayId = 0;
+
+  const Array *canonicalConstantArray(const Array *array);
+  ref<UpdateNode> normalizeUpdates(const UpdateNode *head);
+  ref<Expr> normalizeCommutative(Expr::Kind kind, ref<Expr> lhs,
+                                 ref<Expr> rhs);
+  unsigned shapeHash(const ref<Expr> &e);
+
+public:
+  QueryNormalizer()
+      : builder(createSimplifyingExprBuilder(
+            createConstantFoldingExprBuilder(createDefaultExprBuilder()))) {}
+
+  /// Drop all per-query state; canonical arrays are kept.
+  void reset();
+
+  /// Return the canonical array \p array is renamed to in the current query.
+  const Array *rename(const Array *array);
+
+  ref<Expr> normalize(const ref<Expr> &e);
+
+  /// Normalize the constraints of \p query and store them sorted in
+  /// \p constraints. The query expression is normalized first so that it
+  /// determines the numbering of the arrays it mentions.
+  ref<Expr> normalize(const Query &query, ConstraintSet &constraints);
+};
+
+void QueryNormalizer::reset() {
+  renaming.clear();
+  normalized.clear();
+  normalizedUpdates.clear();
+  shapeHashes.clear();
+  nextArrayId = 0;
+}
+
+const Array *QueryNormalizer::canonicalConstantArray(const Array *array) {
+  // Only arrays whose values fit into the key can be shared
+  if (array->getRange() > Expr::Int64)
+    return array;
+
+  std::vector<uint64_t> key;
+  key.reserve(array->constantValues.size() + 2);
+  key.push_back(array->getDomain());
+  key.push_back(array->getRange());
+  for (const auto &value : array->constantValues)
+    key.push_back(value->getZExtValue());
+
+  auto it = constantArrays.find(key);
+  if (it != constantArrays.end())
+    return it->second;
+
+  const Array *canonical = canonicalArrays.CreateArray(
+      "norm_const" + llvm::utostr(constantArrays.size()), array->size,
+      &array->constantValues[0],
+      &array->constantValues[0] + array->constantValues.size(),
+      array->getDomain(), array->getRange());
+  constantArrays.emplace(std::move(key), canonical);
+  return canonical;
+}
+
+const Array *QueryNormalizer::rename(const Array *array) {
+  auto it = renaming.find(array);
+  if (it != renaming.end())
+    return it->second;
+
+  const Array *canonical;
+  if (array->isConstantArray()) {
+    canonical = canonicalConstantArray(array);
+  } else {
+    // The symbolic array cache only distinguishes names and sizes, so
+    // encode non-default widths in the name.
+    std::string name = "norm" + llvm::utostr(nextArrayId++);
+    if (array->getDomain() != Expr::Int32 || array->getRange() != Expr::Int8)
+      name += "_" + llvm::utostr(array->getDomain()) + "_" +
+              llvm::utostr(array->getRange());
+    canonical = canonicalArrays.CreateArray(name, array->size, nullptr,
+                                            nullptr, array->getDomain(),
+                                            array->getRange());
+  }
+  renaming.emplace(array, canonical);
+  return canonical;
+}
+
+ref<UpdateNode> QueryNormalizer::normalizeUpdates(const UpdateNode *head) {
+  // Collect the suffix of the update list that has not been normalized yet
+  std::vector<const UpdateNode *> pending;
+  ref<UpdateNode> result;
+  for (const UpdateNode *un = head; un; un = un->next.get()) {
+    auto it = normalizedUpdates.find(un);
+    if (it != normalizedUpdates.end()) {
+      result = it->second;
+      break;
+    }
+    pending.push_back(un);
+  }
+
+  // Rebuild it from the oldest to the newest update
+  for (auto it = pending.rbegin(), ie = pending.rend(); it != ie; ++it) {
+    ref<Expr> index = normalize((*it)->index);
+    ref<Expr> value = normalize((*it)->value);
+    result = new UpdateNode(result, index, value);
+    normalizedUpdates.emplace(*it, result);
+  }
+  return result;
+}
+
+ref<Expr> QueryNormalizer::normalizeCommutative(Expr::Kind kind,
+                                                ref<Expr> lhs, ref<Expr> rhs) {
+  // Constants go to the left (see Expr canonicalization rules), otherwise
+  // order the operands by their structural order.
+  if (isa<ConstantExpr>(rhs) ||
+      (!isa<ConstantExpr>(lhs) && rhs.compare(lhs) < 0))
+    std::swap(lhs, rhs);
+
+  switch (kind) {
+  case Expr::Add: return builder->Add(lhs, rhs);
+  case Expr::Mul: return builder->Mul(lhs, rhs);
+  case Expr::And: return builder->And(lhs, rhs);
+  case Expr::Or: return builder->Or(lhs, rhs);
+  case Expr::Xor: return builder->Xor(lhs, rhs);
+  case Expr::Eq: return builder->Eq(lhs, rhs);
+  default:
+    assert(0 && "not a commutative expression");
+    return nullptr;
+  }
+}
+
+ref<Expr> QueryNormalizer::normalize(const ref<Expr> &e) {
+  if (isa<ConstantExpr>(e))
+    return e;
+
+  auto it = normalized.find(e);
+  if (it != normalized.end())
+    return it->second;
+
+  ref<Expr> result;
+  switch (e->getKind()) {
+  case Expr::NotOptimized:
+    result = builder->NotOptimized(normalize(e->getKid(0)));
+    break;
+
+  case Expr::Read: {
+    const ReadExpr *re = cast<ReadExpr>(e);
+    UpdateList updates(rename(re->updates.root),
+                       normalizeUpdates(re->updates.head.get()));
+    result = builder->Read(updates, normalize(re->index));
+    break;
+  }
+
+  case Expr::Select:
+    result = builder->Select(normalize(e->getKid(0)), normalize(e->getKid(1)),
+                             normalize(e->getKid(2)));
+    break;
+
+  case Expr::Concat:
+    result = builder->Concat(normalize(e->getKid(0)), normalize(e->getKid(1)));
+    break;
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    result = builder->Extract(normalize(ee->expr), ee->offset, ee->width);
+    break;
+  }
+
+  case Expr::ZExt:
+    result = builder->ZExt(normalize(e->getKid(0)), e->getWidth());
+    break;
+
+  case Expr::SExt:
+    result = builder->SExt(normalize(e->getKid(0)), e->getWidth());
+    break;
+
+  case Expr::Not:
+    result = builder->Not(normalize(e->getKid(0)));
+    break;
+
+  case Expr::Add:
+  case Expr::Mul:
+  case Expr::And:
+  case Expr::Or:
+  case Expr::Xor:
+  case Expr::Eq:
+    result = normalizeCommutative(e->getKind(), normalize(e->getKid(0)),
+                                  normalize(e->getKid(1)));
+    break;
+
+  default: {
+    assert(e->getNumKids() == 2 && "unexpected expression kind");
+    ref<Expr> lhs = normalize(e->getKid(0));
+    ref<Expr> rhs = normalize(e->getKid(1));
+    switch (e->getKind()) {
+    case Expr::Sub: result = builder->Sub(lhs, rhs); break;
+    case Expr::UDiv: result = builder->UDiv(lhs, rhs); break;
+    case Expr::SDiv: result = builder->SDiv(lhs, rhs); break;
+    case Expr::URem: result = builder->URem(lhs, rhs); break;
+    case Expr::SRem: result = builder->SRem(lhs, rhs); break;
+    case Expr::Shl: result = builder->Shl(lhs, rhs); break;
+    case Expr::LShr: result = builder->LShr(lhs, rhs); break;
+    case Expr::AShr: result = builder->AShr(lhs, rhs); break;
+    case Expr::Ne: result = builder->Ne(lhs, rhs); break;
+    case Expr::Ult: result = builder->Ult(lhs, rhs); break;
+    case Expr::Ule: result = builder->Ule(lhs, rhs); break;
+    case Expr::Ugt: result = builder->Ugt(lhs, rhs); break;
+    case Expr::Uge: result = builder->Uge(lhs, rhs); break;
+    case Expr::Slt: result = builder->Slt(lhs, rhs); break;
+    case Expr::Sle: result = builder->Sle(lhs, rhs); break;
+    case Expr::Sgt: result = builder->Sgt(lhs, rhs); break;
+    case Expr::Sge: result = builder->Sge(lhs, rhs); break;
+    default:
+      assert(0 && "invalid expression kind");
+    }
+  }
+  }
+
+  normalized.emplace(e, result);
+  return result;
+}
+
+/// Structural hash that ignores array names. Used to put the constraints
+/// into an order independent of the original numbering of the arrays
+/// before the canonical names are handed out.
+unsigned QueryNormalizer::shapeHash(const ref<Expr> &e) {
+  if (isa<ConstantExpr>(e))
+    return e->hash();
+
+  auto it = shapeHashes.find(e);
+  if (it != shapeHashes.end())
+    return it->second;
+
+  unsigned res = e->getKind() * Expr::MAGIC_HASH_CONSTANT + e->getWidth();
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+    res = res * Expr::MAGIC_HASH_CONSTANT + re->updates.root->size;
+    res = res * Expr::MAGIC_HASH_CONSTANT + re->updates.getSize();
+  } else if (const ExtractExpr *ee = dyn_cast<ExtractExpr>(e)) {
+    res = res * Expr::MAGIC_HASH_CONSTANT + ee->offset;
+  }
+  for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+    res = res * Expr::MAGIC_HASH_CONSTANT + shapeHash(e->getKid(i));
+
+  shapeHashes.emplace(e, res);
+  return res;
+}
+
+ref<Expr> QueryNormalizer::normalize(const Query &query,
+                                     ConstraintSet &constraints) {
+  ref<Expr> expr = normalize(query.expr);
+
+  std::vector<ref<Expr>> original(query.constraints.begin(),
+                                  query.constraints.end());
+  std::stable_sort(original.begin(), original.end(),
+                   [this](const ref<Expr> &a, const ref<Expr> &b) {
+                     return shapeHash(a) < shapeHash(b);
+                   });
+
+  std::vector<ref<Expr>> result;
+  result.reserve(original.size());
+  for (const auto &constraint : original) {
+    ref<Expr> c = normalize(constraint);
+    if (ConstantExpr *ce = dyn_cast<ConstantExpr>(c))
+      if (ce->isTrue())
+        continue;
+    result.push_back(c);
+  }
+
+  std::sort(result.begin(), result.end(),
+            [](const ref<Expr> &a, const ref<Expr> &b) {
+              return a.compare(b) < 0;
+            });
+  result.erase(std::unique(result.begin(), result.end(),
+                           [](const ref<Expr> &a, const ref<Expr> &b) {
+                             return a.compare(b) == 0;
+                           }),
+               result.end());
+
+  constraints = ConstraintSet(std::move(result));
+  return expr;
+}
+
+class NormalizingSolver : public SolverImpl {
+private:
+  std::unique_ptr<Solver> solver;
+  QueryNormalizer normalizer;
+
+public:
+  NormalizingSolver(std::unique_ptr<Solver> solver)
+      : solver(std::move(solver)) {}
+
+  bool computeValidity(const Query &, Solver::Validity &result) override;
+  bool computeTruth(const Query &, bool &isValid) override;
+  bool computeValue(const Query &, ref<Expr> &result) override;
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char>> &values,
+                            bool &hasSolution) override;
+  SolverRunStatus getOperationStatusCode() override;
+  std::string getConstraintLog(const Query &) override;
+  void setCoreSolverTimeout(time::Span timeout) override;
+};
+
+bool NormalizingSolver::computeValidity(const Query &query,
+                                        Solver::Validity &result) {
+  normalizer.reset();
+  ConstraintSet constraints;
+  ref<Expr> expr = normalizer.normalize(query, constraints);
+
+  // Solvers expect a non-constant query expression
+  if (isa<ConstantExpr>(expr))
+    return solver->impl->computeValidity(query, result);
+
+  ++stats::queryNormalizations;
+  return solver->impl->computeValidity(Query(constraints, expr), result);
+}
+
+bool NormalizingSolver::computeTruth(const Query &query, bool &isValid) {
+  normalizer.reset();
+  ConstraintSet constraints;
+  ref<Expr> expr = normalizer.normalize(query, constraints);
+
+  if (isa<ConstantExpr>(expr))
+    return solver->impl->computeTruth(query, isValid);
+
+  ++stats::queryNormalizations;
+  return solver->impl->computeTruth(Query(constraints, expr), isValid);
+}
+
+bool NormalizingSolver::computeValue(const Query &query, ref<Expr> &result) {
+  normalizer.reset();
+  ConstraintSet constraints;
+  ref<Expr> expr = normalizer.normalize(query, constraints);
+
+  // A constant is the only feasible value of itself
+  if (isa<ConstantExpr>(expr)) {
+    result = expr;
+    return true;
+  }
+
+  ++stats::queryNormalizations;
+  return solver->impl->computeValue(Query(constraints, expr), result);
+}
+
+bool NormalizingSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char>> &values, bool &hasSolution) {
+  normalizer.reset();
+  ConstraintSet constraints;
+  ref<Expr> expr = normalizer.normalize(query, constraints);
+
+  // Solvers below assume a constant query expression to be false
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(expr))
+    if (!CE->isFalse())
+      return solver->impl->computeInitialValues(query, objects, values,
+                                                hasSolution);
+
+  // Objects not mentioned by the query get the next free canonical names.
+  // Values are returned positionally, so they map back to the original
+  // objects without further work.
+  std::vector<const Array *> canonicalObjects;
+  canonicalObjects.reserve(objects.size());
+  for (const Array *array : objects)
+    canonicalObjects.push_back(normalizer.rename(array));
+
+  ++stats::queryNormalizations;
+  return solver->impl->computeInitialValues(Query(constraints, expr),
+                                            canonicalObjects, values,
+                                            hasSolution);
+}
+
+SolverImpl::SolverRunStatus NormalizingSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+std::string NormalizingSolver::getConstraintLog(const Query &query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void NormalizingSolver::setCoreSolverTimeout(time::Span timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+} // namespace
+
+std::unique_ptr<Solver>
+klee::createNormalizingSolver(std::unique_ptr<Solver> s) {
+  return std::make_unique<Solver>(
+      std::make_unique<NormalizingSolver>(std::move(s)));
+}
@@ -56,6 +56,31 @@ cl::opt<bool>
                          cl::desc("Use constraint independence (default=true)"),
                          cl::cat(SolvingCat));
 
+cl::opt<bool> UseQueryNormalization(
+    "use-query-normalization", cl::init(false),
+    cl::desc("Rewrite queries into a canonical form (renamed arrays, sorted "
+             "constraints) before they reach the caches (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> EliminateArrays(
+    "eliminate-arrays", cl::init(false),
+    cl::desc("Replace array reads over concrete updates and with small bounded "
+             "indices by if-then-else expressions before queries reach the "
+             "core solver (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> ArrayEliminationMaxUpdates(
+    "array-elimination-max-updates", cl::init(128),
+    cl::desc("Maximum number of concrete updates of a read to turn into an "
+             "if-then-else expression (default=128)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> ArrayEliminationMaxSize(
+    "array-elimination-max-size", cl::init(64),
+    cl::desc("Maximum number of array elements a read with a bounded index "
+             "is expanded into (default=64)"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool> DebugValidateSolver(
     "debug-validate-solver", cl::init(false),
     cl::desc("Crosscheck the results of the solver chain above the core solver "
@@ -0,0 +1,392 @@
+//===-- StatsLog.cpp ------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+#include "klee/Support/StatsLog.h"
+
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+using namespace klee;
+
+namespace {
+const char magic[] = "KSTATLOG";
+const std::size_t magicSize = sizeof(magic) - 1;
+const std::uint64_t version = 1;
+
+void writeString(llvm::raw_ostream &os, const std::string &s) {
+  llvm::encodeULEB128(s.size(), os);
+  os << s;
+}
+
+/// Decodes the payload of a record
+class Decoder {
+  const std::uint8_t *p;
+  const std::uint8_t *end;
+  bool failed = false;
+
+public:
+  explicit Decoder(const std::string &payload)
+      : p(reinterpret_cast<const std::uint8_t *>(payload.data())),
+        end(p + payload.size()) {}
+
+  std::uint64_t readULEB() {
+    unsigned n = 0;
+    const char *error = nullptr;
+    std::uint64_t value = llvm::decodeULEB128(p, &n, end, &error);
+    if (error) {
+      failed = true;
+      p = end;
+      return 0;
+    }
+    p += n;
+    return value;
+  }
+
+  std::int64_t readSLEB() {
+    unsigned n = 0;
+    const char *error = nullptr;
+    std::int64_t value = llvm::decodeSLEB128(p, &n, end, &error);
+    if (error) {
+      failed = true;
+      p = end;
+      return 0;
+    }
+    p += n;
+    return value;
+  }
+
+  std::string readString() {
+    std::uint64_t size = readULEB();
+    if (size > static_cast<std::uint64_t>(end - p)) {
+      failed = true;
+      p = end;
+      return {};
+    }
+    std::string s(reinterpret_cast<const char *>(p), size);
+    p += size;
+    return s;
+  }
+
+  /// Returns true if the whole payload was decoded
+  bool done() const { return !failed && p == end; }
+};
+
+/// Reads an unsigned LEB128 number from a stream, returns false at its end
+bool readULEB(std::istream &is, std::uint64_t &value) {
+  value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    int c = is.get();
+    if (c == EOF)
+      return false;
+    value |= static_cast<std::uint64_t>(c & 0x7f) << shift;
+    if (!(c & 0x80))
+      return true;
+  }
+  return false;
+}
+} // namespace
+
+StatsLogWriter::StatsLogWriter(std::unique_ptr<llvm::raw_fd_ostream> os)
+    : os(std::move(os)) {
+  // The start time identifies the run, so that readers notice when a log is
+  // replaced by a new run
+  auto const runId = std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+  *this->os << magic;
+  llvm::encodeULEB128(version, *this->os);
+  llvm::encodeULEB128(runId, *this->os);
+}
+
+StatsLogWriter::~StatsLogWriter() = default;
+
+void StatsLogWriter::writeRecord(StatsLogRecord kind,
+                                 const std::string &payload) {
+  *os << static_cast<char>(kind);
+  llvm::encodeULEB128(payload.size(), *os);
+  *os << payload;
+}
+
+void StatsLogWriter::writeColumn(const std::string &name, bool real) {
+  std::string payload;
+  llvm::raw_string_ostream ps(payload);
+  writeString(ps, name);
+  ps << static_cast<char>(real);
+  writeRecord(StatsLogRecord::Column, ps.str());
+  lastRow.push_back(0);
+}
+
+void StatsLogWriter::writeRow(const std::vector<std::int64_t> &values) {
+  std::string changes;
+  llvm::raw_string_ostream cs(changes);
+  unsigned numChanges = 0;
+  for (std::size_t i = 0; i != values.size() && i != lastRow.size(); ++i) {
+    if (values[i] == lastRow[i])
+      continue;
+    llvm::encodeULEB128(i, cs);
+    llvm::encodeSLEB128(values[i] - lastRow[i], cs);
+    lastRow[i] = values[i];
+    ++numChanges;
+  }
+
+  std::string payload;
+  llvm::raw_string_ostream ps(payload);
+  llvm::encodeULEB128(numChanges, ps);
+  ps << cs.str();
+  writeRecord(StatsLogRecord::Row, ps.str());
+  os->flush();
+}
+
+void StatsLogWriter::writeInfo(const std::string &key,
+                               const std::string &value) {
+  std::string payload;
+  llvm::raw_string_ostream ps(payload);
+  writeString(ps, key);
+  writeString(ps, value);
+  writeRecord(StatsLogRecord::Info, ps.str());
+}
+
+void StatsLogWriter::writeEvent(const std::string &shortName,
+                                const std::string &name) {
+  std::string payload;
+  llvm::raw_string_ostream ps(payload);
+  writeString(ps, shortName);
+  writeString(ps, name);
+  writeRecord(StatsLogRecord::Event, ps.str());
+  ++numEvents;
+}
+
+unsigned StatsLogWriter::getFile(const std::string &path) {
+  auto [it, inserted] = files.emplace(path, files.size());
+  if (inserted) {
+    std::string payload;
+    llvm::raw_string_ostream ps(payload);
+    writeString(ps, path);
+    writeRecord(StatsLogRecord::File, ps.str());
+  }
+  return it->second;
+}
+
+unsigned StatsLogWriter::writeFunction(const std::string &name,
+                                       unsigned file) {
+  std::string payload;
+  llvm::raw_string_ostream ps(payload);
+  writeString(ps, name);
+  llvm::encodeULEB128(file, ps);
+  writeRecord(StatsLogRecord::Function, ps.str());
+  return numFunctions++;
+}
+
+void StatsLogWriter::writeInstruction(unsigned id, unsigned function,
+                                      unsigned file, unsigned line,
+                                      unsigned assemblyLine) {
+  std::string payload;
+  llvm::raw_string_ostream ps(payload);
+  for (unsigned value : {id, function, file, line, assemblyLine})
+    llvm::encodeULEB128(value, ps);
+  writeRecord(StatsLogRecord::Instruction, ps.str());
+}
+
+void StatsLogWriter::writeInstructionStats(
+    std::uint64_t wallTime, const std::vector<std::uint64_t> &values) {
+  if (lastInstructionStats.size() < values.size())
+    lastInstructionStats.resize(values.size());
+
+  std::string changes;
+  llvm::raw_string_ostream cs(changes);
+  std::uint64_t numChanges = 0;
+  for (std::size_t i = 0; numEvents && i != values.size(); ++i) {
+    if (values[i] == lastInstructionStats[i])
+      continue;
+    llvm::encodeULEB128(i / numEvents, cs);
+    llvm::encodeULEB128(i % numEvents, cs);
+    llvm::encodeSLEB128(
+        static_cast<std::int64_t>(values[i] - lastInstructionStats[i]), cs);
+    lastInstructionStats[i] = values[i];
+    ++numChanges;
+  }
+
+  std::string payload;
+  llvm::raw_string_ostream ps(payload);
+  llvm::encodeULEB128(wallTime, ps);
+  llvm::encodeULEB128(numChanges, ps);
+  ps << cs.str();
+  writeRecord(StatsLogRecord::InstructionStats, ps.str());
+  os->flush();
+}
+
+bool StatsLogReader::open(const std::string &path, std::string &error) {
+  is.open(path, std::ios::binary);
+  if (!is) {
+    error = "cannot open " + path + ": " + std::strerror(errno);
+    return false;
+  }
+
+  char header[magicSize];
+  std::uint64_t fileVersion;
+  if (!is.read(header, magicSize) || std::memcmp(header, magic, magicSize) ||
+      !readULEB(is, fileVersion) || !readULEB(is, runId)) {
+    error = path + " is not a stats log";
+    return false;
+  }
+  if (fileVersion != version) {
+    error = path + " has the unsupported version " +
+            std::to_string(fileVersion);
+    return false;
+  }
+  offset = is.tellg();
+  return true;
+}
+
+std::optional<StatsLogRecord> StatsLogReader::next(std::string &error) {
+  // The log may have grown since the end was reached
+  is.clear();
+  is.seekg(offset);
+
+  int kind = is.get();
+  std::uint64_t size;
+  if (kind == EOF || !readULEB(is, size))
+    return std::nullopt;
+  std::string payload(size, '\0');
+  if (!is.read(payload.data(), size))
+    return std::nullopt;
+
+  if (!apply(static_cast<StatsLogRecord>(kind), payload, error))
+    return std::nullopt;
+  offset = is.tellg();
+  return static_cast<StatsLogRecord>(kind);
+}
+
+bool StatsLogReader::apply(StatsLogRecord kind, const std::string &payload,
+                           std::string &error) {
+  Decoder d(payload);
+  switch (kind) {
+  case StatsLogRecord::Column: {
+    Column column;
+    column.name = d.readString();
+    std::uint64_t real = d.readULEB();
+    column.real = real;
+    if (!d.done())
+      break;
+    columns.push_back(std::move(column));
+    row.push_back(0);
+    return true;
+  }
+  case StatsLogRecord::Row: {
+    std::vector<std::int64_t> newRow = row;
+    for (std::uint64_t n = d.readULEB(); n; --n) {
+      std::uint64_t column = d.readULEB();
+      std::int64_t delta = d.readSLEB();
+      if (column >= newRow.size()) {
+        error = "row refers to unknown column " + std::to_string(column);
+        return false;
+      }
+      newRow[column] += delta;
+    }
+    if (!d.done())
+      break;
+    row = std::move(newRow);
+    return true;
+  }
+  case StatsLogRecord::Info: {
+    std::string key = d.readString();
+    std::string value = d.readString();
+    if (!d.done())
+      break;
+    info.emplace_back(std::move(key), std::move(value));
+    return true;
+  }
+  case StatsLogRecord::Event: {
+    Event event;
+    event.shortName = d.readString();
+    event.name = d.readString();
+    if (!d.done())
+      break;
+    events.push_back(std::move(event));
+    return true;
+  }
+  case StatsLogRecord::File: {
+    std::string path = d.readString();
+    if (!d.done())
+      break;
+    files.push_back(std::move(path));
+    return true;
+  }
+  case StatsLogRecord::Function: {
+    Function function;
+    function.name = d.readString();
+    function.file = d.readULEB();
+    if (!d.done())
+      break;
+    functions.push_back(std::move(function));
+    return true;
+  }
+  case StatsLogRecord::Instruction: {
+    Instruction instruction;
+    instruction.id = d.readULEB();
+    instruction.function = d.readULEB();
+    instruction.file = d.readULEB();
+    instruction.line = d.readULEB();
+    instruction.assemblyLine = d.readULEB();
+    if (!d.done())
+      break;
+    instructions.push_back(instruction);
+    return true;
+  }
+  case StatsLogRecord::InstructionStats: {
+    std::uint64_t time = d.readULEB();
+    std::vector<std::uint64_t> newStats = instructionStats;
+    for (std::uint64_t n = d.readULEB(); n && !events.empty(); --n) {
+      std::uint64_t id = d.readULEB();
+      std::uint64_t event = d.readULEB();
+      std::int64_t delta = d.readSLEB();
+      if (event >= events.size() ||
+          id > std::numeric_limits<unsigned>::max()) {
+        error = "invalid instruction statistic";
+        return false;
+      }
+      std::uint64_t index = id * events.size() + event;
+      if (index >= newStats.size())
+        newStats.resize(index + 1);
+      newStats[index] += delta;
+    }
+    if (!d.done())
+      break;
+    instructionStatsTime = time;
+    instructionStats = std::move(newStats);
+    return true;
+  }
+  default:
+    error = "unknown record kind " + std::to_string(static_cast<int>(kind));
+    return false;
+  }
+
+  error = "invalid record at offset " + std::to_string(offset);
+  return false;
+}
+
+void StatsLogReader::restore(std::uint64_t offset, std::vector<Column> columns,
+                             std::vector<std::int64_t> row) {
+  this->offset = offset;
+  this->columns = std::move(columns);
+  this->row = std::move(row);
+  this->row.resize(this->columns.size());
+}
+
+std::uint64_t StatsLogReader::getInstructionStat(unsigned id,
+                                                 unsigned event) const {
+  std::size_t index = static_cast<std::size_t>(id) * events.size() + event;
+  return event < events.size() && index < instructionStats.size()
+             ? instructionStats[index]
+             : 0;
+}
@@ -0,0 +1,33 @@
+// RUN: %clang %s -emit-llvm -g -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee -kdalloc -kdalloc-profile -output-dir=%t.klee-out %t.bc >%t.output 2>&1
+// RUN: FileCheck %s -check-prefix=CHECK-PROFILE -input-file=%t.klee-out/kdalloc-profile.txt
+// RUN: rm -rf %t.klee-out-derived
+// RUN: %klee -kdalloc -kdalloc-size-classes-from-profile=%t.klee-out/kdalloc-profile.txt -output-dir=%t.klee-out-derived %t.bc >%t.derived 2>&1
+// RUN: FileCheck %s -check-prefix=CHECK-DERIVED -input-file=%t.derived
+// RUN: rm -rf %t.klee-out-explicit
+// RUN: not %klee -kdalloc -kdalloc-size-classes=1,2,3 -output-dir=%t.klee-out-explicit %t.bc >%t.explicit 2>&1
+// RUN: FileCheck %s -check-prefix=CHECK-INVALID -input-file=%t.explicit
+
+#include <stdlib.h>
+
+struct record {
+  char data[300];
+};
+
+int main() {
+  for (int i = 0; i < 4; ++i) {
+    struct record *r = malloc(sizeof(struct record));
+    r->data[0] = i;
+    free(r);
+  }
+  return 0;
+}
+
+// CHECK-PROFILE: # size count site
+// CHECK-PROFILE: 300 4 main:{{.*}}call{{.*}}malloc
+
+// CHECK-DERIVED: Deterministic allocator: Using size classes {{.*}}512
+// CHECK-DERIVED: KLEE: done: completed paths = 1
+
+// CHECK-INVALID: requires exactly 8 sizes
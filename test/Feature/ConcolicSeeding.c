@@ -0,0 +1,32 @@
+// RUN: %clang -emit-llvm -c %O0opt -g %s -o %t.bc
+// RUN: rm -rf %t.klee-out %t.klee-out-seeded %t.klee-out-concolic %t.klee-out-depth
+// RUN: %klee --output-dir=%t.klee-out %t.bc
+// RUN: %klee --output-dir=%t.klee-out-seeded --only-seed --seed-file=%t.klee-out/test000001.ktest %t.bc 2>&1 | FileCheck --check-prefix=CHECK-SEEDED %s
+// RUN: %klee --output-dir=%t.klee-out-concolic --only-seed --concolic-seeding --seed-file=%t.klee-out/test000001.ktest %t.bc 2>&1 | FileCheck --check-prefix=CHECK-CONCOLIC %s
+// RUN: %klee --output-dir=%t.klee-out-depth --only-seed --concolic-seeding --max-depth=1 --seed-file=%t.klee-out/test000001.ktest %t.bc 2>&1 | FileCheck --check-prefix=CHECK-DEPTH %s
+
+// CHECK-SEEDED-NOT: branches not taken by the seeds
+// CHECK-SEEDED: seeding done (1 states remain)
+// CHECK-SEEDED: generated tests = 2{{$}}
+
+// The branch not taken by the seed is only checked after seeding
+// CHECK-CONCOLIC: 1 of 1 branches not taken by the seeds are feasible
+// CHECK-CONCOLIC: seeding done (1 states remain)
+// CHECK-CONCOLIC: generated tests = 2{{$}}
+
+// The branch not taken by the seed is dropped at the depth limit, as it was
+// never checked
+// CHECK-DEPTH-NOT: branches not taken by the seeds
+// CHECK-DEPTH: generated tests = 1{{$}}
+
+#include "klee/klee.h"
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x > 10)
+    klee_warning("big");
+  else
+    klee_warning("small");
+  return 0;
+}
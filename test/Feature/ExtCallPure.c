@@ -0,0 +1,47 @@
+// RUN: %clang %s -emit-llvm %O0opt -g -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --external-calls-pure=log,sqrt,strlen --exit-on-error %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.evict.klee-out
+// RUN: %klee --output-dir=%t.evict.klee-out --external-calls-pure=log,sqrt,strlen --external-calls-pure-cache-size=2 --exit-on-error %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.copy-all.klee-out
+// RUN: %klee --output-dir=%t.copy-all.klee-out --external-calls-copy-changed-only=false --exit-on-error %t.bc 2>&1 | FileCheck %s -check-prefix=CHECK-COPY-ALL
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+char buffer[16] = "hello";
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x)
+    buffer[1] = '\0';
+
+  // strlen reads memory and must not be memoized
+  // CHECK: not memoizing calls to strlen
+  for (int i = 0; i < 100; ++i) {
+    buffer[2] = i % 2 ? 'l' : '\0';
+    assert(strlen(buffer) == (x ? 1 : (i % 2 ? 5 : 2)));
+    int k = i % 4;
+    assert(sqrt(k * k) == k);
+  }
+
+  // memoized calls reproduce errno
+  volatile double minusOne = -1.0, one = 1.0;
+  for (int i = 0; i < 2; ++i) {
+    errno = 0;
+    assert(isnan(log(minusOne)));
+    assert(errno == EDOM);
+    errno = 0;
+    assert(log(one) == 0.0);
+    assert(errno == 0);
+  }
+
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 2
+// CHECK-COPY-ALL: KLEE: done: completed paths = 2
@@ -0,0 +1,50 @@
+// RUN: %clang %s -emit-llvm %O0opt -g -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --external-calls-sandbox --external-calls-sandbox-timeout=1s %t.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+char global[16];
+
+int main() {
+  char local[16] = "abc";
+
+  // memory written by the sandbox is copied back
+  int len = snprintf(global, sizeof(global), "%s-%d", local, 42);
+  assert(len == 6);
+  assert(strcmp(global, "abc-42") == 0);
+
+  // errno is propagated
+  errno = 0;
+  assert(write(-1, global, 1) == -1);
+  assert(errno == EBADF);
+
+  // pointers into the memory of the state stay valid
+  assert(strchr(local, 'b') == local + 1);
+
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x == 1) {
+    // The FILE is allocated by the sandbox helper, which outlives the call
+    FILE *f = fopen("/dev/null", "w");
+    assert(f);
+    assert(fputs("abc", f) >= 0);
+    assert(fclose(f) == 0);
+  } else if (x) {
+    // CHECK-DAG: external call to sleep timed out
+    // CHECK-DAG: failed external call: sleep
+    sleep(5);
+  }
+
+  // the helper is restarted after the timeout
+  assert(strchr(local, 'c') == local + 2);
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 2
+// CHECK: KLEE: done: partially completed paths = 1
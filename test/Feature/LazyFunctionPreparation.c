@@ -0,0 +1,32 @@
+// RUN: %clang %s -emit-llvm %O0opt -g -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.lazy.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2>&1 | FileCheck %s
+// RUN: %klee --output-dir=%t.lazy.klee-out --lazy-function-preparation %t.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --check-prefix=CHECK-EAGER --input-file=%t.klee-out/info %s
+// RUN: FileCheck --check-prefix=CHECK-LAZY --input-file=%t.lazy.klee-out/info %s
+
+#include "klee/klee.h"
+
+static const char *greeting = "hello";
+
+static int first(int x) { return x + greeting[0]; }
+
+static int second(int x) { return x * 2; }
+
+static int unused(int x) { return x - 1; }
+
+// Functions called through pointers are only known at run time
+static int (*const handlers[])(int) = {first, second, unused};
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x > 0)
+    return handlers[0](x) > 'h';
+  return handlers[1](x) < 0;
+}
+// CHECK: KLEE: done: completed paths = 4
+
+// Only main, first and second are called, so unused is never prepared
+// CHECK-EAGER: KLEE: done: prepared functions = {{([4-9]|[1-9][0-9]+)$}}
+// CHECK-LAZY: KLEE: done: prepared functions = 3{{$}}
@@ -0,0 +1,37 @@
+// RUN: %clang %s -emit-llvm %O0opt -g -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.min.klee-out %t.max.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2>&1 | FileCheck --check-prefix=CHECK-ALL %s
+// RUN: %klee --output-dir=%t.min.klee-out --minimize-tests --search=dfs %t.bc 2>&1 | FileCheck --check-prefix=CHECK-MIN %s
+// RUN: ls %t.min.klee-out/redundant-tests | FileCheck --check-prefix=CHECK-REDUNDANT %s
+// RUN: %klee --output-dir=%t.max.klee-out --minimize-tests --search=dfs --max-tests=1 --dump-states-on-halt=false %t.bc 2>&1 | FileCheck --check-prefix=CHECK-MAX %s
+
+// CHECK-ALL: generated tests = 9{{$}}
+
+// A test that takes both directions covers all blocks, so only one test is
+// left after moving the redundant ones aside, and tests for errors are always
+// output
+// CHECK-MIN: minimized test suite: kept 1 of 8 test cases
+// CHECK-MIN: generated tests = 2{{$}}
+// CHECK-REDUNDANT: .ktest
+
+// Only the tests that are kept count
+// CHECK-MAX: minimized test suite: kept 1 of 1 test cases
+// CHECK-MAX: generated tests = 1{{$}}
+
+#include "klee/klee.h"
+
+int small, big;
+
+int main() {
+  char a[4];
+  klee_make_symbolic(a, sizeof(a), "a");
+  for (int i = 0; i < 3; ++i) {
+    if (a[i] > 10)
+      ++big;
+    else
+      ++small;
+  }
+  if (a[3] == 42)
+    klee_report_error(__FILE__, __LINE__, "found", "user.err");
+  return 0;
+}
@@ -0,0 +1,35 @@
+// RUN: %clang %s -emit-llvm %O0opt -g -c -o %t.bc
+// RUN: rm -rf %t.cache %t.klee-out %t.cached.klee-out
+// RUN: %klee --output-dir=%t.klee-out --module-cache-dir=%t.cache %t.bc 2>&1 | FileCheck %s -check-prefix=CHECK-STORE
+// RUN: %klee --output-dir=%t.cached.klee-out --module-cache-dir=%t.cache %t.bc 2>&1 | FileCheck %s -check-prefix=CHECK-LOAD
+// RUN: diff %t.klee-out/assembly.ll %t.cached.klee-out/assembly.ll
+// RUN: rm -rf %t.switch.klee-out
+// RUN: %klee --output-dir=%t.switch.klee-out --module-cache-dir=%t.cache --switch-type=simple %t.bc 2>&1 | FileCheck %s -check-prefix=CHECK-STORE
+// RUN: rm -rf %t.noverify.klee-out
+// RUN: %klee --output-dir=%t.noverify.klee-out --module-cache-dir=%t.cache --disable-verify %t.bc 2>&1 | FileCheck %s -check-prefix=CHECK-STORE
+
+// A policy that allows no cached data empties the cache before the lookup
+// RUN: rm -rf %t.pruned.klee-out
+// RUN: %klee --output-dir=%t.pruned.klee-out --module-cache-dir=%t.cache --module-cache-policy=prune_interval=0s:cache_size_bytes=1 %t.bc 2>&1 | FileCheck %s -check-prefix=CHECK-STORE
+// RUN: rm -rf %t.policy.klee-out
+// RUN: not %klee --output-dir=%t.policy.klee-out --module-cache-dir=%t.cache --module-cache-policy=unknown=1 %t.bc 2>&1 | FileCheck %s -check-prefix=CHECK-POLICY
+
+#include "klee/klee.h"
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  switch (x) {
+  case 1:
+    return 1;
+  case 2:
+    return 2;
+  default:
+    return 0;
+  }
+}
+// CHECK-STORE-NOT: Using prepared module from cache
+// CHECK-STORE: KLEE: done: completed paths = 3
+// CHECK-LOAD: KLEE: Using prepared module from cache
+// CHECK-LOAD: KLEE: done: completed paths = 3
+// CHECK-POLICY: Invalid --module-cache-policy
@@ -0,0 +1,68 @@
+; RUN: %llvmas %s -o %t.bc
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --optimize-symbolic --optimize-symbolic-max-arm-size=16 %t.bc 2>&1 | FileCheck %s
+; RUN: rm -rf %t.default.klee-out
+; RUN: %klee --output-dir=%t.default.klee-out --optimize-symbolic %t.bc 2>&1 | FileCheck %s -check-prefix=CHECK-DEFAULT
+; RUN: rm -rf %t.branches.klee-out
+; RUN: %klee --output-dir=%t.branches.klee-out %t.bc 2>&1 | FileCheck %s -check-prefix=CHECK-BRANCHES
+
+; CHECK: KLEE: Converted 2 branches into selects
+; CHECK: KLEE: done: completed paths = 1
+; The arms of the outer branch are too large by default
+; CHECK-DEFAULT: KLEE: Converted 1 branches into selects
+; CHECK-DEFAULT: KLEE: done: completed paths = 16
+; CHECK-BRANCHES: KLEE: done: completed paths = 81
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare void @klee_make_symbolic(ptr, i64, ptr)
+@.name = private constant [2 x i8] c"a\00"
+
+define i32 @clamp(i32 %x) {
+entry:
+  %neg = icmp slt i32 %x, 0
+  br i1 %neg, label %zero, label %check
+zero:
+  br label %done
+check:
+  %big = icmp sgt i32 %x, 100
+  br i1 %big, label %hundred, label %same
+hundred:
+  %h0 = mul i32 %x, 7
+  %h1 = xor i32 %h0, 9
+  %h2 = lshr i32 %h1, 2
+  %h = add i32 %h2, 1
+  br label %join
+same:
+  %y0 = mul i32 %x, 3
+  %y1 = xor i32 %y0, 5
+  %y2 = shl i32 %y1, 2
+  %y = add i32 %y2, 1
+  br label %join
+join:
+  %r = phi i32 [ %h, %hundred ], [ %y, %same ]
+  br label %done
+done:
+  %res = phi i32 [ 0, %zero ], [ %r, %join ]
+  ret i32 %res
+}
+
+define i32 @main() {
+entry:
+  %a = alloca [4 x i32]
+  call void @klee_make_symbolic(ptr %a, i64 16, ptr @.name)
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i1, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s1, %loop ]
+  %p = getelementptr inbounds i32, ptr %a, i64 %i
+  %v = load i32, ptr %p
+  %c = call i32 @clamp(i32 %v)
+  %s1 = add i32 %s, %c
+  %i1 = add i64 %i, 1
+  %e = icmp eq i64 %i1, 4
+  br i1 %e, label %out, label %loop
+out:
+  ret i32 %s1
+}
@@ -0,0 +1,39 @@
+// RUN: %clang -emit-llvm -c %O0opt -g -DSIZE=8 %s -o %t.seed.bc
+// RUN: rm -rf %t.klee-out %t.seeds
+// RUN: %klee --output-dir=%t.klee-out %t.seed.bc
+// RUN: mkdir %t.seeds
+// RUN: cp %t.klee-out/test000001.ktest %t.seeds/a.ktest
+// RUN: cp %t.klee-out/test000001.ktest %t.seeds/b.ktest
+// RUN: cp %t.klee-out/test000002.ktest %t.seeds/c.ktest
+// RUN: cp %t.klee-out/test000003.ktest %t.seeds/d.ktest
+// RUN: cp %t.klee-out/test000004.ktest %t.seeds/e.ktest
+// RUN: %clang -emit-llvm -c %O0opt -g -DSIZE=4 %s -o %t.bc
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --only-seed --allow-seed-truncation --seed-dir=%t.seeds %t.bc 2>&1 | FileCheck %s
+
+// Seeds with identical inputs are ignored right away. The remaining four
+// seeds differ in both bytes read by the 8 byte version, but only in the
+// first once truncated to 4 bytes, so two of them follow the same path as
+// another one.
+// CHECK: ignoring 1 duplicate seeds
+// CHECK: dropped 2 seeds following the same path as another seed
+// CHECK: seeding done
+// CHECK: completed paths = 2{{$}}
+
+#include "klee/klee.h"
+
+int main() {
+  char buf[SIZE];
+  klee_make_symbolic(buf, sizeof(buf), "buf");
+  if (buf[0] > 10)
+    klee_warning("big");
+  else
+    klee_warning("small");
+#if SIZE > 4
+  if (buf[4] > 10)
+    klee_warning("big");
+  else
+    klee_warning("small");
+#endif
+  return 0;
+}
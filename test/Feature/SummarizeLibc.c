@@ -0,0 +1,36 @@
+// RUN: %clang %s -emit-llvm %O0opt -g -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --libc=klee --summarize-libc --exit-on-error %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.interpreted.klee-out
+// RUN: %klee --output-dir=%t.interpreted.klee-out --libc=klee --exit-on-error %t.bc 2>&1 | FileCheck %s -check-prefix=CHECK-INTERPRETED
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <string.h>
+
+int main() {
+  char s[8];
+  klee_make_symbolic(s, sizeof(s), "s");
+  s[7] = '\0';
+
+  char copy[8];
+  memcpy(copy, s, sizeof(copy));
+  assert(memcmp(copy, s, sizeof(copy)) == 0);
+  // The interpreted strcmp forks at every possible terminator
+  assert(strcmp(copy, s) == 0);
+
+  char hello[] = "hello";
+  assert(strcmp(hello, "help") < 0);
+  assert(memcmp(hello, "help", 3) == 0);
+  assert(strlen(hello) == 5);
+
+  size_t len = strlen(s);
+  if (len == 3) {
+    assert(s[0] && s[1] && s[2] && !s[3]);
+    return 1;
+  }
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 2
+// CHECK-INTERPRETED: KLEE: done: completed paths = 8
@@ -0,0 +1,30 @@
+// RUN: %clang %s -emit-llvm -O1 -g -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --summarize-loops --exit-on-error %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.interpreted.klee-out
+// RUN: %klee --output-dir=%t.interpreted.klee-out --exit-on-error %t.bc 2>&1 | FileCheck %s -check-prefix=CHECK-INTERPRETED
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+int main() {
+  char s[8];
+  klee_make_symbolic(s, sizeof(s), "s");
+  s[7] = '\0';
+
+  // The interpreted loop forks at every possible terminator
+  const char *p = s;
+  while (*p)
+    ++p;
+
+  size_t len = p - s;
+  if (len == 3) {
+    assert(s[0] && s[1] && s[2] && !s[3]);
+    return 1;
+  }
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 2
+// CHECK-INTERPRETED: KLEE: done: completed paths = 8
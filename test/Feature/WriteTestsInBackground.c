@@ -0,0 +1,25 @@
+// RUN: %clang %s -emit-llvm %O0opt -g -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.bg.klee-out
+// RUN: %klee --output-dir=%t.klee-out --write-kqueries --write-cov %t.bc 2>&1 | FileCheck %s
+// RUN: %klee --output-dir=%t.bg.klee-out --write-tests-in-background --max-pending-tests-size=0 --write-kqueries --write-cov %t.bc 2>&1 | FileCheck %s
+// RUN: %ktest-tool %t.klee-out/test*.ktest | grep "int :" > %t.tests
+// RUN: %ktest-tool %t.bg.klee-out/test*.ktest | grep "int :" | diff %t.tests -
+// RUN: cat %t.klee-out/test*.kquery %t.klee-out/test*.cov > %t.files
+// RUN: cat %t.bg.klee-out/test*.kquery %t.bg.klee-out/test*.cov | diff %t.files -
+
+// Test cases are written in the order of their ids, even when waiting for
+// the writer
+// CHECK: generated tests = 3{{$}}
+
+#include "klee/klee.h"
+
+int main() {
+  int x = klee_int("x");
+  if (x > 10)
+    klee_warning("big");
+  else if (x < 0)
+    klee_warning("negative");
+  else
+    klee_warning("small");
+  return 0;
+}
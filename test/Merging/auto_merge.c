@@ -0,0 +1,33 @@
+// RUN: %clang -emit-llvm -g -c -o %t.bc %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --use-merge --auto-merge --search=dfs %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --use-merge --auto-merge --search=bfs %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2>&1 | FileCheck %s -check-prefix=CHECK-NOMERGE
+// RUN: rm -rf %t.klee-out
+// RUN: not %klee --output-dir=%t.klee-out --auto-merge %t.bc 2>&1 | FileCheck %s -check-prefix=CHECK-ERROR
+
+// CHECK: Inserted merge points for 2 regions
+// CHECK: completed paths = 1{{$}}
+// CHECK-NOMERGE: completed paths = 16{{$}}
+// CHECK-ERROR: --auto-merge used without --use-merge
+
+#include "klee/klee.h"
+
+int main() {
+  int a[4];
+  int sum = 0;
+  klee_make_symbolic(a, sizeof(a), "a");
+
+  // Merged at the loop exit, and the final branch at the return
+  for (int i = 0; i < 4; i++) {
+    if (a[i] > 0)
+      sum += 1;
+    else
+      sum += 2;
+  }
+  if (sum == 6)
+    return 1;
+  return 0;
+}
@@ -0,0 +1,59 @@
+// RUN: rm -rf %t.out
+// RUN: mkdir -p %t.out
+// RUN: %ktest-gen --bout-file %t.out/normal.ktest normal
+// RUN: %ktest-gen --bout-file %t.out/exit.ktest exit
+// RUN: %ktest-gen --bout-file %t.out/exit77.ktest exit77
+// RUN: %ktest-gen --bout-file %t.out/crash1.ktest crash
+// RUN: %ktest-gen --bout-file %t.out/crash2.ktest crash
+// RUN: %ktest-gen --bout-file %t.out/loop.ktest loop
+// RUN: %cc %s -O0 -o %t
+// RUN: env KLEE_REPLAY_TIMEOUT=1 %klee-replay --jobs=3 %t %t.out/normal.ktest %t.out/exit.ktest %t.out/exit77.ktest %t.out/loop.ktest %t.out/crash2.ktest %t.out/crash1.ktest 2> %t.out/out.txt
+// RUN: FileCheck --input-file=%t.out/out.txt %s
+
+// The output of each test is written at once
+// CHECK: KLEE-REPLAY: NOTE: Test file:
+// CHECK-NEXT: KLEE-REPLAY: NOTE: Arguments:
+// CHECK-NOT: Test file:
+// CHECK: KLEE-REPLAY: NOTE: EXIT STATUS:
+// CHECK: KLEE-REPLAY: NOTE: Test file:
+// CHECK-NEXT: KLEE-REPLAY: NOTE: Arguments:
+// CHECK-NOT: Test file:
+// CHECK: KLEE-REPLAY: NOTE: EXIT STATUS:
+// CHECK: KLEE-REPLAY: NOTE: Test file:
+// CHECK-NEXT: KLEE-REPLAY: NOTE: Arguments:
+// CHECK-NOT: Test file:
+// CHECK: KLEE-REPLAY: NOTE: EXIT STATUS:
+// CHECK: KLEE-REPLAY: NOTE: Test file:
+// CHECK-NEXT: KLEE-REPLAY: NOTE: Arguments:
+// CHECK-NOT: Test file:
+// CHECK: KLEE-REPLAY: NOTE: EXIT STATUS:
+// CHECK: KLEE-REPLAY: NOTE: Test file:
+// CHECK-NEXT: KLEE-REPLAY: NOTE: Arguments:
+// CHECK-NOT: Test file:
+// CHECK: KLEE-REPLAY: NOTE: EXIT STATUS:
+// CHECK: KLEE-REPLAY: NOTE: Test file:
+// CHECK-NEXT: KLEE-REPLAY: NOTE: Arguments:
+// CHECK-NOT: Test file:
+// CHECK: KLEE-REPLAY: NOTE: EXIT STATUS:
+// CHECK: KLEE-REPLAY: NOTE: replayed 6 tests: 1 normal, 2 abnormal, 2 crashed, 1 timed out
+// CHECK-NEXT: KLEE-REPLAY: NOTE: CRASHED: {{.*}}crash1.ktest
+// CHECK-NEXT: KLEE-REPLAY: NOTE: CRASHED: {{.*}}crash2.ktest
+// CHECK-NEXT: KLEE-REPLAY: NOTE: TIMED OUT: {{.*}}loop.ktest
+
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char **argv) {
+  if (argc < 2)
+    return 1;
+  if (!strcmp(argv[1], "crash"))
+    abort();
+  if (!strcmp(argv[1], "exit"))
+    return 2;
+  if (!strcmp(argv[1], "exit77"))
+    return 77;
+  if (!strcmp(argv[1], "loop"))
+    for (;;)
+      ;
+  return 0;
+}
@@ -0,0 +1,32 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --search=dfs --pack-ktests %t.bc
+// RUN: test -f %t.klee-out/tests.ktestpack
+// RUN: not test -f %t.klee-out/test000001.ktest
+// RUN: %ktest-tool %t.klee-out/tests.ktestpack | FileCheck -check-prefix=TOOL %s
+
+// Tests are read from the pack by their id
+// RUN: %cc %s %libkleeruntest -Wl,-rpath %libkleeruntestdir -o %t_runner
+// RUN: env KTEST_FILE=%t.klee-out/tests.ktestpack#1 %t_runner | FileCheck -check-prefix=TESTONE %s
+// RUN: env KTEST_FILE=%t.klee-out/tests.ktestpack#2 %t_runner | FileCheck -check-prefix=TESTTWO %s
+
+#include "klee/klee.h"
+#include <stdio.h>
+
+int main(int argc, char** argv) {
+  int x = 0;
+  klee_make_symbolic(&x, sizeof(x), "x");
+
+  if (x == 0) {
+    printf("x is 0\n");
+  } else {
+    printf("x is not 0\n");
+  }
+  return 0;
+}
+
+// TOOL: ktest file : '{{.*}}tests.ktestpack#1'
+// TOOL: ktest file : '{{.*}}tests.ktestpack#2'
+
+// TESTONE: x is not 0
+// TESTTWO: x is 0
@@ -0,0 +1,12 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --reuse-state-models --debug-validate-solver --debug-assignment-validating-solver %t1.bc 2>&1 | FileCheck %s
+// RUN: %klee-stats --print-columns 'QModelHits' --table-format=csv %t.klee-out | FileCheck --check-prefix=CHECK-STATS %s
+
+#include "ExerciseSolver.c.inc"
+
+// CHECK: KLEE: done: completed paths = 15
+// CHECK: KLEE: done: partially completed paths = 0
+
+// CHECK-STATS: QModelHits
+// CHECK-STATS-NEXT: {{[1-9][0-9]*}}
@@ -0,0 +1,44 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --stats-format=log %t.bc 2> %t.log
+// RUN: test -f %t.klee-out/run.statslog
+// RUN: not test -f %t.klee-out/run.stats
+// RUN: not test -f %t.klee-out/run.istats
+// RUN: %klee-stats --print-columns 'Path,Instrs,ICov(%)' --table-format=csv %t.klee-out | FileCheck --check-prefix=CHECK-STATS %s
+// RUN: %klee-stats-backend --format=csv %t.klee-out | FileCheck --check-prefix=CHECK-BACKEND %s
+
+// The log is converted into the default format
+// RUN: %klee-stats-backend --export %t.klee-out
+// RUN: %klee-stats --print-columns 'Path,Instrs,ICov(%)' --table-format=csv %t.klee-out | FileCheck --check-prefix=CHECK-STATS %s
+// RUN: FileCheck --check-prefix=CHECK-ISTATS --input-file=%t.klee-out/run.istats %s
+// RUN: not %klee-stats-backend --export %t.klee-out 2>&1 | FileCheck --check-prefix=CHECK-EXISTS %s
+
+// Query profiles are only written to databases
+// RUN: rm -rf %t.klee-out-profile
+// RUN: not %klee --output-dir=%t.klee-out-profile --stats-format=log --profile-queries %t.bc 2>&1 | FileCheck --check-prefix=CHECK-PROFILE %s
+#include "klee/klee.h"
+
+int main() {
+  int a;
+  klee_make_symbolic(&a, sizeof(int), "a");
+  if (a > 42)
+    return 1;
+  return 0;
+}
+
+// CHECK-STATS: Path,Instrs,ICov(%)
+// CHECK-STATS-NEXT: {{.*}}klee-out,{{[1-9][0-9]*}},100.00
+
+// CHECK-BACKEND: Path,Instructions,
+// CHECK-BACKEND-NEXT: {{.*}}klee-out,{{[1-9][0-9]*}},
+
+// CHECK-ISTATS: positions: instr line
+// CHECK-ISTATS: events: {{.*}}Icov
+// CHECK-ISTATS: ob=assembly.ll
+// CHECK-ISTATS: fl={{.*}}KleeStatsLog.c
+// CHECK-ISTATS-NEXT: fn=main
+// CHECK-ISTATS-NEXT: {{[1-9][0-9]*}} {{[1-9][0-9]*}}
+
+// CHECK-EXISTS: cannot export {{.*}}run.stats already exists
+
+// CHECK-PROFILE: --profile-queries requires --stats-format=sqlite
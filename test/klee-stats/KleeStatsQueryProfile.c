@@ -0,0 +1,25 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --profile-queries %t.bc 2> %t.log
+// RUN: %klee-stats --print-query-profile --table-format=csv %t.klee-out > %t.stats
+// RUN: FileCheck -input-file=%t.stats %s
+// Without profile, klee-stats reports the missing table
+// RUN: rm -rf %t.klee-out-noprofile
+// RUN: %klee --output-dir=%t.klee-out-noprofile %t.bc 2> %t.log
+// RUN: %klee-stats --print-query-profile --table-format=csv %t.klee-out-noprofile 2>&1 | FileCheck -check-prefix=CHECK-NOPROFILE %s
+#include "klee/klee.h"
+
+int main() {
+  int a;
+  klee_make_symbolic(&a, sizeof(int), "a");
+  if (a > 42)
+    return 1;
+  return 0;
+}
+
+// CHECK: Function,File,Line,Kind,Stage,Queries,Time(s),AvgNodes,AvgArrays,AvgConstraints
+// CHECK-DAG: main,{{.*}}KleeStatsQueryProfile.c,15,Validity,
+// Queries for tests are not attributed to the last executed instruction
+// CHECK-DAG: {{^}},,,InitialValues,
+
+// CHECK-NOPROFILE: No query profile
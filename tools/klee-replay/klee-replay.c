@@ -13,6 +13,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -50,6 +51,17 @@ static unsigned obj_index;
 static const char *progname = 0;
 static unsigned monitored_pid = 0;
 static unsigned monitored_timeout;
+static volatile sig_atomic_t monitored_timed_out;
+
+/* Outcomes of a test, which the process monitoring the executable writes to
+   outcome_fd, as its exit status cannot tell them apart */
+enum {
+  OUTCOME_NORMAL = 'N',
+  OUTCOME_ABNORMAL = 'A',
+  OUTCOME_CRASHED = 'C',
+  OUTCOME_TIMED_OUT = 'T',
+};
+static int outcome_fd = -1;
 
 static char *rootdir = NULL;
 static struct option long_options[] = {
@@ -57,6 +69,7 @@ static struct option long_options[] = {
   {"chroot-to-dir", required_argument, 0, 'r'},
   {"help", no_argument, 0, 'h'},
   {"keep-replay-dir", no_argument, 0, 'k'},
+  {"jobs", required_argument, 0, 'j'},
   {0, 0, 0, 0},
 };
 
@@ -121,6 +134,7 @@ static void int_handler(int signal) {
 }
 
 static void timeout_handler(int signal) {
+  monitored_timed_out = 1;
   fprintf(stderr, "KLEE-REPLAY: NOTE: EXIT STATUS: TIMED OUT (%d seconds)\n",
           monitored_timeout);
   if (monitored_pid) {
@@ -134,12 +148,23 @@ static void timeout_handler(int signal) {
   }
 }
 
+static void report_outcome(char outcome) {
+  if (outcome_fd < 0)
+    return;
+  /* A timeout takes precedence over how the executable was stopped */
+  if (monitored_timed_out)
+    outcome = OUTCOME_TIMED_OUT;
+  if (write(outcome_fd, &outcome, 1) != 1)
+    perror("write");
+}
+
 void process_status(int status, time_t elapsed, const char *pfx) {
   if (pfx)
     fprintf(stderr, "KLEE-REPLAY: NOTE: %s: ", pfx);
   if (WIFSIGNALED(status)) {
     fprintf(stderr, "KLEE-REPLAY: NOTE: EXIT STATUS: CRASHED signal %d (%d seconds)\n",
             WTERMSIG(status), (int) elapsed);
+    report_outcome(OUTCOME_CRASHED);
     _exit(77);
   } else if (WIFEXITED(status)) {
     int rc = WEXITSTATUS(status);
@@ -151,9 +176,11 @@ void process_status(int status, time_t elapsed, const char *pfx) {
       snprintf(msg, sizeof(msg), "ABNORMAL %d", rc);
     }
     fprintf(stderr, "KLEE-REPLAY: NOTE: EXIT STATUS: %s (%d seconds)\n", msg, (int) elapsed);
+    report_outcome(rc ? OUTCOME_ABNORMAL : OUTCOME_NORMAL);
     _exit(rc);
   } else {
     fprintf(stderr, "KLEE-REPLAY: NOTE: EXIT STATUS: NONE (%d seconds)\n", (int) elapsed);
+    report_outcome(OUTCOME_NORMAL);
     _exit(0);
   }
 }
@@ -269,11 +296,12 @@ void ensure_capsyschroot(const char *executable) {
 
 static void usage(void) {
   fprintf(stderr,
-    "Usage: %s [option]... <executable> <ktest-file>...\n"
+    "Usage: %s [option]... <executable> <ktest-file or ktestpack-file>...\n"
     "   or: %s --create-files-only <ktest-file>\n"
     "\n"
     "-r, --chroot-to-dir=DIR  use chroot jail, requires CAP_SYS_CHROOT\n"
     "-k, --keep-replay-dir    do not delete replay directory\n"
+    "-j, --jobs=N             replay up to N tests in parallel (default=1)\n"
     "-h, --help               display this help and exit\n"
     "\n"
     "Use KLEE_REPLAY_TIMEOUT environment variable to set a timeout (in seconds).\n",
@@ -284,6 +312,227 @@ static void usage(void) {
 
 int keep_temps = 0;
 
+/* Replays the test in input, which is freed afterwards, and returns the exit
+   status of the process monitoring the executable */
+static int replay_input(char *executable, const char *program,
+                        const char *input_fname, int separate) {
+  int prg_argc;
+  char ** prg_argv;
+  unsigned i;
+
+  obj_index = 0;
+  prg_argc = input->numArgs;
+  prg_argv = input->args;
+  free(prg_argv[0]);
+  prg_argv[0] = strdup(program);
+
+  klee_init_env(&prg_argc, &prg_argv);
+
+  if (separate)
+    fputc('\n', stderr);
+  fprintf(stderr, "KLEE-REPLAY: NOTE: Test file: %s\n"
+                  "KLEE-REPLAY: NOTE: Arguments: ", input_fname);
+  for (i=0; i != (unsigned) prg_argc; ++i) {
+    char *s = prg_argv[i];
+    if (s[0]=='A' && s[1] && !s[2]) s[1] = '\0';
+    fprintf(stderr, "\"%s\" ", prg_argv[i]);
+  }
+  fputc('\n', stderr);
+
+  /* Create the input files, pipes, etc. */
+  replay_create_files(&__exe_fs);
+
+  /* Run the test case machinery in a subprocess, eventually this parent
+     process should be a script or something which shells out to the actual
+     execution tool. */
+
+  int pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    _exit(66);
+  } else if (pid == 0) {
+    /* Run the executable */
+    run_monitored(executable, prg_argc, prg_argv);
+    _exit(0);
+  } else {
+    /* Wait for the executable to finish. */
+    int res, status;
+
+    do {
+      res = waitpid(pid, &status, 0);
+    } while (res < 0 && errno == EINTR);
+
+    // Delete all files in the replay directory
+    replay_delete_files();
+
+    if (res < 0) {
+      perror("waitpid");
+      _exit(66);
+    }
+
+    free(prg_argv);
+    kTest_free(input);
+    return status;
+  }
+}
+
+/* Tests being replayed, each in its own worker process. With more than one
+   job, the output of a worker is kept in out and err until it finishes, so
+   that the output of parallel tests is not interleaved. */
+struct replay_job {
+  int pid;
+  char *test_name;
+  int outcome_fd;
+  FILE *out;
+  FILE *err;
+};
+
+static unsigned max_jobs = 1;
+static struct replay_job *jobs;
+static unsigned num_jobs;
+
+/* Outcomes of the finished tests */
+struct failed_test {
+  char *test_name;
+  char outcome;
+};
+
+static unsigned num_replayed, num_normal, num_abnormal, num_crashed,
+    num_timed_out;
+static struct failed_test *failed_tests;
+static unsigned num_failed;
+
+static int compare_failed_tests(const void *a, const void *b) {
+  return strcmp(((const struct failed_test *)a)->test_name,
+                ((const struct failed_test *)b)->test_name);
+}
+
+static void copy_output(FILE *from, FILE *to) {
+  char buffer[4096];
+  size_t n;
+
+  rewind(from);
+  while ((n = fread(buffer, 1, sizeof(buffer), from)) != 0)
+    fwrite(buffer, 1, n, to);
+  fclose(from);
+  fflush(to);
+}
+
+/* Waits for one of the running tests to finish and records its outcome */
+static void wait_for_job(void) {
+  int res, status;
+  unsigned i;
+
+  do {
+    res = waitpid(-1, &status, 0);
+  } while (res < 0 && errno == EINTR);
+
+  if (res < 0) {
+    perror("waitpid");
+    _exit(66);
+  }
+
+  for (i = 0; i != num_jobs && jobs[i].pid != res; ++i)
+    ;
+  if (i == num_jobs)
+    return;
+
+  if (jobs[i].out) {
+    copy_output(jobs[i].out, stdout);
+    copy_output(jobs[i].err, stderr);
+  }
+
+  /* Without an outcome, the worker failed before the executable ran */
+  char outcome;
+  ssize_t n;
+  do {
+    n = read(jobs[i].outcome_fd, &outcome, 1);
+  } while (n < 0 && errno == EINTR);
+  close(jobs[i].outcome_fd);
+  if (n != 1)
+    outcome = WIFSIGNALED(status) ? OUTCOME_CRASHED : OUTCOME_ABNORMAL;
+
+  ++num_replayed;
+  switch (outcome) {
+  case OUTCOME_NORMAL:
+    ++num_normal;
+    free(jobs[i].test_name);
+    break;
+  case OUTCOME_ABNORMAL:
+    ++num_abnormal;
+    free(jobs[i].test_name);
+    break;
+  default:
+    if (outcome == OUTCOME_TIMED_OUT)
+      ++num_timed_out;
+    else
+      ++num_crashed;
+    failed_tests = realloc(failed_tests,
+                           (num_failed + 1) * sizeof(*failed_tests));
+    failed_tests[num_failed].test_name = jobs[i].test_name;
+    failed_tests[num_failed].outcome = outcome;
+    ++num_failed;
+    break;
+  }
+  jobs[i] = jobs[--num_jobs];
+}
+
+/* Replays the test in input in a worker process, once one of the max_jobs
+   workers is free. The input is freed afterwards. */
+static void start_job(char *executable, const char *program,
+                      const char *input_fname, int separate) {
+  while (num_jobs == max_jobs)
+    wait_for_job();
+
+  struct replay_job *job = &jobs[num_jobs];
+  int fds[2];
+  if (pipe(fds) < 0) {
+    perror("pipe");
+    _exit(66);
+  }
+  /* Neither the executable nor later workers may keep the pipe open */
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+  job->outcome_fd = fds[0];
+  job->out = job->err = NULL;
+  if (max_jobs > 1) {
+    job->out = tmpfile();
+    job->err = tmpfile();
+    if (!job->out || !job->err) {
+      perror("tmpfile");
+      _exit(66);
+    }
+  }
+
+  /* Replaying in a separate process also keeps the files created for the
+     test, which may replace stdin and stdout, out of this process */
+  fflush(stdout);
+  fflush(stderr);
+  int pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    _exit(66);
+  } else if (pid == 0) {
+    close(fds[0]);
+    outcome_fd = fds[1];
+    if (job->out && (dup2(fileno(job->out), STDOUT_FILENO) < 0 ||
+                     dup2(fileno(job->err), STDERR_FILENO) < 0)) {
+      perror("dup2");
+      _exit(66);
+    }
+    int status = replay_input(executable, program, input_fname,
+                              separate && !job->out);
+    _exit(WIFEXITED(status) ? WEXITSTATUS(status) : 77);
+  }
+  close(fds[1]);
+
+  job->pid = pid;
+  job->test_name = strdup(input_fname);
+  ++num_jobs;
+  kTest_free(input);
+}
+
+
 int main(int argc, char** argv) {
   int prg_argc;
   char ** prg_argv;
@@ -294,7 +543,7 @@ int main(int argc, char** argv) {
     usage();
 
   int c, opt_index;
-  while ((c = getopt_long(argc, argv, "f:r:k", long_options, &opt_index)) != -1) {
+  while ((c = getopt_long(argc, argv, "f:r:kj:", long_options, &opt_index)) != -1) {
     switch (c) {
     case 'f': {
       /* Special case hack for only creating files and not actually executing
@@ -328,9 +577,24 @@ int main(int argc, char** argv) {
     case 'k':
       keep_temps = 1;
       break;
+
+    case 'j': {
+      char *end;
+      long n = strtol(optarg, &end, 10);
+      if (*end || n < 1 || n > 4096) {
+        fprintf(stderr, "KLEE-REPLAY: ERROR: invalid number of jobs (%s)\n",
+                optarg);
+        exit(1);
+      }
+      max_jobs = n;
+      break;
+    }
     }
   }
 
+  if (optind + 1 >= argc)
+    usage();
+
   // Executable needs to be converted to an absolute path, as klee-replay calls
   // chdir just before executing it
   char executable[PATH_MAX];
@@ -354,10 +618,40 @@ int main(int argc, char** argv) {
     exit(1);
   }
 
+  jobs = calloc(max_jobs, sizeof(*jobs));
+  if (!jobs) {
+    perror("calloc");
+    exit(1);
+  }
+
   int idx = 0;
   for (idx = optind + 1; idx != argc; ++idx) {
     char* input_fname = argv[idx];
-    unsigned i;
+
+    /* Replay every test of a pack without unpacking it */
+    if (kTestPack_isKTestPackFile(input_fname)) {
+      KTestPack *pack = kTestPack_open(input_fname);
+      unsigned i;
+      if (!pack) {
+        fprintf(stderr, "KLEE-REPLAY: ERROR: input file %s not valid.\n",
+                input_fname);
+        exit(1);
+      }
+      for (i = 0; i != kTestPack_numTests(pack); ++i) {
+        char test_name[PATH_MAX];
+        input = kTestPack_getTest(pack, i);
+        if (!input) {
+          fprintf(stderr, "KLEE-REPLAY: ERROR: test %u of %s not valid.\n",
+                  i, input_fname);
+          exit(1);
+        }
+        snprintf(test_name, sizeof(test_name), "%s#%u", input_fname,
+                 kTestPack_getId(pack, i));
+        start_job(executable, argv[optind], test_name, idx > 2 || i > 0);
+      }
+      kTestPack_close(pack);
+      continue;
+    }
 
     input = kTest_fromFile(input_fname);
     if (!input) {
@@ -365,62 +659,27 @@ int main(int argc, char** argv) {
               input_fname);
       exit(1);
     }
+    start_job(executable, argv[optind], input_fname, idx > 2);
+  }
 
-    obj_index = 0;
-    prg_argc = input->numArgs;
-    prg_argv = input->args;
-    free(prg_argv[0]);
-    prg_argv[0] = strdup(argv[optind]);
-
-    klee_init_env(&prg_argc, &prg_argv);
-
-    if (idx > 2)
-      fputc('\n', stderr);
-    fprintf(stderr, "KLEE-REPLAY: NOTE: Test file: %s\n"
-                    "KLEE-REPLAY: NOTE: Arguments: ", input_fname);
-    for (i=0; i != (unsigned) prg_argc; ++i) {
-      char *s = prg_argv[i];
-      if (s[0]=='A' && s[1] && !s[2]) s[1] = '\0';
-      fprintf(stderr, "\"%s\" ", prg_argv[i]);
-    }
-    fputc('\n', stderr);
-
-    /* Create the input files, pipes, etc. */
-    replay_create_files(&__exe_fs);
-
-    /* Run the test case machinery in a subprocess, eventually this parent
-       process should be a script or something which shells out to the actual
-       execution tool. */
-
-    int pid = fork();
-    if (pid < 0) {
-      perror("fork");
-      _exit(66);
-    } else if (pid == 0) {
-      /* Run the executable */
-      run_monitored(executable, prg_argc, prg_argv);
-      _exit(0);
-    } else {
-      /* Wait for the executable to finish. */
-      int res, status;
-
-      do {
-        res = waitpid(pid, &status, 0);
-      } while (res < 0 && errno == EINTR);
-
-      // Delete all files in the replay directory
-      replay_delete_files();
+  while (num_jobs)
+    wait_for_job();
 
-      if (res < 0) {
-        perror("waitpid");
-        _exit(66);
-      }
-
-      free(prg_argv);
-      kTest_free(input);
-    }
+  if (num_replayed > 1) {
+    unsigned i;
+    fprintf(stderr,
+            "\nKLEE-REPLAY: NOTE: replayed %u tests: %u normal, %u abnormal, "
+            "%u crashed, %u timed out\n",
+            num_replayed, num_normal, num_abnormal, num_crashed,
+            num_timed_out);
+    qsort(failed_tests, num_failed, sizeof(*failed_tests),
+          compare_failed_tests);
+    for (i = 0; i != num_failed; ++i)
+      fprintf(stderr, "KLEE-REPLAY: NOTE: %s: %s\n",
+              failed_tests[i].outcome == OUTCOME_TIMED_OUT ? "TIMED OUT"
+                                                           : "CRASHED",
+              failed_tests[i].test_name);
   }
-
   return 0;
 }
 
@@ -0,0 +1,242 @@
+//===-- Export.cpp ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Export.h"
+
+#include "klee/Support/StatsLog.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <sqlite3.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace llvm;
+using klee::StatsLogReader;
+using klee::StatsLogRecord;
+
+namespace {
+using Rows = std::vector<std::vector<std::int64_t>>;
+
+/// Reads a whole stats log and the values of the stats table after each row
+bool readLog(const std::string &path, StatsLogReader &reader, Rows &rows,
+             std::string &error) {
+  if (!reader.open(path, error))
+    return false;
+  while (auto kind = reader.next(error)) {
+    if (*kind == StatsLogRecord::Row)
+      rows.push_back(reader.getRow());
+  }
+  return error.empty();
+}
+
+bool execute(sqlite3 *db, const std::string &sql, std::string &error) {
+  char *message = nullptr;
+  if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &message) == SQLITE_OK)
+    return true;
+  error = message ? message : sqlite3_errmsg(db);
+  sqlite3_free(message);
+  return false;
+}
+
+std::string getInfo(const StatsLogReader &reader, const std::string &key) {
+  for (const auto &[k, value] : reader.getInfo())
+    if (k == key)
+      return value;
+  return {};
+}
+
+/// Writes the instruction level statistics like KLEE with
+/// --stats-format=sqlite, except for the calls
+bool writeIStats(raw_ostream &os, const StatsLogReader &reader,
+                 std::string &error) {
+  const auto &events = reader.getEvents();
+  const auto &files = reader.getFiles();
+  const auto &functions = reader.getFunctions();
+
+  os << "version: 1\n";
+  os << "creator: klee\n";
+  os << "pid: " << getInfo(reader, "pid") << "\n";
+  os << "cmd: " << getInfo(reader, "cmd") << "\n\n";
+  os << "\n";
+  os << "positions: instr line\n";
+  for (const StatsLogReader::Event &event : events)
+    os << "event: " << event.shortName << " : " << event.name << "\n";
+  os << "events: ";
+  for (const StatsLogReader::Event &event : events)
+    os << event.shortName << " ";
+  os << "\n";
+  os << "ob=" << getInfo(reader, "ob") << "\n";
+
+  std::string sourceFile;
+  unsigned currentFunction = functions.size();
+  for (const StatsLogReader::Instruction &instruction :
+       reader.getInstructions()) {
+    if (instruction.function >= functions.size() ||
+        instruction.file >= files.size() ||
+        functions[instruction.function].file >= files.size()) {
+      error = "instruction refers to an unknown function or file";
+      return false;
+    }
+
+    // Write the file before the function name, as KCachegrind otherwise
+    // creates two entries for the function
+    if (instruction.function != currentFunction) {
+      currentFunction = instruction.function;
+      const StatsLogReader::Function &function = functions[currentFunction];
+      if (files[function.file] != sourceFile) {
+        sourceFile = files[function.file];
+        os << "fl=" << sourceFile << "\n";
+      }
+      os << "fn=" << function.name << "\n";
+    }
+    if (files[instruction.file] != sourceFile) {
+      sourceFile = files[instruction.file];
+      os << "fl=" << sourceFile << "\n";
+    }
+
+    os << instruction.assemblyLine << " " << instruction.line << " ";
+    for (unsigned event = 0; event != events.size(); ++event)
+      os << reader.getInstructionStat(instruction.id, event) << " ";
+    os << "\n";
+  }
+  return true;
+}
+} // namespace
+
+bool createStatsTable(sqlite3 *db,
+                      const std::vector<StatsLogReader::Column> &columns,
+                      std::string &error) {
+  std::string create = "CREATE TABLE stats (";
+  for (std::size_t i = 0; i != columns.size(); ++i) {
+    // Names are quoted, as they come from the log
+    std::string name = columns[i].name;
+    for (std::size_t p = 0; (p = name.find('"', p)) != std::string::npos;
+         p += 2)
+      name.insert(p, 1, '"');
+    create += (i ? ",\"" : "\"") + name + "\"" +
+              (columns[i].real ? " REAL" : " INTEGER");
+  }
+  create += ')';
+  return execute(db, create, error);
+}
+
+bool insertStatsRows(sqlite3 *db, const Rows &rows, std::string &error) {
+  if (rows.empty())
+    return true;
+  std::string insert = "INSERT INTO stats VALUES (";
+  for (std::size_t i = 0; i != rows.front().size(); ++i)
+    insert += i ? ",?" : "?";
+  insert += ')';
+
+  if (!execute(db, "BEGIN TRANSACTION", error))
+    return false;
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db, insert.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    error = sqlite3_errmsg(db);
+    std::string ignored;
+    execute(db, "ROLLBACK TRANSACTION", ignored);
+    return false;
+  }
+  for (const std::vector<std::int64_t> &row : rows) {
+    for (std::size_t i = 0; i != row.size(); ++i)
+      sqlite3_bind_int64(stmt, i + 1, row[i]);
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+      error = sqlite3_errmsg(db);
+      sqlite3_finalize(stmt);
+      std::string ignored;
+      execute(db, "ROLLBACK TRANSACTION", ignored);
+      return false;
+    }
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+  return execute(db, "END TRANSACTION", error);
+}
+
+bool exportStatsLog(const std::string &directory, std::string &error) {
+  fs::path const statsPath = fs::path(directory) / "run.stats";
+  fs::path const istatsPath = fs::path(directory) / "run.istats";
+  std::error_code ec;
+  for (const fs::path &path : {statsPath, istatsPath}) {
+    if (fs::exists(path, ec)) {
+      error = path.string() + " already exists";
+      return false;
+    }
+  }
+
+  StatsLogReader reader;
+  Rows rows;
+  if (!readLog((fs::path(directory) / "run.statslog").string(), reader, rows,
+               error))
+    return false;
+
+  // Both files are written under temporary names and only renamed once both
+  // are complete, so that a failed export can simply be repeated
+  fs::path const statsTemp = statsPath.string() + ".tmp";
+  fs::path const istatsTemp = istatsPath.string() + ".tmp";
+  auto fail = [&](const std::string &message) {
+    error = message;
+    fs::remove(statsTemp, ec);
+    fs::remove(istatsTemp, ec);
+    return false;
+  };
+  fs::remove(statsTemp, ec);
+  fs::remove(istatsTemp, ec);
+
+  bool const hasStats = !reader.getColumns().empty();
+  if (hasStats) {
+    sqlite3 *handle = nullptr;
+    int rc = sqlite3_open_v2(statsTemp.c_str(), &handle,
+                             SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                             nullptr);
+    std::unique_ptr<sqlite3, decltype(&sqlite3_close)> db(handle,
+                                                          sqlite3_close);
+    if (rc != SQLITE_OK)
+      return fail(sqlite3_errmsg(db.get()));
+    std::string message;
+    if (!createStatsTable(db.get(), reader.getColumns(), message) ||
+        !insertStatsRows(db.get(), rows, message))
+      return fail(statsPath.string() + ": " + message);
+  }
+
+  bool const hasIStats = !reader.getEvents().empty();
+  if (hasIStats) {
+    raw_fd_ostream os(istatsTemp.string(), ec, sys::fs::OF_None);
+    if (ec)
+      return fail("cannot open " + istatsTemp.string() + ": " + ec.message());
+    std::string message;
+    if (!writeIStats(os, reader, message))
+      return fail(message);
+    os.close();
+    if (os.has_error())
+      return fail("cannot write " + istatsTemp.string() + ": " +
+                  os.error().message());
+  }
+
+  if (hasStats) {
+    fs::rename(statsTemp, statsPath, ec);
+    if (ec)
+      return fail("cannot rename " + statsTemp.string() + ": " + ec.message());
+  }
+  if (hasIStats) {
+    fs::rename(istatsTemp, istatsPath, ec);
+    if (ec) {
+      fs::remove(statsPath, ec);
+      return fail("cannot rename " + istatsTemp.string() + ": " +
+                  ec.message());
+    }
+  }
+  return true;
+}
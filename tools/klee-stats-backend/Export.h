@@ -0,0 +1,39 @@
+//===-- Export.h ------------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPORT_H
+#define KLEE_EXPORT_H
+
+#include "klee/Support/StatsLog.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct sqlite3;
+
+/// Creates the stats table of a database with the columns of a stats log.
+/// Returns false and sets error on failure.
+bool createStatsTable(sqlite3 *db,
+                      const std::vector<klee::StatsLogReader::Column> &columns,
+                      std::string &error);
+
+/// Appends rows to the stats table in one transaction. Returns false and sets
+/// error on failure.
+bool insertStatsRows(sqlite3 *db,
+                     const std::vector<std::vector<std::int64_t>> &rows,
+                     std::string &error);
+
+/// Converts the run.statslog of a KLEE output directory into run.stats and
+/// run.istats, which must not exist yet. Calls are not part of the log, so
+/// run.istats contains no call entries. Returns false and sets error on
+/// failure.
+bool exportStatsLog(const std::string &directory, std::string &error);
+
+#endif /* KLEE_EXPORT_H */
@@ -0,0 +1,88 @@
+//===-- Printers.cpp --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Printers.h"
+
+#include "llvm/Support/Format.h"
+
+#include <algorithm>
+#include <set>
+
+using namespace llvm;
+
+void printJSON(raw_ostream &os, const std::vector<RunStats> &runs) {
+  std::vector<json::Object> summaries;
+  for (const RunStats &run : runs)
+    summaries.push_back(run.getSummary());
+
+  json::Object result;
+  if (runs.size() > 1)
+    result["total"] = getTotal(summaries);
+  json::Array array;
+  for (json::Object &summary : summaries)
+    array.push_back(std::move(summary));
+  result["runs"] = std::move(array);
+  os << json::Value(std::move(result)) << '\n';
+}
+
+static void printCSVValue(raw_ostream &os, const json::Value *value) {
+  if (!value)
+    return;
+  if (auto integer = value->getAsInteger()) {
+    os << *integer;
+  } else if (auto number = value->getAsNumber()) {
+    os << format("%.2f", *number);
+  } else if (auto string = value->getAsString()) {
+    if (string->find_first_of(",\"\n") == StringRef::npos) {
+      os << *string;
+      return;
+    }
+    os << '"';
+    for (char c : *string)
+      os << (c == '"' ? "\"\"" : StringRef(&c, 1));
+    os << '"';
+  }
+}
+
+void printCSV(raw_ostream &os, const std::vector<RunStats> &runs) {
+  std::vector<json::Object> summaries;
+  for (const RunStats &run : runs)
+    summaries.push_back(run.getSummary());
+
+  // The path and the columns of the stats table come first, followed by the
+  // aggregated and derived columns
+  std::vector<std::string> header{"Path"};
+  for (const RunStats &run : runs) {
+    for (const std::string &column : run.getColumns()) {
+      if (std::find(header.begin(), header.end(), column) == header.end())
+        header.push_back(column);
+    }
+  }
+  std::set<std::string> derived;
+  for (const json::Object &summary : summaries) {
+    for (const auto &entry : summary) {
+      if (std::find(header.begin(), header.end(), entry.first.str()) ==
+          header.end())
+        derived.insert(entry.first.str());
+    }
+  }
+  header.insert(header.end(), derived.begin(), derived.end());
+
+  for (std::size_t i = 0; i != header.size(); ++i)
+    os << (i ? "," : "") << header[i];
+  os << '\n';
+  for (const json::Object &summary : summaries) {
+    for (std::size_t i = 0; i != header.size(); ++i) {
+      if (i)
+        os << ',';
+      printCSVValue(os, summary.get(header[i]));
+    }
+    os << '\n';
+  }
+}
@@ -0,0 +1,26 @@
+//===-- Printers.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PRINTERS_H
+#define KLEE_PRINTERS_H
+
+#include "RunStats.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <vector>
+
+/// Prints the summaries of all runs and, for more than one run, their total
+/// as a JSON object {"runs": [...], "total": {...}}
+void printJSON(llvm::raw_ostream &os, const std::vector<RunStats> &runs);
+
+/// Prints one line of comma-separated values per run
+void printCSV(llvm::raw_ostream &os, const std::vector<RunStats> &runs);
+
+#endif /* KLEE_PRINTERS_H */
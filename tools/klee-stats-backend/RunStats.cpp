@@ -0,0 +1,437 @@
+//===-- RunStats.cpp --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "RunStats.h"
+
+#include "Export.h"
+
+#include "klee/Support/StatsLog.h"
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <thread>
+
+namespace fs = std::filesystem;
+using namespace llvm;
+
+namespace {
+using Database = std::unique_ptr<sqlite3, decltype(&sqlite3_close)>;
+using Statement = std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)>;
+
+Statement prepare(sqlite3 *db, const char *query) {
+  sqlite3_stmt *stmt = nullptr;
+  sqlite3_prepare_v2(db, query, -1, &stmt, nullptr);
+  return Statement(stmt, sqlite3_finalize);
+}
+
+json::Value getValue(sqlite3_stmt *stmt, int column) {
+  switch (sqlite3_column_type(stmt, column)) {
+  case SQLITE_INTEGER:
+    return static_cast<std::int64_t>(sqlite3_column_int64(stmt, column));
+  case SQLITE_FLOAT:
+    return sqlite3_column_double(stmt, column);
+  case SQLITE_TEXT:
+    return json::fixUTF8(
+        reinterpret_cast<const char *>(sqlite3_column_text(stmt, column)));
+  default:
+    return nullptr;
+  }
+}
+
+bool isKleeOutDir(const fs::path &path) {
+  std::error_code ec;
+  return fs::exists(path / "info", ec) &&
+         (fs::exists(path / "run.stats", ec) ||
+          fs::exists(path / "run.statslog", ec));
+}
+} // namespace
+
+std::string RunStats::getDatabasePath() const {
+  return (fs::path(directory) / "run.stats").string();
+}
+
+std::string RunStats::getLogPath() const {
+  return (fs::path(directory) / "run.statslog").string();
+}
+
+bool RunStats::usesLog() const {
+  std::error_code ec;
+  return !fs::exists(getDatabasePath(), ec) && fs::exists(getLogPath(), ec);
+}
+
+void RunStats::reset() {
+  lastRowId = 0;
+  logRunId = logOffset = 0;
+  logTable.reset();
+  columns.clear();
+  lastRecord.clear();
+  rows = 0;
+  mallocUsageSum = mallocUsageMax = 0;
+  numStatesSum = numStatesMax = 0;
+}
+
+bool RunStats::update(std::string &error) {
+  if (usesLog())
+    return updateFromLog(error);
+
+  // The database is opened for writing like in klee-stats, as reading a
+  // database in WAL mode may have to create its shared memory file
+  sqlite3 *handle = nullptr;
+  int rc = sqlite3_open_v2(getDatabasePath().c_str(), &handle,
+                           SQLITE_OPEN_READWRITE, nullptr);
+  Database db(handle, sqlite3_close);
+  if (rc != SQLITE_OK) {
+    error = sqlite3_errmsg(db.get());
+    return false;
+  }
+
+  // Empty databases have no stats table
+  Statement hasTable = prepare(
+      db.get(), "SELECT 1 FROM sqlite_master WHERE type = 'table' AND "
+                "name = 'stats'");
+  if (!hasTable) {
+    error = sqlite3_errmsg(db.get());
+    return false;
+  }
+  if (sqlite3_step(hasTable.get()) != SQLITE_ROW) {
+    reset();
+    return true;
+  }
+
+  // The database was replaced by a new run if the last row read changed
+  if (lastRowId) {
+    auto wallTime = std::find(columns.begin(), columns.end(), "WallTime");
+    Statement lastRow =
+        prepare(db.get(), "SELECT WallTime FROM stats WHERE rowid = ?");
+    if (!lastRow) {
+      error = sqlite3_errmsg(db.get());
+      return false;
+    }
+    sqlite3_bind_int64(lastRow.get(), 1, lastRowId);
+    if (wallTime == columns.end() ||
+        sqlite3_step(lastRow.get()) != SQLITE_ROW ||
+        getValue(lastRow.get(), 0) !=
+            lastRecord[wallTime - columns.begin()])
+      reset();
+  }
+
+  Statement newRows = prepare(
+      db.get(), "SELECT rowid, * FROM stats WHERE rowid > ? ORDER BY rowid");
+  if (!newRows) {
+    error = sqlite3_errmsg(db.get());
+    return false;
+  }
+  sqlite3_bind_int64(newRows.get(), 1, lastRowId);
+
+  int const numColumns = sqlite3_column_count(newRows.get()) - 1;
+  int mallocUsage = -1;
+  int numStates = -1;
+  std::vector<std::string> newColumns;
+  for (int i = 0; i != numColumns; ++i) {
+    newColumns.emplace_back(sqlite3_column_name(newRows.get(), i + 1));
+    if (newColumns.back() == "MallocUsage")
+      mallocUsage = i + 1;
+    else if (newColumns.back() == "NumStates")
+      numStates = i + 1;
+  }
+
+  while ((rc = sqlite3_step(newRows.get())) == SQLITE_ROW) {
+    lastRowId = sqlite3_column_int64(newRows.get(), 0);
+    columns = newColumns;
+    lastRecord.clear();
+    for (int i = 0; i != numColumns; ++i)
+      lastRecord.push_back(getValue(newRows.get(), i + 1));
+
+    ++rows;
+    if (mallocUsage >= 0) {
+      double const value = sqlite3_column_double(newRows.get(), mallocUsage);
+      mallocUsageSum += value;
+      mallocUsageMax = std::max(mallocUsageMax, value);
+    }
+    if (numStates >= 0) {
+      double const value = sqlite3_column_double(newRows.get(), numStates);
+      numStatesSum += value;
+      numStatesMax = std::max(numStatesMax, value);
+    }
+  }
+  if (rc != SQLITE_DONE) {
+    error = sqlite3_errmsg(db.get());
+    return false;
+  }
+  return true;
+}
+
+void RunStats::keepLogTableInMemory() {
+  // The rows read so far are not kept, so start over
+  keepLogTable = true;
+  reset();
+}
+
+bool RunStats::updateFromLog(std::string &error) {
+  klee::StatsLogReader reader;
+  if (!reader.open(getLogPath(), error))
+    return false;
+
+  if (reader.getRunId() != logRunId) {
+    reset();
+    logRunId = reader.getRunId();
+  } else if (logOffset) {
+    // Which columns hold reals is only needed to create a table, which is
+    // done when reading from the start
+    std::vector<klee::StatsLogReader::Column> savedColumns;
+    std::vector<std::int64_t> savedRow;
+    for (std::size_t i = 0; i != columns.size(); ++i) {
+      auto value = lastRecord[i].getAsInteger();
+      savedColumns.push_back({columns[i], false});
+      savedRow.push_back(value ? *value : 0);
+    }
+    reader.restore(logOffset, std::move(savedColumns), std::move(savedRow));
+  }
+
+  std::vector<std::vector<std::int64_t>> newRows;
+  while (auto kind = reader.next(error)) {
+    logOffset = reader.getOffset();
+    if (*kind != klee::StatsLogRecord::Row)
+      continue;
+    if (keepLogTable)
+      newRows.push_back(reader.getRow());
+
+    columns.clear();
+    lastRecord.clear();
+    double mallocUsage = 0;
+    double numStates = 0;
+    for (std::size_t i = 0; i != reader.getColumns().size(); ++i) {
+      const std::string &name = reader.getColumns()[i].name;
+      std::int64_t const value = reader.getRow()[i];
+      columns.push_back(name);
+      lastRecord.push_back(value);
+      if (name == "MallocUsage")
+        mallocUsage = value;
+      else if (name == "NumStates")
+        numStates = value;
+    }
+
+    ++rows;
+    mallocUsageSum += mallocUsage;
+    mallocUsageMax = std::max(mallocUsageMax, mallocUsage);
+    numStatesSum += numStates;
+    numStatesMax = std::max(numStatesMax, numStates);
+  }
+  if (!error.empty())
+    return false;
+
+  if (keepLogTable && !newRows.empty()) {
+    if (!logTable) {
+      sqlite3 *handle = nullptr;
+      int rc = sqlite3_open_v2(":memory:", &handle, SQLITE_OPEN_READWRITE,
+                               nullptr);
+      logTable.reset(handle, sqlite3_close);
+      if (rc != SQLITE_OK ||
+          !createStatsTable(handle, reader.getColumns(), error)) {
+        if (error.empty())
+          error = sqlite3_errmsg(handle);
+        reset();
+        return false;
+      }
+    }
+    if (!insertStatsRows(logTable.get(), newRows, error)) {
+      reset();
+      return false;
+    }
+  }
+  return true;
+}
+
+json::Object RunStats::getSummary() const {
+  json::Object summary;
+  for (std::size_t i = 0; i != columns.size(); ++i)
+    summary[columns[i]] = lastRecord[i];
+  summary["Path"] = directory;
+
+  double const MiB = 1024 * 1024;
+  if (rows) {
+    summary["MaxMem"] = mallocUsageMax / MiB;
+    summary["AvgMem"] = mallocUsageSum / rows / MiB;
+    summary["MaxStates"] = static_cast<std::int64_t>(numStatesMax);
+    summary["AvgStates"] = numStatesSum / rows;
+  }
+
+  // Recorded times are in microseconds
+  for (const char *key : {"UserTime", "WallTime", "QueryTime", "SolverTime",
+                          "CexCacheTime", "ForkTime", "ResolveTime"}) {
+    if (auto value = summary.getNumber(key))
+      summary[key] = *value / 1000000;
+  }
+  if (auto value = summary.getNumber("MallocUsage"))
+    summary["MallocUsage"] = *value / MiB;
+
+  auto constructs = summary.getNumber("NumQueryConstructs");
+  auto queries = summary.getNumber("SolverQueries");
+  if (constructs && queries)
+    summary["AvgQC"] =
+        static_cast<std::int64_t>(*constructs / std::max(1.0, *queries));
+
+  auto covered = summary.getInteger("CoveredInstructions");
+  auto uncovered = summary.getInteger("UncoveredInstructions");
+  if (covered && uncovered) {
+    summary["ICount"] = *covered + *uncovered;
+    if (*covered + *uncovered)
+      summary["ICov"] = 100.0 * *covered / (*covered + *uncovered);
+  }
+
+  auto full = summary.getNumber("FullBranches");
+  auto partial = summary.getNumber("PartialBranches");
+  auto branches = summary.getNumber("NumBranches");
+  if (full && partial && branches)
+    summary["BCov"] =
+        *branches ? 100 * (2 * *full + *partial) / (2 * *branches) : 100.0;
+
+  auto wallTime = summary.getNumber("WallTime");
+  for (const char *key :
+       {"SolverTime", "CexCacheTime", "ForkTime", "ResolveTime", "UserTime"}) {
+    auto value = summary.getNumber(key);
+    if (wallTime && *wallTime && value)
+      summary[std::string("Rel") + key] = 100 * *value / *wallTime;
+  }
+  return summary;
+}
+
+json::Value RunStats::saveState() const {
+  return json::Object{
+      {"lastRowId", lastRowId},
+      {"logRunId", static_cast<std::int64_t>(logRunId)},
+      {"logOffset", static_cast<std::int64_t>(logOffset)},
+      {"columns", json::Array(columns)},
+      {"lastRecord", json::Array(lastRecord)},
+      {"rows", static_cast<std::int64_t>(rows)},
+      {"mallocUsageSum", mallocUsageSum},
+      {"mallocUsageMax", mallocUsageMax},
+      {"numStatesSum", numStatesSum},
+      {"numStatesMax", numStatesMax},
+  };
+}
+
+bool RunStats::loadState(const json::Value &state) {
+  const json::Object *object = state.getAsObject();
+  if (!object)
+    return false;
+  auto savedLastRowId = object->getInteger("lastRowId");
+  auto savedRows = object->getInteger("rows");
+  auto savedMallocUsageSum = object->getNumber("mallocUsageSum");
+  auto savedMallocUsageMax = object->getNumber("mallocUsageMax");
+  auto savedNumStatesSum = object->getNumber("numStatesSum");
+  auto savedNumStatesMax = object->getNumber("numStatesMax");
+  const json::Array *savedColumns = object->getArray("columns");
+  const json::Array *savedLastRecord = object->getArray("lastRecord");
+  if (!savedLastRowId || !savedRows || !savedMallocUsageSum ||
+      !savedMallocUsageMax || !savedNumStatesSum || !savedNumStatesMax ||
+      !savedColumns || !savedLastRecord ||
+      savedColumns->size() != savedLastRecord->size())
+    return false;
+
+  std::vector<std::string> names;
+  for (const json::Value &column : *savedColumns) {
+    auto name = column.getAsString();
+    if (!name)
+      return false;
+    names.push_back(name->str());
+  }
+
+  lastRowId = *savedLastRowId;
+  // States saved before stats logs were supported have no log position
+  auto savedLogRunId = object->getInteger("logRunId");
+  auto savedLogOffset = object->getInteger("logOffset");
+  logRunId = savedLogRunId ? *savedLogRunId : 0;
+  logOffset = savedLogOffset ? *savedLogOffset : 0;
+  columns = std::move(names);
+  lastRecord.assign(savedLastRecord->begin(), savedLastRecord->end());
+  rows = *savedRows;
+  mallocUsageSum = *savedMallocUsageSum;
+  mallocUsageMax = *savedMallocUsageMax;
+  numStatesSum = *savedNumStatesSum;
+  numStatesMax = *savedNumStatesMax;
+  return true;
+}
+
+std::vector<std::string>
+findKleeOutDirs(const std::vector<std::string> &paths) {
+  std::vector<std::string> result;
+  for (const std::string &path : paths) {
+    if (isKleeOutDir(path)) {
+      result.push_back(path);
+      continue;
+    }
+
+    std::vector<std::string> found;
+    std::error_code ec;
+    for (fs::recursive_directory_iterator
+             it(path, fs::directory_options::skip_permission_denied, ec),
+         end;
+         !ec && it != end; it.increment(ec)) {
+      if (it->is_directory(ec) && isKleeOutDir(it->path()))
+        found.push_back(it->path().string());
+    }
+    std::sort(found.begin(), found.end());
+    result.insert(result.end(), found.begin(), found.end());
+  }
+  return result;
+}
+
+void updateAll(std::vector<RunStats> &runs, unsigned jobs) {
+  std::atomic<std::size_t> next{0};
+  auto worker = [&]() {
+    for (std::size_t i; (i = next++) < runs.size();) {
+      std::string error;
+      if (!runs[i].update(error))
+        errs() << "klee-stats-backend: cannot read "
+               << (runs[i].usesLog() ? runs[i].getLogPath()
+                                     : runs[i].getDatabasePath())
+               << ": " << error << '\n';
+    }
+  };
+
+  std::vector<std::thread> threads;
+  jobs = std::min<std::size_t>(std::max(1u, jobs), runs.size());
+  for (unsigned i = 1; i < jobs; ++i)
+    threads.emplace_back(worker);
+  worker();
+  for (std::thread &thread : threads)
+    thread.join();
+}
+
+json::Object getTotal(const std::vector<json::Object> &summaries) {
+  // Averages and percentages are averaged, maxima maximized and all other
+  // columns summed up
+  json::Object total;
+  for (const json::Object &summary : summaries) {
+    for (const auto &[key, value] : summary) {
+      auto number = value.getAsNumber();
+      if (!number)
+        continue;
+      StringRef name = key;
+      double result;
+      auto current = total.getNumber(name);
+      if (name.take_front(3) == "Max")
+        result = current ? std::max(*current, *number) : *number;
+      else if (name.take_front(3) == "Avg" || name.take_front(3) == "Rel" ||
+               name == "ICov" || name == "BCov")
+        result = (current ? *current : 0) + *number / summaries.size();
+      else
+        result = (current ? *current : 0) + *number;
+      // The key is copied, as the summaries may not outlive the total
+      total[name.str()] = result;
+    }
+  }
+  total["Path"] = "Total (" + std::to_string(summaries.size()) + ")";
+  return total;
+}
@@ -0,0 +1,93 @@
+//===-- RunStats.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_RUNSTATS_H
+#define KLEE_RUNSTATS_H
+
+#include "llvm/Support/JSON.h"
+
+struct sqlite3;
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// The statistics of a single KLEE run, read from its run.stats database or,
+/// with --stats-format=log, from its run.statslog. Only the rows added since
+/// the previous update are read, and the state needed to continue can be
+/// saved, so that repeated polling stays cheap.
+class RunStats {
+  std::string directory;
+
+  // rowid of the last row read
+  std::int64_t lastRowId = 0;
+  std::vector<std::string> columns;
+  std::vector<llvm::json::Value> lastRecord;
+
+  // run and position after the last record read from a stats log
+  std::uint64_t logRunId = 0;
+  std::uint64_t logOffset = 0;
+  // in-memory copy of the stats table of a stats log, extended by every update
+  bool keepLogTable = false;
+  std::shared_ptr<sqlite3> logTable;
+
+  // aggregates over all rows
+  std::uint64_t rows = 0;
+  double mallocUsageSum = 0;
+  double mallocUsageMax = 0;
+  double numStatesSum = 0;
+  double numStatesMax = 0;
+
+  void reset();
+  bool updateFromLog(std::string &error);
+
+public:
+  explicit RunStats(std::string directory) : directory(std::move(directory)) {}
+
+  const std::string &getDirectory() const { return directory; }
+  std::string getDatabasePath() const;
+  std::string getLogPath() const;
+  /// Returns true if the run wrote a stats log instead of a database
+  bool usesLog() const;
+
+  /// Reads the rows added since the last update. Starts over if the database
+  /// or log was replaced by a new run. Returns false and sets error on
+  /// failure.
+  bool update(std::string &error);
+
+  /// Makes updates keep an in-memory copy of the stats table of a stats log,
+  /// so that it can be queried without reading the whole log again
+  void keepLogTableInMemory();
+  /// Returns the copy of the stats table, or nullptr if there is none yet
+  sqlite3 *getLogTable() const { return logTable.get(); }
+
+  /// Column names of the stats table, as of the last update
+  const std::vector<std::string> &getColumns() const { return columns; }
+
+  /// Returns the last record together with the aggregated and derived
+  /// columns, as shown by klee-stats --print-all
+  llvm::json::Object getSummary() const;
+
+  llvm::json::Value saveState() const;
+  /// Restores a state saved by saveState(), returns false if it is invalid
+  bool loadState(const llvm::json::Value &state);
+};
+
+/// Finds the KLEE output directories in or below the given paths
+std::vector<std::string> findKleeOutDirs(const std::vector<std::string> &paths);
+
+/// Updates all runs, using up to jobs threads
+void updateAll(std::vector<RunStats> &runs, unsigned jobs);
+
+/// Computes the total of several summaries, as in the last row of the
+/// klee-stats table
+llvm::json::Object getTotal(const std::vector<llvm::json::Object> &summaries);
+
+#endif /* KLEE_RUNSTATS_H */
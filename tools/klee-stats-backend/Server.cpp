@@ -0,0 +1,380 @@
+//===-- Server.cpp ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Server.h"
+
+#include "Export.h"
+#include "Printers.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Error.h"
+
+#include <sqlite3.h>
+
+#include <netdb.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <optional>
+#include <sstream>
+
+using namespace llvm;
+
+namespace {
+struct Response {
+  unsigned status;
+  const char *contentType;
+  std::string body;
+};
+
+const std::size_t maxRequestSize = 1 << 20;
+/// Time a client has to send its request and receive the response, so that
+/// a client that stalls cannot block the server
+const std::chrono::seconds clientTimeout(5);
+
+Response makeJSON(json::Value value) {
+  std::string body;
+  raw_string_ostream os(body);
+  os << value;
+  return {200, "application/json", os.str()};
+}
+
+Response makeError(unsigned status, const std::string &message) {
+  return {status, "text/plain", message + '\n'};
+}
+
+/// Returns the start time of a run from its info file, in seconds since the
+/// epoch
+std::optional<double> getStartTime(const RunStats &run) {
+  std::ifstream info(std::filesystem::path(run.getDirectory()) / "info");
+  std::string line;
+  while (std::getline(info, line)) {
+    if (line.rfind("Started: ", 0) != 0)
+      continue;
+    // KLEE records the start in local time
+    std::tm tm{};
+    tm.tm_isdst = -1;
+    std::istringstream in(line.substr(std::strlen("Started: ")));
+    in >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
+    if (in.fail())
+      return std::nullopt;
+    return static_cast<double>(std::mktime(&tm));
+  }
+  return std::nullopt;
+}
+
+/// Parses a UTC time sent by Grafana, e.g. 2024-01-31T12:00:00.000Z
+std::optional<double> parseTime(StringRef text) {
+  std::tm tm{};
+  std::istringstream in(text.str());
+  in >> std::get_time(&tm, "%Y-%m-%dT%H:%M:%S");
+  if (in.fail())
+    return std::nullopt;
+  double fraction = 0;
+  if (in.peek() == '.')
+    in >> fraction;
+  return static_cast<double>(timegm(&tm)) + fraction;
+}
+
+/// Returns the averages of the requested columns over intervals of the
+/// requested time range, in Grafana's time series format
+Response query(RunStats &run, StringRef body) {
+  Expected<json::Value> request = json::parse(body);
+  if (!request)
+    return makeError(400, toString(request.takeError()));
+  const json::Object *object = request->getAsObject();
+  const json::Object *range = object ? object->getObject("range") : nullptr;
+  if (!range)
+    return makeError(400, "invalid query");
+  const json::Array *targets = object->getArray("targets");
+  auto interval = object->getNumber("intervalMs");
+  auto limit = object->getInteger("maxDataPoints");
+  auto from = range->getString("from");
+  auto to = range->getString("to");
+  if (!targets || !interval || !limit || !from || !to)
+    return makeError(400, "invalid query");
+  auto fromTime = parseTime(*from);
+  auto toTime = parseTime(*to);
+  if (!fromTime || !toTime)
+    return makeError(400, "invalid time range");
+
+  // Only plain column names can be used in the query
+  std::vector<std::string> columns;
+  for (const json::Value &target : *targets) {
+    const json::Object *t = target.getAsObject();
+    if (!t)
+      continue;
+    auto name = t->getString("target");
+    if (name && !name->empty() && all_of(*name, isAlnum))
+      columns.push_back(name->str());
+  }
+
+  auto startTime = getStartTime(run);
+  if (!startTime)
+    return makeError(500, "cannot find KLEE's start time");
+
+  // Times in the database are microseconds since the start of KLEE
+  double const begin = std::max(*fromTime - *startTime, 0.0);
+  double const end =
+      *toTime - *startTime > begin ? *toTime - *startTime : begin + 100;
+
+  std::string sql = "SELECT WallTime + ?";
+  for (const std::string &column : columns)
+    sql += ", AVG(" + column + ")";
+  sql += " FROM stats WHERE WallTime >= ? AND WallTime <= ? GROUP BY "
+         "WallTime / ? LIMIT ?";
+
+  // Stats logs are queried through the in-memory copy of their stats table,
+  // which the update before the query extended
+  bool const usesLog = run.usesLog();
+  sqlite3 *db = usesLog ? run.getLogTable() : nullptr;
+  sqlite3_stmt *stmt = nullptr;
+  if (usesLog && !db)
+    return makeError(500, "the stats log has no rows yet");
+  if ((!usesLog && sqlite3_open_v2(run.getDatabasePath().c_str(), &db,
+                                   SQLITE_OPEN_READWRITE,
+                                   nullptr) != SQLITE_OK) ||
+      sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    Response response = makeError(500, sqlite3_errmsg(db));
+    if (!usesLog)
+      sqlite3_close(db);
+    return response;
+  }
+  sqlite3_bind_double(stmt, 1, *startTime * 1000000);
+  sqlite3_bind_double(stmt, 2, begin * 1000000);
+  sqlite3_bind_double(stmt, 3, end * 1000000);
+  sqlite3_bind_int64(stmt, 4, static_cast<std::int64_t>(*interval * 1000));
+  sqlite3_bind_int64(stmt, 5, *limit);
+
+  std::vector<json::Array> datapoints(columns.size());
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    double const time = sqlite3_column_double(stmt, 0);
+    auto const timestamp = static_cast<std::int64_t>(time / 1000);
+    for (std::size_t i = 0; i != columns.size(); ++i) {
+      json::Value value = nullptr;
+      if (sqlite3_column_type(stmt, i + 1) != SQLITE_NULL) {
+        double field = sqlite3_column_double(stmt, i + 1);
+        // Times other than the wall and user time are shown relative to the
+        // wall time
+        StringRef column = columns[i];
+        if (column.contains("Time") && !column.contains("Wall") &&
+            !column.contains("User"))
+          field = field / (time - *startTime * 1000000) * 100;
+        value = field;
+      }
+      datapoints[i].push_back(json::Array{std::move(value), timestamp});
+    }
+  }
+  sqlite3_finalize(stmt);
+  if (!usesLog)
+    sqlite3_close(db);
+
+  json::Array result;
+  for (std::size_t i = 0; i != columns.size(); ++i)
+    result.push_back(json::Object{{"target", columns[i]},
+                                  {"datapoints", std::move(datapoints[i])}});
+  return makeJSON(std::move(result));
+}
+
+Response handle(std::vector<RunStats> &runs, unsigned jobs, StringRef method,
+                StringRef path, StringRef body) {
+  if (path == "/")
+    return {200, "text/plain", "OK"};
+
+  if (path == "/query") {
+    if (method != "POST")
+      return makeError(405, "method not allowed");
+    std::string error;
+    if (!runs.front().update(error))
+      return makeError(500, error);
+    return query(runs.front(), body);
+  }
+
+  updateAll(runs, jobs);
+  if (path == "/search") {
+    json::Array columns;
+    for (const std::string &column : runs.front().getColumns())
+      columns.push_back(column);
+    return makeJSON(std::move(columns));
+  }
+
+  std::string output;
+  raw_string_ostream os(output);
+  if (path == "/stats") {
+    printJSON(os, runs);
+    return {200, "application/json", os.str()};
+  }
+  if (path == "/stats.csv") {
+    printCSV(os, runs);
+    return {200, "text/csv", os.str()};
+  }
+  return makeError(404, "not found");
+}
+
+/// Reads an HTTP request, returns false if the request is invalid or not
+/// complete within the client timeout
+bool readRequest(int fd, std::string &method, std::string &path,
+                 std::string &body) {
+  // The socket timeout only bounds each read, so a client sending a byte at a
+  // time is stopped by the deadline
+  auto const deadline = std::chrono::steady_clock::now() + clientTimeout;
+  auto readSome = [&](char *buffer, std::size_t size) -> ssize_t {
+    if (std::chrono::steady_clock::now() > deadline) {
+      errno = ETIMEDOUT;
+      return -1;
+    }
+    return read(fd, buffer, size);
+  };
+
+  std::string data;
+  char buffer[4096];
+  std::size_t headerEnd;
+  while ((headerEnd = data.find("\r\n\r\n")) == std::string::npos) {
+    ssize_t n = readSome(buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0 || data.size() + n > maxRequestSize)
+      return false;
+    data.append(buffer, n);
+  }
+
+  SmallVector<StringRef, 16> lines;
+  StringRef(data).substr(0, headerEnd).split(lines, "\r\n");
+  SmallVector<StringRef, 3> requestLine;
+  lines.front().split(requestLine, ' ');
+  if (requestLine.size() != 3)
+    return false;
+  method = requestLine[0].str();
+  path = requestLine[1].split('?').first.str();
+
+  std::size_t length = 0;
+  for (StringRef line : ArrayRef<StringRef>(lines).drop_front()) {
+    auto [name, value] = line.split(':');
+    if (name.trim().equals_insensitive("content-length") &&
+        value.trim().getAsInteger(10, length))
+      return false;
+  }
+  if (length > maxRequestSize)
+    return false;
+
+  body = data.substr(headerEnd + 4);
+  while (body.size() < length) {
+    ssize_t n =
+        readSome(buffer, std::min(sizeof(buffer), length - body.size()));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    body.append(buffer, n);
+  }
+  body.resize(length);
+  return true;
+}
+
+void writeResponse(int fd, const Response &response) {
+  const char *reason = response.status == 200   ? "OK"
+                       : response.status == 400 ? "Bad Request"
+                       : response.status == 404 ? "Not Found"
+                       : response.status == 405 ? "Method Not Allowed"
+                                                : "Internal Server Error";
+  std::string data;
+  raw_string_ostream os(data);
+  os << "HTTP/1.1 " << response.status << ' ' << reason << "\r\n"
+     << "Content-Type: " << response.contentType << "\r\n"
+     << "Content-Length: " << response.body.size() << "\r\n"
+     << "Connection: close\r\n\r\n"
+     << response.body;
+  os.flush();
+
+  for (std::size_t written = 0; written < data.size();) {
+    ssize_t n = write(fd, data.data() + written, data.size() - written);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return;
+    written += n;
+  }
+}
+} // namespace
+
+bool serve(std::vector<RunStats> &runs, unsigned jobs, const std::string &host,
+           unsigned port, std::string &error) {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  addrinfo *addresses;
+  if (int rc = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints,
+                           &addresses)) {
+    error = gai_strerror(rc);
+    return false;
+  }
+
+  int listener = -1;
+  for (addrinfo *address = addresses; address && listener < 0;
+       address = address->ai_next) {
+    listener = socket(address->ai_family, address->ai_socktype,
+                      address->ai_protocol);
+    if (listener < 0)
+      continue;
+    int const reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(listener, address->ai_addr, address->ai_addrlen) != 0 ||
+        listen(listener, 16) != 0) {
+      close(listener);
+      listener = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (listener < 0) {
+    error = std::string("cannot listen on ") + host + ':' +
+            std::to_string(port) + ": " + std::strerror(errno);
+    return false;
+  }
+
+  // Grafana queries the first run, whose stats log is kept in memory
+  runs.front().keepLogTableInMemory();
+
+  // Clients that disconnect early must not stop the server
+  signal(SIGPIPE, SIG_IGN);
+  while (true) {
+    int client = accept(listener, nullptr, nullptr);
+    if (client < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      error = std::string("accept: ") + std::strerror(errno);
+      close(listener);
+      return false;
+    }
+
+    // Requests are handled one at a time, so clients that stall are dropped
+    // once the timeout expires
+    timeval timeout{};
+    timeout.tv_sec = clientTimeout.count();
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string method, path, body;
+    if (readRequest(client, method, path, body))
+      writeResponse(client, handle(runs, jobs, method, path, body));
+    else
+      writeResponse(client, makeError(400, "invalid request"));
+    close(client);
+  }
+}
@@ -0,0 +1,28 @@
+//===-- Server.h ------------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SERVER_H
+#define KLEE_SERVER_H
+
+#include "RunStats.h"
+
+#include <string>
+#include <vector>
+
+/// Serves the statistics of the runs over HTTP, updating them on every
+/// request:
+///  - /stats and /stats.csv return the summaries of all runs,
+///  - /, /search and /query implement a Grafana JSON data source for the
+///    first run, like klee-stats --grafana, also for runs that wrote a stats
+///    log.
+/// Only returns on error.
+bool serve(std::vector<RunStats> &runs, unsigned jobs, const std::string &host,
+           unsigned port, std::string &error);
+
+#endif /* KLEE_SERVER_H */
@@ -0,0 +1,176 @@
+//===-- main.cpp ------------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Export.h"
+#include "Printers.h"
+#include "RunStats.h"
+#include "Server.h"
+
+#include "klee/Support/CompilerWarning.h"
+DISABLE_WARNING_PUSH
+DISABLE_WARNING_DEPRECATED_DECLARATIONS
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+DISABLE_WARNING_POP
+
+#include <cstdlib>
+#include <thread>
+
+using namespace llvm;
+
+namespace {
+cl::OptionCategory BackendCat("klee-stats-backend options");
+
+cl::list<std::string> Directories(cl::Positional, cl::OneOrMore,
+                                  cl::desc("<KLEE output directories>"),
+                                  cl::cat(BackendCat));
+
+enum class OutputFormat { JSON, CSV };
+
+cl::opt<OutputFormat>
+    Format("format", cl::desc("Output format (default=json)"),
+           cl::values(clEnumValN(OutputFormat::JSON, "json",
+                                 "One JSON object with all runs and their "
+                                 "total"),
+                      clEnumValN(OutputFormat::CSV, "csv",
+                                 "One line of comma-separated values per run")),
+           cl::init(OutputFormat::JSON), cl::cat(BackendCat));
+
+cl::opt<std::string> StateFile(
+    "state-file",
+    cl::desc("Continue reading the runs where the last invocation with the "
+             "same state file stopped, and save the new state to it"),
+    cl::cat(BackendCat));
+
+cl::opt<unsigned>
+    Jobs("jobs",
+         cl::desc("Number of runs read in parallel (default=number of cores)"),
+         cl::init(std::max(1u, std::thread::hardware_concurrency())),
+         cl::cat(BackendCat));
+
+cl::opt<bool> Export("export",
+                     cl::desc("Convert the run.statslog of each run into "
+                              "run.stats and run.istats (default=false)"),
+                     cl::cat(BackendCat));
+
+cl::opt<bool> Serve("serve",
+                    cl::desc("Serve the statistics over HTTP, including a "
+                             "Grafana JSON data source (default=false)"),
+                    cl::cat(BackendCat));
+
+cl::opt<std::string> Host("host",
+                          cl::desc("Address the server listens on "
+                                   "(default=127.0.0.1)"),
+                          cl::init("127.0.0.1"), cl::cat(BackendCat));
+
+cl::opt<unsigned> Port("port",
+                       cl::desc("Port the server listens on (default=5000)"),
+                       cl::init(5000), cl::cat(BackendCat));
+
+void loadState(std::vector<RunStats> &runs) {
+  auto buffer = MemoryBuffer::getFile(StateFile);
+  if (!buffer)
+    return;
+  Expected<json::Value> state = json::parse(buffer.get()->getBuffer());
+  if (!state) {
+    errs() << "klee-stats-backend: ignoring invalid state file " << StateFile
+           << ": " << toString(state.takeError()) << '\n';
+    return;
+  }
+  const json::Object *object = state->getAsObject();
+  for (RunStats &run : runs) {
+    const json::Value *saved = object ? object->get(run.getDirectory()) : nullptr;
+    if (saved && !run.loadState(*saved))
+      run = RunStats(run.getDirectory());
+  }
+}
+
+bool saveState(const std::vector<RunStats> &runs) {
+  json::Object state;
+  for (const RunStats &run : runs)
+    state[run.getDirectory()] = run.saveState();
+
+  // Replace the state atomically, so that concurrent readers never see a
+  // partially written file
+  std::string temp = StateFile + ".tmp";
+  std::error_code ec;
+  {
+    raw_fd_ostream os(temp, ec, sys::fs::OF_None);
+    if (!ec) {
+      os << json::Value(std::move(state));
+      os.close();
+      ec = os.error();
+    }
+  }
+  if (!ec)
+    ec = sys::fs::rename(temp, StateFile);
+  if (ec) {
+    errs() << "klee-stats-backend: cannot write state file " << StateFile
+           << ": " << ec.message() << '\n';
+    return false;
+  }
+  return true;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  cl::HideUnrelatedOptions(BackendCat);
+  cl::ParseCommandLineOptions(
+      argc, argv,
+      " klee-stats-backend\n\n"
+      "  Reads the statistics of KLEE runs incrementally and prints them as\n"
+      "  JSON or CSV, or serves them over HTTP. Runs with --stats-format=log\n"
+      "  can also be converted into the default format.\n");
+
+  std::vector<std::string> directories = findKleeOutDirs(Directories);
+  if (directories.empty()) {
+    errs() << "No KLEE output directory found\n";
+    return EXIT_FAILURE;
+  }
+
+  if (Export) {
+    int result = EXIT_SUCCESS;
+    for (const std::string &directory : directories) {
+      std::string error;
+      if (!exportStatsLog(directory, error)) {
+        errs() << "klee-stats-backend: cannot export " << directory << ": "
+               << error << '\n';
+        result = EXIT_FAILURE;
+      }
+    }
+    return result;
+  }
+
+  std::vector<RunStats> runs;
+  for (const std::string &directory : directories)
+    runs.emplace_back(directory);
+
+  if (Serve) {
+    std::string error;
+    serve(runs, Jobs, Host, Port, error);
+    errs() << "klee-stats-backend: " << error << '\n';
+    return EXIT_FAILURE;
+  }
+
+  if (!StateFile.empty())
+    loadState(runs);
+  updateAll(runs, Jobs);
+
+  if (Format == OutputFormat::JSON)
+    printJSON(outs(), runs);
+  else
+    printCSV(outs(), runs);
+
+  if (!StateFile.empty() && !saveState(runs))
+    return EXIT_FAILURE;
+  return EXIT_SUCCESS;
+}
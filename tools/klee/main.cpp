@@ -58,12 +58,19 @@ DISABLE_WARNING_POP
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <cerrno>
+#include <condition_variable>
 #include <ctime>
+#include <deque>
 #include <fstream>
 #include <iomanip>
 #include <iterator>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <unordered_set>
 
 using namespace llvm;
 using namespace klee;
@@ -128,6 +135,22 @@ namespace {
                 cl::desc("Write .sym.path files for each test case (default=false)"),
                 cl::cat(TestCaseCat));
 
+  cl::opt<bool>
+  PackKTests("pack-ktests",
+             cl::desc("Append the .ktest contents of all test cases to a single tests.ktestpack file instead of writing a file per test (default=false)"),
+             cl::cat(TestCaseCat));
+
+  cl::opt<bool>
+  WriteTestsInBackground("write-tests-in-background",
+                         cl::desc("Write the files of each test case on a separate thread, while execution continues. Only file output is moved off the interpreter thread; test inputs are still solved on it (default=false)"),
+                         cl::cat(TestCaseCat));
+
+  cl::opt<unsigned>
+  MaxPendingTestsSize("max-pending-tests-size",
+                      cl::desc("Wait for the background writer when the test cases not yet written exceed this size (in MB) (default=64)"),
+                      cl::init(64),
+                      cl::cat(TestCaseCat));
+
 
   /*** Startup options ***/
 
@@ -262,12 +285,12 @@ namespace {
 
   cl::list<std::string>
   SeedOutFile("seed-file",
-              cl::desc(".ktest file to be used as seed"),
+              cl::desc(".ktest file to be used as seed, or .ktestpack file with seeds"),
               cl::cat(SeedingCat));
 
   cl::list<std::string>
   SeedOutDir("seed-dir",
-             cl::desc("Directory with .ktest files to be used as seeds"),
+             cl::desc("Directory with .ktest or .ktestpack files to be used as seeds"),
              cl::cat(SeedingCat));
 
   cl::opt<unsigned>
@@ -319,21 +342,64 @@ namespace {
 
 namespace klee {
 extern cl::opt<std::string> MaxTime;
+extern cl::opt<bool> MinimizeTests;
+extern cl::opt<bool> ExternalCallsSandbox;
 class ExecutionState;
 }
 
 /***/
 
+class KleeHandler;
+
+namespace {
+/// The handler whose background writer may still have pending test cases
+KleeHandler *theBackgroundWriter = nullptr;
+
+/// The contents of the files of one test case, taken from the terminated
+/// state so that they can be written after the state is gone.
+struct TestCase {
+  unsigned id = 0;
+  bool hasSolution = false;
+  std::vector<std::pair<std::string, std::vector<unsigned char>>> assignments;
+  bool isError = false;
+  std::string errorMessage;
+  std::string errorSuffix;
+  std::vector<unsigned char> concreteBranches;
+  std::vector<unsigned char> symbolicBranches;
+  std::string kquery;
+  std::string cvc;
+  std::string smt2;
+  std::map<const std::string *, std::set<unsigned>> cov;
+  std::vector<std::uint32_t> coveredBlocks;
+  time::Span collectionTime;
+
+  /// Approximates the memory held by the test case.
+  std::size_t size() const {
+    std::size_t size = sizeof(*this) + errorMessage.size() +
+                       errorSuffix.size() + concreteBranches.size() +
+                       symbolicBranches.size() + kquery.size() + cvc.size() +
+                       smt2.size();
+    for (const auto &assignment : assignments)
+      size += assignment.first.size() + assignment.second.size();
+    for (const auto &entry : cov)
+      size += entry.second.size() * sizeof(unsigned);
+    size += coveredBlocks.size() * sizeof(std::uint32_t);
+    return size;
+  }
+};
+} // namespace
+
 class KleeHandler : public InterpreterHandler {
 private:
   Interpreter *m_interpreter;
   TreeStreamWriter *m_pathWriter, *m_symPathWriter;
   std::unique_ptr<llvm::raw_ostream> m_infoFile;
+  KTestPack *m_testPack = nullptr;
 
   SmallString<128> m_outputDirectory;
 
   unsigned m_numTotalTests;     // Number of tests received from the interpreter
-  unsigned m_numGeneratedTests; // Number of tests successfully generated
+  std::atomic<unsigned> m_numGeneratedTests; // Number of tests successfully generated
   unsigned m_pathsCompleted; // number of completed paths
   unsigned m_pathsExplored; // number of partially explored and completed paths
 
@@ -341,6 +407,33 @@ private:
   int m_argc;
   char **m_argv;
 
+  // used for writing test cases in the background, in the order of their ids
+  std::thread m_writerThread;
+  std::mutex m_writerMutex;
+  std::condition_variable m_writerCondition;
+  std::deque<std::unique_ptr<TestCase>> m_pendingTests;
+  std::size_t m_pendingTestsSize = 0;
+  unsigned m_numUnwrittenTests = 0; // pending tests, or being written
+  bool m_stopWriter = false;
+
+  // used for --minimize-tests: the blocks covered by the tests kept so far
+  std::unordered_set<std::uint32_t> m_coveredBlocks;
+  unsigned m_numMinimizedTests = 0; // number of tests given to minimization
+  unsigned m_numKeptTests = 0;      // number of those that were output
+  // the ids and covered blocks of the kept tests
+  std::vector<std::pair<unsigned, std::vector<std::uint32_t>>> m_keptTests;
+
+  /// Writes the files of \p testCase and returns true if it generated a test.
+  bool writeTestCase(const TestCase &testCase);
+  void outputTestCase(std::unique_ptr<TestCase> testCase);
+  void minimizeTestCase(std::unique_ptr<TestCase> testCase);
+  /// Moves the files of the kept tests that are not needed for coverage
+  /// by the others into the redundant-tests subdirectory.
+  /// \return the number of tests moved
+  unsigned moveRedundantTests();
+  void enqueueTestCase(std::unique_ptr<TestCase> testCase);
+  void runTestCaseWriter();
+
 public:
   KleeHandler(int argc, char **argv);
   ~KleeHandler();
@@ -356,6 +449,16 @@ public:
 
   void setInterpreter(Interpreter *i);
 
+  /// Waits for the test cases kept by --minimize-tests, reduces them to a
+  /// covering subset and reports how many test cases were kept.
+  void finishMinimizedTests();
+
+  /// Waits until the test cases written in the background are on disk.
+  void waitForTestCases();
+  /// Like waitForTestCases(), for when the process exits without running
+  /// the destructor, e.g. through klee_error().
+  static void waitForTestCasesAtExit();
+
   void processTestCase(const ExecutionState  &state,
                        const char *errorMessage,
                        const char *errorSuffix);
@@ -381,6 +484,10 @@ public:
   static void getKTestFilesInDir(std::string directoryPath,
                                  std::vector<std::string> &results);
 
+  /// Reads the test at \p path, or all of them if it is a pack.
+  /// \return false if a test could not be read
+  static bool readKTests(const std::string &path, std::vector<KTest *> &results);
+
   static std::string getRunTimeLibraryPath(const char *argv0);
 };
 
@@ -458,9 +565,27 @@ KleeHandler::KleeHandler(int argc, char **argv)
 
   // open info
   m_infoFile = openOutputFile("info");
+
+  if (PackKTests) {
+    std::string path = getOutputFilename("tests.ktestpack");
+    m_testPack = kTestPack_create(path.c_str());
+    if (!m_testPack)
+      klee_error("cannot create \"%s\"", path.c_str());
+  }
 }
 
 KleeHandler::~KleeHandler() {
+  if (m_writerThread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(m_writerMutex);
+      m_stopWriter = true;
+    }
+    m_writerCondition.notify_all();
+    m_writerThread.join();
+    theBackgroundWriter = nullptr;
+  }
+  if (m_testPack)
+    kTestPack_close(m_testPack);
   delete m_pathWriter;
   delete m_symPathWriter;
   fclose(klee_warning_file);
@@ -535,8 +660,9 @@ bool KleeHandler::writeTestCaseKTest(
     std::copy(out[i].second.begin(), out[i].second.end(), o->bytes);
   }
   bool status = true;
-  if (!kTest_toFile(&b,
-                    getOutputFilename(getTestFilename("ktest", id)).c_str())) {
+  if (m_testPack ? !kTestPack_append(m_testPack, id, &b)
+                 : !kTest_toFile(&b, getOutputFilename(
+                                         getTestFilename("ktest", id)).c_str())) {
     status = false;
     klee_warning("unable to write output test case, losing it");
   }
@@ -612,118 +738,318 @@ void KleeHandler::processTestCase(const ExecutionState &state,
                                   const char *errorSuffix) {
   unsigned test_id = ++m_numTotalTests;
   if (!WriteNone) {
-    std::vector<std::pair<std::string, std::vector<unsigned char>>> assignments;
-    bool success = m_interpreter->getSymbolicSolution(state, assignments);
-
-    if (!success)
+    // Everything needed from the state is collected first, as the files may
+    // be written after the state is terminated
+    auto testCase = std::make_unique<TestCase>();
+    testCase->id = test_id;
+    // Solved here even with --write-tests-in-background: expressions are
+    // reference counted without atomics and the solver chain is not
+    // thread-safe
+    testCase->hasSolution =
+        m_interpreter->getSymbolicSolution(state, testCase->assignments);
+
+    if (!testCase->hasSolution)
       klee_warning("unable to get symbolic solution, losing test case");
 
     const auto start_time = time::getWallTime();
-    bool atLeastOneGenerated = false;
-
-    if (success) {
-      if (WriteKTests) {
-        if (writeTestCaseKTest(assignments, test_id)) {
-          atLeastOneGenerated = true;
-        }
-      }
-
-      if (WriteXMLTests) {
-        writeTestCaseXML(errorMessage != nullptr, assignments, test_id);
-        atLeastOneGenerated = true;
-      }
-    }
 
     if (errorMessage) {
-      auto f = openTestFile(errorSuffix, test_id);
-      if (f)
-        *f << errorMessage;
+      testCase->isError = true;
+      testCase->errorMessage = errorMessage;
+      testCase->errorSuffix = errorSuffix;
     }
 
-    if (m_pathWriter) {
-      std::vector<unsigned char> concreteBranches;
+    if (m_pathWriter)
       m_pathWriter->readStream(m_interpreter->getPathStreamID(state),
-                               concreteBranches);
-      auto f = openTestFile("path", test_id);
-      if (f) {
-        for (const auto &branch : concreteBranches) {
-          *f << branch << '\n';
-        }
-      }
+                               testCase->concreteBranches);
+
+    if (errorMessage || WriteKQueries)
+      m_interpreter->getConstraintLog(state, testCase->kquery,
+                                      Interpreter::KQUERY);
+
+    // FIXME: If using Z3 as the core solver the emitted file is actually
+    // SMT-LIBv2 not CVC which is a bit confusing
+    if (WriteCVCs)
+      m_interpreter->getConstraintLog(state, testCase->cvc, Interpreter::STP);
+
+    if (WriteSMT2s)
+      m_interpreter->getConstraintLog(state, testCase->smt2,
+                                      Interpreter::SMTLIB2);
+
+    if (m_symPathWriter)
+      m_symPathWriter->readStream(m_interpreter->getSymbolicPathStreamID(state),
+                                  testCase->symbolicBranches);
+
+    if (WriteCov)
+      m_interpreter->getCoveredLines(state, testCase->cov);
+
+    testCase->collectionTime = time::getWallTime() - start_time;
+
+    if (MinimizeTests && !errorMessage && testCase->hasSolution) {
+      m_interpreter->getCoveredBlocks(state, testCase->coveredBlocks);
+      minimizeTestCase(std::move(testCase));
+    } else {
+      outputTestCase(std::move(testCase));
     }
+  } // if (!WriteNone)
+
+  if (errorMessage && OptExitOnError) {
+    waitForTestCases();
+    finishMinimizedTests();
+    m_interpreter->prepareForEarlyExit();
+    klee_error("EXITING ON ERROR:\n%s\n", errorMessage);
+  }
+}
 
-    if (atLeastOneGenerated) {
+void KleeHandler::outputTestCase(std::unique_ptr<TestCase> testCase) {
+  if (WriteTestsInBackground) {
+    // Counted when queued, so that --max-tests halts in time; the writer
+    // takes it back if writing fails
+    if (testCase->hasSolution && (WriteKTests || WriteXMLTests))
       ++m_numGeneratedTests;
+    enqueueTestCase(std::move(testCase));
+  } else if (writeTestCase(*testCase)) {
+    ++m_numGeneratedTests;
+  }
+
+  if (m_numGeneratedTests == MaxTests)
+    m_interpreter->setHaltExecution(true);
+}
+
+void KleeHandler::minimizeTestCase(std::unique_ptr<TestCase> testCase) {
+  ++m_numMinimizedTests;
+
+  // A test is output right away if it covers a block no test kept so far
+  // covers, so that no test is lost if KLEE does not exit normally. Tests
+  // that cover nothing new are dropped, which keeps the memory bounded by
+  // the number of blocks. Without any covered blocks, the first test still
+  // represents the program.
+  bool coversNew = m_numKeptTests == 0;
+  for (std::uint32_t block : testCase->coveredBlocks)
+    coversNew |= m_coveredBlocks.insert(block).second;
+  if (!coversNew)
+    return;
+  ++m_numKeptTests;
+  m_keptTests.emplace_back(testCase->id, testCase->coveredBlocks);
+  outputTestCase(std::move(testCase));
+}
+
+unsigned KleeHandler::moveRedundantTests() {
+  // Tests kept early may be covered by the tests kept after them. Greedily
+  // pick the test covering most of the blocks not covered yet, preferring
+  // earlier tests on ties, until all blocks are covered.
+  std::unordered_set<std::uint32_t> uncovered;
+  for (const auto &test : m_keptTests)
+    uncovered.insert(test.second.begin(), test.second.end());
+  std::vector<bool> needed(m_keptTests.size(), false);
+  if (uncovered.empty() && !m_keptTests.empty())
+    needed.front() = true;
+  while (!uncovered.empty()) {
+    std::size_t best = 0, bestCount = 0;
+    for (std::size_t i = 0; i < m_keptTests.size(); ++i) {
+      if (needed[i])
+        continue;
+      std::size_t count = 0;
+      for (std::uint32_t block : m_keptTests[i].second)
+        count += uncovered.count(block);
+      if (count > bestCount) {
+        best = i;
+        bestCount = count;
+      }
     }
+    needed[best] = true;
+    for (std::uint32_t block : m_keptTests[best].second)
+      uncovered.erase(block);
+  }
+
+  std::unordered_set<unsigned> redundant;
+  for (std::size_t i = 0; i < m_keptTests.size(); ++i)
+    if (!needed[i])
+      redundant.insert(m_keptTests[i].first);
+  if (redundant.empty())
+    return 0;
+
+  const std::string directory = getOutputFilename("redundant-tests");
+  if (auto ec = sys::fs::create_directory(directory)) {
+    klee_warning("unable to create \"%s\": %s", directory.c_str(),
+                 ec.message().c_str());
+    return 0;
+  }
+  // The files of a test are named test<id>.<suffix>
+  std::error_code ec;
+  std::vector<std::string> files;
+  for (sys::fs::directory_iterator i(m_outputDirectory, ec), e;
+       i != e && !ec; i.increment(ec)) {
+    StringRef name = sys::path::filename(i->path());
+    unsigned id;
+    if (name.startswith("test") && name.size() > 11 && name[10] == '.' &&
+        !name.substr(4, 6).getAsInteger(10, id) && redundant.count(id))
+      files.push_back(i->path());
+  }
+  for (const std::string &file : files) {
+    SmallString<128> target(directory);
+    sys::path::append(target, sys::path::filename(file));
+    if (auto ec = sys::fs::rename(file, target))
+      klee_warning("unable to move \"%s\": %s", file.c_str(),
+                   ec.message().c_str());
+  }
+  m_numGeneratedTests -= redundant.size();
+  return redundant.size();
+}
+
+void KleeHandler::finishMinimizedTests() {
+  if (!m_numMinimizedTests)
+    return;
+  // Tests in a pack cannot be moved aside
+  const unsigned moved = m_testPack ? 0 : moveRedundantTests();
+  m_keptTests.clear();
+  klee_message("minimized test suite: kept %u of %u test cases",
+               m_numKeptTests - moved, m_numMinimizedTests);
+  if (moved)
+    klee_message("moved %u redundant test cases to \"%s\"", moved,
+                 getOutputFilename("redundant-tests").c_str());
+  m_numKeptTests -= moved;
+}
+
+bool KleeHandler::writeTestCase(const TestCase &testCase) {
+  const auto start_time = time::getWallTime();
+  unsigned const test_id = testCase.id;
+  bool atLeastOneGenerated = false;
 
-    if (errorMessage || WriteKQueries) {
-      std::string constraints;
-      m_interpreter->getConstraintLog(state, constraints,Interpreter::KQUERY);
-      auto f = openTestFile("kquery", test_id);
-      if (f)
-        *f << constraints;
+  if (testCase.hasSolution) {
+    if (WriteKTests) {
+      if (writeTestCaseKTest(testCase.assignments, test_id)) {
+        atLeastOneGenerated = true;
+      }
     }
 
-    if (WriteCVCs) {
-      // FIXME: If using Z3 as the core solver the emitted file is actually
-      // SMT-LIBv2 not CVC which is a bit confusing
-      std::string constraints;
-      m_interpreter->getConstraintLog(state, constraints, Interpreter::STP);
-      auto f = openTestFile("cvc", test_id);
-      if (f)
-        *f << constraints;
+    if (WriteXMLTests) {
+      writeTestCaseXML(testCase.isError, testCase.assignments, test_id);
+      atLeastOneGenerated = true;
     }
+  }
 
-    if (WriteSMT2s) {
-      std::string constraints;
-        m_interpreter->getConstraintLog(state, constraints, Interpreter::SMTLIB2);
-        auto f = openTestFile("smt2", test_id);
-        if (f)
-          *f << constraints;
+  if (testCase.isError) {
+    auto f = openTestFile(testCase.errorSuffix, test_id);
+    if (f)
+      *f << testCase.errorMessage;
+  }
+
+  if (m_pathWriter) {
+    auto f = openTestFile("path", test_id);
+    if (f) {
+      for (const auto &branch : testCase.concreteBranches) {
+        *f << branch << '\n';
+      }
     }
+  }
 
-    if (m_symPathWriter) {
-      std::vector<unsigned char> symbolicBranches;
-      m_symPathWriter->readStream(m_interpreter->getSymbolicPathStreamID(state),
-                                  symbolicBranches);
-      auto f = openTestFile("sym.path", test_id);
-      if (f) {
-        for (const auto &branch : symbolicBranches) {
-          *f << branch << '\n';
-        }
+  if (testCase.isError || WriteKQueries) {
+    auto f = openTestFile("kquery", test_id);
+    if (f)
+      *f << testCase.kquery;
+  }
+
+  if (WriteCVCs) {
+    auto f = openTestFile("cvc", test_id);
+    if (f)
+      *f << testCase.cvc;
+  }
+
+  if (WriteSMT2s) {
+    auto f = openTestFile("smt2", test_id);
+    if (f)
+      *f << testCase.smt2;
+  }
+
+  if (m_symPathWriter) {
+    auto f = openTestFile("sym.path", test_id);
+    if (f) {
+      for (const auto &branch : testCase.symbolicBranches) {
+        *f << branch << '\n';
       }
     }
+  }
 
-    if (WriteCov) {
-      std::map<const std::string*, std::set<unsigned> > cov;
-      m_interpreter->getCoveredLines(state, cov);
-      auto f = openTestFile("cov", test_id);
-      if (f) {
-        for (const auto &entry : cov) {
-          for (const auto &line : entry.second) {
-            *f << *entry.first << ':' << line << '\n';
-          }
+  if (WriteCov) {
+    auto f = openTestFile("cov", test_id);
+    if (f) {
+      for (const auto &entry : testCase.cov) {
+        for (const auto &line : entry.second) {
+          *f << *entry.first << ':' << line << '\n';
         }
       }
     }
+  }
 
-    if (m_numGeneratedTests == MaxTests)
-      m_interpreter->setHaltExecution(true);
+  if (WriteTestInfo) {
+    time::Span elapsed_time(testCase.collectionTime + time::getWallTime() -
+                            start_time);
+    auto f = openTestFile("info", test_id);
+    if (f)
+      *f << "Time to generate test case: " << elapsed_time << '\n';
+  }
 
-    if (WriteTestInfo) {
-      time::Span elapsed_time(time::getWallTime() - start_time);
-      auto f = openTestFile("info", test_id);
-      if (f)
-        *f << "Time to generate test case: " << elapsed_time << '\n';
+  return atLeastOneGenerated;
+}
+
+void KleeHandler::enqueueTestCase(std::unique_ptr<TestCase> testCase) {
+  std::unique_lock<std::mutex> lock(m_writerMutex);
+  if (!m_writerThread.joinable()) {
+    m_writerThread = std::thread(&KleeHandler::runTestCaseWriter, this);
+    theBackgroundWriter = this;
+    static bool registered = false;
+    if (!registered) {
+      atexit(waitForTestCasesAtExit);
+      registered = true;
     }
-  } // if (!WriteNone)
+  }
 
-  if (errorMessage && OptExitOnError) {
-    m_interpreter->prepareForEarlyExit();
-    klee_error("EXITING ON ERROR:\n%s\n", errorMessage);
+  // Bound the memory of the pending tests by waiting for the writer
+  std::size_t const maxSize = std::size_t(MaxPendingTestsSize) << 20;
+  m_writerCondition.wait(lock, [&] {
+    return m_pendingTests.empty() || m_pendingTestsSize < maxSize;
+  });
+  m_pendingTestsSize += testCase->size();
+  ++m_numUnwrittenTests;
+  m_pendingTests.push_back(std::move(testCase));
+  m_writerCondition.notify_all();
+}
+
+void KleeHandler::runTestCaseWriter() {
+  std::unique_lock<std::mutex> lock(m_writerMutex);
+  while (true) {
+    m_writerCondition.wait(
+        lock, [&] { return m_stopWriter || !m_pendingTests.empty(); });
+    if (m_pendingTests.empty())
+      return;
+
+    std::unique_ptr<TestCase> testCase = std::move(m_pendingTests.front());
+    m_pendingTests.pop_front();
+    lock.unlock();
+    bool const generated = writeTestCase(*testCase);
+    if (!generated && testCase->hasSolution && (WriteKTests || WriteXMLTests))
+      --m_numGeneratedTests;
+    lock.lock();
+
+    m_pendingTestsSize -= testCase->size();
+    --m_numUnwrittenTests;
+    m_writerCondition.notify_all();
   }
 }
 
+void KleeHandler::waitForTestCases() {
+  std::unique_lock<std::mutex> lock(m_writerMutex);
+  m_writerCondition.wait(lock, [&] { return m_numUnwrittenTests == 0; });
+}
+
+void KleeHandler::waitForTestCasesAtExit() {
+  // The writer cannot wait for itself
+  if (theBackgroundWriter && std::this_thread::get_id() !=
+                                 theBackgroundWriter->m_writerThread.get_id())
+    theBackgroundWriter->waitForTestCases();
+}
+
   // load a .path file
 void KleeHandler::loadPathFile(std::string name,
                                      std::vector<bool> &buffer) {
@@ -747,7 +1073,8 @@ void KleeHandler::getKTestFilesInDir(std::string directoryPath,
   llvm::sys::fs::directory_iterator i(directoryPath, ec), e;
   for (; i != e && !ec; i.increment(ec)) {
     auto f = i->path();
-    if (f.size() >= 6 && f.substr(f.size()-6,f.size()) == ".ktest") {
+    if ((f.size() >= 6 && f.substr(f.size()-6,f.size()) == ".ktest") ||
+        (f.size() >= 10 && f.substr(f.size()-10,f.size()) == ".ktestpack")) {
       results.push_back(f);
     }
   }
@@ -759,6 +1086,29 @@ void KleeHandler::getKTestFilesInDir(std::string directoryPath,
   }
 }
 
+bool KleeHandler::readKTests(const std::string &path,
+                             std::vector<KTest *> &results) {
+  if (!kTestPack_isKTestPackFile(path.c_str())) {
+    KTest *out = kTest_fromFile(path.c_str());
+    if (out)
+      results.push_back(out);
+    return out;
+  }
+
+  KTestPack *pack = kTestPack_open(path.c_str());
+  if (!pack)
+    return false;
+  bool success = true;
+  for (unsigned i = 0, e = kTestPack_numTests(pack); i != e && success; ++i) {
+    KTest *out = kTestPack_getTest(pack, i);
+    if (out)
+      results.push_back(out);
+    success = out;
+  }
+  kTestPack_close(pack);
+  return success;
+}
+
 std::string KleeHandler::getRunTimeLibraryPath(const char *argv0) {
   // allow specifying the path to the runtime library
   const char *env = getenv("KLEE_RUNTIME_LIBRARY_PATH");
@@ -892,6 +1242,7 @@ static const char *modelledExternals[] = {
   "klee_get_value_i64",
   "klee_get_obj_size",
   "klee_is_symbolic",
+  "klee_loop_search",
   "klee_make_symbolic",
   "klee_mark_global",
   "klee_open_merge",
@@ -1252,6 +1603,12 @@ int main(int argc, char **argv, char **envp) {
   parseArguments(argc, argv);
   sys::PrintStackTraceOnErrorSignal(argv[0]);
 
+  // Forking for a sandboxed call while the writer thread may hold locks could
+  // deadlock the sandbox process
+  if (WriteTestsInBackground && ExternalCallsSandbox)
+    klee_error("--write-tests-in-background cannot be used with "
+               "--external-calls-sandbox");
+
   if (Watchdog) {
     if (MaxTime.empty()) {
       klee_error("--watchdog used without --max-time");
@@ -1530,6 +1887,8 @@ int main(int argc, char **argv, char **envp) {
   // Get the desired main function.  klee_main initializes uClibc
   // locale and other data and then calls main.
 
+  // The prepared module may be loaded from the module cache instead
+  std::string mainFnName = mainFn ? mainFn->getName().str() : "";
   auto finalModule = interpreter->setModule(loadedModules, Opts);
   entryFn = finalModule->getFunction(EntryPoint);
   if (!entryFn)
@@ -1575,7 +1934,7 @@ int main(int argc, char **argv, char **envp) {
                << "</programfile>\n";
     *meta_file << "\t<programhash>" << XMLMetadataProgramHash
                << "</programhash>\n";
-    *meta_file << "\t<entryfunction>" << mainFn->getName().str()
+    *meta_file << "\t<entryfunction>" << mainFnName
                << "</entryfunction>\n";
     *meta_file << "\t<architecture>"
                << finalModule->getDataLayout().getPointerSizeInBits()
@@ -1608,10 +1967,7 @@ int main(int argc, char **argv, char **envp) {
     for (std::vector<std::string>::iterator
            it = kTestFiles.begin(), ie = kTestFiles.end();
          it != ie; ++it) {
-      KTest *out = kTest_fromFile(it->c_str());
-      if (out) {
-        kTests.push_back(out);
-      } else {
+      if (!KleeHandler::readKTests(*it, kTests)) {
         klee_warning("unable to open: %s\n", (*it).c_str());
       }
     }
@@ -1632,7 +1988,7 @@ int main(int argc, char **argv, char **envp) {
       interpreter->setReplayKTest(out);
       llvm::errs() << "KLEE: replaying: " << *it << " (" << kTest_numBytes(out)
                    << " bytes)"
-                   << " (" << ++i << "/" << kTestFiles.size() << ")\n";
+                   << " (" << ++i << "/" << kTests.size() << ")\n";
       // XXX should put envp in .ktest ?
       interpreter->runFunctionAsMain(entryFn, out->numArgs, out->args, pEnvp);
       if (interrupted) break;
@@ -1647,11 +2003,9 @@ int main(int argc, char **argv, char **envp) {
     for (std::vector<std::string>::iterator
            it = SeedOutFile.begin(), ie = SeedOutFile.end();
          it != ie; ++it) {
-      KTest *out = kTest_fromFile(it->c_str());
-      if (!out) {
+      if (!KleeHandler::readKTests(*it, seeds)) {
         klee_error("unable to open: %s\n", (*it).c_str());
       }
-      seeds.push_back(out);
     }
     for (std::vector<std::string>::iterator
            it = SeedOutDir.begin(), ie = SeedOutDir.end();
@@ -1661,11 +2015,9 @@ int main(int argc, char **argv, char **envp) {
       for (std::vector<std::string>::iterator
              it2 = kTestFiles.begin(), ie = kTestFiles.end();
            it2 != ie; ++it2) {
-        KTest *out = kTest_fromFile(it2->c_str());
-        if (!out) {
+        if (!KleeHandler::readKTests(*it2, seeds)) {
           klee_error("unable to open: %s\n", (*it2).c_str());
         }
-        seeds.push_back(out);
       }
       if (kTestFiles.empty()) {
         klee_error("seeds directory is empty: %s\n", (*it).c_str());
@@ -1692,6 +2044,11 @@ int main(int argc, char **argv, char **envp) {
     }
   }
 
+  // Pending test cases refer to the program arguments and to the
+  // interpreter's module
+  handler->waitForTestCases();
+  handler->finishMinimizedTests();
+
   auto endTime = std::time(nullptr);
   { // output end and elapsed time
     std::uint32_t h;
@@ -1732,6 +2089,8 @@ int main(int argc, char **argv, char **envp) {
     *theStatisticManager->getStatisticByName("Instructions");
   uint64_t forks =
     *theStatisticManager->getStatisticByName("Forks");
+  uint64_t preparedFunctions =
+    *theStatisticManager->getStatisticByName("PreparedFunctions");
 
   handler->getInfoStream()
     << "KLEE: done: explored paths = " << 1 + forks << "\n";
@@ -1746,7 +2105,8 @@ int main(int argc, char **argv, char **envp) {
     << "KLEE: done: total queries = " << queries << "\n"
     << "KLEE: done: valid queries = " << queriesValid << "\n"
     << "KLEE: done: invalid queries = " << queriesInvalid << "\n"
-    << "KLEE: done: query cex = " << queryCounterexamples << "\n";
+    << "KLEE: done: query cex = " << queryCounterexamples << "\n"
+    << "KLEE: done: prepared functions = " << preparedFunctions << "\n";
 
   std::stringstream stats;
   stats << '\n'
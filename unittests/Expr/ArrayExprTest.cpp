@@ -10,9 +10,11 @@
 #include "gtest/gtest.h"
 
 #include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/ArrayEliminator.h"
 #include "klee/Expr/ArrayExprOptimizer.h"
 #include "klee/Expr/Assignment.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprUtil.h"
 
 #include <llvm/Support/CommandLine.h>
 
@@ -21,6 +23,8 @@
 using namespace klee;
 namespace klee {
 extern llvm::cl::opt<ArrayOptimizationType> OptimizeArray;
+extern llvm::cl::opt<unsigned> ArrayValueParallelThreshold;
+extern llvm::cl::opt<unsigned> ArrayValueTableCacheSize;
 }
 
 namespace {
@@ -74,4 +78,162 @@ TEST(ArrayExprTest, HashCollisions) {
   EXPECT_EQ(a->evaluate(oUpdatedRead), getConstant(42, Expr::Int8));
   EXPECT_EQ(a->evaluate(oFirstRead), getConstant(5, Expr::Int8));
 }
+
+TEST(ArrayExprTest, ParallelValueTable) {
+  klee::OptimizeArray = VALUE;
+  klee::ArrayValueParallelThreshold = 16;
+
+  // A table of 32-bit elements with few distinct values
+  std::vector<ref<ConstantExpr>> constVals;
+  for (unsigned i = 0; i < 1024; ++i)
+    constVals.push_back(ConstantExpr::create((i / 64) % 3, Expr::Int8));
+  const Array *array = ac.CreateArray("table", constVals.size(),
+                                      constVals.data(),
+                                      constVals.data() + constVals.size(),
+                                      Expr::Int32, Expr::Int8);
+  const Array *symArray = ac.CreateArray("tableIdx", 4);
+  ref<Expr> symIdx = MulExpr::create(
+      getConstant(4, Expr::Int32),
+      URemExpr::create(Expr::createTempRead(symArray, Expr::Int32),
+                       getConstant(256, Expr::Int32)));
+  ref<Expr> read = ConcatExpr::create4(
+      ReadExpr::create(UpdateList(array, 0),
+                       AddExpr::create(getConstant(3, Expr::Int32), symIdx)),
+      ReadExpr::create(UpdateList(array, 0),
+                       AddExpr::create(getConstant(2, Expr::Int32), symIdx)),
+      ReadExpr::create(UpdateList(array, 0),
+                       AddExpr::create(getConstant(1, Expr::Int32), symIdx)),
+      ReadExpr::create(UpdateList(array, 0), symIdx));
+  ref<Expr> cond = EqExpr::create(read, getConstant(0x02020202, Expr::Int32));
+
+  ExprOptimizer opt;
+  ref<Expr> optimized = opt.optimizeExpr(cond, true);
+  EXPECT_NE(cond, optimized);
+
+  std::vector<const Array *> objects = {symArray};
+  for (unsigned i = 0; i < 256; i += 7) {
+    std::vector<std::vector<unsigned char>> values = {
+        {static_cast<unsigned char>(i), 0, 0, 0}};
+    Assignment a(objects, values);
+    EXPECT_EQ(a.evaluate(cond), a.evaluate(optimized));
+  }
+
+  // A second query over the same table reuses its analysis
+  ref<Expr> other = EqExpr::create(read, getConstant(0, Expr::Int32));
+  EXPECT_NE(other, opt.optimizeExpr(other, true));
+
+  klee::ArrayValueParallelThreshold = 65536;
+  klee::OptimizeArray = NONE;
+}
+
+TEST(ArrayExprTest, ValueTableEviction) {
+  klee::OptimizeArray = VALUE;
+  klee::ArrayValueTableCacheSize = 1;
+
+  // Alternate between two tables, so that each evicts the other's analysis
+  const Array *symArray = ac.CreateArray("evictIdx", 4);
+  ref<Expr> symIdx =
+      URemExpr::create(Expr::createTempRead(symArray, Expr::Int32),
+                       getConstant(64, Expr::Int32));
+  std::vector<ref<Expr>> reads;
+  for (unsigned t = 0; t < 2; ++t) {
+    std::vector<ref<ConstantExpr>> constVals;
+    for (unsigned i = 0; i < 64; ++i)
+      constVals.push_back(ConstantExpr::create((i / 8 + t) % 2, Expr::Int8));
+    const Array *array = ac.CreateArray(t ? "evict1" : "evict0",
+                                        constVals.size(), constVals.data(),
+                                        constVals.data() + constVals.size(),
+                                        Expr::Int32, Expr::Int8);
+    reads.push_back(ReadExpr::create(UpdateList(array, 0), symIdx));
+  }
+
+  ExprOptimizer opt;
+  std::vector<const Array *> objects = {symArray};
+  for (unsigned round = 0; round < 2; ++round) {
+    // A new query in each round, so that evicted tables are analyzed again
+    for (const ref<Expr> &read : reads) {
+      ref<Expr> cond = EqExpr::create(read, getConstant(round, Expr::Int8));
+      ref<Expr> optimized = opt.optimizeExpr(cond, true);
+      EXPECT_NE(cond, optimized);
+      for (unsigned i = 0; i < 64; i += 5) {
+        std::vector<std::vector<unsigned char>> values = {
+            {static_cast<unsigned char>(i), 0, 0, 0}};
+        Assignment a(objects, values);
+        EXPECT_EQ(a.evaluate(cond), a.evaluate(optimized));
+      }
+    }
+  }
+
+  klee::ArrayValueTableCacheSize = 128;
+  klee::OptimizeArray = NONE;
+}
+
+TEST(ArrayExprTest, EliminateConcreteUpdates) {
+  const Array *array = ac.CreateArray("elimArr", 16);
+  const Array *symArray = ac.CreateArray("elimIdx", 4);
+  ref<Expr> symIdx = Expr::createTempRead(symArray, Expr::Int32);
+  UpdateList ul(array, 0);
+  ul.extend(getConstant(3, Expr::Int32), getConstant(11, Expr::Int8));
+  ul.extend(getConstant(6, Expr::Int32), getConstant(42, Expr::Int8));
+  ul.extend(getConstant(3, Expr::Int32), getConstant(13, Expr::Int8));
+  ref<Expr> read = ReadExpr::create(ul, symIdx);
+
+  ArrayEliminator eliminator(128, 64);
+  ref<Expr> eliminated = eliminator.eliminate(read);
+  EXPECT_EQ(Expr::Select, eliminated->getKind());
+
+  // Only the unmodified base array is still read
+  std::vector<ref<ReadExpr>> reads;
+  findReads(eliminated, /*visitUpdates=*/true, reads);
+  for (const auto &re : reads)
+    EXPECT_TRUE(re->updates.head.isNull());
+
+  std::vector<const Array *> objects = {symArray, array};
+  std::vector<unsigned char> base(16, 7);
+  for (unsigned char i = 0; i < 8; ++i) {
+    std::vector<std::vector<unsigned char>> values = {{i, 0, 0, 0}, base};
+    Assignment a(objects, values);
+    EXPECT_EQ(a.evaluate(read), a.evaluate(eliminated));
+  }
+}
+
+TEST(ArrayExprTest, EliminateBoundedRead) {
+  std::vector<ref<ConstantExpr>> constVals;
+  for (unsigned i = 0; i < 32; ++i)
+    constVals.push_back(ConstantExpr::create(i * 3, Expr::Int8));
+  const Array *array =
+      ac.CreateArray("elimConstArr", 32, constVals.data(),
+                     constVals.data() + constVals.size(), Expr::Int32,
+                     Expr::Int8);
+  const Array *symArray = ac.CreateArray("elimBoundIdx", 1);
+  ref<Expr> symByte = Expr::createTempRead(symArray, Expr::Int8);
+  ref<Expr> index = ZExtExpr::create(
+      AndExpr::create(symByte, getConstant(7, Expr::Int8)), Expr::Int32);
+
+  uint64_t bound;
+  ASSERT_TRUE(ArrayEliminator::getUpperBound(index, bound));
+  EXPECT_EQ(7u, bound);
+
+  ref<Expr> read = ReadExpr::create(UpdateList(array, 0), index);
+  ArrayEliminator eliminator(128, 64);
+  ref<Expr> eliminated = eliminator.eliminate(read);
+
+  // The constant array is folded away entirely
+  std::vector<ref<ReadExpr>> reads;
+  findReads(eliminated, /*visitUpdates=*/true, reads);
+  for (const auto &re : reads)
+    EXPECT_EQ(symArray, re->updates.root);
+
+  std::vector<const Array *> objects = {symArray};
+  for (unsigned v = 0; v < 256; v += 5) {
+    std::vector<std::vector<unsigned char>> values = {
+        {static_cast<unsigned char>(v)}};
+    Assignment a(objects, values);
+    EXPECT_EQ(a.evaluate(read), a.evaluate(eliminated));
+  }
+
+  // Reads exceeding the expansion limit are left alone
+  ArrayEliminator smallEliminator(128, 4);
+  EXPECT_EQ(read, smallEliminator.eliminate(read));
+}
 }
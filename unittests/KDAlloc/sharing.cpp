@@ -0,0 +1,92 @@
+//===-- sharing.cpp -------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/KDAlloc/kdalloc.h"
+
+#if defined(USE_GTEST_INSTEAD_OF_MAIN)
+#include "gtest/gtest.h"
+#endif
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+
+namespace {
+struct Usage {
+  std::size_t privateBytes = 0;
+  std::size_t sharedBytes = 0;
+};
+
+Usage getUsage(klee::kdalloc::Allocator const &allocator) {
+  Usage usage;
+  allocator.visitMemory([&usage](void const *, std::size_t bytes,
+                                 bool shared) {
+    (shared ? usage.sharedBytes : usage.privateBytes) += bytes;
+  });
+  return usage;
+}
+} // namespace
+
+void sharing_test() {
+  for (std::uint32_t quarantine : {0u, 8u}) {
+    auto factory = klee::kdalloc::AllocatorFactory(
+        static_cast<std::size_t>(1) << 42, quarantine);
+    auto parent = factory.makeAllocator();
+    [[maybe_unused]] auto *small = parent.allocate(8);
+    [[maybe_unused]] auto *large = parent.allocate(8192);
+
+    auto usage = getUsage(parent);
+    assert(usage.privateBytes > 0);
+    assert(usage.sharedBytes == 0);
+
+    // a fork shares everything
+    auto lhs = parent;
+    usage = getUsage(lhs);
+    assert(usage.privateBytes == 0);
+    assert(usage.sharedBytes > 0);
+
+    // both sides of the fork perform the same allocations
+    auto rhs = parent;
+    parent = klee::kdalloc::Allocator{};
+    [[maybe_unused]] auto *lhsSmall = lhs.allocate(8);
+    [[maybe_unused]] auto *lhsLarge = lhs.allocate(4096);
+    [[maybe_unused]] auto *rhsSmall = rhs.allocate(8);
+    [[maybe_unused]] auto *rhsLarge = rhs.allocate(4096);
+    assert(lhsSmall == rhsSmall);
+    assert(lhsLarge == rhsLarge);
+    assert(getUsage(rhs).privateBytes > 0);
+    assert(lhs.hash() == rhs.hash());
+
+    [[maybe_unused]] auto released = lhs.deduplicate(rhs);
+    assert(released > 0);
+    assert(getUsage(rhs).privateBytes == 0);
+    assert(getUsage(lhs).privateBytes == 0);
+    assert(lhs.deduplicate(rhs) == 0);
+
+    // deduplicated allocators still diverge correctly
+    rhs.free(rhsSmall, 8);
+    assert(lhs.locationInfo(lhsSmall, 8) ==
+           klee::kdalloc::LocationInfo::LI_AllocatedOrQuarantined);
+    assert(lhs.hash() != rhs.hash());
+    assert(lhs.deduplicate(rhs) == 0);
+    [[maybe_unused]] auto *other = lhs.allocate(16);
+    assert(rhs.locationInfo(other, 16) ==
+           klee::kdalloc::LocationInfo::LI_Unallocated);
+  }
+
+  std::exit(0);
+}
+
+#if defined(USE_GTEST_INSTEAD_OF_MAIN)
+TEST(KDAllocDeathTest, Sharing) {
+  ASSERT_EXIT(sharing_test(), ::testing::ExitedWithCode(0), "");
+}
+#else
+int main() { sharing_test(); }
+#endif
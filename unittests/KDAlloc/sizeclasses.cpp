@@ -0,0 +1,107 @@
+//===-- sizeclasses.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/KDAlloc/kdalloc.h"
+
+#if defined(USE_GTEST_INSTEAD_OF_MAIN)
+#include "gtest/gtest.h"
+#endif
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <map>
+
+void size_classes_test() {
+  {
+    // a 300 byte object no longer takes a 2048 byte slot
+    klee::kdalloc::SizeClasses const sizeClasses = {1,  4,   8,   16,
+                                                    64, 256, 512, 2048};
+    assert(klee::kdalloc::isValidSizeClasses(sizeClasses));
+
+    auto factory = klee::kdalloc::AllocatorFactory(
+        static_cast<std::size_t>(1) << 42, 0, sizeClasses);
+    auto allocator = factory.makeAllocator();
+    assert(allocator.getSizeClasses() == sizeClasses);
+
+    auto a = allocator.allocate(300);
+    assert(allocator.getSize(a) == 512);
+    auto b = allocator.allocate(33);
+    assert(allocator.getSize(b) == 64);
+    auto c = allocator.allocate(4000);
+    assert(allocator.getSize(c) >= 4000);
+    assert(allocator.locationInfo(a, 300) ==
+           klee::kdalloc::LocationInfo::LI_AllocatedOrQuarantined);
+
+    // forked allocators share the configuration
+    auto fork = allocator;
+    auto d = fork.allocate(300);
+    assert(fork.getSize(d) == 512);
+    assert(a != d);
+
+    allocator.free(a, 300);
+    allocator.free(b, 33);
+    allocator.free(c, 4000);
+    fork.free(d, 300);
+  }
+
+  {
+    klee::kdalloc::SizeClasses const zero = {0, 4, 8, 16, 32, 64, 256, 2048};
+    assert(!klee::kdalloc::isValidSizeClasses(zero));
+    klee::kdalloc::SizeClasses const duplicate = {1,  4,  4,   16,
+                                                  32, 64, 256, 2048};
+    assert(!klee::kdalloc::isValidSizeClasses(duplicate));
+    klee::kdalloc::SizeClasses const page = {1, 4, 8, 16, 32, 64, 256, 4096};
+    assert(!klee::kdalloc::isValidSizeClasses(page));
+    klee::kdalloc::SizeClasses const odd = {1, 4, 8, 16, 32, 64, 320, 2048};
+    assert(!klee::kdalloc::isValidSizeClasses(odd));
+  }
+
+  {
+    // few distinct sizes each get the class of their power of two
+    std::map<std::size_t, std::uint64_t> histogram = {
+        {300, 10}, {24, 100}, {0, 3}, {5000, 7}};
+    auto sizeClasses = klee::kdalloc::deriveSizeClasses(histogram);
+    assert(klee::kdalloc::isValidSizeClasses(sizeClasses));
+    assert(sizeClasses.back() == klee::kdalloc::defaultSizeClasses.back());
+    for (auto size : {std::size_t{1}, std::size_t{32}, std::size_t{512}}) {
+      bool found = false;
+      for (auto sizeClass : sizeClasses)
+        found |= sizeClass == size;
+      assert(found);
+    }
+  }
+
+  {
+    // many distinct sizes: frequent sizes get the closest classes
+    std::map<std::size_t, std::uint64_t> histogram;
+    for (std::size_t size = 1; size < 1024; ++size)
+      histogram[size] = 1;
+    histogram[40] = 100000;
+    histogram[600] = 100000;
+    auto sizeClasses = klee::kdalloc::deriveSizeClasses(histogram);
+    assert(klee::kdalloc::isValidSizeClasses(sizeClasses));
+    bool found64 = false, found1024 = false;
+    for (auto sizeClass : sizeClasses) {
+      found64 |= sizeClass == 64;
+      found1024 |= sizeClass == 1024;
+    }
+    assert(found64 && found1024);
+  }
+
+  std::exit(0);
+}
+
+#if defined(USE_GTEST_INSTEAD_OF_MAIN)
+TEST(KDAllocDeathTest, SizeClasses) {
+  ASSERT_EXIT(size_classes_test(), ::testing::ExitedWithCode(0), "");
+}
+#else
+int main() { size_classes_test(); }
+#endif
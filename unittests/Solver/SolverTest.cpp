@@ -14,6 +14,7 @@
 #include "klee/Expr/Expr.h"
 #include "klee/Solver/Solver.h"
 #include "klee/Solver/SolverCmdLine.h"
+#include "klee/Solver/SolverImpl.h"
 
 #include "llvm/ADT/StringExtras.h"
 
@@ -167,4 +168,117 @@ TEST(SolverTest, Evaluation) {
   testOpcode<SgeExpr>(*solver);
 }
 
+TEST(SolverTest, NormalizedEvaluation) {
+  auto solver = klee::createCoreSolver(CoreSolverToUse);
+
+  solver = createCexCachingSolver(std::move(solver));
+  solver = createCachingSolver(std::move(solver));
+  solver = createNormalizingSolver(std::move(solver));
+  solver = createIndependentSolver(std::move(solver));
+
+  testOpcode<SelectExpr>(*solver);
+  testOpcode<ZExtExpr>(*solver);
+  testOpcode<AddExpr>(*solver);
+  testOpcode<SubExpr>(*solver);
+  testOpcode<AndExpr>(*solver);
+  testOpcode<EqExpr>(*solver);
+  testOpcode<NeExpr>(*solver);
+  testOpcode<UgtExpr>(*solver);
+  testOpcode<SgeExpr>(*solver);
+}
+
+TEST(SolverTest, ArrayEliminatedEvaluation) {
+  auto solver = klee::createCoreSolver(CoreSolverToUse);
+
+  solver = createArrayEliminatingSolver(std::move(solver), 128, 64);
+  solver = createCexCachingSolver(std::move(solver));
+  solver = createCachingSolver(std::move(solver));
+  solver = createIndependentSolver(std::move(solver));
+
+  testOpcode<SelectExpr>(*solver);
+  testOpcode<ZExtExpr>(*solver);
+  testOpcode<AddExpr>(*solver);
+  testOpcode<AndExpr>(*solver);
+  testOpcode<EqExpr>(*solver);
+  testOpcode<UltExpr>(*solver);
+}
+
+// Records the queries reaching it and answers every truth query with false
+class RecordingSolver : public SolverImpl {
+public:
+  std::vector<ref<Expr>> &exprs;
+  std::vector<ConstraintSet> &constraints;
+
+  RecordingSolver(std::vector<ref<Expr>> &exprs,
+                  std::vector<ConstraintSet> &constraints)
+      : exprs(exprs), constraints(constraints) {}
+
+  bool computeTruth(const Query &query, bool &isValid) override {
+    exprs.push_back(query.expr);
+    constraints.push_back(query.constraints);
+    isValid = false;
+    return true;
+  }
+  bool computeValue(const Query &, ref<Expr> &) override { return false; }
+  bool computeInitialValues(const Query &, const std::vector<const Array *> &,
+                            std::vector<std::vector<unsigned char>> &,
+                            bool &) override {
+    return false;
+  }
+  SolverRunStatus getOperationStatusCode() override {
+    return SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  }
+};
+
+TEST(SolverTest, NormalizationIgnoresNamesAndOrder) {
+  std::vector<ref<Expr>> exprs;
+  std::vector<ConstraintSet> constraints;
+  auto solver = createNormalizingSolver(std::make_unique<Solver>(
+      std::make_unique<RecordingSolver>(exprs, constraints)));
+
+  const Array *a = ac.CreateArray("norm_test_a", 1);
+  const Array *b = ac.CreateArray("norm_test_b", 1);
+  const Array *c = ac.CreateArray("norm_test_c", 1);
+  const Array *d = ac.CreateArray("norm_test_d", 1);
+  ref<Expr> ra = Expr::createTempRead(a, Expr::Int8);
+  ref<Expr> rb = Expr::createTempRead(b, Expr::Int8);
+  ref<Expr> rc = Expr::createTempRead(c, Expr::Int8);
+  ref<Expr> rd = Expr::createTempRead(d, Expr::Int8);
+  ref<Expr> ten = ConstantExpr::create(10, Expr::Int8);
+
+  // (Eq 0 (Eq a b)) with constraints [a u< 10, b u< 10]
+  ConstraintSet first(std::vector<ref<Expr>>{UltExpr::create(ra, ten),
+                                             UltExpr::create(rb, ten)});
+  bool res;
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(first, Expr::createIsZero(EqExpr::create(ra, rb))), res));
+
+  // (Ne d c) with constraints [d u< 10, c u< 10] listed in reverse order
+  ConstraintSet second(std::vector<ref<Expr>>{UltExpr::create(rc, ten),
+                                              UltExpr::create(rd, ten)});
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(second, NeExpr::alloc(rd, rc)), res));
+
+  ASSERT_EQ(2u, exprs.size());
+  EXPECT_EQ(0, exprs[0].compare(exprs[1]))
+      << exprs[0] << " vs. " << exprs[1];
+  EXPECT_TRUE(constraints[0] == constraints[1]);
+}
+
+TEST(SolverTest, NormalizedInitialValuesOfValidQuery) {
+  auto solver =
+      createNormalizingSolver(klee::createCoreSolver(CoreSolverToUse));
+
+  // (Eq a a) folds to true, which has no counterexample
+  const Array *a = ac.CreateArray("norm_test_valid", 1);
+  ref<Expr> ra = Expr::createTempRead(a, Expr::Int8);
+  std::vector<const Array *> objects{a};
+  std::vector<std::vector<unsigned char>> values;
+  bool hasSolution = true;
+  ASSERT_TRUE(solver->impl->computeInitialValues(
+      Query(ConstraintSet(), EqExpr::alloc(ra, ra)), objects, values,
+      hasSolution));
+  EXPECT_FALSE(hasSolution);
+}
+
 }
@@ -0,0 +1,139 @@
+//===-- SpecialFunctionHandlerTest.cpp --------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "Core/SpecialFunctionHandler.h"
+#include "klee/Config/config.h"
+#include "klee/Core/Interpreter.h"
+#include "klee/Expr/Expr.h"
+
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+class TestHandler : public InterpreterHandler {
+  std::string directory;
+
+public:
+  unsigned testCases = 0;
+
+  explicit TestHandler(std::string directory)
+      : directory(std::move(directory)) {}
+
+  llvm::raw_ostream &getInfoStream() const override { return llvm::nulls(); }
+
+  std::string getOutputFilename(const std::string &filename) override {
+    llvm::SmallString<128> path(directory);
+    llvm::sys::path::append(path, filename);
+    return std::string(path);
+  }
+
+  std::unique_ptr<llvm::raw_fd_ostream>
+  openOutputFile(const std::string &filename) override {
+    std::error_code ec;
+    auto f = std::make_unique<llvm::raw_fd_ostream>(
+        getOutputFilename(filename), ec, llvm::sys::fs::OF_None);
+    if (ec)
+      return nullptr;
+    return f;
+  }
+
+  void incPathsCompleted() override {}
+  void incPathsExplored(std::uint32_t) override {}
+
+  void processTestCase(const ExecutionState &, const char *,
+                       const char *) override {
+    ++testCases;
+  }
+};
+
+std::vector<std::uint64_t> handledArguments;
+
+void handleTestFunction(SpecialFunctionHandler &, ExecutionState &,
+                        KInstruction *, std::vector<ref<Expr>> &arguments) {
+  ASSERT_EQ(arguments.size(), 1u);
+  auto *value = dyn_cast<ConstantExpr>(arguments[0]);
+  ASSERT_NE(value, nullptr);
+  handledArguments.push_back(value->getZExtValue());
+}
+
+TEST(SpecialFunctionHandlerTest, RegisteredHandler) {
+  // Calls to the registered function are dispatched to the handler, even
+  // though it is defined, and instead of executing its body, which would
+  // abort the path
+  SpecialFunctionHandler::registerHandler("klee_test_handled",
+                                          handleTestFunction,
+                                          /*doesNotReturn=*/false,
+                                          /*hasReturnValue=*/false);
+
+  // The external dispatcher requires the native target
+  llvm::InitializeNativeTarget();
+
+  llvm::LLVMContext ctx;
+  llvm::SMDiagnostic error;
+  std::unique_ptr<llvm::Module> module = llvm::parseAssemblyString(
+      R"(declare void @abort()
+
+         define void @klee_test_handled(i32 %x) {
+           call void @abort()
+           unreachable
+         }
+
+         define i32 @main() {
+           call void @klee_test_handled(i32 42)
+           call void @klee_test_handled(i32 43)
+           ret i32 0
+         })",
+      error, ctx);
+  ASSERT_TRUE(module) << error.getMessage().str();
+
+  llvm::SmallString<128> directory;
+  ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("klee-sfh", directory));
+  TestHandler handler{std::string(directory)};
+
+  std::unique_ptr<Interpreter> interpreter(
+      Interpreter::create(ctx, Interpreter::InterpreterOptions(), &handler));
+  std::vector<std::unique_ptr<llvm::Module>> modules;
+  modules.push_back(std::move(module));
+  llvm::SmallString<128> libraryDir(KLEE_DIR);
+  llvm::sys::path::append(libraryDir, "runtime", "lib");
+  Interpreter::ModuleOptions opts(std::string(libraryDir), "main",
+                                  std::string("64_") + RUNTIME_CONFIGURATION,
+                                  /*Optimize=*/false, /*CheckDivZero=*/false,
+                                  /*CheckOvershift=*/false);
+  llvm::Module *finalModule = interpreter->setModule(modules, opts);
+  ASSERT_NE(finalModule, nullptr);
+
+  char name[] = "test";
+  char *argv[] = {name, nullptr};
+  char *envp[] = {nullptr};
+  interpreter->runFunctionAsMain(finalModule->getFunction("main"), 1, argv,
+                                 envp);
+  interpreter.reset();
+  llvm::sys::fs::remove_directories(directory);
+
+  EXPECT_EQ(handledArguments, (std::vector<std::uint64_t>{42, 43}));
+  EXPECT_EQ(handler.testCases, 1u);
+}
+
+} // namespace